@@ -16,10 +16,13 @@ set(Boost_COMPONENTS
     iostreams
     regex
 )
+set(Boost_MINIMUM_VERSION 1.59.0)
 if(ENABLE_PYTHON)
-    set(Boost_COMPONENTS python ${Boost_COMPONENTS})
+    set(Boost_COMPONENTS python numpy ${Boost_COMPONENTS})
+    # Boost.Python NumPy extension
+    set(Boost_MINIMUM_VERSION 1.63.0)
 endif()
-find_package(Boost 1.59.0 REQUIRED COMPONENTS ${Boost_COMPONENTS})
+find_package(Boost ${Boost_MINIMUM_VERSION} REQUIRED COMPONENTS ${Boost_COMPONENTS})
 
 #### Python ##################################################################
 if(ENABLE_PYTHON)
@@ -0,0 +1,144 @@
+#include <cap/electrochemical_physics.h>
+#include <cap/geometry.h>
+#include <cap/mp_values.h>
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_renumbering.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/fe/fe_system.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/mpi/environment.hpp>
+#include <boost/mpi/timer.hpp>
+#include <iostream>
+#include <string>
+
+// Measure the time spent assembling the system of ElectrochemicalPhysics when
+// the number of threads increases. The number of threads goes from one to the
+// value given on the command line (default is the number of cores) doubling
+// each time.
+template <int dim>
+void run_benchmark(boost::property_tree::ptree const &device_database,
+                   boost::mpi::communicator &comm,
+                   unsigned int const max_n_threads)
+{
+  // Build the mesh, the degrees of freedom, and the material properties like
+  // SuperCapacitor does.
+  std::shared_ptr<boost::property_tree::ptree> geometry_database =
+      std::make_shared<boost::property_tree::ptree>(
+          device_database.get_child("geometry"));
+  std::shared_ptr<cap::Geometry<dim>> geometry =
+      std::make_shared<cap::Geometry<dim>>(geometry_database, comm);
+  unsigned int const fe_degree = device_database.get("solver.fe_degree", 1);
+  dealii::FESystem<dim> fe(dealii::FE_Q<dim>(fe_degree), 2);
+  std::shared_ptr<dealii::DoFHandler<dim>> dof_handler =
+      std::make_shared<dealii::DoFHandler<dim>>(
+          *geometry->get_triangulation());
+  dof_handler->distribute_dofs(fe);
+  dealii::DoFRenumbering::component_wise(*dof_handler);
+
+  std::shared_ptr<boost::property_tree::ptree> material_properties_database =
+      std::make_shared<boost::property_tree::ptree>(
+          device_database.get_child("material_properties"));
+  cap::MPValuesParameters<dim> mp_values_params(material_properties_database);
+  mp_values_params.geometry = geometry;
+  std::shared_ptr<cap::MPValues<dim>> mp_values =
+      cap::SuperCapacitorMPValuesFactory<dim>::build(mp_values_params);
+
+  // Do not print the timers of ElectrochemicalPhysics.
+  boost::property_tree::ptree physics_database = device_database;
+  physics_database.put("verbosity", 0);
+  std::shared_ptr<cap::ElectrochemicalPhysicsParameters<dim>> params =
+      std::make_shared<cap::ElectrochemicalPhysicsParameters<dim>>(
+          physics_database);
+  params->geometry = geometry;
+  params->dof_handler = dof_handler;
+  params->mp_values = mp_values;
+  params->time_step = 0.1;
+  params->supercapacitor_state = cap::ConstantCurrent;
+  params->constant_current_density = 1.0;
+  params->constant_voltage = 2.1;
+
+  if (comm.rank() == 0)
+  {
+    std::cout << "Number of processors: " << comm.size() << std::endl;
+    std::cout << "n dofs: " << dof_handler->n_dofs() << std::endl;
+    std::cout << "n_threads  assembly time [s]  speedup" << std::endl;
+  }
+
+  unsigned int const n_repetitions = 10;
+  double reference_time = 0.;
+  for (unsigned int n_threads = 1; n_threads <= max_n_threads; n_threads *= 2)
+  {
+    dealii::MultithreadInfo::set_thread_limit(n_threads);
+    params->supercapacitor_state = cap::ConstantCurrent;
+    cap::ElectrochemicalPhysics<dim> physics(params, comm);
+
+    // Switching between imposing the current and imposing the voltage changes
+    // the boundary conditions and forces the system to be assembled again.
+    comm.barrier();
+    boost::mpi::timer timer;
+    for (unsigned int i = 0; i < n_repetitions; ++i)
+    {
+      params->supercapacitor_state =
+          (i % 2 == 0) ? cap::ConstantVoltage : cap::ConstantCurrent;
+      physics.reinit(params);
+    }
+    comm.barrier();
+    double const assembly_time = timer.elapsed() / n_repetitions;
+    if (n_threads == 1)
+      reference_time = assembly_time;
+
+    if (comm.rank() == 0)
+      std::cout << n_threads << "  " << assembly_time << "  "
+                << reference_time / assembly_time << std::endl;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    boost::mpi::environment env(argc, argv);
+    boost::mpi::communicator world;
+
+    boost::property_tree::ptree device_database;
+    boost::property_tree::info_parser::read_info("super_capacitor.info",
+                                                 device_database);
+    unsigned int const max_n_threads =
+        (argc > 1) ? std::stoi(argv[1])
+                   : dealii::MultithreadInfo::n_cores();
+
+    if (device_database.get<int>("dim") == 2)
+      run_benchmark<2>(device_database, world, max_n_threads);
+    else
+      run_benchmark<3>(device_database, world, max_n_threads);
+  }
+  catch (std::exception &exc)
+  {
+    std::cerr << std::endl
+              << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    std::cerr << "Exception on processing: " << std::endl
+              << exc.what() << std::endl
+              << "Aborting!" << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    return 1;
+  }
+  catch (...)
+  {
+    std::cerr << std::endl
+              << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    std::cerr << "Unknown exception!" << std::endl
+              << "Aborting!" << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <cap/energy_storage_device.h>
+#include <cap/resistor_capacitor_batch.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/mpi/environment.hpp>
+#include <boost/mpi/timer.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compare the number of circuits advanced per second when each circuit is an
+// EnergyStorageDevice and when all the circuits are stored in a batch. The
+// number of circuits and the number of time steps can be given on the command
+// line.
+template <typename Batch>
+void run_benchmark(boost::property_tree::ptree const &device_database,
+                   boost::mpi::communicator const &comm,
+                   std::size_t const n_circuits, unsigned int const n_steps)
+{
+  double const time_step = 0.1;
+  double const current = 0.01;
+  double const voltage = 2.1;
+
+  // One device per circuit
+  std::vector<std::shared_ptr<cap::EnergyStorageDevice>> devices;
+  for (std::size_t k = 0; k < n_circuits; ++k)
+    devices.push_back(cap::EnergyStorageDevice::build(device_database, comm));
+  boost::mpi::timer timer;
+  for (unsigned int step = 0; step < n_steps; ++step)
+  {
+    for (auto &device : devices)
+      device->evolve_one_time_step_constant_current(time_step, current);
+    for (auto &device : devices)
+      device->evolve_one_time_step_constant_voltage(time_step, voltage);
+  }
+  double const device_time = timer.elapsed();
+
+  // Batch
+  Batch batch(n_circuits, device_database);
+  timer.restart();
+  for (unsigned int step = 0; step < n_steps; ++step)
+  {
+    batch.evolve_one_time_step_constant_current(time_step, current);
+    batch.evolve_one_time_step_constant_voltage(time_step, voltage);
+  }
+  double const batch_time = timer.elapsed();
+
+  double const n_updates = 2. * n_steps * n_circuits;
+  std::cout << device_database.get<std::string>("type") << std::endl;
+  std::cout << "  EnergyStorageDevice: " << n_updates / device_time
+            << " circuits/s" << std::endl;
+  std::cout << "  Batch:               " << n_updates / batch_time
+            << " circuits/s" << std::endl;
+  std::cout << "  Speedup:             " << device_time / batch_time
+            << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    boost::mpi::environment env(argc, argv);
+    boost::mpi::communicator self(MPI_COMM_SELF, boost::mpi::comm_attach);
+
+    std::size_t const n_circuits = (argc > 1) ? std::stoul(argv[1]) : 10000;
+    unsigned int const n_steps = (argc > 2) ? std::stoi(argv[2]) : 100;
+
+    boost::property_tree::ptree device_database;
+    device_database.put("series_resistance", 50.0e-3);
+    device_database.put("parallel_resistance", 2.5e6);
+    device_database.put("capacitance", 3.0);
+
+    device_database.put("type", "SeriesRC");
+    run_benchmark<cap::SeriesRCBatch>(device_database, self, n_circuits,
+                                      n_steps);
+    device_database.put("type", "ParallelRC");
+    run_benchmark<cap::ParallelRCBatch>(device_database, self, n_circuits,
+                                        n_steps);
+  }
+  catch (std::exception &exc)
+  {
+    std::cerr << std::endl
+              << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    std::cerr << "Exception on processing: " << std::endl
+              << exc.what() << std::endl
+              << "Aborting!" << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    return 1;
+  }
+  catch (...)
+  {
+    std::cerr << std::endl
+              << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    std::cerr << "Unknown exception!" << std::endl
+              << "Aborting!" << std::endl
+              << "----------------------------------------------------"
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,240 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/adaptive_time_stepper.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+namespace internal
+{
+/**
+ * Exponents of the PI controller for a local error in
+ * \f$ \mathcal{O}(\Delta t^2)\f$.
+ */
+double const INTEGRAL_GAIN = 0.7 / 2.;
+double const PROPORTIONAL_GAIN = 0.4 / 2.;
+/**
+ * Bounds on the ratio between two consecutive time steps.
+ */
+double const MIN_FACTOR = 0.2;
+double const MAX_FACTOR = 5.0;
+/**
+ * Errors smaller than this value are rounded up so that the controller does
+ * not divide by zero when the device is integrated exactly.
+ */
+double const MIN_ERROR = 1.0e-10;
+
+bool use_extrapolation(std::string const &error_estimator)
+{
+  if (error_estimator.compare("extrapolation") == 0)
+    return true;
+  else if (error_estimator.compare("step_doubling") == 0)
+    return false;
+  else
+    throw std::runtime_error("invalid error_estimator " + error_estimator);
+}
+}
+
+AdaptiveTimeStepper::AdaptiveTimeStepper(
+    boost::property_tree::ptree const &ptree)
+    : _initial_time_step(ptree.get<double>("initial_time_step")),
+      _min_time_step(
+          ptree.get("min_time_step", 1.0e-6 * _initial_time_step)),
+      _max_time_step(ptree.get("max_time_step",
+                               std::numeric_limits<double>::infinity())),
+      _rel_tolerance(ptree.get("rel_tolerance", 1.0e-3)),
+      _voltage_tolerance(ptree.get("voltage_tolerance", 1.0e-6)),
+      _current_tolerance(ptree.get("current_tolerance", 1.0e-6)),
+      _safety_factor(ptree.get("safety_factor", 0.9)),
+      _max_rejected_steps(ptree.get("max_rejected_steps", 100u)),
+      _extrapolation(internal::use_extrapolation(
+          ptree.get<std::string>("error_estimator", "step_doubling"))),
+      _n_accepted_steps(0), _n_rejected_steps(0)
+{
+  if (!(_initial_time_step > 0.0))
+    throw std::runtime_error("initial_time_step should be positive");
+  if (_max_rejected_steps == 0)
+    throw std::runtime_error("max_rejected_steps should be positive");
+  if (_min_time_step > _initial_time_step)
+    throw std::runtime_error(
+        "min_time_step should not be larger than initial_time_step");
+  reset();
+}
+
+void AdaptiveTimeStepper::reset()
+{
+  _time_step = std::min(_initial_time_step, _max_time_step);
+  _previous_error = 1.0;
+  _n_history = 0;
+}
+
+double AdaptiveTimeStepper::get_time_step() const { return _time_step; }
+
+std::size_t AdaptiveTimeStepper::get_n_accepted_steps() const
+{
+  return _n_accepted_steps;
+}
+
+std::size_t AdaptiveTimeStepper::get_n_rejected_steps() const
+{
+  return _n_rejected_steps;
+}
+
+double AdaptiveTimeStepper::error_norm(double const voltage,
+                                       double const current,
+                                       double const reference_voltage,
+                                       double const reference_current) const
+{
+  double const voltage_error =
+      std::abs(voltage - reference_voltage) /
+      (_voltage_tolerance +
+       _rel_tolerance *
+           std::max(std::abs(voltage), std::abs(reference_voltage)));
+  double const current_error =
+      std::abs(current - reference_current) /
+      (_current_tolerance +
+       _rel_tolerance *
+           std::max(std::abs(current), std::abs(reference_current)));
+  return std::max(voltage_error, current_error);
+}
+
+double AdaptiveTimeStepper::evolve_one_time_step(
+    EnergyStorageDevice &device, TimeEvolution const &evolve_one_time_step,
+    double const max_time_step)
+{
+  unsigned int n_rejected_steps = 0;
+  while (true)
+  {
+    double const time_step = std::min(_time_step, max_time_step);
+    std::unique_ptr<EnergyStorageDeviceSnapshot> const snapshot =
+        device.snapshot();
+    bool const step_doubling = (!_extrapolation) || (_n_history < 2);
+    double voltage;
+    double current;
+    double half_step_voltage = 0.;
+    double half_step_current = 0.;
+    double error;
+    if (step_doubling)
+    {
+      double full_step_voltage;
+      double full_step_current;
+      evolve_one_time_step(device, time_step);
+      device.get_voltage(full_step_voltage);
+      device.get_current(full_step_current);
+      device.restore(*snapshot);
+      evolve_one_time_step(device, 0.5 * time_step);
+      device.get_voltage(half_step_voltage);
+      device.get_current(half_step_current);
+      evolve_one_time_step(device, 0.5 * time_step);
+      device.get_voltage(voltage);
+      device.get_current(current);
+      // For a first order method, the error of the two half steps is the
+      // difference between the two solutions divided by 2^1 - 1.
+      error = error_norm(voltage, current, full_step_voltage,
+                         full_step_current);
+    }
+    else
+    {
+      evolve_one_time_step(device, time_step);
+      device.get_voltage(voltage);
+      device.get_current(current);
+      double const ratio = time_step / _previous_time_step;
+      double const predicted_voltage =
+          _last_voltage + ratio * (_last_voltage - _previous_voltage);
+      double const predicted_current =
+          _last_current + ratio * (_last_current - _previous_current);
+      // The local error of a first order method is
+      // dt/(dt + dt_previous) times the distance to the predictor.
+      error = time_step / (time_step + _previous_time_step) *
+              error_norm(voltage, current, predicted_voltage,
+                         predicted_current);
+    }
+
+    if (error <= 1.0)
+    {
+      ++_n_accepted_steps;
+      double const bounded_error = std::max(error, internal::MIN_ERROR);
+      double factor =
+          _safety_factor * std::pow(bounded_error, -internal::INTEGRAL_GAIN) *
+          std::pow(_previous_error, internal::PROPORTIONAL_GAIN);
+      factor = std::min(internal::MAX_FACTOR,
+                        std::max(internal::MIN_FACTOR, factor));
+      // Do not increase the time step right after a rejection.
+      if (n_rejected_steps > 0)
+        factor = std::min(factor, 1.0);
+      _previous_error = bounded_error;
+      // If the time step was shortened to not overshoot max_time_step, the
+      // time step that was planned is kept unless it needs to be decreased.
+      if ((time_step == _time_step) || (factor < 1.0))
+        _time_step = std::min(time_step * factor, _max_time_step);
+
+      if (step_doubling)
+      {
+        _previous_time_step = 0.5 * time_step;
+        _previous_voltage = half_step_voltage;
+        _previous_current = half_step_current;
+      }
+      else
+      {
+        _previous_time_step = time_step;
+        _previous_voltage = _last_voltage;
+        _previous_current = _last_current;
+      }
+      _last_voltage = voltage;
+      _last_current = current;
+      _n_history = 2;
+
+      return time_step;
+    }
+
+    // Roll back and try again with a smaller time step. If the error is not
+    // finite, e.g. the device produced a NaN, the controller cannot be used
+    // and the time step is shrunk as much as allowed.
+    ++_n_rejected_steps;
+    ++n_rejected_steps;
+    device.restore(*snapshot);
+    double const factor =
+        std::isfinite(error)
+            ? std::max(internal::MIN_FACTOR,
+                       std::min(1.0, _safety_factor * std::pow(error, -0.5)))
+            : internal::MIN_FACTOR;
+    _time_step = time_step * factor;
+    if (_time_step < _min_time_step)
+      throw std::runtime_error("The time step " + std::to_string(_time_step) +
+                               " is smaller than min_time_step " +
+                               std::to_string(_min_time_step));
+    if (n_rejected_steps >= _max_rejected_steps)
+      throw std::runtime_error("The time step was rejected " +
+                               std::to_string(n_rejected_steps) +
+                               " times in a row");
+  }
+}
+
+std::size_t AdaptiveTimeStepper::evolve(
+    EnergyStorageDevice &device, TimeEvolution const &evolve_one_time_step,
+    double const duration)
+{
+  std::size_t n_steps = 0;
+  double time = 0.;
+  // Stop when the remaining time is only round-off.
+  double const time_tolerance = 1.0e-12 * duration;
+  while (duration - time > time_tolerance)
+  {
+    time += this->evolve_one_time_step(device, evolve_one_time_step,
+                                       duration - time);
+    ++n_steps;
+  }
+  return n_steps;
+}
+
+} // end namespace cap
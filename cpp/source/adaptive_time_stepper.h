@@ -0,0 +1,162 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_ADAPTIVE_TIME_STEPPER_H
+#define CAP_ADAPTIVE_TIME_STEPPER_H
+
+#include <cap/energy_storage_device.h>
+#include <boost/property_tree/ptree.hpp>
+#include <functional>
+#include <string>
+
+namespace cap
+{
+
+/**
+ * Adaptive time stepping on top of an EnergyStorageDevice. The local error
+ * on the voltage and on the current is estimated after each time step and
+ * the time step is rejected, i.e. the device is restored to the state it had
+ * before the time step, if the error is larger than the tolerance. The next
+ * time step is chosen by a PI controller.
+ *
+ * Two error estimators are available:
+ *  - step_doubling: the time step is done once with \f$ \Delta t \f$ and
+ *  twice with \f$ \Delta t/2 \f$. This costs three time steps of the device.
+ *  - extrapolation: the solution is compared to the linear extrapolation of
+ *  the last two accepted time steps. This costs a single time step of the
+ *  device. Step doubling is used for the first time step after reset(), when
+ *  there is nothing to extrapolate from.
+ *
+ * The time integrators of the devices are at least first order accurate, so
+ * the estimates assume a local error in \f$ \mathcal{O}(\Delta t^2)\f$. The
+ * extrapolation measures the curvature of the solution, which is the error
+ * of the backward Euler scheme used by default by SuperCapacitor. Step
+ * doubling measures the error of the device itself: the closed-form updates
+ * of the RC circuits are exact for a constant current or voltage, so rests
+ * and holds are done in a handful of time steps that grow up to
+ * max_time_step.
+ *
+ * The parameters are read from a ptree:
+ *  - initial_time_step
+ *  - min_time_step (default 1e-6 initial_time_step): an exception is thrown
+ *  if a smaller time step would be needed
+ *  - max_time_step (default infinity)
+ *  - rel_tolerance (default 1e-3)
+ *  - voltage_tolerance (default 1e-6): absolute tolerance on the voltage
+ *  - current_tolerance (default 1e-6): absolute tolerance on the current
+ *  - error_estimator (default step_doubling)
+ *  - safety_factor (default 0.9)
+ *  - max_rejected_steps (default 100): an exception is thrown if a time step
+ *  is rejected more often in a row
+ *
+ * A time step whose error is not finite, e.g. because the device produced a
+ * NaN, is rejected and the next time step is the smallest one allowed by the
+ * controller.
+ *
+ * Stage and MultiStage use it when their ptree has an adaptive_time_stepping
+ * child holding these parameters.
+ */
+class AdaptiveTimeStepper
+{
+public:
+  /**
+   * Function advancing the device by the given time step with the operating
+   * condition of the current stage.
+   */
+  typedef std::function<void(EnergyStorageDevice &device, double time_step)>
+      TimeEvolution;
+
+  AdaptiveTimeStepper(boost::property_tree::ptree const &ptree);
+
+  /**
+   * Forget the history of the error estimator. This must be called when the
+   * operating condition changes since the voltage and the current are then
+   * discontinuous. The next time step is the initial time step.
+   */
+  void reset();
+
+  /**
+   * Advance @p device by one accepted time step no larger than @p
+   * max_time_step. Rejected time steps are rolled back using
+   * EnergyStorageDevice::snapshot() and EnergyStorageDevice::restore(). Return
+   * the time step that was accepted. An exception is thrown, with the device
+   * in the state it had before the call, if the time step falls below
+   * min_time_step or if it is rejected max_rejected_steps times in a row.
+   */
+  double evolve_one_time_step(EnergyStorageDevice &device,
+                              TimeEvolution const &evolve_one_time_step,
+                              double const max_time_step);
+
+  /**
+   * Advance @p device by @p duration seconds. Return the number of accepted
+   * time steps.
+   */
+  std::size_t evolve(EnergyStorageDevice &device,
+                     TimeEvolution const &evolve_one_time_step,
+                     double const duration);
+
+  /**
+   * Return the time step that will be tried next.
+   */
+  double get_time_step() const;
+
+  /**
+   * Return the number of accepted time steps since the construction of the
+   * object.
+   */
+  std::size_t get_n_accepted_steps() const;
+
+  /**
+   * Return the number of rejected time steps since the construction of the
+   * object.
+   */
+  std::size_t get_n_rejected_steps() const;
+
+private:
+  /**
+   * Return the weighted norm of the difference between (@p voltage, @p
+   * current) and (@p reference_voltage, @p reference_current).
+   */
+  double error_norm(double const voltage, double const current,
+                    double const reference_voltage,
+                    double const reference_current) const;
+
+  double const _initial_time_step;
+  double const _min_time_step;
+  double const _max_time_step;
+  double const _rel_tolerance;
+  double const _voltage_tolerance;
+  double const _current_tolerance;
+  double const _safety_factor;
+  unsigned int const _max_rejected_steps;
+  bool const _extrapolation;
+  /**
+   * Time step that will be tried next.
+   */
+  double _time_step;
+  /**
+   * Error of the last accepted time step, used by the proportional part of
+   * the controller.
+   */
+  double _previous_error;
+  /**
+   * Number of (time step, voltage, current) stored for the extrapolation.
+   * This is zero after reset() and it is at most two.
+   */
+  unsigned int _n_history;
+  double _previous_time_step;
+  double _previous_voltage;
+  double _previous_current;
+  double _last_voltage;
+  double _last_current;
+  std::size_t _n_accepted_steps;
+  std::size_t _n_rejected_steps;
+};
+
+} // end namespace cap
+
+#endif // CAP_ADAPTIVE_TIME_STEPPER_H
@@ -0,0 +1,126 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/data_recorder.h>
+#include <cap/default_inspector.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+DataRecorder::DataRecorder(
+    std::size_t const chunk_size,
+    std::vector<std::string> const &post_processor_keys)
+    : _chunk_size(chunk_size), _keys({"time", "current", "voltage"}),
+      _n_values_in_last_chunk(0), _size(0), _last_time(0.)
+{
+  if (_chunk_size == 0)
+    throw std::runtime_error("chunk_size should be positive");
+  _keys.insert(_keys.end(), post_processor_keys.begin(),
+               post_processor_keys.end());
+}
+
+void DataRecorder::report(double const time, EnergyStorageDevice const &device)
+{
+  if (_chunks.empty() || (_n_values_in_last_chunk == _chunk_size))
+  {
+    _chunks.push_back(
+        std::make_shared<std::vector<double>>(_keys.size() * _chunk_size));
+    _n_values_in_last_chunk = 0;
+  }
+
+  double *values = _chunks.back()->data() + _n_values_in_last_chunk;
+  values[0] = time;
+  device.get_current(values[_chunk_size]);
+  device.get_voltage(values[2 * _chunk_size]);
+  for (std::size_t k = 3; k < _keys.size(); ++k)
+    values[k * _chunk_size] = get_post_processor_value(device, _keys[k]);
+
+  ++_n_values_in_last_chunk;
+  ++_size;
+  _last_time = time;
+}
+
+std::vector<std::string> const &DataRecorder::get_keys() const
+{
+  return _keys;
+}
+
+std::size_t DataRecorder::size() const { return _size; }
+
+std::size_t DataRecorder::get_n_values_in_memory() const
+{
+  if (_chunks.empty())
+    return 0;
+  return (_chunks.size() - 1) * _chunk_size + _n_values_in_last_chunk;
+}
+
+double DataRecorder::get_last_time() const { return _last_time; }
+
+std::size_t DataRecorder::get_chunk_size() const { return _chunk_size; }
+
+std::size_t DataRecorder::get_n_chunks() const { return _chunks.size(); }
+
+std::size_t DataRecorder::get_n_full_chunks() const
+{
+  if (_chunks.empty())
+    return 0;
+  return (_n_values_in_last_chunk == _chunk_size) ? _chunks.size()
+                                                   : _chunks.size() - 1;
+}
+
+std::size_t DataRecorder::get_n_values(std::size_t const chunk) const
+{
+  if (chunk >= _chunks.size())
+    throw std::runtime_error("Chunk " + std::to_string(chunk) +
+                             " is not in memory");
+  return (chunk + 1 == _chunks.size()) ? _n_values_in_last_chunk
+                                       : _chunk_size;
+}
+
+double const *DataRecorder::get_values(std::string const &key,
+                                       std::size_t const chunk) const
+{
+  return get_chunk(chunk)->data() + get_key_index(key) * _chunk_size;
+}
+
+std::shared_ptr<std::vector<double> const>
+DataRecorder::get_chunk(std::size_t const chunk) const
+{
+  if (chunk >= _chunks.size())
+    throw std::runtime_error("Chunk " + std::to_string(chunk) +
+                             " is not in memory");
+  return _chunks[chunk];
+}
+
+void DataRecorder::release_chunks(std::size_t const n_chunks)
+{
+  if (n_chunks > _chunks.size())
+    throw std::runtime_error("Cannot release " + std::to_string(n_chunks) +
+                             " chunks, only " +
+                             std::to_string(_chunks.size()) +
+                             " are in memory");
+  // Erasing moves the remaining pointers but not the chunks, so the pointers
+  // to the values of the chunks that are kept stay valid. The released chunks
+  // are freed once nobody else owns them.
+  _chunks.erase(_chunks.begin(), _chunks.begin() + n_chunks);
+  if (_chunks.empty())
+    _n_values_in_last_chunk = 0;
+}
+
+std::size_t DataRecorder::get_key_index(std::string const &key) const
+{
+  auto const it = std::find(_keys.begin(), _keys.end(), key);
+  if (it == _keys.end())
+    throw std::runtime_error("Key '" + key + "' is not recorded");
+  return std::distance(_keys.begin(), it);
+}
+
+} // end namespace cap
@@ -0,0 +1,125 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_DATA_RECORDER_H
+#define CAP_DATA_RECORDER_H
+
+#include <cap/energy_storage_device.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cap
+{
+
+/**
+ * Record the time, the current, the voltage, and optionally quantities
+ * computed by the postprocessor of the device after each time step. The
+ * values are stored in chunks of fixed size that are allocated once and never
+ * moved. Recording n time steps is therefore O(n), and the chunks can be
+ * exposed without copy, e.g. as numpy arrays, and written to a file as soon as
+ * they are full. The chunks are shared so that a view on a chunk can keep it
+ * alive after it has been released by the recorder.
+ */
+class DataRecorder
+{
+public:
+  /**
+   * Constructor. @p chunk_size is the number of time steps stored in a chunk.
+   * @p post_processor_keys are the additional quantities to record. They are
+   * read from the postprocessor of the device which must then be a
+   * SuperCapacitor.
+   */
+  DataRecorder(std::size_t const chunk_size = 4096,
+               std::vector<std::string> const &post_processor_keys = {});
+
+  /**
+   * Append @p time and the state of @p device.
+   */
+  void report(double const time, EnergyStorageDevice const &device);
+
+  /**
+   * Return the names of the recorded quantities: time, current, voltage, and
+   * the postprocessor keys.
+   */
+  std::vector<std::string> const &get_keys() const;
+
+  /**
+   * Return the number of time steps recorded since the construction,
+   * including the ones in released chunks.
+   */
+  std::size_t size() const;
+
+  /**
+   * Return the number of time steps in the chunks in memory.
+   */
+  std::size_t get_n_values_in_memory() const;
+
+  /**
+   * Return the time of the last recorded time step or zero if nothing has been
+   * recorded.
+   */
+  double get_last_time() const;
+
+  std::size_t get_chunk_size() const;
+
+  /**
+   * Return the number of chunks in memory. Only the last one may be partially
+   * filled.
+   */
+  std::size_t get_n_chunks() const;
+
+  /**
+   * Return the number of chunks in memory that are full.
+   */
+  std::size_t get_n_full_chunks() const;
+
+  /**
+   * Return the number of time steps stored in the chunk @p chunk.
+   */
+  std::size_t get_n_values(std::size_t const chunk) const;
+
+  /**
+   * Return a pointer to the values of @p key in the chunk @p chunk. The
+   * pointer is valid until the chunk is released, or as long as a pointer
+   * returned by get_chunk() is kept.
+   */
+  double const *get_values(std::string const &key,
+                           std::size_t const chunk) const;
+
+  /**
+   * Return the storage of the chunk @p chunk. It stays alive after the chunk
+   * is released, e.g. to own a view returned by get_values().
+   */
+  std::shared_ptr<std::vector<double> const>
+  get_chunk(std::size_t const chunk) const;
+
+  /**
+   * Free the memory of the first @p n_chunks chunks, e.g. after they have been
+   * written to a file. The remaining chunks are renumbered from zero.
+   */
+  void release_chunks(std::size_t const n_chunks);
+
+private:
+  std::size_t get_key_index(std::string const &key) const;
+
+  std::size_t const _chunk_size;
+  std::vector<std::string> _keys;
+  /**
+   * Each chunk stores the values of the keys one after the other, i.e. the
+   * value of the key k at the time step i is at k * _chunk_size + i.
+   */
+  std::vector<std::shared_ptr<std::vector<double>>> _chunks;
+  std::size_t _n_values_in_last_chunk;
+  std::size_t _size;
+  double _last_time;
+};
+
+} // end namespace cap
+
+#endif // CAP_DATA_RECORDER_H
@@ -0,0 +1,21 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/electrochemical_operator.templates.h>
+
+namespace cap
+{
+template class ElectrochemicalOperator<2, 1>;
+template class ElectrochemicalOperator<2, 2>;
+template class ElectrochemicalOperator<2, 3>;
+template class ElectrochemicalOperator<3, 1>;
+template class ElectrochemicalOperator<3, 2>;
+template class ElectrochemicalOperator<3, 3>;
+
+template class ElectrochemicalOperatorFactory<2>;
+template class ElectrochemicalOperatorFactory<3>;
+}
@@ -0,0 +1,252 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_DEAL_II_ELECTROCHEMICAL_OPERATOR_H
+#define CAP_DEAL_II_ELECTROCHEMICAL_OPERATOR_H
+
+#include <cap/electrochemical_physics.h>
+#include <cap/timer.h>
+#include <deal.II/base/subscriptor.h>
+#include <deal.II/base/table.h>
+#include <deal.II/base/vectorization.h>
+#include <deal.II/lac/constraint_matrix.h>
+#include <deal.II/lac/parallel_vector.h>
+#include <deal.II/lac/precondition.h>
+#include <deal.II/lac/solver_control.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/matrix_free/matrix_free.h>
+#include <memory>
+
+namespace cap
+{
+/**
+ * Matrix-free counterpart of ElectrochemicalPhysics. Instead of assembling
+ * sparse matrices, the action of \f$M + \alpha \Delta t K\f$ is evaluated on
+ * the fly using sum factorization on batches of cells. This class also owns the
+ * preconditioner and the Krylov solver used to advance the solution in time.
+ */
+template <int dim>
+class ElectrochemicalOperatorBase
+{
+public:
+  virtual ~ElectrochemicalOperatorBase() = default;
+
+  /**
+   * Update the operator when the time step, the operating mode, or the value
+   * imposed on the cathode has changed. The mesh and the material properties
+   * must be the same as the ones used to build the object.
+   */
+  virtual void
+  reinit(std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const>
+             parameters) = 0;
+
+  /**
+   * Solve \f$(M + \alpha \Delta t K) w = M v + \alpha \Delta t f\f$ where
+   * \f$v\f$ is @p solution when the function is called. @p solution is
+   * replaced by \f$w\f$. For backward Euler this advances @p solution by one
+   * time step, see TimeIntegrator. The Krylov solver starts from @p
+   * initial_guess, which may be @p solution itself. The tolerance used by the
+   * Krylov solver is the maximum of the tolerance of @p solver_control and of
+   * @p rel_tolerance \f$ \times ||b||_{2}\f$.
+   */
+  virtual void evolve_one_time_step(
+      dealii::SolverControl &solver_control, double const rel_tolerance,
+      dealii::Trilinos::MPI::Vector &solution,
+      dealii::Trilinos::MPI::Vector const &initial_guess) const = 0;
+
+  /**
+   * Solve \f$(M + \alpha \Delta t K) w = \alpha \Delta t N\f$ where
+   * \f$N\f$ is the load vector of a unit current density on the cathode and
+   * store \f$w\f$ in @p response. The current must be imposed on the cathode.
+   */
+  virtual void compute_unit_current_response(
+      dealii::SolverControl &solver_control, double const rel_tolerance,
+      dealii::Trilinos::MPI::Vector &response) const = 0;
+
+  /**
+   * Return the integral of the solid potential of @p solution on the cathode.
+   * The current must be imposed on the cathode.
+   */
+  virtual double integrate_cathode_potential(
+      dealii::Trilinos::MPI::Vector const &solution) const = 0;
+};
+
+template <int dim, int fe_degree>
+class ElectrochemicalOperator : public ElectrochemicalOperatorBase<dim>,
+                                public dealii::Subscriptor
+{
+public:
+  typedef dealii::distributed::Vector<double> VectorType;
+
+  ElectrochemicalOperator(
+      std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters,
+      boost::mpi::communicator mpi_communicator);
+
+  ~ElectrochemicalOperator();
+
+  void reinit(std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const>
+                  parameters) override;
+
+  void evolve_one_time_step(
+      dealii::SolverControl &solver_control, double const rel_tolerance,
+      dealii::Trilinos::MPI::Vector &solution,
+      dealii::Trilinos::MPI::Vector const &initial_guess) const override;
+
+  void compute_unit_current_response(
+      dealii::SolverControl &solver_control, double const rel_tolerance,
+      dealii::Trilinos::MPI::Vector &response) const override;
+
+  double integrate_cathode_potential(
+      dealii::Trilinos::MPI::Vector const &solution) const override;
+
+  /**
+   * Number of rows of the operator.
+   */
+  dealii::types::global_dof_index m() const;
+
+  /**
+   * Number of columns of the operator.
+   */
+  dealii::types::global_dof_index n() const;
+
+  /**
+   * Apply \f$M + \Delta t K\f$ to @p src. The constrained degrees of freedom
+   * are treated as zero and the rows associated to them are replaced by the
+   * identity.
+   */
+  void vmult(VectorType &dst, VectorType const &src) const;
+
+  /**
+   * The operator is symmetric so this is the same as vmult().
+   */
+  void Tvmult(VectorType &dst, VectorType const &src) const;
+
+  /**
+   * Initialize @p vector with the parallel layout used by the operator.
+   */
+  void initialize_dof_vector(VectorType &vector) const;
+
+private:
+  /**
+   * Build the MatrixFree object, the tables of coefficients, the Neumann load
+   * vector, and the diagonal of the mass and of the stiffness matrices. This
+   * needs to be done again when the Dirichlet boundary conditions change.
+   */
+  void setup();
+
+  /**
+   * Evaluate @p mass_factor \f$ M \f$ + @p stiffness_factor \f$ K \f$ on the
+   * cells in @p cell_range. If @p plain is true the constraints are ignored
+   * when reading the values in @p src.
+   */
+  template <bool plain>
+  void apply_cell_range(dealii::MatrixFree<dim, double> const &data,
+                        VectorType &dst, VectorType const &src,
+                        std::pair<unsigned int, unsigned int> const &cell_range,
+                        double const mass_factor,
+                        double const stiffness_factor) const;
+
+  /**
+   * Cell kernel of vmult().
+   */
+  void local_apply(dealii::MatrixFree<dim, double> const &data,
+                   VectorType &dst, VectorType const &src,
+                   std::pair<unsigned int, unsigned int> const &cell_range) const;
+
+  /**
+   * Cell kernel computing the contribution of the previous time step to the
+   * right-hand side.
+   */
+  void local_apply_mass(
+      dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+      VectorType const &src,
+      std::pair<unsigned int, unsigned int> const &cell_range) const;
+
+  /**
+   * Cell kernel computing the contribution of the Dirichlet boundary
+   * conditions to the right-hand side.
+   */
+  void local_apply_lifting(
+      dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+      VectorType const &src,
+      std::pair<unsigned int, unsigned int> const &cell_range) const;
+
+  typedef dealii::PreconditionChebyshev<ElectrochemicalOperator<dim, fe_degree>,
+                                        VectorType>
+      PreconditionerType;
+
+  boost::mpi::communicator _mpi_communicator;
+  unsigned int _verbose_lvl;
+  std::shared_ptr<dealii::DoFHandler<dim>> _dof_handler;
+  std::shared_ptr<Geometry<dim> const> _geometry;
+  std::shared_ptr<MPValuesCache<dim> const> _mp_values_cache;
+  dealii::IndexSet _locally_owned_dofs;
+  dealii::IndexSet _locally_relevant_dofs;
+  unsigned int _solid_potential_component;
+  unsigned int _liquid_potential_component;
+  SuperCapacitorState _supercapacitor_state;
+  bool _cathode_dirichlet_bc;
+  double _constant_current_density;
+  /**
+   * Time step multiplied by the implicit factor of the time integrator.
+   */
+  double _time_step;
+  double _cathode_voltage;
+  unsigned int _chebyshev_degree;
+  double _chebyshev_smoothing_range;
+  /**
+   * Constraints with the value imposed on the cathode. They are used to lift
+   * the Dirichlet boundary conditions and to set the constrained values of the
+   * solution.
+   */
+  dealii::ConstraintMatrix _constraint_matrix;
+  /**
+   * Same as _constraint_matrix but all the Dirichlet values are zero. These
+   * are the constraints used by the MatrixFree object.
+   */
+  dealii::ConstraintMatrix _homogeneous_constraint_matrix;
+  dealii::MatrixFree<dim, double> _matrix_free;
+  /**
+   * Material properties evaluated at the quadrature points of each batch of
+   * cells.
+   */
+  dealii::Table<2, dealii::VectorizedArray<double>> _specific_capacitance;
+  dealii::Table<2, dealii::VectorizedArray<double>>
+      _faradaic_reaction_coefficient;
+  dealii::Table<2, dealii::VectorizedArray<double>>
+      _solid_electrical_conductivity;
+  dealii::Table<2, dealii::VectorizedArray<double>>
+      _liquid_electrical_conductivity;
+  /**
+   * Load vector for a unit current density on the cathode.
+   */
+  VectorType _neumann_load;
+  /**
+   * Diagonal of the mass and of the stiffness matrices. They are combined to
+   * form the diagonal used by the Chebyshev preconditioner.
+   */
+  VectorType _mass_diagonal;
+  VectorType _stiffness_diagonal;
+  PreconditionerType _preconditioner;
+  Timer _setup_timer;
+};
+
+/**
+ * Factory that dispatches the run-time degree of the finite element to the
+ * right instantiation of ElectrochemicalOperator.
+ */
+template <int dim>
+class ElectrochemicalOperatorFactory
+{
+public:
+  static std::unique_ptr<ElectrochemicalOperatorBase<dim>>
+  build(std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters,
+        boost::mpi::communicator mpi_communicator);
+};
+}
+
+#endif
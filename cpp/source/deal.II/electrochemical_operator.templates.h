@@ -0,0 +1,534 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_DEAL_II_ELECTROCHEMICAL_OPERATOR_TEMPLATES_H
+#define CAP_DEAL_II_ELECTROCHEMICAL_OPERATOR_TEMPLATES_H
+
+#include <cap/electrochemical_operator.h>
+#include <boost/assert.hpp>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/dofs/dof_tools.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/lac/solver_cg.h>
+#include <deal.II/matrix_free/fe_evaluation.h>
+#include <iostream>
+#include <stdexcept>
+
+namespace cap
+{
+template <int dim, int fe_degree>
+ElectrochemicalOperator<dim, fe_degree>::ElectrochemicalOperator(
+    std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters,
+    boost::mpi::communicator mpi_communicator)
+    : _mpi_communicator(mpi_communicator),
+      _verbose_lvl(parameters->database.get("verbosity", 0)),
+      _dof_handler(parameters->dof_handler), _geometry(parameters->geometry),
+      _mp_values_cache(parameters->mp_values_cache),
+      _solid_potential_component(-1),
+      _liquid_potential_component(-1),
+      _supercapacitor_state(parameters->supercapacitor_state),
+      _cathode_dirichlet_bc(parameters->supercapacitor_state ==
+                            ConstantVoltage),
+      _constant_current_density(0.), _time_step(0.), _cathode_voltage(0.),
+      _chebyshev_degree(0), _chebyshev_smoothing_range(0.),
+      _setup_timer(mpi_communicator, "ElectrochemicalOperator setup")
+{
+  boost::property_tree::ptree const &database = parameters->database;
+
+  // clang-format off
+  _solid_potential_component  = database.get<unsigned int>("solid_potential_component");
+  _liquid_potential_component = database.get<unsigned int>("liquid_potential_component");
+  _chebyshev_degree           = database.get("solver.chebyshev_degree", 5);
+  _chebyshev_smoothing_range  = database.get("solver.chebyshev_smoothing_range", 20.);
+  // clang-format on
+
+  BOOST_ASSERT_MSG(_dof_handler->get_fe().degree ==
+                       static_cast<unsigned int>(fe_degree),
+                   "The degree of the finite element does not match the "
+                   "degree of the ElectrochemicalOperator");
+
+  if (_mp_values_cache == nullptr)
+    _mp_values_cache = std::make_shared<MPValuesCache<dim>>(
+        *(parameters->mp_values), *_dof_handler,
+        dealii::QGauss<dim>(fe_degree + 1));
+
+  _locally_owned_dofs = _dof_handler->locally_owned_dofs();
+  dealii::DoFTools::extract_locally_relevant_dofs(*_dof_handler,
+                                                  _locally_relevant_dofs);
+
+  setup();
+  reinit(parameters);
+}
+
+template <int dim, int fe_degree>
+ElectrochemicalOperator<dim, fe_degree>::~ElectrochemicalOperator()
+{
+  if (_verbose_lvl > 0)
+    _setup_timer.print();
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::setup()
+{
+  _setup_timer.start();
+
+  make_electrochemical_constraints(
+      *_dof_handler, *_geometry, _locally_relevant_dofs,
+      _solid_potential_component, _cathode_dirichlet_bc, 0.,
+      _homogeneous_constraint_matrix);
+
+  typename dealii::MatrixFree<dim, double>::AdditionalData additional_data;
+  additional_data.tasks_parallel_scheme =
+      dealii::MatrixFree<dim, double>::AdditionalData::none;
+  additional_data.mapping_update_flags =
+      dealii::update_values | dealii::update_gradients |
+      dealii::update_JxW_values | dealii::update_quadrature_points;
+  _matrix_free.reinit(*_dof_handler, _homogeneous_constraint_matrix,
+                      dealii::QGauss<1>(fe_degree + 1), additional_data);
+
+  // Evaluate the material properties at the quadrature points of each batch of
+  // cells. The quadrature points of QGauss<dim> are ordered like the ones
+  // used by FEEvaluation.
+  dealii::FiniteElement<dim> const &fe = _dof_handler->get_fe();
+  dealii::QGauss<dim> quadrature_rule(fe_degree + 1);
+  unsigned int const n_q_points = quadrature_rule.size();
+  unsigned int const n_cells = _matrix_free.n_macro_cells();
+  dealii::FEValues<dim> fe_values(fe, quadrature_rule,
+                                  dealii::update_values |
+                                      dealii::update_gradients |
+                                      dealii::update_JxW_values |
+                                      dealii::update_quadrature_points);
+  _specific_capacitance.reinit(n_cells, n_q_points);
+  _faradaic_reaction_coefficient.reinit(n_cells, n_q_points);
+  _solid_electrical_conductivity.reinit(n_cells, n_q_points);
+  _liquid_electrical_conductivity.reinit(n_cells, n_q_points);
+  std::vector<double> specific_capacitance_values(n_q_points);
+  std::vector<double> faradaic_reaction_coefficient_values(n_q_points);
+  std::vector<double> solid_electrical_conductivity_values(n_q_points);
+  std::vector<double> liquid_electrical_conductivity_values(n_q_points);
+
+  // The diagonal of the matrices is needed by the preconditioner.
+  dealii::FEValuesExtractors::Scalar const solid_potential(
+      _solid_potential_component);
+  dealii::FEValuesExtractors::Scalar const liquid_potential(
+      _liquid_potential_component);
+  unsigned int const dofs_per_cell = fe.dofs_per_cell;
+  dealii::Vector<double> cell_mass_diagonal(dofs_per_cell);
+  dealii::Vector<double> cell_stiffness_diagonal(dofs_per_cell);
+  std::vector<dealii::types::global_dof_index> local_dof_indices(dofs_per_cell);
+  initialize_dof_vector(_mass_diagonal);
+  initialize_dof_vector(_stiffness_diagonal);
+
+  for (unsigned int cell = 0; cell < n_cells; ++cell)
+  {
+    for (unsigned int q = 0; q < n_q_points; ++q)
+    {
+      _specific_capacitance(cell, q) = 0.;
+      _faradaic_reaction_coefficient(cell, q) = 0.;
+      _solid_electrical_conductivity(cell, q) = 0.;
+      _liquid_electrical_conductivity(cell, q) = 0.;
+    }
+    for (unsigned int v = 0; v < _matrix_free.n_components_filled(cell); ++v)
+    {
+      auto dof_cell = _matrix_free.get_cell_iterator(cell, v);
+      fe_values.reinit(dof_cell);
+
+      unsigned int const cell_index = dof_cell->active_cell_index();
+      // clang-format off
+      _mp_values_cache->get_values(MaterialProperty::specific_capacitance,           cell_index, specific_capacitance_values);
+      _mp_values_cache->get_values(MaterialProperty::faradaic_reaction_coefficient,  cell_index, faradaic_reaction_coefficient_values);
+      _mp_values_cache->get_values(MaterialProperty::solid_electrical_conductivity,  cell_index, solid_electrical_conductivity_values);
+      _mp_values_cache->get_values(MaterialProperty::liquid_electrical_conductivity, cell_index, liquid_electrical_conductivity_values);
+      // clang-format on
+
+      cell_mass_diagonal = 0.;
+      cell_stiffness_diagonal = 0.;
+      for (unsigned int q = 0; q < n_q_points; ++q)
+      {
+        // clang-format off
+        _specific_capacitance(cell, q)[v]           = specific_capacitance_values[q];
+        _faradaic_reaction_coefficient(cell, q)[v]  = faradaic_reaction_coefficient_values[q];
+        _solid_electrical_conductivity(cell, q)[v]  = solid_electrical_conductivity_values[q];
+        _liquid_electrical_conductivity(cell, q)[v] = liquid_electrical_conductivity_values[q];
+        // clang-format on
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i)
+        {
+          double const potential_difference =
+              fe_values[solid_potential].value(i, q) -
+              fe_values[liquid_potential].value(i, q);
+          double const potential_difference_square =
+              potential_difference * potential_difference;
+          cell_mass_diagonal[i] += specific_capacitance_values[q] *
+                                   potential_difference_square *
+                                   fe_values.JxW(q);
+          cell_stiffness_diagonal[i] +=
+              (solid_electrical_conductivity_values[q] *
+                   fe_values[solid_potential].gradient(i, q).norm_square() +
+               liquid_electrical_conductivity_values[q] *
+                   fe_values[liquid_potential].gradient(i, q).norm_square() +
+               faradaic_reaction_coefficient_values[q] *
+                   potential_difference_square) *
+              fe_values.JxW(q);
+        }
+      }
+      dof_cell->get_dof_indices(local_dof_indices);
+      _homogeneous_constraint_matrix.distribute_local_to_global(
+          cell_mass_diagonal, local_dof_indices, _mass_diagonal);
+      _homogeneous_constraint_matrix.distribute_local_to_global(
+          cell_stiffness_diagonal, local_dof_indices, _stiffness_diagonal);
+    }
+  }
+  _mass_diagonal.compress(dealii::VectorOperation::add);
+  _stiffness_diagonal.compress(dealii::VectorOperation::add);
+
+  // Assemble the load vector of the Neumann boundary condition on the cathode
+  // for a unit current density.
+  initialize_dof_vector(_neumann_load);
+  if (!_cathode_dirichlet_bc)
+  {
+    auto const &cathode_boundary_ids =
+        (*_geometry->get_boundaries())["cathode"];
+    dealii::QGauss<dim - 1> face_quadrature_rule(fe_degree + 1);
+    unsigned int const n_face_q_points = face_quadrature_rule.size();
+    dealii::FEFaceValues<dim> fe_face_values(
+        fe, face_quadrature_rule, dealii::update_values |
+                                      dealii::update_JxW_values |
+                                      dealii::update_quadrature_points);
+    dealii::Vector<double> cell_rhs(dofs_per_cell);
+    for (auto cell : _dof_handler->active_cell_iterators())
+      if (cell->is_locally_owned() && cell->at_boundary())
+      {
+        cell_rhs = 0.0;
+        for (unsigned int face = 0;
+             face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
+        {
+          if ((cell->face(face)->at_boundary()) &&
+              (cathode_boundary_ids.count(cell->face(face)->boundary_id()) > 0))
+          {
+            fe_face_values.reinit(cell, face);
+            for (unsigned int q = 0; q < n_face_q_points; ++q)
+              for (unsigned int i = 0; i < dofs_per_cell; ++i)
+                cell_rhs[i] += fe_face_values[solid_potential].value(i, q) *
+                               fe_face_values.JxW(q);
+          }
+        }
+        cell->get_dof_indices(local_dof_indices);
+        _homogeneous_constraint_matrix.distribute_local_to_global(
+            cell_rhs, local_dof_indices, _neumann_load);
+      }
+    _neumann_load.compress(dealii::VectorOperation::add);
+  }
+
+  _setup_timer.stop();
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::reinit(
+    std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters)
+{
+  // The Robin boundary condition of a constant load needs face integrals which
+  // the MatrixFree object does not provide.
+  if (parameters->supercapacitor_state == ConstantLoad)
+    throw std::runtime_error(
+        "The constant load is not implemented with the matrix-free operator.");
+
+  // The MatrixFree object depends on the Dirichlet boundary conditions. It
+  // only needs to be rebuilt if the boundary conditions have changed.
+  bool const cathode_dirichlet_bc =
+      (parameters->supercapacitor_state == ConstantVoltage);
+  bool const new_boundary_conditions =
+      (cathode_dirichlet_bc != _cathode_dirichlet_bc);
+  if (new_boundary_conditions)
+  {
+    _cathode_dirichlet_bc = cathode_dirichlet_bc;
+    setup();
+  }
+
+  // Same as ElectrochemicalPhysics, the time step is scaled by the implicit
+  // factor of the time integrator.
+  double const time_step =
+      get_implicit_factor(parameters->time_integrator) * parameters->time_step;
+  bool const new_time_step = (time_step != _time_step);
+  _supercapacitor_state = parameters->supercapacitor_state;
+  _constant_current_density = parameters->constant_current_density;
+  _time_step = time_step;
+  _cathode_voltage = _cathode_dirichlet_bc ? parameters->constant_voltage : 0.;
+  make_electrochemical_constraints(
+      *_dof_handler, *_geometry, _locally_relevant_dofs,
+      _solid_potential_component, _cathode_dirichlet_bc, _cathode_voltage,
+      _constraint_matrix);
+
+  // The preconditioner only depends on the diagonal of M + dt * K. The rows
+  // of the constrained degrees of freedom are the identity.
+  if (new_time_step || new_boundary_conditions)
+  {
+    typename PreconditionerType::AdditionalData additional_data;
+    additional_data.degree = _chebyshev_degree;
+    additional_data.smoothing_range = _chebyshev_smoothing_range;
+    initialize_dof_vector(additional_data.matrix_diagonal_inverse);
+    for (auto const i : _locally_owned_dofs)
+    {
+      double const diagonal =
+          _mass_diagonal(i) + _time_step * _stiffness_diagonal(i);
+      additional_data.matrix_diagonal_inverse(i) =
+          (_homogeneous_constraint_matrix.is_constrained(i) ||
+           (diagonal <= 0.))
+              ? 1.
+              : 1. / diagonal;
+    }
+    _preconditioner.initialize(*this, additional_data);
+  }
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::evolve_one_time_step(
+    dealii::SolverControl &solver_control, double const rel_tolerance,
+    dealii::Trilinos::MPI::Vector &solution,
+    dealii::Trilinos::MPI::Vector const &initial_guess) const
+{
+  // Copy the solution at the previous time step.
+  VectorType old_solution;
+  initialize_dof_vector(old_solution);
+  for (auto const i : _locally_owned_dofs)
+    old_solution(i) = solution(i);
+
+  // M * u_old
+  VectorType system_rhs;
+  initialize_dof_vector(system_rhs);
+  _matrix_free.cell_loop(&ElectrochemicalOperator::local_apply_mass, this,
+                         system_rhs, old_solution);
+
+  // Lift the Dirichlet boundary conditions: -(M + dt * K) * g where g is zero
+  // everywhere except on the constrained degrees of freedom.
+  if (_cathode_dirichlet_bc)
+  {
+    VectorType lifting;
+    VectorType dirichlet_values;
+    initialize_dof_vector(lifting);
+    initialize_dof_vector(dirichlet_values);
+    for (auto const i : _locally_owned_dofs)
+      if (_constraint_matrix.is_inhomogeneously_constrained(i))
+        dirichlet_values(i) = _constraint_matrix.get_inhomogeneity(i);
+    _matrix_free.cell_loop(&ElectrochemicalOperator::local_apply_lifting,
+                           this, lifting, dirichlet_values);
+    system_rhs += lifting;
+  }
+  else if (_supercapacitor_state == ConstantCurrent)
+    system_rhs.add(_time_step * _constant_current_density, _neumann_load);
+
+  // The rows of the constrained degrees of freedom are the identity. The
+  // solution at the previous time step is reused to store the initial guess.
+  if (&initial_guess != &solution)
+    for (auto const i : _locally_owned_dofs)
+      old_solution(i) = initial_guess(i);
+  for (auto const i : _matrix_free.get_constrained_dofs())
+  {
+    system_rhs.local_element(i) = 0.;
+    old_solution.local_element(i) = 0.;
+  }
+
+  solver_control.set_tolerance(std::max(
+      solver_control.tolerance(), rel_tolerance * system_rhs.l2_norm()));
+  dealii::SolverCG<VectorType> solver(solver_control);
+  solver.solve(*this, old_solution, system_rhs, _preconditioner);
+
+  // Copy the result back and set the constrained values.
+  for (auto const i : _locally_owned_dofs)
+    solution(i) = old_solution(i);
+  solution.compress(dealii::VectorOperation::insert);
+  _constraint_matrix.distribute(solution);
+
+  if ((_verbose_lvl > 0) && (_mpi_communicator.rank() == 0))
+  {
+    std::cout << "Initial value: " << solver_control.initial_value()
+              << std::endl;
+    std::cout << "Last value: " << solver_control.last_value() << std::endl;
+    std::cout << "Number of iterations: " << solver_control.last_step()
+              << std::endl
+              << std::endl;
+  }
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::compute_unit_current_response(
+    dealii::SolverControl &solver_control, double const rel_tolerance,
+    dealii::Trilinos::MPI::Vector &response) const
+{
+  BOOST_ASSERT_MSG(!_cathode_dirichlet_bc,
+                   "The current must be imposed on the cathode");
+
+  // dt * N. The rows of the constrained degrees of freedom are the identity.
+  VectorType system_rhs;
+  initialize_dof_vector(system_rhs);
+  system_rhs.add(_time_step, _neumann_load);
+  for (auto const i : _matrix_free.get_constrained_dofs())
+    system_rhs.local_element(i) = 0.;
+
+  VectorType solution;
+  initialize_dof_vector(solution);
+  solver_control.set_tolerance(std::max(
+      solver_control.tolerance(), rel_tolerance * system_rhs.l2_norm()));
+  dealii::SolverCG<VectorType> solver(solver_control);
+  solver.solve(*this, solution, system_rhs, _preconditioner);
+
+  for (auto const i : _locally_owned_dofs)
+    response(i) = solution(i);
+  response.compress(dealii::VectorOperation::insert);
+  _homogeneous_constraint_matrix.distribute(response);
+}
+
+template <int dim, int fe_degree>
+double ElectrochemicalOperator<dim, fe_degree>::integrate_cathode_potential(
+    dealii::Trilinos::MPI::Vector const &solution) const
+{
+  BOOST_ASSERT_MSG(!_cathode_dirichlet_bc,
+                   "The current must be imposed on the cathode");
+
+  double integral = 0.;
+  for (auto const i : _locally_owned_dofs)
+    integral += _neumann_load(i) * solution(i);
+  return dealii::Utilities::MPI::sum(integral, _mpi_communicator);
+}
+
+template <int dim, int fe_degree>
+dealii::types::global_dof_index
+ElectrochemicalOperator<dim, fe_degree>::m() const
+{
+  return _dof_handler->n_dofs();
+}
+
+template <int dim, int fe_degree>
+dealii::types::global_dof_index
+ElectrochemicalOperator<dim, fe_degree>::n() const
+{
+  return _dof_handler->n_dofs();
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::vmult(
+    VectorType &dst, VectorType const &src) const
+{
+  dst = 0.;
+  _matrix_free.cell_loop(&ElectrochemicalOperator::local_apply, this, dst, src);
+  for (auto const i : _matrix_free.get_constrained_dofs())
+    dst.local_element(i) = src.local_element(i);
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::Tvmult(
+    VectorType &dst, VectorType const &src) const
+{
+  vmult(dst, src);
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::initialize_dof_vector(
+    VectorType &vector) const
+{
+  _matrix_free.initialize_dof_vector(vector);
+}
+
+template <int dim, int fe_degree>
+template <bool plain>
+void ElectrochemicalOperator<dim, fe_degree>::apply_cell_range(
+    dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+    VectorType const &src,
+    std::pair<unsigned int, unsigned int> const &cell_range,
+    double const mass_factor, double const stiffness_factor) const
+{
+  dealii::FEEvaluation<dim, fe_degree, fe_degree + 1, 2, double> phi(data);
+  unsigned int const s = _solid_potential_component;
+  unsigned int const l = _liquid_potential_component;
+
+  for (unsigned int cell = cell_range.first; cell < cell_range.second; ++cell)
+  {
+    phi.reinit(cell);
+    if (plain)
+      phi.read_dof_values_plain(src);
+    else
+      phi.read_dof_values(src);
+    phi.evaluate(true, true, false);
+    for (unsigned int q = 0; q < phi.n_q_points; ++q)
+    {
+      auto const value = phi.get_value(q);
+      auto const gradient = phi.get_gradient(q);
+      auto const potential_difference = value[s] - value[l];
+      auto value_flux = value;
+      auto gradient_flux = gradient;
+      value_flux[s] =
+          (mass_factor * _specific_capacitance(cell, q) +
+           stiffness_factor * _faradaic_reaction_coefficient(cell, q)) *
+          potential_difference;
+      value_flux[l] = -value_flux[s];
+      gradient_flux[s] = (stiffness_factor *
+                          _solid_electrical_conductivity(cell, q)) *
+                         gradient[s];
+      gradient_flux[l] = (stiffness_factor *
+                          _liquid_electrical_conductivity(cell, q)) *
+                         gradient[l];
+      phi.submit_value(value_flux, q);
+      phi.submit_gradient(gradient_flux, q);
+    }
+    phi.integrate(true, true);
+    phi.distribute_local_to_global(dst);
+  }
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::local_apply(
+    dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+    VectorType const &src,
+    std::pair<unsigned int, unsigned int> const &cell_range) const
+{
+  apply_cell_range<false>(data, dst, src, cell_range, 1., _time_step);
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::local_apply_mass(
+    dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+    VectorType const &src,
+    std::pair<unsigned int, unsigned int> const &cell_range) const
+{
+  apply_cell_range<true>(data, dst, src, cell_range, 1., 0.);
+}
+
+template <int dim, int fe_degree>
+void ElectrochemicalOperator<dim, fe_degree>::local_apply_lifting(
+    dealii::MatrixFree<dim, double> const &data, VectorType &dst,
+    VectorType const &src,
+    std::pair<unsigned int, unsigned int> const &cell_range) const
+{
+  apply_cell_range<true>(data, dst, src, cell_range, -1., -_time_step);
+}
+
+template <int dim>
+std::unique_ptr<ElectrochemicalOperatorBase<dim>>
+ElectrochemicalOperatorFactory<dim>::build(
+    std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters,
+    boost::mpi::communicator mpi_communicator)
+{
+  unsigned int const fe_degree = parameters->dof_handler->get_fe().degree;
+  switch (fe_degree)
+  {
+  case 1:
+    return std::unique_ptr<ElectrochemicalOperatorBase<dim>>(
+        new ElectrochemicalOperator<dim, 1>(parameters, mpi_communicator));
+  case 2:
+    return std::unique_ptr<ElectrochemicalOperatorBase<dim>>(
+        new ElectrochemicalOperator<dim, 2>(parameters, mpi_communicator));
+  case 3:
+    return std::unique_ptr<ElectrochemicalOperatorBase<dim>>(
+        new ElectrochemicalOperator<dim, 3>(parameters, mpi_communicator));
+  default:
+    throw std::runtime_error("The matrix-free operator is only available for "
+                             "finite elements of degree 1, 2, and 3");
+  }
+}
+}
+
+#endif
@@ -6,9 +6,46 @@
  */
 
 #include <cap/electrochemical_physics.templates.h>
+#include <stdexcept>
 
 namespace cap
 {
+TimeIntegrator to_time_integrator(std::string const &time_integrator)
+{
+  if (time_integrator.compare("backward_euler") == 0)
+    return TimeIntegrator::backward_euler;
+  else if (time_integrator.compare("bdf2") == 0)
+    return TimeIntegrator::bdf2;
+  else if (time_integrator.compare("crank_nicolson") == 0)
+    return TimeIntegrator::crank_nicolson;
+  else
+    throw std::runtime_error("invalid time integrator " + time_integrator);
+}
+
+double get_implicit_factor(TimeIntegrator const time_integrator)
+{
+  switch (time_integrator)
+  {
+  case TimeIntegrator::backward_euler:
+    return 1.;
+  case TimeIntegrator::bdf2:
+    return 2. / 3.;
+  case TimeIntegrator::crank_nicolson:
+    return 0.5;
+  default:
+    throw std::runtime_error("Unknown TimeIntegrator");
+  }
+}
+
 template class ElectrochemicalPhysics<2>;
 template class ElectrochemicalPhysics<3>;
+
+template void make_electrochemical_constraints<2>(
+    dealii::DoFHandler<2> const &, Geometry<2> const &,
+    dealii::IndexSet const &, unsigned int const, bool const, double const,
+    dealii::ConstraintMatrix &);
+template void make_electrochemical_constraints<3>(
+    dealii::DoFHandler<3> const &, Geometry<3> const &,
+    dealii::IndexSet const &, unsigned int const, bool const, double const,
+    dealii::ConstraintMatrix &);
 }
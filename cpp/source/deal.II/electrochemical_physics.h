@@ -10,6 +10,13 @@
 
 #include <cap/physics.h>
 #include <cap/timer.h>
+#include <deal.II/base/quadrature.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/vector.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace cap
 {
@@ -18,9 +25,49 @@ enum SuperCapacitorState
   Uninitialized,
   ConstantCurrent,
   ConstantVoltage,
-  ConstantLoad
+  ConstantLoad,
+  /**
+   * The current is imposed on the cathode. The system is built without
+   * current and SuperCapacitor adds the response to the current that delivers
+   * the power.
+   */
+  ConstantPower
 };
 
+/**
+ * Implicit time integrators available to advance the electrochemical physics.
+ * All of them solve at each time step a system of the form
+ * \f$ (M + \alpha \Delta t K) w = M v + \alpha \Delta t f\f$:
+ *  - backward_euler: \f$\alpha = 1\f$, \f$v = u_n\f$, and
+ *  \f$u_{n+1} = w\f$. First order and L-stable.
+ *  - bdf2: \f$\alpha = 2/3\f$, \f$v = (4 u_n - u_{n-1})/3\f$, and
+ *  \f$u_{n+1} = w\f$. Second order and L-stable. The formula assumes a
+ *  constant time step.
+ *  - crank_nicolson: written as the implicit midpoint rule, i.e., the one-stage
+ *  SDIRK scheme, \f$\alpha = 1/2\f$, \f$v = u_n\f$, and
+ *  \f$u_{n+1} = 2 w - u_n\f$. For a constant load this is the same as
+ *  Crank-Nicolson. Second order and A-stable but not L-stable: the stiff
+ *  components are not damped.
+ */
+enum class TimeIntegrator
+{
+  backward_euler,
+  bdf2,
+  crank_nicolson
+};
+
+/**
+ * Convert a string to a TimeIntegrator. Throw an exception if the string does
+ * not correspond to a time integrator.
+ */
+TimeIntegrator to_time_integrator(std::string const &time_integrator);
+
+/**
+ * Return the factor \f$\alpha\f$ of the time step in the system solved by
+ * @p time_integrator.
+ */
+double get_implicit_factor(TimeIntegrator const time_integrator);
+
 /**
  * This class encapsulates the parameters used in ElectrochemicalPhysics.
  */
@@ -31,21 +78,148 @@ public:
   ElectrochemicalPhysicsParameters(boost::property_tree::ptree const &d)
       : PhysicsParameters<dim>(d), supercapacitor_state(Uninitialized),
         constant_current_density(0.), constant_voltage(0.),
-        constant_load_density(0.), time_step(0.)
+        constant_load_density(0.), constant_power_density(0.), time_step(0.),
+        time_integrator(TimeIntegrator::backward_euler)
   {
   }
 
   SuperCapacitorState supercapacitor_state;
   double constant_current_density;
   double constant_voltage;
+  /**
+   * Load multiplied by the area of the cathode.
+   */
   double constant_load_density;
+  /**
+   * Power divided by the area of the cathode.
+   */
+  double constant_power_density;
   double time_step;
+  /**
+   * Time integrator used for the next time step. The system is built with the
+   * time step scaled by get_implicit_factor().
+   */
+  TimeIntegrator time_integrator;
+};
+
+namespace internal
+{
+/**
+ * Scratch object used by the threads assembling the cells in
+ * ElectrochemicalPhysics.
+ */
+template <int dim>
+struct ElectrochemicalAssemblyScratchData
+{
+  ElectrochemicalAssemblyScratchData(
+      dealii::FiniteElement<dim> const &fe,
+      dealii::Quadrature<dim> const &quadrature,
+      dealii::Quadrature<dim - 1> const &face_quadrature,
+      unsigned int const solid_potential_component,
+      unsigned int const liquid_potential_component);
+
+  ElectrochemicalAssemblyScratchData(
+      ElectrochemicalAssemblyScratchData<dim> const &scratch_data);
+
+  dealii::FEValues<dim> fe_values;
+  dealii::FEFaceValues<dim> fe_face_values;
+  std::vector<double> specific_capacitance_values;
+  std::vector<double> solid_electrical_conductivity_values;
+  std::vector<double> liquid_electrical_conductivity_values;
+  std::vector<double> faradaic_reaction_coefficient_values;
+  /**
+   * Values of the shape functions at the current quadrature point multiplied
+   * by the sign of their component in \f$\phi_s - \phi_l\f$.
+   */
+  std::vector<double> signed_shape_values;
+  /**
+   * Gradients of the shape functions at the current quadrature point.
+   */
+  std::vector<dealii::Tensor<1, dim>> shape_gradients;
+  /**
+   * 1 for the shape functions of the solid potential and -1 for the shape
+   * functions of the liquid potential.
+   */
+  std::vector<double> component_signs;
+  /**
+   * Shape functions of the solid potential and of the liquid potential in
+   * increasing order.
+   */
+  std::vector<unsigned int> solid_dofs;
+  std::vector<unsigned int> liquid_dofs;
+};
+
+/**
+ * Local contributions of a cell computed by a worker thread and copied to the
+ * global matrices and vectors of ElectrochemicalPhysics.
+ */
+struct ElectrochemicalAssemblyCopyData
+{
+  ElectrochemicalAssemblyCopyData(unsigned int const dofs_per_cell)
+      : cell_mass_matrix(dofs_per_cell, dofs_per_cell),
+        cell_stiffness_matrix(dofs_per_cell, dofs_per_cell),
+        cell_robin_matrix(dofs_per_cell, dofs_per_cell),
+        cell_rhs(dofs_per_cell), cell_neumann_load(dofs_per_cell),
+        has_neumann_load(false), local_dof_indices(dofs_per_cell)
+  {
+  }
+
+  dealii::FullMatrix<double> cell_mass_matrix;
+  dealii::FullMatrix<double> cell_stiffness_matrix;
+  /**
+   * Mass matrix of the solid potential on the faces of the cell that are on
+   * the cathode.
+   */
+  dealii::FullMatrix<double> cell_robin_matrix;
+  /**
+   * Always zero. Used to compute the contributions of the inhomogeneous
+   * constraints.
+   */
+  dealii::Vector<double> cell_rhs;
+  dealii::Vector<double> cell_neumann_load;
+  /**
+   * True if the cell has a face on the cathode with a Neumann or a Robin
+   * boundary condition.
+   */
+  bool has_neumann_load;
+  std::vector<dealii::types::global_dof_index> local_dof_indices;
 };
+}
+
+/**
+ * Fill @p constraints with the hanging node constraints and the Dirichlet
+ * boundary conditions of the electrochemical physics. The solid potential is
+ * zero on the anode. If @p cathode_dirichlet_bc is true, the solid potential is
+ * also imposed on the cathode and its value is @p cathode_voltage.
+ */
+template <int dim>
+void make_electrochemical_constraints(
+    dealii::DoFHandler<dim> const &dof_handler, Geometry<dim> const &geometry,
+    dealii::IndexSet const &locally_relevant_dofs,
+    unsigned int const solid_potential_component,
+    bool const cathode_dirichlet_bc, double const cathode_voltage,
+    dealii::ConstraintMatrix &constraints);
 
 /**
  * This class builds the system of equations that describes an electrochemical
  * physics. The system is built when the constructor or the reinit() function
  * is called.
+ *
+ * The mass matrix \f$M\f$, the stiffness matrix \f$K\f$, and the load
+ * vectors associated with a unit current density on the cathode and with a
+ * unit voltage on the cathode are assembled once and cached. The system matrix
+ * \f$M + \alpha \Delta t K\f$ and the right-hand side are then obtained
+ * from the cached pieces using only vector operations, \f$\alpha\f$ being
+ * the implicit factor of the time integrator.
+ *
+ * When a load \f$R\f$ is connected to the device, the current density on the
+ * cathode is \f$-\phi_s/(R A)\f$ where \f$A\f$ is the area of the cathode.
+ * This Robin boundary condition is linear in the solution so it is added to
+ * the system matrix, \f$M + \alpha \Delta t (K + B/(R A))\f$, where \f$B\f$
+ * is the mass matrix of the solid potential on the cathode. A time step with
+ * a constant load costs a single linear solve. The cached pieces are assembled
+ * again only when the Dirichlet boundary conditions change, i.e., when
+ * switching between imposing the voltage and imposing the current.
  */
 template <int dim>
 class ElectrochemicalPhysics : public Physics<dim>
@@ -57,12 +231,122 @@ public:
 
   ~ElectrochemicalPhysics();
 
+  /**
+   * Update the system of equations when the time step, the operating mode, or
+   * the value imposed on the cathode has changed. The mesh and the material
+   * properties must be the same as the ones used to build the object.
+   */
+  void reinit(std::shared_ptr<PhysicsParameters<dim> const> parameters);
+
+  /**
+   * Return the load vector associated with a unit current density on the
+   * cathode. The dot product of this vector with a solution is the integral of
+   * the solid potential on the cathode.
+   */
+  dealii::Trilinos::MPI::Vector const &get_neumann_load() const;
+
+  /**
+   * Return the mass matrix with the constraints applied.
+   */
+  dealii::Trilinos::SparseMatrix const &get_constrained_mass_matrix() const;
+
+  /**
+   * Return the stiffness matrix with the constraints applied.
+   */
+  dealii::Trilinos::SparseMatrix const &get_stiffness_matrix() const;
+
+  /**
+   * Return the mass matrix of the solid potential on the cathode with the
+   * constraints applied. It is only assembled when the voltage is not imposed.
+   */
+  dealii::Trilinos::SparseMatrix const &get_robin_matrix() const;
+
 private:
-  void assemble_system(std::shared_ptr<PhysicsParameters<dim> const> parameters,
-                       bool const inhomogeneous_bc);
+  /**
+   * Assemble the mass matrix, the stiffness matrix, and the load vectors. The
+   * cells are assembled in parallel using the threads available to deal.II,
+   * see the option solver.n_threads of SuperCapacitor.
+   */
+  void assemble_system();
+
+  /**
+   * Compute the local contributions of @p cell. This function is called
+   * concurrently by several threads.
+   */
+  void assemble_local_system(
+      typename dealii::DoFHandler<dim>::active_cell_iterator const &cell,
+      internal::ElectrochemicalAssemblyScratchData<dim> &scratch_data,
+      internal::ElectrochemicalAssemblyCopyData &copy_data) const;
+
+  /**
+   * Add the local contributions in @p copy_data to the global matrices and
+   * vectors.
+   */
+  void copy_local_to_global_system(
+      internal::ElectrochemicalAssemblyCopyData const &copy_data);
+
+  /**
+   * Build the constraints for the current Dirichlet boundary conditions. This
+   * is only needed when the boundary conditions change.
+   */
+  void build_constraints();
+
+  /**
+   * Build the system matrix and the right-hand side from the cached matrices
+   * and load vectors. The inhomogeneities of the constraints are scaled by the
+   * voltage imposed on the cathode.
+   */
+  void update_system(std::shared_ptr<
+                     ElectrochemicalPhysicsParameters<dim> const> parameters);
 
   unsigned int _solid_potential_component;
   unsigned int _liquid_potential_component;
+  /**
+   * Material properties at the quadrature points of the locally owned cells.
+   */
+  std::shared_ptr<MPValuesCache<dim> const> _mp_values_cache;
+  /**
+   * True if the solid potential is imposed on the cathode.
+   */
+  bool _cathode_dirichlet_bc;
+  /**
+   * Same as the constraint matrix but the voltage imposed on the cathode is
+   * one. It is used to assemble the cached matrices and load vectors.
+   */
+  dealii::ConstraintMatrix _unit_constraint_matrix;
+  /**
+   * Inhomogeneous constraints of _unit_constraint_matrix and their values.
+   */
+  std::vector<std::pair<dealii::types::global_dof_index, double>>
+      _unit_inhomogeneities;
+  /**
+   * Voltage on the cathode used by the inhomogeneities of the constraint
+   * matrix.
+   */
+  double _constraints_cathode_voltage;
+  /**
+   * Mass matrix with the constraints applied.
+   */
+  dealii::Trilinos::SparseMatrix _constrained_mass_matrix;
+  /**
+   * Stiffness matrix with the constraints applied.
+   */
+  dealii::Trilinos::SparseMatrix _stiffness_matrix;
+  /**
+   * Mass matrix of the solid potential on the cathode with the constraints
+   * applied. Used by the Robin boundary condition of a constant load.
+   */
+  dealii::Trilinos::SparseMatrix _robin_matrix;
+  /**
+   * Load vector for a unit current density on the cathode.
+   */
+  dealii::Trilinos::MPI::Vector _neumann_load;
+  /**
+   * Contributions of the mass matrix and of the stiffness matrix to the
+   * right-hand side for a unit voltage imposed on the cathode.
+   */
+  dealii::Trilinos::MPI::Vector _mass_dirichlet_load;
+  dealii::Trilinos::MPI::Vector _stiffness_dirichlet_load;
   Timer _assembly_timer;
   Timer _setup_timer;
 };
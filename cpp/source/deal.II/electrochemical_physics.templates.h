@@ -12,18 +12,130 @@
 #include <cap/types.h>
 #include <boost/assert.hpp>
 #include <deal.II/base/function.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/work_stream.h>
 #include <deal.II/dofs/dof_tools.h>
-#include <deal.II/fe/fe_values.h>
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/numerics/vector_tools.h>
+#include <functional>
 
 namespace cap
 {
+template <int dim>
+void make_electrochemical_constraints(
+    dealii::DoFHandler<dim> const &dof_handler, Geometry<dim> const &geometry,
+    dealii::IndexSet const &locally_relevant_dofs,
+    unsigned int const solid_potential_component,
+    bool const cathode_dirichlet_bc, double const cathode_voltage,
+    dealii::ConstraintMatrix &constraints)
+{
+  auto const &anode_boundary_ids = (*geometry.get_boundaries())["anode"];
+  auto const &cathode_boundary_ids = (*geometry.get_boundaries())["cathode"];
+
+  // Take care of hanging nodes
+  constraints.clear();
+  constraints.reinit(locally_relevant_dofs);
+  dealii::DoFTools::make_hanging_node_constraints(dof_handler, constraints);
+
+  // Take care of Dirichlet boundary condition.
+  // The anode is always set in Earth (Dirichlet value of 0).
+  // If we impose a the voltage, the cathode is also a Dirichlet condition.
+  unsigned int const n_components = dealii::DoFTools::n_components(dof_handler);
+  std::vector<bool> mask(n_components, false);
+  mask[solid_potential_component] = true;
+  dealii::ComponentMask component_mask(mask);
+  typename dealii::FunctionMap<dim>::type dirichlet_boundary_condition;
+  dealii::ZeroFunction<dim> homogeneous_bc(n_components);
+  for (auto const &boundary_id : anode_boundary_ids)
+    dirichlet_boundary_condition[boundary_id] = &homogeneous_bc;
+  dealii::ConstantFunction<dim> cathode_dirichlet_bc_function(cathode_voltage,
+                                                              n_components);
+  if (cathode_dirichlet_bc)
+    for (auto const &boundary_id : cathode_boundary_ids)
+      dirichlet_boundary_condition[boundary_id] =
+          &cathode_dirichlet_bc_function;
+
+  dealii::VectorTools::interpolate_boundary_values(
+      dof_handler, dirichlet_boundary_condition, constraints, component_mask);
+
+  // Finally close the ConstraintMatrix.
+  constraints.close();
+}
+
+namespace internal
+{
+template <int dim>
+ElectrochemicalAssemblyScratchData<dim>::ElectrochemicalAssemblyScratchData(
+    dealii::FiniteElement<dim> const &fe,
+    dealii::Quadrature<dim> const &quadrature,
+    dealii::Quadrature<dim - 1> const &face_quadrature,
+    unsigned int const solid_potential_component,
+    unsigned int const liquid_potential_component)
+    : fe_values(fe, quadrature,
+                dealii::update_values | dealii::update_gradients |
+                    dealii::update_JxW_values |
+                    dealii::update_quadrature_points),
+      fe_face_values(fe, face_quadrature,
+                     dealii::update_values | dealii::update_JxW_values |
+                         dealii::update_quadrature_points),
+      specific_capacitance_values(quadrature.size()),
+      solid_electrical_conductivity_values(quadrature.size()),
+      liquid_electrical_conductivity_values(quadrature.size()),
+      faradaic_reaction_coefficient_values(quadrature.size()),
+      signed_shape_values(fe.dofs_per_cell),
+      shape_gradients(fe.dofs_per_cell), component_signs(fe.dofs_per_cell)
+{
+  // The ordering of the shape functions is the same on every cell so the
+  // component of each shape function is computed once.
+  for (unsigned int i = 0; i < fe.dofs_per_cell; ++i)
+  {
+    unsigned int const component = fe.system_to_component_index(i).first;
+    if (component == solid_potential_component)
+    {
+      component_signs[i] = 1.;
+      solid_dofs.push_back(i);
+    }
+    else if (component == liquid_potential_component)
+    {
+      component_signs[i] = -1.;
+      liquid_dofs.push_back(i);
+    }
+  }
+}
+
+template <int dim>
+ElectrochemicalAssemblyScratchData<dim>::ElectrochemicalAssemblyScratchData(
+    ElectrochemicalAssemblyScratchData<dim> const &scratch_data)
+    : fe_values(scratch_data.fe_values.get_fe(),
+                scratch_data.fe_values.get_quadrature(),
+                scratch_data.fe_values.get_update_flags()),
+      fe_face_values(scratch_data.fe_face_values.get_fe(),
+                     scratch_data.fe_face_values.get_quadrature(),
+                     scratch_data.fe_face_values.get_update_flags()),
+      specific_capacitance_values(
+          scratch_data.specific_capacitance_values.size()),
+      solid_electrical_conductivity_values(
+          scratch_data.solid_electrical_conductivity_values.size()),
+      liquid_electrical_conductivity_values(
+          scratch_data.liquid_electrical_conductivity_values.size()),
+      faradaic_reaction_coefficient_values(
+          scratch_data.faradaic_reaction_coefficient_values.size()),
+      signed_shape_values(scratch_data.signed_shape_values.size()),
+      shape_gradients(scratch_data.shape_gradients.size()),
+      component_signs(scratch_data.component_signs),
+      solid_dofs(scratch_data.solid_dofs), liquid_dofs(scratch_data.liquid_dofs)
+{
+}
+}
+
 template <int dim>
 ElectrochemicalPhysics<dim>::ElectrochemicalPhysics(
     std::shared_ptr<PhysicsParameters<dim> const> parameters,
     boost::mpi::communicator mpi_communicator)
     : Physics<dim>(parameters, mpi_communicator),
       _solid_potential_component(-1), _liquid_potential_component(-1),
+      _mp_values_cache(parameters->mp_values_cache),
+      _cathode_dirichlet_bc(false),
       _assembly_timer(mpi_communicator, "ElectrochemicalPhysics assembly"),
       _setup_timer(mpi_communicator, "ElectrochemicalPhysics setup")
 {
@@ -35,10 +147,6 @@ ElectrochemicalPhysics<dim>::ElectrochemicalPhysics(
   this->_liquid_potential_component = database.get<unsigned int>("liquid_potential_component");
   // clang-format on
 
-  auto const &anode_boundary_ids = (*this->geometry->get_boundaries())["anode"];
-  auto const &cathode_boundary_ids =
-      (*this->geometry->get_boundaries())["cathode"];
-
   std::shared_ptr<
       ElectrochemicalPhysicsParameters<dim> const> electrochemical_parameters =
       std::dynamic_pointer_cast<ElectrochemicalPhysicsParameters<dim> const>(
@@ -46,64 +154,54 @@ ElectrochemicalPhysics<dim>::ElectrochemicalPhysics(
   BOOST_ASSERT_MSG(electrochemical_parameters != nullptr,
                    "Problem during dowcasting the pointer");
 
+  // Evaluate the material properties once if they have not been provided.
+  unsigned int const fe_degree = this->dof_handler->get_fe().degree;
+  if (_mp_values_cache == nullptr)
+    _mp_values_cache = std::make_shared<MPValuesCache<dim>>(
+        *(this->mp_values), *(this->dof_handler),
+        dealii::QGauss<dim>(fe_degree + 1));
+  BOOST_ASSERT_MSG(_mp_values_cache->n_quadrature_points() ==
+                       dealii::QGauss<dim>(fe_degree + 1).size(),
+                   "The material properties are not evaluated at the "
+                   "quadrature points used by ElectrochemicalPhysics");
+
   // Initialize locally_owned_dofs and locally_relevant_dofs
   this->locally_owned_dofs = this->dof_handler->locally_owned_dofs();
   dealii::DoFTools::extract_locally_relevant_dofs(*(this->dof_handler),
                                                   this->locally_relevant_dofs);
 
-  // Take care of hanging nodes
-  this->constraint_matrix.clear();
-  this->constraint_matrix.reinit(this->locally_relevant_dofs);
-  dealii::DoFTools::make_hanging_node_constraints(*(this->dof_handler),
-                                                  this->constraint_matrix);
+  // Take care of the hanging nodes and of the Dirichlet boundary conditions.
+  _cathode_dirichlet_bc =
+      (electrochemical_parameters->supercapacitor_state == ConstantVoltage);
+  build_constraints();
 
-  // Take care of Dirichlet boundary condition.
-  // The anode is always set in Earth (Dirichlet value of 0).
-  // If we impose a the voltage, the cathode is also a Dirichlet condition.
-  unsigned int const n_components =
-      dealii::DoFTools::n_components(*(this->dof_handler));
-  std::vector<bool> mask(n_components, false);
-  mask[this->_solid_potential_component] = true;
-  dealii::ComponentMask component_mask(mask);
-  typename dealii::FunctionMap<dim>::type dirichlet_boundary_condition;
-  dealii::ZeroFunction<dim> homogeneous_bc(n_components);
-  for (auto const &boundary_id : anode_boundary_ids)
-    dirichlet_boundary_condition[boundary_id] = &homogeneous_bc;
-  std::unique_ptr<dealii::Function<dim>> cathode_dirichlet_bc = nullptr;
-  bool inhomogeneous_bc = false;
-  if (electrochemical_parameters->supercapacitor_state == ConstantVoltage)
-  {
-    cathode_dirichlet_bc = std::make_unique<dealii::ConstantFunction<dim>>(
-        dealii::ConstantFunction<dim>(
-            electrochemical_parameters->constant_voltage, n_components));
-    for (auto const &boundary_id : cathode_boundary_ids)
-      dirichlet_boundary_condition[boundary_id] = cathode_dirichlet_bc.get();
-    inhomogeneous_bc = true;
-  }
-
-  dealii::VectorTools::interpolate_boundary_values(
-      *(this->dof_handler), dirichlet_boundary_condition,
-      this->constraint_matrix, component_mask);
-
-  // Finally close the ConstraintMatrix.
-  this->constraint_matrix.close();
-
-  // Create sparsity pattern
+  // Create sparsity pattern. The Dirichlet constraints do not modify the
+  // sparsity pattern, so it does not need to be rebuilt when the boundary
+  // conditions change.
   this->sparsity_pattern.reinit(
       this->locally_owned_dofs, this->locally_owned_dofs,
       this->locally_relevant_dofs, this->mpi_communicator);
   dealii::DoFTools::make_sparsity_pattern(
-      *(this->dof_handler), this->sparsity_pattern, this->constraint_matrix,
+      *(this->dof_handler), this->sparsity_pattern, _unit_constraint_matrix,
       true, dealii::Utilities::MPI::this_mpi_process(this->mpi_communicator));
   this->sparsity_pattern.compress();
 
   // Initialize matrices and vectors
   this->system_matrix.reinit(this->sparsity_pattern);
   this->mass_matrix.reinit(this->sparsity_pattern);
+  _constrained_mass_matrix.reinit(this->sparsity_pattern);
+  _stiffness_matrix.reinit(this->sparsity_pattern);
+  _robin_matrix.reinit(this->sparsity_pattern);
   this->system_rhs.reinit(this->locally_owned_dofs, this->mpi_communicator);
+  _neumann_load.reinit(this->locally_owned_dofs, this->mpi_communicator);
+  _mass_dirichlet_load.reinit(this->locally_owned_dofs,
+                              this->mpi_communicator);
+  _stiffness_dirichlet_load.reinit(this->locally_owned_dofs,
+                                   this->mpi_communicator);
 
   _setup_timer.stop();
-  assemble_system(parameters, inhomogeneous_bc);
+  assemble_system();
+  update_system(electrochemical_parameters);
 }
 
 template <int dim>
@@ -117,11 +215,9 @@ ElectrochemicalPhysics<dim>::~ElectrochemicalPhysics()
 }
 
 template <int dim>
-void ElectrochemicalPhysics<dim>::assemble_system(
-    std::shared_ptr<PhysicsParameters<dim> const> parameters,
-    bool const inhomogeneous_bc)
+void ElectrochemicalPhysics<dim>::reinit(
+    std::shared_ptr<PhysicsParameters<dim> const> parameters)
 {
-  _assembly_timer.start();
   std::shared_ptr<
       ElectrochemicalPhysicsParameters<dim> const> electrochemical_parameters =
       std::dynamic_pointer_cast<ElectrochemicalPhysicsParameters<dim> const>(
@@ -129,151 +225,334 @@ void ElectrochemicalPhysics<dim>::assemble_system(
   BOOST_ASSERT_MSG(electrochemical_parameters != nullptr,
                    "Problem during dowcasting the pointer");
 
+  // The cached matrices depend on the Dirichlet boundary conditions. They only
+  // need to be assembled again if the boundary conditions have changed.
+  bool const cathode_dirichlet_bc =
+      (electrochemical_parameters->supercapacitor_state == ConstantVoltage);
+  if (cathode_dirichlet_bc != _cathode_dirichlet_bc)
+  {
+    _setup_timer.start();
+    _cathode_dirichlet_bc = cathode_dirichlet_bc;
+    build_constraints();
+    _setup_timer.stop();
+    assemble_system();
+  }
+  update_system(electrochemical_parameters);
+}
+
+template <int dim>
+dealii::Trilinos::MPI::Vector const &
+ElectrochemicalPhysics<dim>::get_neumann_load() const
+{
+  return _neumann_load;
+}
+
+template <int dim>
+dealii::Trilinos::SparseMatrix const &
+ElectrochemicalPhysics<dim>::get_constrained_mass_matrix() const
+{
+  return _constrained_mass_matrix;
+}
+
+template <int dim>
+dealii::Trilinos::SparseMatrix const &
+ElectrochemicalPhysics<dim>::get_stiffness_matrix() const
+{
+  return _stiffness_matrix;
+}
+
+template <int dim>
+dealii::Trilinos::SparseMatrix const &
+ElectrochemicalPhysics<dim>::get_robin_matrix() const
+{
+  return _robin_matrix;
+}
+
+template <int dim>
+void ElectrochemicalPhysics<dim>::assemble_system()
+{
+  _assembly_timer.start();
+
   dealii::DoFHandler<dim> const &dof_handler = *(this->dof_handler);
   dealii::FiniteElement<dim> const &fe = dof_handler.get_fe();
+  dealii::QGauss<dim> quadrature_rule(fe.degree + 1);
+  dealii::QGauss<dim - 1> face_quadrature_rule(fe.degree + 1);
+
+  this->mass_matrix = 0.0;
+  _constrained_mass_matrix = 0.0;
+  _stiffness_matrix = 0.0;
+  _robin_matrix = 0.0;
+  _neumann_load = 0.0;
+  _mass_dirichlet_load = 0.0;
+  _stiffness_dirichlet_load = 0.0;
+
+  // The cells are assembled in parallel by the worker threads. The copy of the
+  // local contributions to the global matrices and vectors is done by a single
+  // thread at a time.
+  typedef dealii::FilteredIterator<
+      typename dealii::DoFHandler<dim>::active_cell_iterator>
+      CellFilter;
+  dealii::WorkStream::run(
+      CellFilter(dealii::IteratorFilters::LocallyOwnedCell(),
+                 dof_handler.begin_active()),
+      CellFilter(dealii::IteratorFilters::LocallyOwnedCell(),
+                 dof_handler.end()),
+      std::bind(&ElectrochemicalPhysics<dim>::assemble_local_system, this,
+                std::placeholders::_1, std::placeholders::_2,
+                std::placeholders::_3),
+      std::bind(&ElectrochemicalPhysics<dim>::copy_local_to_global_system,
+                this, std::placeholders::_1),
+      internal::ElectrochemicalAssemblyScratchData<dim>(
+          fe, quadrature_rule, face_quadrature_rule,
+          _solid_potential_component, _liquid_potential_component),
+      internal::ElectrochemicalAssemblyCopyData(fe.dofs_per_cell));
+
+  // We are done fill-in the matrices and the vectors. So we can compress
+  // everything.
+  this->mass_matrix.compress(dealii::VectorOperation::add);
+  _constrained_mass_matrix.compress(dealii::VectorOperation::add);
+  _stiffness_matrix.compress(dealii::VectorOperation::add);
+  _robin_matrix.compress(dealii::VectorOperation::add);
+  _neumann_load.compress(dealii::VectorOperation::add);
+  _mass_dirichlet_load.compress(dealii::VectorOperation::add);
+  _stiffness_dirichlet_load.compress(dealii::VectorOperation::add);
+
+  _assembly_timer.stop();
+}
 
+template <int dim>
+void ElectrochemicalPhysics<dim>::assemble_local_system(
+    typename dealii::DoFHandler<dim>::active_cell_iterator const &cell,
+    internal::ElectrochemicalAssemblyScratchData<dim> &scratch_data,
+    internal::ElectrochemicalAssemblyCopyData &copy_data) const
+{
+  dealii::FEValues<dim> &fe_values = scratch_data.fe_values;
+  dealii::FEFaceValues<dim> &fe_face_values = scratch_data.fe_face_values;
   dealii::FEValuesExtractors::Scalar const solid_potential(
       this->_solid_potential_component);
-  dealii::FEValuesExtractors::Scalar const liquid_potential(
-      this->_liquid_potential_component);
-  dealii::QGauss<dim> quadrature_rule(fe.degree + 1);
-  dealii::FEValues<dim> fe_values(
-      fe, quadrature_rule, dealii::update_values | dealii::update_gradients |
-                               dealii::update_JxW_values |
-                               dealii::update_quadrature_points);
-
-  unsigned int const dofs_per_cell = fe.dofs_per_cell;
-  unsigned int const n_q_points = quadrature_rule.size();
-  double const time_step = electrochemical_parameters->time_step;
-  dealii::Vector<double> cell_rhs(dofs_per_cell);
-  dealii::FullMatrix<double> cell_system_matrix(dofs_per_cell, dofs_per_cell);
-  dealii::FullMatrix<double> cell_mass_matrix(dofs_per_cell, dofs_per_cell);
-  std::vector<double> solid_phase_diffusion_coefficient_values(n_q_points);
-  std::vector<double> liquid_phase_diffusion_coefficient_values(n_q_points);
-  std::vector<double> specific_capacitance_values(n_q_points);
-  std::vector<double> faradaic_reaction_coefficient_values(n_q_points);
-  std::vector<dealii::types::global_dof_index> local_dof_indices(dofs_per_cell);
-
-  this->system_matrix = 0.0;
-  this->mass_matrix = 0.0;
-  this->system_rhs = 0.0;
+  unsigned int const dofs_per_cell = fe_values.get_fe().dofs_per_cell;
+  unsigned int const n_q_points = fe_values.n_quadrature_points;
+  unsigned int const n_face_q_points = fe_face_values.n_quadrature_points;
+  std::vector<double> &specific_capacitance_values =
+      scratch_data.specific_capacitance_values;
+  std::vector<double> &solid_phase_diffusion_coefficient_values =
+      scratch_data.solid_electrical_conductivity_values;
+  std::vector<double> &liquid_phase_diffusion_coefficient_values =
+      scratch_data.liquid_electrical_conductivity_values;
+  std::vector<double> &faradaic_reaction_coefficient_values =
+      scratch_data.faradaic_reaction_coefficient_values;
+
+  copy_data.cell_mass_matrix = 0.0;
+  copy_data.cell_stiffness_matrix = 0.0;
+  copy_data.cell_robin_matrix = 0.0;
+  copy_data.cell_neumann_load = 0.0;
+  copy_data.has_neumann_load = false;
+  fe_values.reinit(cell);
+
+  unsigned int const cell_index = cell->active_cell_index();
+  // clang-format off
+  _mp_values_cache->get_values(MaterialProperty::specific_capacitance,           cell_index, specific_capacitance_values);
+  _mp_values_cache->get_values(MaterialProperty::solid_electrical_conductivity,  cell_index, solid_phase_diffusion_coefficient_values);
+  _mp_values_cache->get_values(MaterialProperty::liquid_electrical_conductivity, cell_index, liquid_phase_diffusion_coefficient_values);
+  _mp_values_cache->get_values(MaterialProperty::faradaic_reaction_coefficient,  cell_index, faradaic_reaction_coefficient_values);
+  // clang-format on
 
-  for (auto cell : dof_handler.active_cell_iterators())
+  // Every shape function of the FESystem is nonzero in a single component.
+  // The mass matrix and the Faradaic term only depend on the difference of
+  // the potentials, so they are the products of signed shape values. The
+  // conductivity terms only couple shape functions of the same component. The
+  // coefficients are zeros when the physics does not make sense.
+  std::vector<double> &signed_values = scratch_data.signed_shape_values;
+  std::vector<dealii::Tensor<1, dim>> &gradients = scratch_data.shape_gradients;
+  std::vector<double> const &component_signs = scratch_data.component_signs;
+  dealii::FullMatrix<double> &cell_mass_matrix = copy_data.cell_mass_matrix;
+  dealii::FullMatrix<double> &cell_stiffness_matrix =
+      copy_data.cell_stiffness_matrix;
+  for (unsigned int q = 0; q < n_q_points; ++q)
   {
-    if (cell->is_locally_owned())
+    double const JxW = fe_values.JxW(q);
+    for (unsigned int i = 0; i < dofs_per_cell; ++i)
     {
-      cell_system_matrix = 0.0;
-      cell_mass_matrix = 0.0;
-      cell_rhs = 0.0;
-      fe_values.reinit(cell);
-
-      // clang-format off
-      (this->mp_values)->get_values("specific_capacitance",           fe_values, specific_capacitance_values);
-      (this->mp_values)->get_values("solid_electrical_conductivity",  fe_values, solid_phase_diffusion_coefficient_values);
-      (this->mp_values)->get_values("liquid_electrical_conductivity", fe_values, liquid_phase_diffusion_coefficient_values);
-      (this->mp_values)->get_values("faradaic_reaction_coefficient",  fe_values, faradaic_reaction_coefficient_values);
-      // clang-format on
-
-      // The coefficients are zeros when the physics does not make sense.
-      for (unsigned int q = 0; q < n_q_points; ++q)
-        for (unsigned int i = 0; i < dofs_per_cell; ++i)
-        {
-          for (unsigned int j = 0; j < dofs_per_cell; ++j)
-          {
-            // Mass matrix terms
-            double const mass_matrix_val =
-                specific_capacitance_values[q] *
-                (fe_values[solid_potential].value(i, q) *
-                     fe_values[solid_potential].value(j, q) -
-                 fe_values[solid_potential].value(i, q) *
-                     fe_values[liquid_potential].value(j, q) -
-                 fe_values[liquid_potential].value(i, q) *
-                     fe_values[solid_potential].value(j, q) +
-                 fe_values[liquid_potential].value(i, q) *
-                     fe_values[liquid_potential].value(j, q)) *
-                fe_values.JxW(q);
-            cell_mass_matrix(i, j) += mass_matrix_val;
-            cell_system_matrix(i, j) +=
-                mass_matrix_val +
-                time_step *
-                    // Stiffness matrix terms
-                    (solid_phase_diffusion_coefficient_values[q] *
-                         (fe_values[solid_potential].gradient(i, q) *
-                          fe_values[solid_potential].gradient(j, q)) +
-                     liquid_phase_diffusion_coefficient_values[q] *
-                         (fe_values[liquid_potential].gradient(i, q) *
-                          fe_values[liquid_potential].gradient(j, q)) +
-                     faradaic_reaction_coefficient_values[q] *
-                         ((fe_values[solid_potential].value(i, q) *
-                           fe_values[solid_potential].value(j, q)) -
-                          (fe_values[liquid_potential].value(i, q) *
-                           fe_values[solid_potential].value(j, q)) -
-                          (fe_values[solid_potential].value(i, q) *
-                           fe_values[liquid_potential].value(j, q)) +
-                          (fe_values[liquid_potential].value(i, q) *
-                           fe_values[liquid_potential].value(j, q)))) *
-                    fe_values.JxW(q);
-          }
-        }
+      signed_values[i] = component_signs[i] * fe_values.shape_value(i, q);
+      gradients[i] = fe_values.shape_grad(i, q);
+    }
 
-      // Fill in the global matrices.
-      cell->get_dof_indices(local_dof_indices);
-      this->constraint_matrix.distribute_local_to_global(
-          cell_system_matrix, cell_rhs, local_dof_indices, this->system_matrix,
-          this->system_rhs, inhomogeneous_bc);
-      for (unsigned int i = 0; i < dofs_per_cell; ++i)
-        for (unsigned int j = 0; j < dofs_per_cell; ++j)
-          this->mass_matrix.add(local_dof_indices[i], local_dof_indices[j],
-                                cell_mass_matrix(i, j));
+    // Both matrices are symmetric so only the lower triangle is computed.
+    double const mass_coefficient = specific_capacitance_values[q] * JxW;
+    double const faradaic_coefficient =
+        faradaic_reaction_coefficient_values[q] * JxW;
+    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+      for (unsigned int j = 0; j <= i; ++j)
+      {
+        double const value_product = signed_values[i] * signed_values[j];
+        cell_mass_matrix(i, j) += mass_coefficient * value_product;
+        cell_stiffness_matrix(i, j) += faradaic_coefficient * value_product;
+      }
+
+    double const solid_coefficient =
+        solid_phase_diffusion_coefficient_values[q] * JxW;
+    for (unsigned int a = 0; a < scratch_data.solid_dofs.size(); ++a)
+    {
+      unsigned int const i = scratch_data.solid_dofs[a];
+      for (unsigned int b = 0; b <= a; ++b)
+      {
+        unsigned int const j = scratch_data.solid_dofs[b];
+        cell_stiffness_matrix(i, j) +=
+            solid_coefficient * (gradients[i] * gradients[j]);
+      }
+    }
+    double const liquid_coefficient =
+        liquid_phase_diffusion_coefficient_values[q] * JxW;
+    for (unsigned int a = 0; a < scratch_data.liquid_dofs.size(); ++a)
+    {
+      unsigned int const i = scratch_data.liquid_dofs[a];
+      for (unsigned int b = 0; b <= a; ++b)
+      {
+        unsigned int const j = scratch_data.liquid_dofs[b];
+        cell_stiffness_matrix(i, j) +=
+            liquid_coefficient * (gradients[i] * gradients[j]);
+      }
     }
   }
+  for (unsigned int i = 0; i < dofs_per_cell; ++i)
+    for (unsigned int j = i + 1; j < dofs_per_cell; ++j)
+    {
+      cell_mass_matrix(i, j) = cell_mass_matrix(j, i);
+      cell_stiffness_matrix(i, j) = cell_stiffness_matrix(j, i);
+    }
 
-  // Apply Neumann boundary condition on the cathode (constant current
-  // charge).
-  if (electrochemical_parameters->supercapacitor_state == ConstantCurrent)
+  // Load vector of the Neumann boundary condition on the cathode (constant
+  // current charge) for a unit current density and boundary mass matrix of the
+  // Robin boundary condition (constant load).
+  if ((!_cathode_dirichlet_bc) && cell->at_boundary())
   {
+    // Use at() rather than operator[] since several threads read the map.
     auto const &cathode_boundary_ids =
-        (*this->geometry->get_boundaries())["cathode"];
-    double const time_step = electrochemical_parameters->time_step;
-    double const current_density =
-        electrochemical_parameters->constant_current_density;
-    dealii::QGauss<dim - 1> face_quadrature_rule(fe.degree + 1);
-    unsigned int const n_face_q_points = face_quadrature_rule.size();
-    dealii::FEFaceValues<dim> fe_face_values(
-        fe, face_quadrature_rule, dealii::update_values |
-                                      dealii::update_JxW_values |
-                                      dealii::update_quadrature_points);
-    for (auto cell : dof_handler.active_cell_iterators())
-      if (cell->is_locally_owned() && cell->at_boundary())
+        this->geometry->get_boundaries()->at("cathode");
+    for (unsigned int face = 0;
+         face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
+    {
+      if ((cell->face(face)->at_boundary()) &&
+          (cathode_boundary_ids.count(cell->face(face)->boundary_id()) > 0))
       {
-        cell_rhs = 0.0;
-        for (unsigned int face = 0;
-             face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
+        copy_data.has_neumann_load = true;
+        fe_face_values.reinit(cell, face);
+        for (unsigned int q = 0; q < n_face_q_points; ++q)
         {
-          if ((cell->face(face)->at_boundary()) &&
-              (cathode_boundary_ids.count(cell->face(face)->boundary_id()) > 0))
+          double const JxW = fe_face_values.JxW(q);
+          for (unsigned int i = 0; i < dofs_per_cell; ++i)
           {
-            fe_face_values.reinit(cell, face);
-            for (unsigned int q = 0; q < n_face_q_points; ++q)
-              for (unsigned int i = 0; i < dofs_per_cell; ++i)
-                cell_rhs[i] += time_step * current_density *
-                               fe_face_values[solid_potential].value(i, q) *
-                               fe_face_values.JxW(q);
+            double const value = fe_face_values[solid_potential].value(i, q);
+            copy_data.cell_neumann_load[i] += value * JxW;
+            for (unsigned int j = 0; j < dofs_per_cell; ++j)
+              copy_data.cell_robin_matrix(i, j) +=
+                  value * fe_face_values[solid_potential].value(j, q) * JxW;
           }
         }
-        cell->get_dof_indices(local_dof_indices);
-        this->constraint_matrix.distribute_local_to_global(
-            cell_rhs, local_dof_indices, this->system_rhs);
       }
+    }
   }
 
-  // We are done fill-in the matrices and the vector. So we can compress
-  // everything.
-  this->system_matrix.compress(dealii::VectorOperation::add);
-  this->mass_matrix.compress(dealii::VectorOperation::add);
-  this->system_rhs.compress(dealii::VectorOperation::add);
+  cell->get_dof_indices(copy_data.local_dof_indices);
+}
 
-  _assembly_timer.stop();
+template <int dim>
+void ElectrochemicalPhysics<dim>::copy_local_to_global_system(
+    internal::ElectrochemicalAssemblyCopyData const &copy_data)
+{
+  // The contributions of the inhomogeneous constraints are computed for a unit
+  // voltage on the cathode.
+  _unit_constraint_matrix.distribute_local_to_global(
+      copy_data.cell_mass_matrix, copy_data.cell_rhs,
+      copy_data.local_dof_indices, _constrained_mass_matrix,
+      _mass_dirichlet_load, _cathode_dirichlet_bc);
+  _unit_constraint_matrix.distribute_local_to_global(
+      copy_data.cell_stiffness_matrix, copy_data.cell_rhs,
+      copy_data.local_dof_indices, _stiffness_matrix,
+      _stiffness_dirichlet_load, _cathode_dirichlet_bc);
+  if (copy_data.has_neumann_load)
+  {
+    _unit_constraint_matrix.distribute_local_to_global(
+        copy_data.cell_neumann_load, copy_data.local_dof_indices,
+        _neumann_load);
+    _unit_constraint_matrix.distribute_local_to_global(
+        copy_data.cell_robin_matrix, copy_data.local_dof_indices,
+        _robin_matrix);
+  }
+  unsigned int const dofs_per_cell = copy_data.local_dof_indices.size();
+  for (unsigned int i = 0; i < dofs_per_cell; ++i)
+    for (unsigned int j = 0; j < dofs_per_cell; ++j)
+      this->mass_matrix.add(copy_data.local_dof_indices[i],
+                            copy_data.local_dof_indices[j],
+                            copy_data.cell_mass_matrix(i, j));
+}
+
+template <int dim>
+void ElectrochemicalPhysics<dim>::build_constraints()
+{
+  make_electrochemical_constraints(
+      *(this->dof_handler), *(this->geometry), this->locally_relevant_dofs,
+      _solid_potential_component, _cathode_dirichlet_bc, 1.0,
+      _unit_constraint_matrix);
+
+  // The constraints are linear in the voltage imposed on the cathode. Only the
+  // inhomogeneities need to be updated when the voltage changes, so we store
+  // their values for a unit voltage.
+  this->constraint_matrix.copy_from(_unit_constraint_matrix);
+  _constraints_cathode_voltage = 1.0;
+  _unit_inhomogeneities.clear();
+  unsigned int const n_dofs = this->locally_relevant_dofs.n_elements();
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    dealii::types::global_dof_index const dof =
+        this->locally_relevant_dofs.nth_index_in_set(i);
+    if (_unit_constraint_matrix.is_inhomogeneously_constrained(dof))
+      _unit_inhomogeneities.emplace_back(
+          dof, _unit_constraint_matrix.get_inhomogeneity(dof));
+  }
+}
+
+template <int dim>
+void ElectrochemicalPhysics<dim>::update_system(
+    std::shared_ptr<ElectrochemicalPhysicsParameters<dim> const> parameters)
+{
+  // All the time integrators solve a backward Euler system with a scaled time
+  // step.
+  double const time_step =
+      get_implicit_factor(parameters->time_integrator) * parameters->time_step;
+
+  // The Dirichlet boundary conditions are linear in the voltage imposed on the
+  // cathode so the right-hand side is obtained by scaling the load vectors
+  // assembled for a unit voltage.
+  double const cathode_voltage =
+      _cathode_dirichlet_bc ? parameters->constant_voltage : 0.;
+  if (cathode_voltage != _constraints_cathode_voltage)
+  {
+    for (auto const &inhomogeneity : _unit_inhomogeneities)
+      this->constraint_matrix.set_inhomogeneity(
+          inhomogeneity.first, cathode_voltage * inhomogeneity.second);
+    _constraints_cathode_voltage = cathode_voltage;
+  }
+
+  // M + alpha * dt * K, plus alpha * dt * B / (R * A) for a constant load
+  this->system_matrix.copy_from(_constrained_mass_matrix);
+  this->system_matrix.add(time_step, _stiffness_matrix);
+  if (parameters->supercapacitor_state == ConstantLoad)
+  {
+    BOOST_ASSERT_MSG(parameters->constant_load_density > 0.,
+                     "The load should be greater than zero.");
+    this->system_matrix.add(time_step / parameters->constant_load_density,
+                            _robin_matrix);
+  }
+
+  this->system_rhs = 0.0;
+  if (parameters->supercapacitor_state == ConstantCurrent)
+    this->system_rhs.add(time_step * parameters->constant_current_density,
+                         _neumann_load);
+  else if (parameters->supercapacitor_state == ConstantVoltage)
+    this->system_rhs.add(cathode_voltage, _mass_dirichlet_load,
+                         time_step * cathode_voltage,
+                         _stiffness_dirichlet_load);
 }
 }
 
@@ -31,5 +31,30 @@ template class UniformConstantMPValues<2>;
 template class UniformConstantMPValues<3>;
 template class FunctionSpaceMPValues<2>;
 template class FunctionSpaceMPValues<3>;
+template class MPValuesCache<2>;
+template class MPValuesCache<3>;
+
+std::string to_string(MaterialProperty const property)
+{
+  switch (property)
+  {
+  case MaterialProperty::specific_capacitance:
+    return "specific_capacitance";
+  case MaterialProperty::faradaic_reaction_coefficient:
+    return "faradaic_reaction_coefficient";
+  case MaterialProperty::solid_electrical_conductivity:
+    return "solid_electrical_conductivity";
+  case MaterialProperty::liquid_electrical_conductivity:
+    return "liquid_electrical_conductivity";
+  case MaterialProperty::density:
+    return "density";
+  case MaterialProperty::density_of_active_material:
+    return "density_of_active_material";
+  case MaterialProperty::specific_surface_area:
+    return "specific_surface_area";
+  default:
+    throw std::runtime_error("Invalid material property");
+  }
+}
 
 } // end samespace cap
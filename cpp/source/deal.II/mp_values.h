@@ -12,7 +12,12 @@
 #include <deal.II/grid/cell_id.h>
 #include <deal.II/fe/fe_values.h>
 #include <deal.II/base/function.h>
+#include <deal.II/base/quadrature.h>
+#include <deal.II/dofs/dof_handler.h>
+#include <boost/assert.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <array>
 
 namespace cap
 {
@@ -129,6 +134,11 @@ public:
   SuperCapacitorMPValues(MPValuesParameters<dim> const &params);
 };
 
+/**
+ * Material properties where the parameters listed in the database are sampled
+ * randomly on each locally owned cell. The sampling is reproducible: it only
+ * depends on the optional seed in the database and on the id of the cell.
+ */
 template <int dim>
 class InhomogeneousSuperCapacitorMPValues : public MPValues<dim>
 {
@@ -140,7 +150,19 @@ public:
                   std::vector<double> &values) const override;
 
 protected:
-  std::map<dealii::CellId, std::shared_ptr<MPValues<dim>>> _map = {};
+  /**
+   * Values of each property indexed by the active cell index. The cells that
+   * are not locally owned and the cells whose material does not define the
+   * property have the value NaN.
+   */
+  std::unordered_map<std::string, std::vector<double>> _values = {};
+  /**
+   * Space varying liquid electrical conductivity of the materials that
+   * define custom_liquid_electrical_conductivity.
+   */
+  std::unordered_map<dealii::types::material_id,
+                     std::shared_ptr<MPValues<dim> const>>
+      _custom_liquid_electrical_conductivity = {};
 };
 
 template <int dim>
@@ -159,6 +181,82 @@ public:
                     MPValuesParameters<dim> const &params);
 };
 
+//////////////////////// MP VALUES CACHE ////////////////////////////
+/**
+ * Material properties stored by MPValuesCache.
+ */
+enum class MaterialProperty : unsigned int
+{
+  specific_capacitance,
+  faradaic_reaction_coefficient,
+  solid_electrical_conductivity,
+  liquid_electrical_conductivity,
+  density,
+  density_of_active_material,
+  specific_surface_area,
+  n_properties
+};
+
+/**
+ * Return the key used by MPValues::get_values() for @p property.
+ */
+std::string to_string(MaterialProperty const property);
+
+/**
+ * This class evaluates once the material properties at the quadrature points
+ * of the locally owned cells and stores them in flat arrays, one per
+ * property, indexed by the active cell index. Reading the values does not
+ * require any string comparison, map lookup, or virtual call. When a property
+ * is constant on a cell, a single value is stored for that cell.
+ */
+template <int dim>
+class MPValuesCache
+{
+public:
+  MPValuesCache(MPValues<dim> const &mp_values,
+                dealii::DoFHandler<dim> const &dof_handler,
+                dealii::Quadrature<dim> const &quadrature);
+
+  /**
+   * Fill @p values with @p property evaluated at the quadrature points of the
+   * locally owned cell whose active cell index is @p active_cell_index.
+   */
+  inline void get_values(MaterialProperty const property,
+                         unsigned int const active_cell_index,
+                         std::vector<double> &values) const
+  {
+    unsigned int const p = static_cast<unsigned int>(property);
+    unsigned int const begin = _offsets[p][active_cell_index];
+    unsigned int const n_values = _offsets[p][active_cell_index + 1] - begin;
+    BOOST_ASSERT_MSG(n_values > 0, "The cell is not locally owned");
+    BOOST_ASSERT_MSG(values.size() == _n_q_points,
+                     "values must be the same size as the quadrature rule");
+    if (n_values == 1)
+      std::fill(values.begin(), values.end(), _values[p][begin]);
+    else
+      std::copy(_values[p].begin() + begin,
+                _values[p].begin() + begin + n_values, values.begin());
+  }
+
+  /**
+   * Return the number of quadrature points used to build the cache.
+   */
+  unsigned int n_quadrature_points() const { return _n_q_points; }
+
+private:
+  static unsigned int constexpr n_properties =
+      static_cast<unsigned int>(MaterialProperty::n_properties);
+
+  unsigned int _n_q_points;
+  /**
+   * The values of a property on the cell with active index i are stored
+   * between _offsets[p][i] and _offsets[p][i+1] in _values[p]. There is no
+   * value for the cells that are not locally owned.
+   */
+  std::array<std::vector<unsigned int>, n_properties> _offsets;
+  std::array<std::vector<double>, n_properties> _values;
+};
+
 } // end namespace cap
 
 #endif // CAP_MP_VALUES_H
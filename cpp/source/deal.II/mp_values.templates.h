@@ -8,6 +8,10 @@
 #include <cap/mp_values.h>
 #include <cap/utils.h>
 #include <deal.II/base/function_parser.h>
+#include <deal.II/base/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <random>
 #include <tuple>
 #include <stdexcept>
@@ -166,92 +170,6 @@ build_material_properties(std::string const &material_name,
 }
 } // end namespace internal
 
-//////////////////////// INHOMOGENEOUS SUPERCAPACITOR //////////////////////////
-template <int dim>
-InhomogeneousSuperCapacitorMPValues<dim>::InhomogeneousSuperCapacitorMPValues(
-    MPValuesParameters<dim> const &params)
-{
-  boost::property_tree::ptree const &database = *params.database;
-  // Build a map material_id -> material_name
-  std::map<dealii::types::material_id, std::string> material_map;
-  for (auto const &m : *params.geometry->get_materials())
-  {
-    std::string const &material_name = m.first;
-    auto const &material_ids = m.second;
-    boost::property_tree::ptree const &material_database =
-        database.get_child(material_name);
-    std::string const type = material_database.get<std::string>("type");
-    for (auto const &id : material_ids)
-    {
-      auto ret = material_map.emplace(id, material_name);
-      if (!ret.second)
-        throw std::runtime_error("material id " + std::to_string(id) +
-                                 " assigned multiple times");
-    }
-  }
-  auto const parameters = database.get<int>("parameters");
-  // Build a map material_id -> parameters
-  // TODO: For simplicity let's perturb all parameters for now
-  // The map is only a map parameter path in the ptree -> object that emulates
-  // the std random distribution (i.e. takes a generator object as argument and
-  // returns a double)
-  std::map<std::string, std::function<double(std::default_random_engine &)>>
-      parameter_map;
-  for (int p = 0; p < parameters; ++p)
-  {
-    boost::property_tree::ptree const &parameter_database =
-        database.get_child("parameter_" + std::to_string(p));
-    auto const parameter_path = parameter_database.get<std::string>("path");
-    // Check that the parameter does exist
-    if (!database.get_optional<double>(parameter_path))
-      throw std::runtime_error("Parameter path " + parameter_path +
-                               " does not exist in the material database");
-    auto ret = parameter_map.emplace(
-        parameter_path, internal::build_parameter(parameter_database));
-    if (!ret.second)
-      throw std::runtime_error("Parameter " + parameter_path +
-                               "  is present multiple times");
-  }
-  // Make a copy of the material database so that the original database is not
-  // changed.
-  auto perturbed_database =
-      std::make_shared<boost::property_tree::ptree>(*params.database);
-  MPValuesParameters<dim> perturbed_params = params;
-  perturbed_params.database = perturbed_database;
-  // Traverse the triangulation and build material properties with perturbed
-  // parameters in each cell.
-  // Construct a random number generator and use the MPI rank as a seed.
-  std::default_random_engine generator(
-      params.geometry->get_mpi_communicator().rank());
-  auto const &triangulation = *params.geometry->get_triangulation();
-
-  for (auto cell : triangulation.active_cell_iterators())
-  {
-    if (cell->is_locally_owned())
-    {
-      // Perturb the parameters in the copy of the database
-      for (auto const &x : parameter_map)
-        perturbed_database->put(x.first, x.second(generator));
-      _map.emplace(cell->id(),
-                   internal::build_material_properties(
-                       material_map[cell->material_id()], perturbed_params));
-    }
-  }
-}
-
-template <int dim>
-void InhomogeneousSuperCapacitorMPValues<dim>::get_values(
-    std::string const &key, dealii::FEValues<dim> const &fe_values,
-    std::vector<double> &values) const
-{
-  auto cell = fe_values.get_cell();
-  auto got = _map.find(cell->id());
-  if (got == _map.end())
-    throw std::runtime_error("Invalid cell property " + cell->id().to_string());
-  auto property = got->second;
-  property->get_values(key, fe_values, values);
-}
-
 //////////////////////// SUPERCAPACITOR ////////////////////////////////////////
 template <int dim>
 std::unique_ptr<MPValues<dim>>
@@ -313,102 +231,148 @@ auto to_ohm_meter = [](double const &o_cm)
   return 1e-2 * o_cm;
 };
 
-template <int dim>
-PorousElectrodeMPValues<dim>::PorousElectrodeMPValues(
-    std::string const &material_name, MPValuesParameters<dim> const &parameters)
+namespace internal
+{
+// Compute the material properties of a porous electrode. For a permeable
+// membrane, the matrix phase has no capacitance, no Faradaic reaction, and it
+// does not conduct electrons.
+inline std::unordered_map<std::string, double>
+compute_porous_electrode_properties(std::string const &material_name,
+                                    boost::property_tree::ptree const &database,
+                                    bool const permeable_membrane = false)
 {
-  std::shared_ptr<boost::property_tree::ptree const> database =
-      parameters.database;
-  std::shared_ptr<boost::property_tree::ptree const> material_database =
-      std::make_shared<boost::property_tree::ptree>(
-          database->get_child(material_name));
-
   std::string const matrix_phase =
-      material_database->get<std::string>("matrix_phase");
-  std::shared_ptr<boost::property_tree::ptree const> matrix_phase_database =
-      std::make_shared<boost::property_tree::ptree>(
-          database->get_child(matrix_phase));
+      database.get<std::string>(material_name + ".matrix_phase");
+  boost::property_tree::ptree const &matrix_phase_database =
+      database.get_child(matrix_phase);
 
   // from the matrix_phase database
   // clang-format off
-  double const differential_capacitance       = to_farads_per_square_meter(matrix_phase_database->get<double>("differential_capacitance"));
-  double const exchange_current_density       = to_amperes_per_square_meter(matrix_phase_database->get<double>("exchange_current_density"));
-  double const void_volume_fraction           = matrix_phase_database->get<double>("void_volume_fraction");
-  double const tortuosity_factor              = matrix_phase_database->get<double>("tortuosity_factor");
-  double const pores_characteristic_dimension = to_meters(matrix_phase_database->get<double>("pores_characteristic_dimension"));
-  double const pores_geometry_factor          = matrix_phase_database->get<double>("pores_geometry_factor");
-  double const mass_density                   = to_kilograms_per_cubic_meter(matrix_phase_database->get<double>("mass_density"));
-  double const electrical_resistivity         = to_ohm_meter(matrix_phase_database->get<double>("electrical_resistivity"));
-  double const electrical_conductivity        = (electrical_resistivity>1e300) ? 0. : 1.0/electrical_resistivity;
-  double const heat_capacity                  = matrix_phase_database->get<double>("heat_capacity");
-  double const thermal_conductivity           = matrix_phase_database->get<double>("thermal_conductivity");
+  double const differential_capacitance       = permeable_membrane ? 0. : to_farads_per_square_meter(matrix_phase_database.get<double>("differential_capacitance"));
+  double const exchange_current_density       = permeable_membrane ? 0. : to_amperes_per_square_meter(matrix_phase_database.get<double>("exchange_current_density"));
+  double const void_volume_fraction           = matrix_phase_database.get<double>("void_volume_fraction");
+  double const tortuosity_factor              = matrix_phase_database.get<double>("tortuosity_factor");
+  double const pores_characteristic_dimension = to_meters(matrix_phase_database.get<double>("pores_characteristic_dimension"));
+  double const pores_geometry_factor          = matrix_phase_database.get<double>("pores_geometry_factor");
+  double const mass_density                   = to_kilograms_per_cubic_meter(matrix_phase_database.get<double>("mass_density"));
+  double const electrical_resistivity         = permeable_membrane ? 0. : to_ohm_meter(matrix_phase_database.get<double>("electrical_resistivity"));
+  double const electrical_conductivity        = (permeable_membrane || (electrical_resistivity>1e300)) ? 0. : 1.0/electrical_resistivity;
+  double const heat_capacity                  = matrix_phase_database.get<double>("heat_capacity");
+  double const thermal_conductivity           = matrix_phase_database.get<double>("thermal_conductivity");
   // clang-format on
+  std::ignore = heat_capacity;
+  std::ignore = thermal_conductivity;
   double const specific_surface_area_per_unit_volume =
       (1.0 + pores_geometry_factor) * void_volume_fraction /
       pores_characteristic_dimension;
-  (this->_properties)
-      .emplace("specific_surface_area",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   specific_surface_area_per_unit_volume));
-  (this->_properties)
-      .emplace("specific_capacitance",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   specific_surface_area_per_unit_volume *
-                   differential_capacitance));
-  (this->_properties)
-      .emplace("solid_electrical_conductivity",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   (1.0 - void_volume_fraction) * electrical_conductivity));
 
   // from the solution_phase datatabase
   std::string const solution_phase =
-      material_database->get<std::string>("solution_phase");
-  std::shared_ptr<boost::property_tree::ptree const> solution_phase_database =
-      std::make_shared<boost::property_tree::ptree>(
-          database->get_child(solution_phase));
+      database.get<std::string>(material_name + ".solution_phase");
+  boost::property_tree::ptree const &solution_phase_database =
+      database.get_child(solution_phase);
   double const electrolyte_conductivity =
       1.0 / to_ohm_meter(
-                solution_phase_database->get<double>("electrical_resistivity"));
+                solution_phase_database.get<double>("electrical_resistivity"));
   double const electrolyte_mass_density = to_kilograms_per_cubic_meter(
-      solution_phase_database->get<double>("mass_density"));
-  (this->_properties)
-      .emplace("liquid_electrical_conductivity",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   void_volume_fraction * electrolyte_conductivity /
-                   tortuosity_factor));
+      solution_phase_database.get<double>("mass_density"));
+
   // TODO: not sure where to pull this from
   // clang-format off
-  double const anodic_charge_transfer_coefficient   = database->get<double>("anodic_charge_transfer_coefficient", 0.5);
-  double const cathodic_charge_transfer_coefficient = database->get<double>("cathodic_charge_transfer_coefficient", 0.5);
-  double const faraday_constant                     = database->get<double>("faraday_constant", 9.64853365e4);
-  double const gas_constant                         = database->get<double>("gas_constant", 8.3144621);
-  double const temperature                          = database->get<double>("temperature", 300.0);
+  double const anodic_charge_transfer_coefficient   = database.get<double>("anodic_charge_transfer_coefficient", 0.5);
+  double const cathodic_charge_transfer_coefficient = database.get<double>("cathodic_charge_transfer_coefficient", 0.5);
+  double const faraday_constant                     = database.get<double>("faraday_constant", 9.64853365e4);
+  double const gas_constant                         = database.get<double>("gas_constant", 8.3144621);
+  double const temperature                          = database.get<double>("temperature", 300.0);
+  // clang-format on
+
+  std::unordered_map<std::string, double> properties;
+  properties["specific_surface_area"] = specific_surface_area_per_unit_volume;
+  properties["specific_capacitance"] =
+      specific_surface_area_per_unit_volume * differential_capacitance;
+  properties["solid_electrical_conductivity"] =
+      (1.0 - void_volume_fraction) * electrical_conductivity;
+  properties["liquid_electrical_conductivity"] =
+      void_volume_fraction * electrolyte_conductivity / tortuosity_factor;
+  properties["faradaic_reaction_coefficient"] =
+      specific_surface_area_per_unit_volume * exchange_current_density *
+      (anodic_charge_transfer_coefficient +
+       cathodic_charge_transfer_coefficient) *
+      faraday_constant / (gas_constant * temperature);
+  properties["electron_thermal_voltage"] =
+      gas_constant * temperature / faraday_constant;
+  properties["density"] = void_volume_fraction * electrolyte_mass_density +
+                          (1.0 - void_volume_fraction) * mass_density;
+  properties["density_of_active_material"] =
+      (1.0 - void_volume_fraction) * mass_density;
+
+  return properties;
+}
+
+// Compute the material properties of a metal foil.
+inline std::unordered_map<std::string, double>
+compute_metal_foil_properties(std::string const &material_name,
+                              boost::property_tree::ptree const &database)
+{
+  std::string const metal_foil =
+      database.get<std::string>(material_name + ".metal_foil");
+  boost::property_tree::ptree const &metal_foil_database =
+      database.get_child(metal_foil);
+
+  // clang-format off
+  double const mass_density           = to_kilograms_per_cubic_meter(metal_foil_database.get<double>("mass_density"));
+  double const electrical_resistivity = to_ohm_meter(metal_foil_database.get<double>("electrical_resistivity"));
+  double const heat_capacity          = metal_foil_database.get<double>("heat_capacity");
+  double const thermal_conductivity   = metal_foil_database.get<double>("thermal_conductivity");
   // clang-format on
-  (this->_properties)
-      .emplace("faradaic_reaction_coefficient",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   specific_surface_area_per_unit_volume *
-                   exchange_current_density *
-                   (anodic_charge_transfer_coefficient +
-                    cathodic_charge_transfer_coefficient) *
-                   faraday_constant / (gas_constant * temperature)));
-  (this->_properties)
-      .emplace("electron_thermal_voltage",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   gas_constant * temperature / faraday_constant));
   std::ignore = heat_capacity;
   std::ignore = thermal_conductivity;
-  (this->_properties)
-      .emplace("density", std::make_shared<UniformConstantMPValues<dim>>(
-                              void_volume_fraction * electrolyte_mass_density +
-                              (1.0 - void_volume_fraction) * mass_density));
-  (this->_properties)
-      .emplace("density_of_active_material",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   (1.0 - void_volume_fraction) * mass_density));
-
-  auto custom = matrix_phase_database->get_child_optional(
-      "custom_liquid_electrical_conductivity");
+
+  std::unordered_map<std::string, double> properties;
+  properties["density_of_active_material"] = 0.0;
+  properties["specific_surface_area"] = 0.0;
+  properties["specific_capacitance"] = 0.0;
+  properties["faradaic_reaction_coefficient"] = 0.0;
+  properties["liquid_electrical_conductivity"] = 0.0;
+  properties["solid_electrical_conductivity"] = 1.0 / electrical_resistivity;
+  properties["density"] = mass_density;
+
+  return properties;
+}
+
+// Compute the material properties of any type of material.
+inline std::unordered_map<std::string, double>
+compute_material_properties(std::string const &material_name,
+                            boost::property_tree::ptree const &database)
+{
+  std::string const type = database.get<std::string>(material_name + ".type");
+  if (type.compare("porous_electrode") == 0)
+    return compute_porous_electrode_properties(material_name, database);
+  else if (type.compare("permeable_membrane") == 0)
+    return compute_porous_electrode_properties(material_name, database, true);
+  else if (type.compare("current_collector") == 0)
+    return compute_metal_foil_properties(material_name, database);
+  else
+    throw std::runtime_error("Invalid material type " + type);
+}
+} // end namespace internal
+
+template <int dim>
+PorousElectrodeMPValues<dim>::PorousElectrodeMPValues(
+    std::string const &material_name, MPValuesParameters<dim> const &parameters)
+{
+  boost::property_tree::ptree const &database = *parameters.database;
+  for (auto const &property :
+       internal::compute_porous_electrode_properties(material_name, database))
+    (this->_properties)
+        .emplace(property.first,
+                 std::make_shared<UniformConstantMPValues<dim>>(
+                     property.second));
+
+  std::string const matrix_phase =
+      database.get<std::string>(material_name + ".matrix_phase");
+  auto custom = database.get_child(matrix_phase)
+                    .get_child_optional("custom_liquid_electrical_conductivity");
   if (custom)
     (this->_properties)["liquid_electrical_conductivity"] =
         std::make_shared<FunctionSpaceMPValues<dim>>(*custom);
@@ -419,41 +383,148 @@ template <int dim>
 MetalFoilMPValues<dim>::MetalFoilMPValues(
     std::string const &material_name, MPValuesParameters<dim> const &parameters)
 {
-  std::shared_ptr<boost::property_tree::ptree const> database =
-      parameters.database;
-  std::shared_ptr<boost::property_tree::ptree const> material_database =
-      std::make_shared<boost::property_tree::ptree>(
-          database->get_child(material_name));
+  for (auto const &property : internal::compute_metal_foil_properties(
+           material_name, *parameters.database))
+    (this->_properties)
+        .emplace(property.first,
+                 std::make_shared<UniformConstantMPValues<dim>>(
+                     property.second));
+}
 
-  std::string const metal_foil =
-      material_database->get<std::string>("metal_foil");
-  std::shared_ptr<boost::property_tree::ptree const> metal_foil_database =
-      std::make_shared<boost::property_tree::ptree>(
-          database->get_child(metal_foil));
+//////////////////////// INHOMOGENEOUS SUPERCAPACITOR //////////////////////////
+template <int dim>
+InhomogeneousSuperCapacitorMPValues<dim>::InhomogeneousSuperCapacitorMPValues(
+    MPValuesParameters<dim> const &params)
+{
+  boost::property_tree::ptree const &database = *params.database;
+  // Build a map material_id -> material_name
+  std::map<dealii::types::material_id, std::string> material_map;
+  for (auto const &m : *params.geometry->get_materials())
+  {
+    std::string const &material_name = m.first;
+    auto const &material_ids = m.second;
+    for (auto const &id : material_ids)
+    {
+      auto ret = material_map.emplace(id, material_name);
+      if (!ret.second)
+        throw std::runtime_error("material id " + std::to_string(id) +
+                                 " assigned multiple times");
+    }
+    // A custom liquid electrical conductivity replaces the (perturbed)
+    // uniform value.
+    if (database.get<std::string>(material_name + ".type")
+            .compare("current_collector") != 0)
+    {
+      auto custom =
+          database
+              .get_child(database.get<std::string>(material_name +
+                                                   ".matrix_phase"))
+              .get_child_optional("custom_liquid_electrical_conductivity");
+      if (custom)
+      {
+        auto function = std::make_shared<FunctionSpaceMPValues<dim>>(*custom);
+        for (auto const &id : material_ids)
+          _custom_liquid_electrical_conductivity.emplace(id, function);
+      }
+    }
+    // Allocate one array for each property of the material.
+    for (auto const &property :
+         internal::compute_material_properties(material_name, database))
+      _values.emplace(property.first, std::vector<double>());
+  }
+  auto const parameters = database.get<int>("parameters");
+  // Build a map material_id -> parameters
+  // TODO: For simplicity let's perturb all parameters for now
+  // The map is only a map parameter path in the ptree -> object that emulates
+  // the std random distribution (i.e. takes a generator object as argument and
+  // returns a double)
+  std::map<std::string, std::function<double(std::default_random_engine &)>>
+      parameter_map;
+  for (int p = 0; p < parameters; ++p)
+  {
+    boost::property_tree::ptree const &parameter_database =
+        database.get_child("parameter_" + std::to_string(p));
+    auto const parameter_path = parameter_database.get<std::string>("path");
+    // Check that the parameter does exist
+    if (!database.get_optional<double>(parameter_path))
+      throw std::runtime_error("Parameter path " + parameter_path +
+                               " does not exist in the material database");
+    auto ret = parameter_map.emplace(
+        parameter_path, internal::build_parameter(parameter_database));
+    if (!ret.second)
+      throw std::runtime_error("Parameter " + parameter_path +
+                               "  is present multiple times");
+  }
 
-  // clang-format off
-  double const mass_density           = to_kilograms_per_cubic_meter(metal_foil_database->get<double>("mass_density"));
-  double const electrical_resistivity = to_ohm_meter(metal_foil_database->get<double>("electrical_resistivity"));
-  double const heat_capacity          = metal_foil_database->get<double>("heat_capacity");
-  double const thermal_conductivity   = metal_foil_database->get<double>("thermal_conductivity");
-  // clang-format on
+  // The cells that are not locally owned have no value.
+  auto const &triangulation = *params.geometry->get_triangulation();
+  for (auto &property : _values)
+    property.second.assign(triangulation.n_active_cells(),
+                           std::numeric_limits<double>::quiet_NaN());
+  std::vector<typename dealii::Triangulation<dim>::active_cell_iterator>
+      locally_owned_cells;
+  for (auto cell : triangulation.active_cell_iterators())
+    if (cell->is_locally_owned())
+      locally_owned_cells.push_back(cell);
 
-  auto null_property = std::make_shared<UniformConstantMPValues<dim>>(0.0);
-
-  (this->_properties).emplace("density_of_active_material", null_property);
-  (this->_properties).emplace("specific_surface_area", null_property);
-  (this->_properties).emplace("specific_capacitance", null_property);
-  (this->_properties).emplace("faradaic_reaction_coefficient", null_property);
-  (this->_properties).emplace("liquid_electrical_conductivity", null_property);
-  (this->_properties)
-      .emplace("solid_electrical_conductivity",
-               std::make_shared<UniformConstantMPValues<dim>>(
-                   1.0 / electrical_resistivity));
-  (this->_properties)
-      .emplace("density",
-               std::make_shared<UniformConstantMPValues<dim>>(mass_density));
-  std::ignore = heat_capacity;
-  std::ignore = thermal_conductivity;
+  // The random number generator of each cell is seeded with the seed given in
+  // the database and with the id of the cell. The sampled values do not depend
+  // on the partition of the mesh or on the number of threads. The cells are
+  // processed in parallel and each thread perturbs its own copy of the
+  // database.
+  unsigned int const seed = database.get("seed", 0);
+  dealii::parallel::apply_to_subranges(
+      0u, static_cast<unsigned int>(locally_owned_cells.size()),
+      [&](unsigned int const begin, unsigned int const end)
+      {
+        boost::property_tree::ptree perturbed_database = database;
+        for (unsigned int i = begin; i < end; ++i)
+        {
+          auto const &cell = locally_owned_cells[i];
+          std::string const cell_id = cell->id().to_string();
+          std::vector<unsigned int> seeds(1, seed);
+          seeds.insert(seeds.end(), cell_id.begin(), cell_id.end());
+          std::seed_seq seed_sequence(seeds.begin(), seeds.end());
+          std::default_random_engine generator(seed_sequence);
+          // The distributions have an internal state so each cell uses its
+          // own copy.
+          auto cell_parameter_map = parameter_map;
+          // Perturb the parameters in the copy of the database
+          for (auto &x : cell_parameter_map)
+            perturbed_database.put(x.first, x.second(generator));
+          for (auto const &property : internal::compute_material_properties(
+                   material_map.at(cell->material_id()), perturbed_database))
+            _values.at(property.first)[cell->active_cell_index()] =
+                property.second;
+        }
+      },
+      64);
+}
+
+template <int dim>
+void InhomogeneousSuperCapacitorMPValues<dim>::get_values(
+    std::string const &key, dealii::FEValues<dim> const &fe_values,
+    std::vector<double> &values) const
+{
+  auto cell = fe_values.get_cell();
+  if (key.compare("liquid_electrical_conductivity") == 0)
+  {
+    auto custom = _custom_liquid_electrical_conductivity.find(
+        cell->material_id());
+    if (custom != _custom_liquid_electrical_conductivity.end())
+    {
+      custom->second->get_values(key, fe_values, values);
+      return;
+    }
+  }
+  auto property = _values.find(key);
+  if (property == _values.end())
+    throw std::runtime_error("Invalid material property " + key);
+  double const value = property->second[cell->active_cell_index()];
+  if (std::isnan(value))
+    throw std::runtime_error("Invalid cell property " +
+                             cell->id().to_string());
+  std::fill(values.begin(), values.end(), value);
 }
 
 template <int dim>
@@ -496,4 +567,51 @@ void FunctionSpaceMPValues<dim>::get_values(
   }
 }
 
+//////////////////////// MP VALUES CACHE ///////////////////////////////////////
+template <int dim>
+MPValuesCache<dim>::MPValuesCache(MPValues<dim> const &mp_values,
+                                  dealii::DoFHandler<dim> const &dof_handler,
+                                  dealii::Quadrature<dim> const &quadrature)
+    : _n_q_points(quadrature.size())
+{
+  // FunctionSpaceMPValues needs the position of the quadrature points.
+  dealii::FEValues<dim> fe_values(dof_handler.get_fe(), quadrature,
+                                  dealii::update_quadrature_points);
+  unsigned int const n_active_cells =
+      dof_handler.get_triangulation().n_active_cells();
+  std::vector<double> cell_values(_n_q_points);
+  for (unsigned int p = 0; p < n_properties; ++p)
+  {
+    _offsets[p].assign(n_active_cells + 1, 0);
+    _values[p].clear();
+  }
+
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    unsigned int const i = cell->active_cell_index();
+    if (cell->is_locally_owned())
+    {
+      fe_values.reinit(cell);
+      for (unsigned int p = 0; p < n_properties; ++p)
+      {
+        mp_values.get_values(to_string(static_cast<MaterialProperty>(p)),
+                             fe_values, cell_values);
+        bool const is_constant =
+            std::all_of(cell_values.begin(), cell_values.end(),
+                        [&cell_values](double const value)
+                        {
+                          return value == cell_values[0];
+                        });
+        if (is_constant)
+          _values[p].push_back(cell_values[0]);
+        else
+          _values[p].insert(_values[p].end(), cell_values.begin(),
+                            cell_values.end());
+      }
+    }
+    for (unsigned int p = 0; p < n_properties; ++p)
+      _offsets[p][i + 1] = _values[p].size();
+  }
+}
+
 } // end namespace cap
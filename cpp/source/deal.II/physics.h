@@ -21,7 +21,8 @@ class PhysicsParameters
 {
 public:
   PhysicsParameters(boost::property_tree::ptree const &d)
-      : geometry(nullptr), dof_handler(nullptr), mp_values(nullptr), database(d)
+      : geometry(nullptr), dof_handler(nullptr), mp_values(nullptr),
+        mp_values_cache(nullptr), database(d)
   {
   }
 
@@ -30,6 +31,11 @@ public:
   std::shared_ptr<Geometry<dim> const> geometry;
   std::shared_ptr<dealii::DoFHandler<dim>> dof_handler;
   std::shared_ptr<MPValues<dim> const> mp_values;
+  /**
+   * Material properties evaluated at the quadrature points. This is optional:
+   * if it is not set, the Physics builds its own cache from mp_values.
+   */
+  std::shared_ptr<MPValuesCache<dim> const> mp_values_cache;
   boost::property_tree::ptree const database;
 };
 
@@ -8,6 +8,7 @@
 #ifndef CAP_POSTPROCESSOR_H
 #define CAP_POSTPROCESSOR_H
 
+#include <cap/energy_integrator.h> // compute_energy
 #include <cap/mp_values.h>
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/lac/sparse_matrix.h>
@@ -28,7 +29,7 @@ public:
       std::shared_ptr<boost::property_tree::ptree const> d,
       std::shared_ptr<dealii::DoFHandler<dim>> const dof_handler)
       : dof_handler(dof_handler), solution(nullptr), mp_values(nullptr),
-        database(d)
+        mp_values_cache(nullptr), database(d)
   {
     BOOST_ASSERT_MSG(dof_handler != nullptr, "Invalid DoFHandler.");
     BOOST_ASSERT_MSG(database != nullptr, "Invalid database.");
@@ -39,6 +40,11 @@ public:
   std::shared_ptr<dealii::Trilinos::MPI::BlockVector const> solution;
 
   std::shared_ptr<MPValues<dim> const> mp_values;
+  /**
+   * Material properties evaluated at the quadrature points. This is optional:
+   * if it is not set, the Postprocessor builds its own cache from mp_values.
+   */
+  std::shared_ptr<MPValuesCache<dim> const> mp_values_cache;
 
   std::shared_ptr<boost::property_tree::ptree const> database;
 };
@@ -58,6 +64,12 @@ public:
   std::vector<std::string> get_vector_keys() const;
 
 protected:
+  /**
+   * Called by get() before @p key is looked up. Derived classes can override
+   * this function to compute expensive quantities only when they are needed.
+   */
+  virtual void update(std::string const &key) const;
+
   boost::mpi::communicator _communicator;
   std::shared_ptr<dealii::DoFHandler<dim> const> dof_handler;
   std::shared_ptr<dealii::Trilinos::MPI::BlockVector const> solution;
@@ -65,9 +77,10 @@ protected:
   std::shared_ptr<MPValues<dim> const> mp_values;
 
   // This values are only local to a processor, so we don't use
-  // Trilinos::MPI::Vector.
-  std::unordered_map<std::string, dealii::Vector<double>> vectors;
-  std::unordered_map<std::string, double> values;
+  // Trilinos::MPI::Vector. They are mutable so that they can be computed
+  // lazily in update().
+  mutable std::unordered_map<std::string, dealii::Vector<double>> vectors;
+  mutable std::unordered_map<std::string, double> values;
 };
 
 //////////////////////// SUPERCAPACITOR POSTPROCESSOR PARAMETERS ////
@@ -82,6 +95,17 @@ public:
 };
 
 //////////////////////// SUPERCAPACITOR POSTPROCESSOR ///////////////
+/**
+ * Compute the voltage and the current on the cathode and other quantities of
+ * interest. The quantities that only depend on the mesh and on the material
+ * properties, e.g. the volume, the mass, or the surface area, are computed
+ * once in the constructor. If postprocessor.lightweight is true in the
+ * database, reset() only integrates over the faces of the cathode, i.e., it
+ * only computes the voltage and the current. The other quantities that depend
+ * on the solution are computed the first time they are requested through
+ * get(). Since they require a reduction, get() must then be called on all the
+ * processors.
+ */
 template <int dim>
 class SuperCapacitorPostprocessor : public Postprocessor<dim>
 {
@@ -93,24 +117,57 @@ public:
   void reset(
       std::shared_ptr<PostprocessorParameters<dim> const> parameters) override;
 
+protected:
+  void update(std::string const &key) const override;
+
 private:
+  /**
+   * Integrate the quantities that do not depend on the solution. This is done
+   * once in the constructor.
+   */
+  void compute_geometric_quantities();
+
+  /**
+   * Integrate the current and the voltage over the faces of the cathode.
+   */
+  void compute_cathode_quantities();
+
+  /**
+   * Integrate the quantities defined over the cells that depend on the
+   * solution and fill the debug vectors.
+   */
+  void compute_volume_quantities() const;
+
+  bool _lightweight;
+  mutable bool _volume_quantities_up_to_date;
+  /**
+   * Volume of the anode and of the cathode. They are used to average the
+   * potential of the electrodes.
+   */
+  double _anode_volume;
+  double _cathode_volume;
+  unsigned int _solid_potential_component;
+  unsigned int _liquid_potential_component;
+  /**
+   * Copy of the solution with the ghost entries. The vector is allocated once
+   * and updated by reset().
+   */
+  dealii::Trilinos::MPI::BlockVector _relevant_solution;
+  /**
+   * Locally owned cells and face indices of the faces on the cathode.
+   */
+  std::vector<std::pair<typename dealii::DoFHandler<dim>::active_cell_iterator,
+                        unsigned int>>
+      _cathode_faces;
   bool _debug_material_ids;
   bool _debug_boundary_ids;
   std::vector<std::string> _debug_material_properties;
   std::vector<std::string> _debug_solution_fields;
   std::vector<std::string> _debug_solution_fluxes;
   std::shared_ptr<Geometry<dim> const> _geometry;
+  std::shared_ptr<MPValuesCache<dim> const> _mp_values_cache;
 };
 
-//////////////////////// MOVE SOMEWHERE ELSE LATER /////////////////////
-
-/**
- * Compute the integral of the power using Dormand-Prince 5. A linear
- * interpolation is used for the power when necessary.
- */
-void compute_energy(std::vector<double> const &time,
-                    std::vector<double> const &power,
-                    std::vector<double> &energy);
 } // end namespace cap
 
 #endif // CAP_POSTPROCESSOR_H
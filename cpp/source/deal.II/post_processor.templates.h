@@ -10,6 +10,7 @@
 #include <deal.II/base/quadrature_lib.h>
 #include <deal.II/dofs/dof_tools.h>
 #include <deal.II/fe/fe_values.h>
+#include <deal.II/grid/filtered_iterator.h>
 #include <algorithm>
 #include <functional>
 #include <limits>
@@ -35,6 +36,7 @@ template <int dim>
 dealii::Vector<double> const &
 Postprocessor<dim>::get(std::string const &key) const
 {
+  this->update(key);
   std::unordered_map<std::string, dealii::Vector<double>>::const_iterator it =
       this->vectors.find(key);
   AssertThrow(it != this->vectors.end(), dealii::StandardExceptions::ExcMessage(
@@ -45,6 +47,7 @@ Postprocessor<dim>::get(std::string const &key) const
 template <int dim>
 void Postprocessor<dim>::get(std::string const &key, double &value) const
 {
+  this->update(key);
   std::unordered_map<std::string, double>::const_iterator it =
       this->values.find(key);
   AssertThrow(it != this->values.end(), dealii::StandardExceptions::ExcMessage(
@@ -52,6 +55,11 @@ void Postprocessor<dim>::get(std::string const &key, double &value) const
   value = it->second;
 }
 
+template <int dim>
+void Postprocessor<dim>::update(std::string const &) const
+{
+}
+
 template <int dim>
 std::vector<std::string> Postprocessor<dim>::get_vector_keys() const
 {
@@ -81,12 +89,20 @@ SuperCapacitorPostprocessor<dim>::SuperCapacitorPostprocessor(
     std::shared_ptr<PostprocessorParameters<dim> const> parameters,
     std::shared_ptr<Geometry<dim> const> geometry,
     boost::mpi::communicator mpi_communicator)
-    : Postprocessor<dim>(parameters, mpi_communicator),
+    : Postprocessor<dim>(parameters, mpi_communicator), _lightweight(false),
+      _volume_quantities_up_to_date(false), _anode_volume(0.),
+      _cathode_volume(0.), _solid_potential_component(0),
+      _liquid_potential_component(0), _relevant_solution(), _cathode_faces(),
       _debug_material_ids(false), _debug_boundary_ids(false),
       _debug_material_properties(), _debug_solution_fields(),
-      _debug_solution_fluxes(), _geometry(geometry)
+      _debug_solution_fluxes(), _geometry(geometry),
+      _mp_values_cache(parameters->mp_values_cache)
 {
   dealii::DoFHandler<dim> const &dof_handler = *(this->dof_handler);
+  if (_mp_values_cache == nullptr)
+    _mp_values_cache = std::make_shared<MPValuesCache<dim>>(
+        *(this->mp_values), dof_handler,
+        dealii::QGauss<dim>(dof_handler.get_fe().degree + 1));
   this->values["voltage"] = 0.0;
   this->values["current"] = 0.0;
   this->values["joule_heating"] = 0.0;
@@ -97,11 +113,19 @@ SuperCapacitorPostprocessor<dim>::SuperCapacitorPostprocessor(
   this->values["anode_electrode_mass_of_active_material"] = 0.0;
   this->values["cathode_electrode_interfacial_surface_area"] = 0.0;
   this->values["cathode_electrode_mass_of_active_material"] = 0.0;
+  this->values["anode_potential"] = 0.0;
+  this->values["cathode_potential"] = 0.0;
   this->values["n_dofs"] = static_cast<double>(dof_handler.n_dofs());
 
   std::shared_ptr<boost::property_tree::ptree const> database =
       parameters->database;
 
+  _lightweight = database->get("postprocessor.lightweight", false);
+  _solid_potential_component =
+      database->get<unsigned int>("solid_potential_component");
+  _liquid_potential_component =
+      database->get<unsigned int>("liquid_potential_component");
+
   this->_debug_material_properties = cap::to_vector<std::string>(
       database->get("debug.material_properties", ""));
   this->_debug_solution_fields =
@@ -133,328 +157,383 @@ SuperCapacitorPostprocessor<dim>::SuperCapacitorPostprocessor(
     for (int d = 0; d < dim; ++d)
       this->vectors[(*it) + "_" + std::to_string(d)] =
           dealii::Vector<double>(n_active_cells);
+
+  // Allocate the vector with the ghost entries once and for all.
+  dealii::IndexSet locally_relevant_dofs;
+  dealii::DoFTools::extract_locally_relevant_dofs(dof_handler,
+                                                  locally_relevant_dofs);
+  std::vector<dealii::IndexSet> index_sets(1, locally_relevant_dofs);
+  _relevant_solution.reinit(index_sets, this->_communicator);
+
+  // Store the faces on the cathode so that we don't need to loop over all the
+  // cells to compute the voltage and the current.
+  auto const &cathode_boundary_ids = _geometry->get_boundaries()->at("cathode");
+  for (auto cell :
+       dealii::filter_iterators(dof_handler.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell(),
+                                dealii::IteratorFilters::AtBoundary()))
+    for (unsigned int face = 0;
+         face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
+      if ((cell->face(face)->at_boundary()) &&
+          (cathode_boundary_ids.count(cell->face(face)->boundary_id()) > 0))
+        _cathode_faces.emplace_back(cell, face);
+
+  compute_geometric_quantities();
 }
 
 template <int dim>
 void SuperCapacitorPostprocessor<dim>::reset(
-    std::shared_ptr<PostprocessorParameters<dim> const> parameters)
+    std::shared_ptr<PostprocessorParameters<dim> const> /*parameters*/)
+{
+  _relevant_solution = *(this->solution);
+
+  compute_cathode_quantities();
+
+  _volume_quantities_up_to_date = false;
+  if (!_lightweight)
+    compute_volume_quantities();
+}
+
+template <int dim>
+void SuperCapacitorPostprocessor<dim>::update(std::string const &key) const
+{
+  if (_volume_quantities_up_to_date)
+    return;
+  if ((this->vectors.count(key) > 0) || (key == "joule_heating") ||
+      (key == "anode_potential") || (key == "cathode_potential"))
+    compute_volume_quantities();
+}
+
+template <int dim>
+void SuperCapacitorPostprocessor<dim>::compute_geometric_quantities()
 {
   dealii::DoFHandler<dim> const &dof_handler = *(this->dof_handler);
-  dealii::Trilinos::MPI::BlockVector const &solution = *(this->solution);
+  dealii::FiniteElement<dim> const &fe = dof_handler.get_fe();
+  auto const &anode_material_ids = _geometry->get_materials()->at("anode");
+  auto const &cathode_material_ids = _geometry->get_materials()->at("cathode");
 
-  std::for_each(this->values.begin(), this->values.end(),
-                [](std::unordered_map<std::string, double>::value_type &p)
-                {
-                  p.second = 0.0;
-                });
+  dealii::QGauss<dim> quadrature_rule(fe.degree + 1);
+  dealii::FEValues<dim> fe_values(fe, quadrature_rule,
+                                  dealii::update_JxW_values);
+  unsigned int const n_q_points = quadrature_rule.size();
+  std::vector<double> density_values(n_q_points);
+  std::vector<double> density_of_active_material_values(n_q_points);
+  std::vector<double> specific_surface_area_values(n_q_points);
+  // Volume, mass, anode volume, anode interfacial surface area, anode mass of
+  // active material, cathode volume, cathode interfacial surface area,
+  // cathode mass of active material, and surface area of the cathode
+  std::vector<double> local_values(9, 0.);
+  for (auto cell :
+       dealii::filter_iterators(dof_handler.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    fe_values.reinit(cell);
+    unsigned int const cell_index = cell->active_cell_index();
+    // clang-format off
+    _mp_values_cache->get_values(MaterialProperty::density,                    cell_index, density_values);
+    _mp_values_cache->get_values(MaterialProperty::density_of_active_material, cell_index, density_of_active_material_values);
+    _mp_values_cache->get_values(MaterialProperty::specific_surface_area,      cell_index, specific_surface_area_values);
+    // clang-format on
+    // Offset of the electrode in local_values
+    unsigned int const offset =
+        (anode_material_ids.count(cell->material_id()) > 0)
+            ? 2
+            : ((cathode_material_ids.count(cell->material_id()) > 0) ? 5 : 0);
+    for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
+    {
+      double const JxW = fe_values.JxW(q_point);
+      local_values[0] += JxW;
+      local_values[1] += density_values[q_point] * JxW;
+      if (offset > 0)
+      {
+        local_values[offset] += JxW;
+        local_values[offset + 1] += specific_surface_area_values[q_point] * JxW;
+        local_values[offset + 2] +=
+            density_of_active_material_values[q_point] * JxW;
+      }
+    }
+  }
 
-  // Set the number of dofs since it was erased just before.
-  this->values["n_dofs"] = static_cast<double>(dof_handler.n_dofs());
+  dealii::QGauss<dim - 1> face_quadrature_rule(fe.degree + 1);
+  dealii::FEFaceValues<dim> fe_face_values(fe, face_quadrature_rule,
+                                           dealii::update_JxW_values);
+  unsigned int const n_face_q_points = face_quadrature_rule.size();
+  for (auto const &cathode_face : _cathode_faces)
+  {
+    fe_face_values.reinit(cathode_face.first, cathode_face.second);
+    for (unsigned int face_q_point = 0; face_q_point < n_face_q_points;
+         ++face_q_point)
+      local_values[8] += fe_face_values.JxW(face_q_point);
+  }
 
-  std::shared_ptr<boost::property_tree::ptree const> database =
-      parameters->database;
+  // AllReduce once and for all
+  std::vector<double> global_values(local_values.size());
+  dealii::Utilities::MPI::sum(local_values, this->_communicator,
+                              global_values);
+  this->values["volume"] = global_values[0];
+  this->values["mass"] = global_values[1];
+  _anode_volume = global_values[2];
+  this->values["anode_electrode_interfacial_surface_area"] = global_values[3];
+  this->values["anode_electrode_mass_of_active_material"] = global_values[4];
+  _cathode_volume = global_values[5];
+  this->values["cathode_electrode_interfacial_surface_area"] =
+      global_values[6];
+  this->values["cathode_electrode_mass_of_active_material"] =
+      global_values[7];
+  this->values["surface_area"] = global_values[8];
+}
+
+template <int dim>
+void SuperCapacitorPostprocessor<dim>::compute_cathode_quantities()
+{
+  dealii::FiniteElement<dim> const &fe = this->dof_handler->get_fe();
+  dealii::FEValuesExtractors::Scalar const solid_potential(
+      _solid_potential_component);
+  dealii::QGauss<dim - 1> face_quadrature_rule(fe.degree + 1);
+  dealii::FEFaceValues<dim> fe_face_values(
+      fe, face_quadrature_rule,
+      dealii::update_values | dealii::update_gradients |
+          dealii::update_JxW_values | dealii::update_normal_vectors);
+  unsigned int const n_face_q_points = face_quadrature_rule.size();
+  // TODO: The material properties are only available at the quadrature points
+  // of the cells so we use the values at the quadrature points of the cell as
+  // a temporary bug fix.
+  std::vector<double> face_solid_electrical_conductivity_values(
+      _mp_values_cache->n_quadrature_points());
+  std::vector<double> face_solid_potential_values(n_face_q_points);
+  std::vector<dealii::Tensor<1, dim>> face_solid_potential_gradients(
+      n_face_q_points);
 
-  // NOTE: cannot be const if we want to use the square brackets operator.
-  auto materials = *(_geometry->get_materials());
-  auto boundaries = *(_geometry->get_boundaries());
-  // clang-format off
-  dealii::FEValuesExtractors::Scalar const solid_potential (database->get<unsigned int>("solid_potential_component"));
-  dealii::FEValuesExtractors::Scalar const liquid_potential(database->get<unsigned int>("liquid_potential_component"));
-  // clang-format on
+  // Current and voltage
+  std::vector<double> local_values(2, 0.);
+  for (auto const &cathode_face : _cathode_faces)
+  {
+    fe_face_values.reinit(cathode_face.first, cathode_face.second);
+    _mp_values_cache->get_values(
+        MaterialProperty::solid_electrical_conductivity,
+        cathode_face.first->active_cell_index(),
+        face_solid_electrical_conductivity_values);
+    fe_face_values[solid_potential].get_function_gradients(
+        _relevant_solution, face_solid_potential_gradients);
+    fe_face_values[solid_potential].get_function_values(
+        _relevant_solution, face_solid_potential_values);
+    for (unsigned int face_q_point = 0; face_q_point < n_face_q_points;
+         ++face_q_point)
+    {
+      double const JxW = fe_face_values.JxW(face_q_point);
+      local_values[0] +=
+          (face_solid_electrical_conductivity_values[face_q_point] *
+           face_solid_potential_gradients[face_q_point] *
+           fe_face_values.normal_vector(face_q_point)) *
+          JxW;
+      local_values[1] += face_solid_potential_values[face_q_point] * JxW;
+    }
+  }
+  // AllReduce to get the scalar quantities
+  std::vector<double> global_values(local_values.size());
+  dealii::Utilities::MPI::sum(local_values, this->_communicator,
+                              global_values);
+  this->values["current"] = global_values[0];
+  this->values["voltage"] = global_values[1] / this->values["surface_area"];
+}
+
+template <int dim>
+void SuperCapacitorPostprocessor<dim>::compute_volume_quantities() const
+{
+  dealii::DoFHandler<dim> const &dof_handler = *(this->dof_handler);
 
-  dealii::Vector<double> joule_heating(
-      dof_handler.get_triangulation().n_active_cells());
+  auto const &anode_material_ids = _geometry->get_materials()->at("anode");
+  auto const &cathode_material_ids = _geometry->get_materials()->at("cathode");
+  dealii::FEValuesExtractors::Scalar const solid_potential(
+      _solid_potential_component);
+  dealii::FEValuesExtractors::Scalar const liquid_potential(
+      _liquid_potential_component);
 
   dealii::FiniteElement<dim> const &fe =
       dof_handler.get_fe(); // TODO: don't want to use directly fe because we
                             // might create postprocessor that will only know
                             // about dof_handler
   dealii::QGauss<dim> quadrature_rule(fe.degree + 1);
-  dealii::QGauss<dim - 1> face_quadrature_rule(fe.degree + 1);
   dealii::FEValues<dim> fe_values(
       fe, quadrature_rule, dealii::update_values | dealii::update_gradients |
                                dealii::update_JxW_values |
                                dealii::update_quadrature_points);
-  dealii::FEFaceValues<dim> fe_face_values(
-      fe, face_quadrature_rule,
-      dealii::update_values | dealii::update_gradients |
-          dealii::update_JxW_values | dealii::update_normal_vectors |
-          dealii::update_quadrature_points);
-  //    unsigned int const dofs_per_cell   = fe.dofs_per_cell;
   unsigned int const n_q_points = quadrature_rule.size();
-  unsigned int const n_face_q_points = face_quadrature_rule.size();
   std::vector<double> solid_electrical_conductivity_values(n_q_points);
   std::vector<double> liquid_electrical_conductivity_values(n_q_points);
-  std::vector<double> density_values(n_q_points);
-  std::vector<double> density_of_active_material_values(n_q_points);
-  std::vector<double> specific_surface_area_values(n_q_points);
   std::vector<dealii::Tensor<1, dim>> solid_potential_gradients(n_q_points);
   std::vector<dealii::Tensor<1, dim>> liquid_potential_gradients(n_q_points);
   std::vector<double> solid_potential_values(n_q_points);
   std::vector<double> liquid_potential_values(n_q_points);
-  double anode_electrode_potential = 0.0;
-  double cathode_electrode_potential = 0.0;
-  double anode_electrode_volume = 0.0;
-  double cathode_electrode_volume = 0.0;
+  double joule_heating = 0.0;
+  // Anode potential and cathode potential
+  std::vector<double> local_electrode_values(2, 0.);
 
-  std::vector<double> face_solid_electrical_conductivity_values(
-      n_face_q_points);
-  std::vector<double> face_solid_potential_values(n_face_q_points);
-  std::vector<dealii::Tensor<1, dim>> face_solid_potential_gradients(
-      n_face_q_points);
-  std::vector<dealii::Tensor<1, dim>> normal_vectors(n_face_q_points);
-  // TODO: MPValues::get_values is not able to take FEFaceValues at this time so
-  // we resize this material property vector from n_face_q_points to n_q_points
-  // as a temporary bug fix.
-  face_solid_electrical_conductivity_values.resize(n_q_points);
-
-  dealii::IndexSet locally_relevant_dofs;
-  dealii::DoFTools::extract_locally_relevant_dofs(dof_handler,
-                                                  locally_relevant_dofs);
-  std::vector<dealii::IndexSet> index_sets(1, locally_relevant_dofs);
-  dealii::Trilinos::MPI::BlockVector relevant_solution(index_sets);
-  relevant_solution = solution;
-
-  for (auto cell : dof_handler.active_cell_iterators())
+  for (auto cell :
+       dealii::filter_iterators(dof_handler.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
   {
-    if (cell->is_locally_owned())
+    fe_values.reinit(cell);
+    unsigned int const cell_index = cell->active_cell_index();
+    // clang-format off
+    _mp_values_cache->get_values(MaterialProperty::solid_electrical_conductivity,  cell_index, solid_electrical_conductivity_values);
+    _mp_values_cache->get_values(MaterialProperty::liquid_electrical_conductivity, cell_index, liquid_electrical_conductivity_values);
+    // clang-format on
+    if (*std::max_element(solid_electrical_conductivity_values.begin(),
+                          solid_electrical_conductivity_values.end()) > 1e-300)
+    {
+      fe_values[solid_potential].get_function_gradients(
+          _relevant_solution, solid_potential_gradients);
+      fe_values[solid_potential].get_function_values(_relevant_solution,
+                                                     solid_potential_values);
+    }
+    if (*std::max_element(liquid_electrical_conductivity_values.begin(),
+                          liquid_electrical_conductivity_values.end()) > 1e-300)
     {
-      fe_values.reinit(cell);
-      this->mp_values->get_values("solid_electrical_conductivity", fe_values,
-                                  solid_electrical_conductivity_values);
-      this->mp_values->get_values("liquid_electrical_conductivity", fe_values,
-                                  liquid_electrical_conductivity_values);
-      this->mp_values->get_values("density", fe_values, density_values);
-      this->mp_values->get_values("density_of_active_material", fe_values,
-                                  density_of_active_material_values);
-      this->mp_values->get_values("specific_surface_area", fe_values,
-                                  specific_surface_area_values);
-      if (*std::max_element(solid_electrical_conductivity_values.begin(),
-                            solid_electrical_conductivity_values.end()) >
-          1e-300)
+      fe_values[liquid_potential].get_function_gradients(
+          _relevant_solution, liquid_potential_gradients);
+      fe_values[liquid_potential].get_function_values(_relevant_solution,
+                                                      liquid_potential_values);
+    }
+    bool const anode = anode_material_ids.count(cell->material_id()) > 0;
+    bool const cathode = cathode_material_ids.count(cell->material_id()) > 0;
+    for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
+    {
+      double const JxW = fe_values.JxW(q_point);
+      joule_heating += (solid_electrical_conductivity_values[q_point] *
+                            solid_potential_gradients[q_point] *
+                            solid_potential_gradients[q_point] +
+                        liquid_electrical_conductivity_values[q_point] *
+                            liquid_potential_gradients[q_point] *
+                            liquid_potential_gradients[q_point]) *
+                       JxW;
+      if (anode)
+        local_electrode_values[0] +=
+            (solid_potential_values[q_point] -
+             liquid_potential_values[q_point]) *
+            JxW;
+      else if (cathode)
+        local_electrode_values[1] +=
+            (solid_potential_values[q_point] -
+             liquid_potential_values[q_point]) *
+            JxW;
+    } // end for quadrature point
+    if (this->_debug_material_ids)
+      this->vectors["material_id"][cell_index] =
+          static_cast<double>(cell->material_id());
+    for (std::vector<std::string>::const_iterator it =
+             this->_debug_material_properties.begin();
+         it != this->_debug_material_properties.end(); ++it)
+    {
+      std::vector<double> values(n_q_points);
+      this->mp_values->get_values(*it, fe_values, values);
+      double cell_averaged_value = 0.0;
+      for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
       {
-        fe_values[solid_potential].get_function_gradients(
-            relevant_solution, solid_potential_gradients);
-        fe_values[solid_potential].get_function_values(relevant_solution,
-                                                       solid_potential_values);
+        cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
       }
-      if (*std::max_element(liquid_electrical_conductivity_values.begin(),
-                            liquid_electrical_conductivity_values.end()) >
-          1e-300)
+      cell_averaged_value /= cell->measure();
+      this->vectors[*it][cell_index] = cell_averaged_value;
+    }
+    for (std::vector<std::string>::const_iterator it =
+             this->_debug_solution_fields.begin();
+         it != this->_debug_solution_fields.end(); ++it)
+    {
+      std::vector<double> values(n_q_points);
+      if (it->compare("solid_potential") == 0)
       {
-        fe_values[liquid_potential].get_function_gradients(
-            relevant_solution, liquid_potential_gradients);
-        fe_values[liquid_potential].get_function_values(
-            relevant_solution, liquid_potential_values);
+        values = solid_potential_values;
       }
-      for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
+      else if (it->compare("liquid_potential") == 0)
       {
-        this->values["joule_heating"] +=
-            (solid_electrical_conductivity_values[q_point] *
-                 solid_potential_gradients[q_point] *
-                 solid_potential_gradients[q_point] +
-             liquid_electrical_conductivity_values[q_point] *
-                 liquid_potential_gradients[q_point] *
-                 liquid_potential_gradients[q_point]) *
-            fe_values.JxW(q_point);
-        this->values["volume"] += fe_values.JxW(q_point);
-        this->values["mass"] +=
-            density_values[q_point] * fe_values.JxW(q_point);
-        if (materials["anode"].count(cell->material_id()) > 0)
-        {
-          anode_electrode_potential += (solid_potential_values[q_point] -
-                                        liquid_potential_values[q_point]) *
-                                       fe_values.JxW(q_point);
-          anode_electrode_volume += fe_values.JxW(q_point);
-          this->values["anode_electrode_interfacial_surface_area"] +=
-              specific_surface_area_values[q_point] * fe_values.JxW(q_point);
-          this->values["anode_electrode_mass_of_active_material"] +=
-              density_of_active_material_values[q_point] *
-              fe_values.JxW(q_point);
-        }
-        else if (materials["cathode"].count(cell->material_id()) > 0)
-        {
-          cathode_electrode_potential += (solid_potential_values[q_point] -
-                                          liquid_potential_values[q_point]) *
-                                         fe_values.JxW(q_point);
-          cathode_electrode_volume += fe_values.JxW(q_point);
-          this->values["cathode_electrode_interfacial_surface_area"] +=
-              specific_surface_area_values[q_point] * fe_values.JxW(q_point);
-          this->values["cathode_electrode_mass_of_active_material"] +=
-              density_of_active_material_values[q_point] *
-              fe_values.JxW(q_point);
-        }
-        else
-        {
-          // do nothing
-        }
-      } // end for quadrature point
-      if (this->_debug_material_ids)
-        this->vectors["material_id"][cell->active_cell_index()] =
-            static_cast<double>(cell->material_id());
-      for (std::vector<std::string>::const_iterator it =
-               this->_debug_material_properties.begin();
-           it != this->_debug_material_properties.end(); ++it)
+        values = liquid_potential_values;
+      }
+      else if (it->compare("overpotential") == 0)
       {
-        std::vector<double> values(n_q_points);
-        this->mp_values->get_values(*it, fe_values, values);
-        double cell_averaged_value = 0.0;
-        for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
-        {
-          cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
-        }
-        cell_averaged_value /= cell->measure();
-        this->vectors[*it][cell->active_cell_index()] = cell_averaged_value;
+        std::transform(solid_potential_values.begin(),
+                       solid_potential_values.end(),
+                       liquid_potential_values.begin(), values.begin(),
+                       std::minus<double>());
       }
-      for (std::vector<std::string>::const_iterator it =
-               this->_debug_solution_fields.begin();
-           it != this->_debug_solution_fields.end(); ++it)
+      else if (it->compare("joule_heating") == 0)
       {
-        std::vector<double> values(n_q_points);
-        if (it->compare("solid_potential") == 0)
-        {
-          values = solid_potential_values;
-        }
-        else if (it->compare("liquid_potential") == 0)
-        {
-          values = liquid_potential_values;
-        }
-        else if (it->compare("overpotential") == 0)
-        {
-          std::transform(solid_potential_values.begin(),
-                         solid_potential_values.end(),
-                         liquid_potential_values.begin(), values.begin(),
-                         std::minus<double>());
-        }
-        else if (it->compare("joule_heating") == 0)
-        {
-          for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
-          {
-            values[q_point] =
-                liquid_electrical_conductivity_values[q_point] *
-                    liquid_potential_gradients[q_point].norm_square() +
-                solid_electrical_conductivity_values[q_point] *
-                    solid_potential_gradients[q_point].norm_square();
-          }
-        }
-        else
-        {
-          throw dealii::StandardExceptions::ExcMessage(
-              "Solution field '" + (*it) + "' is not recognized");
-        }
-        double cell_averaged_value = 0.0;
         for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
         {
-          cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
+          values[q_point] =
+              liquid_electrical_conductivity_values[q_point] *
+                  liquid_potential_gradients[q_point].norm_square() +
+              solid_electrical_conductivity_values[q_point] *
+                  solid_potential_gradients[q_point].norm_square();
         }
-        cell_averaged_value /= cell->measure();
-        this->vectors[*it][cell->active_cell_index()] = cell_averaged_value;
       }
-      for (std::vector<std::string>::const_iterator it =
-               this->_debug_solution_fluxes.begin();
-           it != this->_debug_solution_fluxes.end(); ++it)
+      else
       {
-        std::vector<dealii::Tensor<1, dim>> values(n_q_points);
-        if (it->compare("solid_current_density") == 0)
-        {
-          std::transform(solid_electrical_conductivity_values.begin(),
-                         solid_electrical_conductivity_values.end(),
-                         solid_potential_gradients.begin(), values.begin(),
-                         [](double const x, dealii::Tensor<1, dim> const &y)
-                         {
-                           return x * y;
-                         });
-        }
-        else if (it->compare("liquid_current_density") == 0)
-        {
-          std::transform(liquid_electrical_conductivity_values.begin(),
-                         liquid_electrical_conductivity_values.end(),
-                         liquid_potential_gradients.begin(), values.begin(),
-                         [](double const x, dealii::Tensor<1, dim> const &y)
-                         {
-                           return x * y;
-                         });
-        }
-        else
-        {
-          throw dealii::StandardExceptions::ExcMessage(
-              "Solution flux '" + (*it) + "' is not recognized");
-        }
-        dealii::Tensor<1, dim> cell_averaged_value;
-        cell_averaged_value = 0.0;
-        for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
-        {
-          cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
-        }
-        cell_averaged_value /= cell->measure();
-        for (int d = 0; d < dim; ++d)
-          this->vectors[(*it) + "_" +
-                        std::to_string(d)][cell->active_cell_index()] =
-              cell_averaged_value[d];
+        throw dealii::StandardExceptions::ExcMessage(
+            "Solution field '" + (*it) + "' is not recognized");
       }
-
-      if (cell->at_boundary())
+      double cell_averaged_value = 0.0;
+      for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
       {
-        for (unsigned int face = 0;
-             face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
-        {
-          if (cell->face(face)->at_boundary())
-          {
-            if (boundaries["cathode"].count(cell->face(face)->boundary_id()) >
-                0)
-            {
-              fe_face_values.reinit(cell, face);
-              // TODO:  This is a temporary bug fix.  MPValues should take
-              // fe_face_values instead of fe_values as an argument.
-              this->mp_values->get_values(
-                  "solid_electrical_conductivity", fe_values,
-                  face_solid_electrical_conductivity_values);
-              fe_face_values[solid_potential].get_function_gradients(
-                  relevant_solution, face_solid_potential_gradients);
-              fe_face_values[solid_potential].get_function_values(
-                  relevant_solution, face_solid_potential_values);
-              normal_vectors = fe_face_values.get_all_normal_vectors();
-              for (unsigned int face_q_point = 0;
-                   face_q_point < n_face_q_points; ++face_q_point)
-              {
-                this->values["current"] +=
-                    (face_solid_electrical_conductivity_values[face_q_point] *
-                     face_solid_potential_gradients[face_q_point] *
-                     normal_vectors[face_q_point]) *
-                    fe_face_values.JxW(face_q_point);
-                this->values["voltage"] +=
-                    face_solid_potential_values[face_q_point] *
-                    fe_face_values.JxW(face_q_point);
-                this->values["surface_area"] +=
-                    fe_face_values.JxW(face_q_point);
-              } // end for face quadrature point
-            }   // end if cathode
-          }     // end if face at boundary
-        }       // end for face
-      }         // end if cell at boundary
+        cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
+      }
+      cell_averaged_value /= cell->measure();
+      this->vectors[*it][cell_index] = cell_averaged_value;
+    }
+    for (std::vector<std::string>::const_iterator it =
+             this->_debug_solution_fluxes.begin();
+         it != this->_debug_solution_fluxes.end(); ++it)
+    {
+      std::vector<dealii::Tensor<1, dim>> values(n_q_points);
+      if (it->compare("solid_current_density") == 0)
+      {
+        std::transform(solid_electrical_conductivity_values.begin(),
+                       solid_electrical_conductivity_values.end(),
+                       solid_potential_gradients.begin(), values.begin(),
+                       [](double const x, dealii::Tensor<1, dim> const &y)
+                       {
+                         return x * y;
+                       });
+      }
+      else if (it->compare("liquid_current_density") == 0)
+      {
+        std::transform(liquid_electrical_conductivity_values.begin(),
+                       liquid_electrical_conductivity_values.end(),
+                       liquid_potential_gradients.begin(), values.begin(),
+                       [](double const x, dealii::Tensor<1, dim> const &y)
+                       {
+                         return x * y;
+                       });
+      }
+      else
+      {
+        throw dealii::StandardExceptions::ExcMessage(
+            "Solution flux '" + (*it) + "' is not recognized");
+      }
+      dealii::Tensor<1, dim> cell_averaged_value;
+      cell_averaged_value = 0.0;
+      for (unsigned int q_point = 0; q_point < n_q_points; ++q_point)
+      {
+        cell_averaged_value += values[q_point] * fe_values.JxW(q_point);
+      }
+      cell_averaged_value /= cell->measure();
+      for (int d = 0; d < dim; ++d)
+        this->vectors[(*it) + "_" + std::to_string(d)][cell_index] =
+            cell_averaged_value[d];
     }
   } // end for cell
-  // AllReduce to get the scalar quantities
-  this->values["current"] =
-      dealii::Utilities::MPI::sum(this->values["current"], this->_communicator);
-  this->values["surface_area"] = dealii::Utilities::MPI::sum(
-      this->values["surface_area"], this->_communicator);
-  this->values["voltage"] =
-      dealii::Utilities::MPI::sum(this->values["voltage"], this->_communicator);
-  anode_electrode_potential = dealii::Utilities::MPI::sum(
-      anode_electrode_potential, this->_communicator);
-  anode_electrode_volume =
-      dealii::Utilities::MPI::sum(anode_electrode_volume, this->_communicator);
-  cathode_electrode_potential = dealii::Utilities::MPI::sum(
-      cathode_electrode_potential, this->_communicator);
-  cathode_electrode_volume = dealii::Utilities::MPI::sum(
-      cathode_electrode_volume, this->_communicator);
-
-  this->values["voltage"] /= this->values["surface_area"];
-  anode_electrode_potential /= anode_electrode_volume;
-  cathode_electrode_potential /= cathode_electrode_volume;
-  this->values["anode_potential"] = anode_electrode_potential;
-  this->values["cathode_potential"] = cathode_electrode_potential;
+
+  // The joule heating is only local to the processor.
+  this->values["joule_heating"] = joule_heating;
+
+  // AllReduce to get the potential of the electrodes
+  std::vector<double> global_electrode_values(local_electrode_values.size());
+  dealii::Utilities::MPI::sum(local_electrode_values, this->_communicator,
+                              global_electrode_values);
+  this->values["anode_potential"] = global_electrode_values[0] / _anode_volume;
+  this->values["cathode_potential"] =
+      global_electrode_values[1] / _cathode_volume;
+
+  _volume_quantities_up_to_date = true;
 }
 
 } // end namespace cap
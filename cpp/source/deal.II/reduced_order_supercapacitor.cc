@@ -0,0 +1,41 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/reduced_order_supercapacitor.templates.h>
+
+namespace cap
+{
+
+class ReducedOrderSuperCapacitorBuilder : public EnergyStorageDeviceBuilder
+{
+public:
+  ReducedOrderSuperCapacitorBuilder()
+  {
+    register_energy_storage_device("ReducedOrderSuperCapacitor", this);
+  }
+
+  std::unique_ptr<EnergyStorageDevice>
+  build(boost::property_tree::ptree const &ptree,
+        boost::mpi::communicator const &comm) override
+  {
+    int const dim = ptree.get<int>("dim");
+    if (dim == 2)
+      return std::unique_ptr<EnergyStorageDevice>(
+          new ReducedOrderSuperCapacitor<2>(ptree, comm));
+    else if (dim == 3)
+      return std::unique_ptr<EnergyStorageDevice>(
+          new ReducedOrderSuperCapacitor<3>(ptree, comm));
+    else
+      throw std::runtime_error("dim=" + std::to_string(dim) +
+                               " must be 2 or 3");
+  }
+} global_ReducedOrderSuperCapacitorBuilder;
+
+template class ReducedOrderSuperCapacitor<2>;
+template class ReducedOrderSuperCapacitor<3>;
+
+} // end namespace cap
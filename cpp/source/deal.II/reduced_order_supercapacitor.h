@@ -0,0 +1,275 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_DEAL_II_REDUCED_ORDER_SUPERCAPACITOR_H
+#define CAP_DEAL_II_REDUCED_ORDER_SUPERCAPACITOR_H
+
+#include <cap/energy_storage_device.h>
+#include <cap/supercapacitor.h>
+#include <deal.II/lac/constraint_matrix.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/trilinos_vector.h>
+#include <deal.II/lac/vector.h>
+#include <memory>
+#include <vector>
+
+namespace cap
+{
+
+/**
+ * Reduced-order model of a SuperCapacitor obtained by proper orthogonal
+ * decomposition (POD) and Galerkin projection.
+ *
+ * The constructor builds the full model, runs a training charge at constant
+ * current, and computes the POD basis of the solutions at every time step
+ * with the method of snapshots in the inner product of the mass matrix. The
+ * full model is then restored to its initial state. The mass matrix, the
+ * stiffness matrix, and the load vector of a unit current density are
+ * projected on the basis once, so a time step of the reduced model only
+ * involves dense matrices and vectors whose size is the number of modes.
+ *
+ * The reduced model uses backward Euler and solves the same boundary value
+ * problems as the full model for the current, the power, and the load:
+ *  - current and power: the solution at the end of a time step is affine in
+ *  the current, u(I) = u_0 + I r, so the power is imposed by computing the
+ *  current that satisfies the operating condition, as in
+ *  SuperCapacitor::evolve_one_time_step_constant_power().
+ *  - load: the Robin boundary condition of the full model is projected on
+ *  the basis.
+ *
+ * The basis vectors are zero where the full model imposes a Dirichlet
+ * condition on the cathode, so the voltage cannot be imposed by the reduced
+ * model. These time steps are always done with the full model.
+ *
+ * After each reduced time step, the norm of the residual of the full system
+ * of the operating condition evaluated with the reduced solution is compared
+ * to the norm of the right-hand side. It is computed from a Gram matrix
+ * precomputed during the construction, so it costs the same as the reduced
+ * time step. If the relative residual is larger than the tolerance, the time
+ * step is done again with the full model and its solution is projected back
+ * on the basis. Consecutive fallbacks continue from the solution of the full
+ * model. The squared norms are computed from the Gram matrix so, because of
+ * round-off, the indicator is not reliable below about 1e-7.
+ *
+ * The parameters of the full model are read from the same ptree as for a
+ * SuperCapacitor. The parameters of the reduced model are read from the
+ * child reduced_order_model:
+ *  - training.current: current of the training charge
+ *  - training.time_step: time step of the training charge
+ *  - training.n_time_steps: number of time steps of the training charge
+ *  - pod_tolerance (default 1e-6): the modes are truncated once the relative
+ *  energy of the discarded modes is smaller than pod_tolerance squared
+ *  - max_basis_size (default 50)
+ *  - error_tolerance (default 1e-3): tolerance on the relative residual
+ */
+template <int dim>
+class ReducedOrderSuperCapacitor : public EnergyStorageDevice
+{
+public:
+  ReducedOrderSuperCapacitor(boost::property_tree::ptree const &ptree,
+                             boost::mpi::communicator const &comm);
+
+  void inspect(EnergyStorageDeviceInspector *inspector) override;
+
+  void get_voltage(double &voltage) const override;
+
+  void get_current(double &current) const override;
+
+  void evolve_one_time_step_constant_current(double const time_step,
+                                             double const current) override;
+
+  void evolve_one_time_step_constant_voltage(double const time_step,
+                                             double const voltage) override;
+
+  void evolve_one_time_step_constant_power(double const time_step,
+                                           double const power) override;
+
+  void evolve_one_time_step_constant_load(double const time_step,
+                                          double const load) override;
+
+  /**
+   * Same as evolve_one_time_step_constant_current(), as for SuperCapacitor.
+   */
+  void evolve_one_time_step_linear_current(double const time_step,
+                                           double const current) override;
+
+  /**
+   * Same as evolve_one_time_step_constant_voltage(), as for SuperCapacitor.
+   */
+  void evolve_one_time_step_linear_voltage(double const time_step,
+                                           double const voltage) override;
+
+  /**
+   * Same as evolve_one_time_step_constant_power(), as for SuperCapacitor.
+   */
+  void evolve_one_time_step_linear_power(double const time_step,
+                                         double const power) override;
+
+  /**
+   * Same as evolve_one_time_step_constant_load(), as for SuperCapacitor.
+   */
+  void evolve_one_time_step_linear_load(double const time_step,
+                                        double const load) override;
+
+  /**
+   * Save the state of the full model with the solution lifted from the
+   * reduced basis.
+   */
+  void save(const std::string &filename) const override;
+
+  /**
+   * Load the state of the full model and project its solution on the reduced
+   * basis.
+   */
+  void load(const std::string &filename) override;
+
+  std::unique_ptr<EnergyStorageDeviceSnapshot> snapshot() const override;
+
+  void restore(EnergyStorageDeviceSnapshot const &snapshot) override;
+
+  /**
+   * Return the impedance of the reduced system
+   * \f$(K_r + i \omega M_r) c = N_r\f$. The frequencies are solved in
+   * parallel by the threads available to deal.II. The impedance is only
+   * accurate for the time scales represented by the training charge.
+   */
+  std::vector<std::complex<double>>
+  compute_impedance(std::vector<double> const &frequencies) const override;
+
+  /**
+   * Return the number of POD modes.
+   */
+  unsigned int get_basis_size() const;
+
+  /**
+   * Return the number of time steps that have been done with the full model
+   * because the error indicator was larger than the tolerance or because the
+   * voltage was imposed.
+   */
+  std::size_t get_n_full_model_steps() const;
+
+private:
+  /**
+   * Advance the reduced model by @p time_step. @p value is the current, the
+   * voltage, the power, or the load depending on @p supercapacitor_state.
+   */
+  void evolve_one_time_step(double const time_step,
+                            SuperCapacitorState const supercapacitor_state,
+                            double const value);
+
+  /**
+   * Advance the full model by @p time_step and project its solution on the
+   * basis.
+   */
+  void evolve_full_model(double const time_step,
+                         SuperCapacitorState const supercapacitor_state,
+                         double const value);
+
+  /**
+   * Compute the POD basis of @p snapshots and project the system assembled by
+   * @p physics on it. The snapshots are set to zero on the constrained
+   * degrees of freedom.
+   */
+  void build_basis(ElectrochemicalPhysics<dim> const &physics,
+                   std::vector<dealii::Trilinos::MPI::Vector> &snapshots);
+
+  /**
+   * Compute _propagator and _unit_current_response if @p time_step is
+   * different from the time step used to compute them previously.
+   */
+  void update_time_step(double const time_step);
+
+  /**
+   * Compute _load_propagator if @p time_step or @p load is different from the
+   * ones used to compute it previously.
+   */
+  void update_load(double const time_step, double const load);
+
+  /**
+   * Replace the solution of the full model by the solution of the reduced
+   * model.
+   */
+  void lift() const;
+
+  /**
+   * Set the coefficients to the projection of the solution of the full model
+   * and get the voltage and the current from the full model.
+   */
+  void project();
+
+  std::unique_ptr<SuperCapacitor<dim>> _full_model;
+  double const _pod_tolerance;
+  unsigned int const _max_basis_size;
+  double const _error_tolerance;
+  double _surface_area;
+  /**
+   * Constraints of the full model when the current is imposed. The basis
+   * vectors are zero on the constrained degrees of freedom.
+   */
+  dealii::ConstraintMatrix _constraint_matrix;
+  std::vector<dealii::Trilinos::MPI::Vector> _basis;
+  /**
+   * Product of the constrained mass matrix with the basis vectors. Used to
+   * project the solution of the full model.
+   */
+  std::vector<dealii::Trilinos::MPI::Vector> _mass_basis;
+  dealii::FullMatrix<double> _reduced_mass_matrix;
+  dealii::FullMatrix<double> _inverse_reduced_mass_matrix;
+  dealii::FullMatrix<double> _reduced_stiffness_matrix;
+  /**
+   * Projection of the mass matrix of the solid potential on the cathode.
+   */
+  dealii::FullMatrix<double> _reduced_robin_matrix;
+  /**
+   * Projection of the load vector of a unit current density. Its dot product
+   * with the coefficients is the integral of the solid potential on the
+   * cathode.
+   */
+  dealii::Vector<double> _reduced_neumann_load;
+  /**
+   * Gram matrix of the vectors \f$(M \phi_i, K \phi_i, N, B \phi_i)\f$ used
+   * to compute the norm of the residual of the full system.
+   */
+  dealii::FullMatrix<double> _gram_matrix;
+  /**
+   * Time step used to compute _propagator and _unit_current_response.
+   */
+  double _time_step;
+  /**
+   * \f$(M_r + \Delta t K_r)^{-1} M_r\f$
+   */
+  dealii::FullMatrix<double> _propagator;
+  /**
+   * Coefficients of the response to a unit current during a time step.
+   */
+  dealii::Vector<double> _unit_current_response;
+  /**
+   * Voltage associated with _unit_current_response.
+   */
+  double _unit_current_voltage;
+  /**
+   * Time step and load used to compute _load_propagator.
+   */
+  double _load_time_step;
+  double _load;
+  /**
+   * \f$(M_r + \Delta t K_r + \Delta t B_r/(R A))^{-1} M_r\f$
+   */
+  dealii::FullMatrix<double> _load_propagator;
+  dealii::Vector<double> _coefficients;
+  double _voltage;
+  double _current;
+  /**
+   * True if the solution of the full model is the current state of the
+   * device.
+   */
+  bool _full_model_synchronized;
+  std::size_t _n_full_model_steps;
+};
+}
+
+#endif
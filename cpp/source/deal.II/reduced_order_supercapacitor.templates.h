@@ -0,0 +1,589 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_DEAL_II_REDUCED_ORDER_SUPERCAPACITOR_TEMPLATES_H
+#define CAP_DEAL_II_REDUCED_ORDER_SUPERCAPACITOR_TEMPLATES_H
+
+#include <cap/reduced_order_supercapacitor.h>
+#include <cap/supercapacitor.templates.h>
+#include <deal.II/base/parallel.h>
+#include <deal.II/lac/lapack_full_matrix.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace cap
+{
+namespace internal
+{
+/**
+ * State of a ReducedOrderSuperCapacitor.
+ */
+class ReducedOrderSuperCapacitorSnapshot : public EnergyStorageDeviceSnapshot
+{
+public:
+  ReducedOrderSuperCapacitorSnapshot(dealii::Vector<double> const &coefficients,
+                                     double const voltage, double const current)
+      : coefficients(coefficients), voltage(voltage), current(current)
+  {
+  }
+
+  dealii::Vector<double> const coefficients;
+  double const voltage;
+  double const current;
+};
+}
+
+template <int dim>
+ReducedOrderSuperCapacitor<dim>::ReducedOrderSuperCapacitor(
+    boost::property_tree::ptree const &ptree,
+    boost::mpi::communicator const &comm)
+    : EnergyStorageDevice(comm), _full_model(nullptr),
+      _pod_tolerance(ptree.get("reduced_order_model.pod_tolerance", 1e-6)),
+      _max_basis_size(ptree.get("reduced_order_model.max_basis_size", 50u)),
+      _error_tolerance(ptree.get("reduced_order_model.error_tolerance", 1e-3)),
+      _surface_area(0.), _time_step(0.), _unit_current_voltage(0.),
+      _load_time_step(0.), _load(0.), _voltage(0.), _current(0.),
+      _full_model_synchronized(true),
+      _n_full_model_steps(0)
+{
+  if (ptree.get<std::string>("geometry.type") == "restart")
+    throw std::runtime_error(
+        "The reduced-order model cannot be built from a restart.");
+  _full_model.reset(new SuperCapacitor<dim>(ptree, comm));
+  _surface_area = _full_model->_surface_area;
+
+  // Training charge of the full model. The initial state is part of the
+  // snapshots so that it is represented exactly by the basis.
+  boost::property_tree::ptree const &training_database =
+      ptree.get_child("reduced_order_model.training");
+  double const training_current = training_database.get<double>("current");
+  double const training_time_step =
+      training_database.get<double>("time_step");
+  unsigned int const n_training_steps =
+      training_database.get<unsigned int>("n_time_steps");
+  auto const initial_state = _full_model->snapshot();
+  std::vector<dealii::Trilinos::MPI::Vector> snapshots;
+  snapshots.push_back(_full_model->_solution->block(0));
+  for (unsigned int i = 0; i < n_training_steps; ++i)
+  {
+    _full_model->evolve_one_time_step_constant_current(training_time_step,
+                                                       training_current);
+    snapshots.push_back(_full_model->_solution->block(0));
+  }
+  _full_model->restore(*initial_state);
+
+  // The matrices of the full model do not depend on the time step. Assemble
+  // them for an imposed current, which gives the constraints, the Neumann
+  // load, and the Robin matrix used by the reduced model. This works for the
+  // matrix-free operator too.
+  std::unique_ptr<ElectrochemicalPhysics<dim>> physics =
+      _full_model->build_constant_current_physics();
+  _constraint_matrix.copy_from(physics->get_constraint_matrix());
+  build_basis(*physics, snapshots);
+
+  project();
+
+  if ((ptree.get("verbosity", 0) > 0) && (comm.rank() == 0))
+    std::cout << "ReducedOrderSuperCapacitor: " << _basis.size()
+              << " POD modes from " << snapshots.size() << " snapshots"
+              << std::endl;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::build_basis(
+    ElectrochemicalPhysics<dim> const &physics,
+    std::vector<dealii::Trilinos::MPI::Vector> &snapshots)
+{
+  dealii::Trilinos::SparseMatrix const &mass_matrix =
+      physics.get_constrained_mass_matrix();
+  dealii::Trilinos::SparseMatrix const &stiffness_matrix =
+      physics.get_stiffness_matrix();
+  dealii::Trilinos::SparseMatrix const &robin_matrix =
+      physics.get_robin_matrix();
+  dealii::Trilinos::MPI::Vector const &neumann_load =
+      physics.get_neumann_load();
+
+  // Method of snapshots: the modes are the eigenvectors of the correlation
+  // matrix of the snapshots in the inner product of the mass matrix. The
+  // snapshots are zero on the constrained degrees of freedom so that the
+  // reduced matrices are the projection of the condensed system.
+  unsigned int const n_snapshots = snapshots.size();
+  std::vector<dealii::Trilinos::MPI::Vector> mass_snapshots(n_snapshots);
+  for (unsigned int i = 0; i < n_snapshots; ++i)
+  {
+    _constraint_matrix.set_zero(snapshots[i]);
+    mass_snapshots[i].reinit(snapshots[i]);
+    mass_matrix.vmult(mass_snapshots[i], snapshots[i]);
+  }
+  dealii::LAPACKFullMatrix<double> correlation_matrix(n_snapshots);
+  double trace = 0.;
+  for (unsigned int i = 0; i < n_snapshots; ++i)
+    for (unsigned int j = 0; j <= i; ++j)
+    {
+      double const correlation = snapshots[i] * mass_snapshots[j];
+      correlation_matrix(i, j) = correlation;
+      correlation_matrix(j, i) = correlation;
+      if (i == j)
+        trace += correlation;
+    }
+  if (!(trace > 0.))
+    throw std::runtime_error("The training snapshots are all zero.");
+  dealii::Vector<double> eigenvalues;
+  dealii::FullMatrix<double> eigenvectors;
+  correlation_matrix.compute_eigenvalues_symmetric(-trace, 2. * trace, 0.,
+                                                   eigenvalues, eigenvectors);
+
+  // The eigenvalues are sorted in increasing order. Keep the largest ones
+  // until the energy of the discarded modes is small enough.
+  _basis.clear();
+  double discarded_energy = trace;
+  for (int k = eigenvalues.size() - 1; k >= 0; --k)
+  {
+    if ((_basis.size() == _max_basis_size) || (!(eigenvalues[k] > 0.)) ||
+        (discarded_energy <= _pod_tolerance * _pod_tolerance * trace))
+      break;
+    discarded_energy -= eigenvalues[k];
+    dealii::Trilinos::MPI::Vector mode;
+    mode.reinit(snapshots[0]);
+    for (unsigned int j = 0; j < n_snapshots; ++j)
+      mode.add(eigenvectors(j, k) / std::sqrt(eigenvalues[k]), snapshots[j]);
+    _basis.push_back(mode);
+  }
+
+  // Project the system on the basis.
+  unsigned int const n_modes = _basis.size();
+  _mass_basis.resize(n_modes);
+  std::vector<dealii::Trilinos::MPI::Vector> stiffness_basis(n_modes);
+  std::vector<dealii::Trilinos::MPI::Vector> robin_basis(n_modes);
+  for (unsigned int i = 0; i < n_modes; ++i)
+  {
+    _mass_basis[i].reinit(_basis[i]);
+    mass_matrix.vmult(_mass_basis[i], _basis[i]);
+    stiffness_basis[i].reinit(_basis[i]);
+    stiffness_matrix.vmult(stiffness_basis[i], _basis[i]);
+    robin_basis[i].reinit(_basis[i]);
+    robin_matrix.vmult(robin_basis[i], _basis[i]);
+  }
+  _reduced_mass_matrix.reinit(n_modes, n_modes);
+  _reduced_stiffness_matrix.reinit(n_modes, n_modes);
+  _reduced_robin_matrix.reinit(n_modes, n_modes);
+  _reduced_neumann_load.reinit(n_modes);
+  for (unsigned int i = 0; i < n_modes; ++i)
+  {
+    for (unsigned int j = 0; j < n_modes; ++j)
+    {
+      _reduced_mass_matrix(i, j) = _basis[i] * _mass_basis[j];
+      _reduced_stiffness_matrix(i, j) = _basis[i] * stiffness_basis[j];
+      _reduced_robin_matrix(i, j) = _basis[i] * robin_basis[j];
+    }
+    _reduced_neumann_load(i) = _basis[i] * neumann_load;
+  }
+  _inverse_reduced_mass_matrix.reinit(n_modes, n_modes);
+  _inverse_reduced_mass_matrix.invert(_reduced_mass_matrix);
+
+  // The residual of the full system is a linear combination of these vectors
+  // so its norm only requires their Gram matrix.
+  std::vector<dealii::Trilinos::MPI::Vector const *> residual_vectors;
+  for (auto const &vector : _mass_basis)
+    residual_vectors.push_back(&vector);
+  for (auto const &vector : stiffness_basis)
+    residual_vectors.push_back(&vector);
+  residual_vectors.push_back(&neumann_load);
+  for (auto const &vector : robin_basis)
+    residual_vectors.push_back(&vector);
+  unsigned int const n_residual_vectors = residual_vectors.size();
+  _gram_matrix.reinit(n_residual_vectors, n_residual_vectors);
+  for (unsigned int i = 0; i < n_residual_vectors; ++i)
+    for (unsigned int j = 0; j <= i; ++j)
+    {
+      double const product = *residual_vectors[i] * *residual_vectors[j];
+      _gram_matrix(i, j) = product;
+      _gram_matrix(j, i) = product;
+    }
+
+  _coefficients.reinit(n_modes);
+  _time_step = 0.;
+  _load_time_step = 0.;
+  _load = 0.;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::update_time_step(double const time_step)
+{
+  if (time_step == _time_step)
+    return;
+  _time_step = time_step;
+
+  // (M_r + dt K_r)^{-1}
+  unsigned int const n_modes = _basis.size();
+  dealii::FullMatrix<double> inverse_system_matrix(_reduced_mass_matrix);
+  inverse_system_matrix.add(time_step, _reduced_stiffness_matrix);
+  inverse_system_matrix.gauss_jordan();
+
+  _propagator.reinit(n_modes, n_modes);
+  inverse_system_matrix.mmult(_propagator, _reduced_mass_matrix);
+  dealii::Vector<double> unit_current_load(_reduced_neumann_load);
+  unit_current_load *= time_step / _surface_area;
+  _unit_current_response.reinit(n_modes);
+  inverse_system_matrix.vmult(_unit_current_response, unit_current_load);
+  _unit_current_voltage =
+      (_reduced_neumann_load * _unit_current_response) / _surface_area;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::update_load(double const time_step,
+                                                  double const load)
+{
+  if ((time_step == _load_time_step) && (load == _load))
+    return;
+  _load_time_step = time_step;
+  _load = load;
+
+  // (M_r + dt K_r + dt B_r / (R A))^{-1} M_r
+  unsigned int const n_modes = _basis.size();
+  dealii::FullMatrix<double> inverse_system_matrix(_reduced_mass_matrix);
+  inverse_system_matrix.add(time_step, _reduced_stiffness_matrix);
+  inverse_system_matrix.add(time_step / (load * _surface_area),
+                            _reduced_robin_matrix);
+  inverse_system_matrix.gauss_jordan();
+  _load_propagator.reinit(n_modes, n_modes);
+  inverse_system_matrix.mmult(_load_propagator, _reduced_mass_matrix);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step(
+    double const time_step, SuperCapacitorState const supercapacitor_state,
+    double const value)
+{
+  // The basis vectors are zero on the cathode when the voltage is imposed
+  // so a Dirichlet condition cannot be represented by the reduced model.
+  if (supercapacitor_state == ConstantVoltage)
+  {
+    evolve_full_model(time_step, supercapacitor_state, value);
+    return;
+  }
+
+  unsigned int const n_modes = _coefficients.size();
+  dealii::Vector<double> coefficients(n_modes);
+  double current = 0.;
+  // Factor of the Robin term in the residual.
+  double robin_factor = 0.;
+  if (supercapacitor_state == ConstantLoad)
+  {
+    // Galerkin projection of the Robin boundary condition of the full model.
+    update_load(time_step, value);
+    _load_propagator.vmult(coefficients, _coefficients);
+    current =
+        -(_reduced_neumann_load * coefficients) / (_surface_area * value);
+    robin_factor = time_step / (value * _surface_area);
+  }
+  else
+  {
+    // Solution without current, u_0, and voltage V(I) = V_0 + R I.
+    update_time_step(time_step);
+    _propagator.vmult(coefficients, _coefficients);
+    double const voltage =
+        (_reduced_neumann_load * coefficients) / _surface_area;
+    double const resistance = _unit_current_voltage;
+    if (supercapacitor_state == ConstantCurrent)
+      current = value;
+    else if (supercapacitor_state == ConstantPower)
+    {
+      double const discriminant = voltage * voltage + 4. * resistance * value;
+      if (discriminant < 0.)
+        throw std::runtime_error("The power " + std::to_string(value) +
+                                 " W cannot be imposed during the time step.");
+      double const root = std::copysign(std::sqrt(discriminant), voltage);
+      current = (value == 0.) ? 0. : 2. * value / (voltage + root);
+    }
+    else
+      throw std::runtime_error("Unknown SuperCapacitorState");
+    coefficients.add(current, _unit_current_response);
+  }
+
+  // Residual (M + dt K + dt B / (R A)) u_{n+1} - M u_n - dt I / A N and
+  // right-hand side M u_n + dt I / A N of the full system. The Neumann term is
+  // only present when the current is imposed and the Robin term only when the
+  // load is imposed.
+  double const current_density =
+      (supercapacitor_state == ConstantLoad) ? 0. : current / _surface_area;
+  dealii::Vector<double> residual(3 * n_modes + 1);
+  dealii::Vector<double> rhs(3 * n_modes + 1);
+  for (unsigned int i = 0; i < n_modes; ++i)
+  {
+    residual(i) = coefficients(i) - _coefficients(i);
+    residual(n_modes + i) = time_step * coefficients(i);
+    residual(2 * n_modes + 1 + i) = robin_factor * coefficients(i);
+    rhs(i) = _coefficients(i);
+  }
+  residual(2 * n_modes) = -time_step * current_density;
+  rhs(2 * n_modes) = time_step * current_density;
+  double const residual_norm_square =
+      std::max(0., _gram_matrix.matrix_norm_square(residual));
+  double const rhs_norm_square = _gram_matrix.matrix_norm_square(rhs);
+  if (residual_norm_square >
+      _error_tolerance * _error_tolerance * rhs_norm_square)
+  {
+    evolve_full_model(time_step, supercapacitor_state, value);
+    return;
+  }
+
+  _coefficients.swap(coefficients);
+  _voltage = (_reduced_neumann_load * _coefficients) / _surface_area;
+  _current = current;
+  _full_model_synchronized = false;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_full_model(
+    double const time_step, SuperCapacitorState const supercapacitor_state,
+    double const value)
+{
+  if (!_full_model_synchronized)
+    lift();
+  switch (supercapacitor_state)
+  {
+  case ConstantCurrent:
+  {
+    _full_model->evolve_one_time_step_constant_current(time_step, value);
+    break;
+  }
+  case ConstantVoltage:
+  {
+    _full_model->evolve_one_time_step_constant_voltage(time_step, value);
+    break;
+  }
+  case ConstantPower:
+  {
+    _full_model->evolve_one_time_step_constant_power(time_step, value);
+    break;
+  }
+  case ConstantLoad:
+  {
+    _full_model->evolve_one_time_step_constant_load(time_step, value);
+    break;
+  }
+  default:
+    throw std::runtime_error("Unknown SuperCapacitorState");
+  }
+  project();
+  _full_model_synchronized = true;
+  ++_n_full_model_steps;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::lift() const
+{
+  dealii::Trilinos::MPI::BlockVector solution(*(_full_model->_solution));
+  solution.block(0) = 0.;
+  for (unsigned int i = 0; i < _basis.size(); ++i)
+    solution.block(0).add(_coefficients(i), _basis[i]);
+  _constraint_matrix.distribute(solution.block(0));
+  _full_model->restore(internal::SuperCapacitorSnapshot<dim>(solution));
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::project()
+{
+  dealii::Trilinos::MPI::Vector solution(_full_model->_solution->block(0));
+  _constraint_matrix.set_zero(solution);
+  dealii::Vector<double> rhs(_basis.size());
+  for (unsigned int i = 0; i < _basis.size(); ++i)
+    rhs(i) = _mass_basis[i] * solution;
+  _inverse_reduced_mass_matrix.vmult(_coefficients, rhs);
+  _full_model->get_voltage(_voltage);
+  _full_model->get_current(_current);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::inspect(
+    EnergyStorageDeviceInspector *inspector)
+{
+  inspector->inspect(this);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::get_voltage(double &voltage) const
+{
+  voltage = _voltage;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::get_current(double &current) const
+{
+  current = _current;
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_constant_current(
+    double const time_step, double const current)
+{
+  evolve_one_time_step(time_step, ConstantCurrent, current);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_constant_voltage(
+    double const time_step, double const voltage)
+{
+  evolve_one_time_step(time_step, ConstantVoltage, voltage);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_constant_power(
+    double const time_step, double const power)
+{
+  evolve_one_time_step(time_step, ConstantPower, power);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_constant_load(
+    double const time_step, double const load)
+{
+  if (!(load > 0.))
+    throw std::runtime_error("The load should be greater than zero.");
+  evolve_one_time_step(time_step, ConstantLoad, load);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_linear_current(
+    double const time_step, double const current)
+{
+  evolve_one_time_step_constant_current(time_step, current);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_linear_voltage(
+    double const time_step, double const voltage)
+{
+  evolve_one_time_step_constant_voltage(time_step, voltage);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_linear_power(
+    double const time_step, double const power)
+{
+  evolve_one_time_step_constant_power(time_step, power);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::evolve_one_time_step_linear_load(
+    double const time_step, double const load)
+{
+  evolve_one_time_step_constant_load(time_step, load);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::save(const std::string &filename) const
+{
+  lift();
+  _full_model->save(filename);
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::load(const std::string &filename)
+{
+  _full_model->load(filename);
+  project();
+  _full_model_synchronized = true;
+}
+
+template <int dim>
+std::unique_ptr<EnergyStorageDeviceSnapshot>
+ReducedOrderSuperCapacitor<dim>::snapshot() const
+{
+  return std::unique_ptr<EnergyStorageDeviceSnapshot>(
+      new internal::ReducedOrderSuperCapacitorSnapshot(_coefficients, _voltage,
+                                                       _current));
+}
+
+template <int dim>
+void ReducedOrderSuperCapacitor<dim>::restore(
+    EnergyStorageDeviceSnapshot const &snapshot)
+{
+  auto const *state =
+      dynamic_cast<internal::ReducedOrderSuperCapacitorSnapshot const *>(
+          &snapshot);
+  if (state == nullptr)
+    throw std::runtime_error(
+        "The snapshot was taken on a different type of device.");
+  if (state->coefficients.size() != _coefficients.size())
+    throw std::runtime_error(
+        "The snapshot was taken with a different reduced basis.");
+  _coefficients = state->coefficients;
+  _voltage = state->voltage;
+  _current = state->current;
+  _full_model_synchronized = false;
+}
+
+template <int dim>
+std::vector<std::complex<double>>
+ReducedOrderSuperCapacitor<dim>::compute_impedance(
+    std::vector<double> const &frequencies) const
+{
+  std::vector<double> const angular_frequencies =
+      to_angular_frequencies(frequencies);
+  std::vector<std::complex<double>> impedance(angular_frequencies.size());
+
+  // Each frequency is a dense solve of the real form of
+  // (K_r + i omega M_r) c = N_r, so the frequencies are distributed among
+  // the threads.
+  unsigned int const n_modes = _basis.size();
+  double const factor = 1. / (_surface_area * _surface_area);
+  auto const solve = [&](unsigned int const begin, unsigned int const end)
+  {
+    dealii::FullMatrix<double> system_matrix(2 * n_modes, 2 * n_modes);
+    dealii::Vector<double> rhs(2 * n_modes);
+    dealii::Vector<double> solution(2 * n_modes);
+    for (unsigned int i = 0; i < n_modes; ++i)
+      rhs(i) = _reduced_neumann_load(i);
+    for (unsigned int k = begin; k < end; ++k)
+    {
+      double const omega = angular_frequencies[k];
+      for (unsigned int i = 0; i < n_modes; ++i)
+        for (unsigned int j = 0; j < n_modes; ++j)
+        {
+          system_matrix(i, j) = _reduced_stiffness_matrix(i, j);
+          system_matrix(i, n_modes + j) = -omega * _reduced_mass_matrix(i, j);
+          system_matrix(n_modes + i, j) = omega * _reduced_mass_matrix(i, j);
+          system_matrix(n_modes + i, n_modes + j) =
+              _reduced_stiffness_matrix(i, j);
+        }
+      system_matrix.gauss_jordan();
+      system_matrix.vmult(solution, rhs);
+      double real = 0.;
+      double imag = 0.;
+      for (unsigned int i = 0; i < n_modes; ++i)
+      {
+        real += _reduced_neumann_load(i) * solution(i);
+        imag += _reduced_neumann_load(i) * solution(n_modes + i);
+      }
+      impedance[k] = std::complex<double>(factor * real, factor * imag);
+    }
+  };
+  dealii::parallel::apply_to_subranges(
+      0u, static_cast<unsigned int>(angular_frequencies.size()), solve, 1);
+
+  return impedance;
+}
+
+template <int dim>
+unsigned int ReducedOrderSuperCapacitor<dim>::get_basis_size() const
+{
+  return _basis.size();
+}
+
+template <int dim>
+std::size_t ReducedOrderSuperCapacitor<dim>::get_n_full_model_steps() const
+{
+  return _n_full_model_steps;
+}
+
+} // end namespace cap
+
+#endif
@@ -11,12 +11,15 @@
 #include <cap/energy_storage_device.h>
 #include <cap/geometry.h>
 #include <cap/electrochemical_physics.h>
+#include <cap/electrochemical_operator.h>
 #include <cap/post_processor.h>
 #include <cap/timer.h>
 #include <deal.II/fe/fe_system.h>
 #include <deal.II/lac/block_vector.h>
+#include <deal.II/lac/trilinos_precondition.h>
 #include <memory>
 #include <iostream>
+#include <vector>
 
 namespace cap
 {
@@ -117,6 +120,32 @@ public:
    */
   void load(const std::string &filename) override;
 
+  /**
+   * Return a copy of the solution. The mesh is not part of the snapshot so it
+   * can only be restored on the same mesh.
+   */
+  std::unique_ptr<EnergyStorageDeviceSnapshot> snapshot() const override;
+
+  void restore(EnergyStorageDeviceSnapshot const &snapshot) override;
+
+  /**
+   * Solve \f$(K + i \omega M) \hat{u} = N\f$ for each frequency, where K and
+   * M are the stiffness and the mass matrices and N is the load vector of a
+   * unit current density on the cathode. The complex system is solved as a
+   * real system of twice the size with GMRES. The preconditioner is the PRESB
+   * preconditioner, which only requires an AMG preconditioner of
+   * \f$K + \omega M\f$ and whose convergence does not depend on the
+   * frequency. The solution at the previous frequency is the initial guess.
+   */
+  std::vector<std::complex<double>>
+  compute_impedance(std::vector<double> const &frequencies) const override;
+
+  /**
+   * Return the number of iterations of the Krylov solver for each time step
+   * since the construction of the object.
+   */
+  std::vector<unsigned int> const &get_n_iterations() const;
+
 private:
   /**
    * Helper function to advance time by @p time_step second.
@@ -125,6 +154,49 @@ private:
                             SuperCapacitorState supercapacitor_state,
                             bool rebuild);
 
+  /**
+   * Compute the solution at the end of the time step from the solution of the
+   * system solved by @p time_integrator, store @p previous_solution if it is
+   * needed by the next time step, and update the post-processor.
+   */
+  void complete_time_step(SuperCapacitorState const supercapacitor_state,
+                          TimeIntegrator const time_integrator,
+                          dealii::Trilinos::MPI::Vector &previous_solution);
+
+  /**
+   * Return true if the solution at the previous time step is needed, either
+   * by the time integrator or by the extrapolation of the initial guess.
+   */
+  bool keep_history() const;
+
+  /**
+   * Add to the solution, computed without current, the response to the
+   * current that delivers the imposed power. @p response_factor is the
+   * derivative of the solution at the end of the time step with respect to the
+   * solution of the system.
+   */
+  void impose_constant_power(double const response_factor);
+
+  /**
+   * Compute _unit_current_response and _unit_current_voltage.
+   */
+  void compute_unit_current_response();
+
+  /**
+   * Return the integral of the solid potential of @p solution on the cathode.
+   */
+  double integrate_cathode_potential(
+      dealii::Trilinos::MPI::Vector const &solution) const;
+
+  /**
+   * Return an ElectrochemicalPhysics that imposes a zero current on the
+   * cathode. Its mass matrix, stiffness matrix, and load vector do not depend
+   * on the operating condition or on the time step. It is assembled even if
+   * the matrix-free operator is used.
+   */
+  std::unique_ptr<ElectrochemicalPhysics<dim>>
+  build_constant_current_physics() const;
+
   /**
    * Output on the screen the condition number of the system of equations being
    * solved.
@@ -164,6 +236,37 @@ private:
    * tolerance.
    */
   double _rel_tolerance;
+  /**
+   * If true, use a matrix-free operator and a Chebyshev preconditioner instead
+   * of assembling the system matrix and using an AMG preconditioner.
+   */
+  bool _matrix_free;
+  /**
+   * Time integrator read from the option solver.time_integrator. Backward
+   * Euler is used instead for the first time step after a change of the
+   * operating condition.
+   */
+  TimeIntegrator _time_integrator;
+  /**
+   * If true, the initial guess of the Krylov solver is extrapolated from the
+   * solutions at the last two time steps instead of being the solution at the
+   * previous time step. Read from the option solver.initial_guess
+   * (previous or extrapolation).
+   */
+  bool _extrapolate_initial_guess;
+  /**
+   * True if _old_solution is the solution at the previous time step.
+   */
+  bool _valid_history;
+  /**
+   * True if _unit_current_response has been computed with the current time
+   * step and time integrator. It does not depend on the power.
+   */
+  bool _valid_unit_current_response;
+  /**
+   * Voltage associated with _unit_current_response.
+   */
+  double _unit_current_voltage;
   /**
    * Area of the cathode.
    */
@@ -173,19 +276,47 @@ private:
   std::shared_ptr<dealii::FESystem<dim>> _fe;
   std::shared_ptr<dealii::DoFHandler<dim>> _dof_handler;
   std::shared_ptr<dealii::Trilinos::MPI::BlockVector> _solution;
+  /**
+   * Solution at the previous time step. Only used by the second order time
+   * integrators and by the extrapolation of the initial guess.
+   */
+  dealii::Trilinos::MPI::Vector _old_solution;
+  /**
+   * Solution of the system for a unit current density on the cathode and no
+   * contribution from the previous time steps. Used to impose the power.
+   */
+  dealii::Trilinos::MPI::Vector _unit_current_response;
 
   std::shared_ptr<ElectrochemicalPhysicsParameters<dim>>
       _electrochemical_physics_params;
   std::shared_ptr<ElectrochemicalPhysics<dim>> _electrochemical_physics;
+  /**
+   * Preconditioner of the Krylov solver in evolve_one_time_step(). It is only
+   * rebuilt when _electrochemical_physics is rebuilt, i.e., when the system
+   * matrix changes.
+   */
+  std::shared_ptr<dealii::Trilinos::PreconditionAMG> _preconditioner;
+  /**
+   * Matrix-free operator used instead of _electrochemical_physics and
+   * _preconditioner when _matrix_free is true.
+   */
+  std::shared_ptr<ElectrochemicalOperatorBase<dim>> _electrochemical_operator;
   std::shared_ptr<SuperCapacitorPostprocessorParameters<dim>>
       _post_processor_params;
   std::shared_ptr<SuperCapacitorPostprocessor<dim>> _post_processor;
   boost::property_tree::ptree const _ptree;
   Timer _setup_timer;
+  Timer _preconditioner_timer;
   Timer _solver_timer;
+  /**
+   * Number of iterations of the Krylov solver for each time step.
+   */
+  std::vector<unsigned int> _n_iterations;
 
   template <int dimension>
   friend class SuperCapacitorInspector;
+  template <int dimension>
+  friend class ReducedOrderSuperCapacitor;
 };
 }
 
@@ -19,8 +19,8 @@
 #include <deal.II/numerics/matrix_tools.h>
 #include <deal.II/numerics/data_out.h>
 #include <deal.II/grid/filtered_iterator.h>
-#include <deal.II/lac/trilinos_precondition.h>
 #include <deal.II/lac/solver_cg.h>
+#include <deal.II/lac/solver_gmres.h>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
@@ -29,11 +29,114 @@
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/set.hpp>
+#include <cmath>
 #include <fstream>
+#include <numeric>
 #include <typeinfo>
 
 namespace cap
 {
+namespace internal
+{
+/**
+ * State of a SuperCapacitor.
+ */
+template <int dim>
+class SuperCapacitorSnapshot : public EnergyStorageDeviceSnapshot
+{
+public:
+  SuperCapacitorSnapshot(dealii::Trilinos::MPI::BlockVector const &solution)
+      : solution(solution)
+  {
+  }
+
+  dealii::Trilinos::MPI::BlockVector const solution;
+};
+
+/**
+ * Real form of \f$K + i \omega M\f$. Block 0 is the real part and block 1
+ * the imaginary part of the vectors.
+ */
+class ImpedanceOperator
+{
+public:
+  ImpedanceOperator(dealii::Trilinos::SparseMatrix const &stiffness_matrix,
+                    dealii::Trilinos::SparseMatrix const &mass_matrix,
+                    double const angular_frequency)
+      : _stiffness_matrix(stiffness_matrix), _mass_matrix(mass_matrix),
+        _angular_frequency(angular_frequency)
+  {
+  }
+
+  void vmult(dealii::Trilinos::MPI::BlockVector &dst,
+             dealii::Trilinos::MPI::BlockVector const &src) const
+  {
+    _tmp.reinit(src.block(0), true);
+    // K x - omega M y
+    _stiffness_matrix.vmult(dst.block(0), src.block(0));
+    _mass_matrix.vmult(_tmp, src.block(1));
+    dst.block(0).add(-_angular_frequency, _tmp);
+    // omega M x + K y
+    _stiffness_matrix.vmult(dst.block(1), src.block(1));
+    _mass_matrix.vmult(_tmp, src.block(0));
+    dst.block(1).add(_angular_frequency, _tmp);
+  }
+
+private:
+  dealii::Trilinos::SparseMatrix const &_stiffness_matrix;
+  dealii::Trilinos::SparseMatrix const &_mass_matrix;
+  double const _angular_frequency;
+  mutable dealii::Trilinos::MPI::Vector _tmp;
+};
+
+/**
+ * PRESB preconditioner of ImpedanceOperator:
+ * \f[
+ *   P = \begin{pmatrix} K & -\omega M \\ \omega M & K + 2 \omega M
+ *   \end{pmatrix}.
+ * \f]
+ * P is applied with two solves with \f$K + \omega M\f$, which are
+ * approximated by one cycle of AMG. For symmetric positive definite K and M
+ * the eigenvalues of \f$P^{-1} A\f$ lie in \f$[1/2, 1]\f$ for all the
+ * frequencies.
+ */
+class ImpedancePreconditioner
+{
+public:
+  ImpedancePreconditioner(dealii::Trilinos::SparseMatrix const &mass_matrix,
+                          dealii::Trilinos::PreconditionAMG const &amg,
+                          double const angular_frequency)
+      : _mass_matrix(mass_matrix), _amg(amg),
+        _angular_frequency(angular_frequency)
+  {
+  }
+
+  void vmult(dealii::Trilinos::MPI::BlockVector &dst,
+             dealii::Trilinos::MPI::BlockVector const &src) const
+  {
+    // h = (K + omega M)^{-1} (f + g)
+    _tmp = src.block(0);
+    _tmp += src.block(1);
+    _h.reinit(src.block(0), true);
+    _amg.vmult(_h, _tmp);
+    // y = (K + omega M)^{-1} (g - omega M h)
+    _mass_matrix.vmult(_tmp, _h);
+    _tmp.sadd(-_angular_frequency, 1., src.block(1));
+    _amg.vmult(dst.block(1), _tmp);
+    // x = h - y
+    dst.block(0) = _h;
+    dst.block(0) -= dst.block(1);
+  }
+
+private:
+  dealii::Trilinos::SparseMatrix const &_mass_matrix;
+  dealii::Trilinos::PreconditionAMG const &_amg;
+  double const _angular_frequency;
+  mutable dealii::Trilinos::MPI::Vector _tmp;
+  mutable dealii::Trilinos::MPI::Vector _h;
+};
+}
+
 template <int dim>
 void SuperCapacitorInspector<dim>::inspect(EnergyStorageDevice *device)
 {
@@ -92,12 +195,18 @@ template <int dim>
 SuperCapacitor<dim>::SuperCapacitor(boost::property_tree::ptree const &ptree,
                                     boost::mpi::communicator const &comm)
     : EnergyStorageDevice(comm), _max_iter(0), _verbose_lvl(0),
-      _abs_tolerance(0.), _rel_tolerance(0.), _surface_area(0.),
+      _abs_tolerance(0.), _rel_tolerance(0.), _matrix_free(false),
+      _time_integrator(TimeIntegrator::backward_euler),
+      _extrapolate_initial_guess(false), _valid_history(false),
+      _valid_unit_current_response(false), _unit_current_voltage(0.),
+      _surface_area(0.),
       _geometry(nullptr), _fe(nullptr), _dof_handler(nullptr),
       _solution(nullptr), _electrochemical_physics_params(nullptr),
-      _electrochemical_physics(nullptr), _post_processor_params(nullptr),
-      _post_processor(nullptr), _ptree(ptree),
+      _electrochemical_physics(nullptr), _preconditioner(nullptr),
+      _electrochemical_operator(nullptr),
+      _post_processor_params(nullptr), _post_processor(nullptr), _ptree(ptree),
       _setup_timer(comm, "SuperCapacitor setup"),
+      _preconditioner_timer(comm, "SuperCapacitor preconditioner setup"),
       _solver_timer(comm, "SuperCapacitor solver")
 {
   _setup_timer.start();
@@ -110,6 +219,15 @@ SuperCapacitor<dim>::SuperCapacitor(boost::property_tree::ptree const &ptree,
   _max_iter = solver_database.get("max_iter", 1000);
   _rel_tolerance = solver_database.get("rel_tolerance", 1e-12);
   _abs_tolerance = solver_database.get("abs_tolerance", 1e-12);
+  _matrix_free = solver_database.get("matrix_free", false);
+  _time_integrator = to_time_integrator(
+      solver_database.get<std::string>("time_integrator", "backward_euler"));
+  std::string const initial_guess =
+      solver_database.get<std::string>("initial_guess", "previous");
+  if (initial_guess == "extrapolation")
+    _extrapolate_initial_guess = true;
+  else if (initial_guess != "previous")
+    throw std::runtime_error("invalid initial guess " + initial_guess);
   // set the number of threads used by deal.II
   unsigned int n_threads = solver_database.get("n_threads", 1);
   // if 0, let TBB uses all the available threads. This can also be used if one
@@ -136,7 +254,17 @@ SuperCapacitor<dim>::~SuperCapacitor()
   if (_verbose_lvl > 0)
   {
     _setup_timer.print();
+    _preconditioner_timer.print();
     _solver_timer.print();
+    if ((_communicator.rank() == 0) && (!_n_iterations.empty()))
+    {
+      unsigned int const total_iterations = std::accumulate(
+          _n_iterations.begin(), _n_iterations.end(), 0u);
+      std::cout << "SuperCapacitor solver: " << total_iterations
+                << " iterations in " << _n_iterations.size() << " time steps, "
+                << static_cast<double>(total_iterations) / _n_iterations.size()
+                << " iterations per time step" << std::endl;
+    }
   }
 }
 
@@ -192,44 +320,35 @@ void SuperCapacitor<dim>::evolve_one_time_step_constant_power(
 {
   BOOST_ASSERT_MSG(_surface_area > 0.,
                    "The surface area should be greater than zero.");
-  dealii::Trilinos::MPI::Vector old_solution(_solution->block(0));
-  // The tolerance and the maximum number of iterations are for the picard
-  // iterations done below. This is not related to the Krylov solver in
-  // evolve_one_time_step.
-  int const max_iterations = 10;
-  double const percent_tolerance = 1.0e-2;
-  double current(0.0);
-  double voltage(0.0);
-  get_voltage(voltage);
-  for (int k = 0; k < max_iterations; ++k)
-  {
-    current = power / voltage;
-    double const constant_current_density = current / _surface_area;
-    bool const rebuild =
-        (_electrochemical_physics_params->constant_current_density ==
-         constant_current_density)
-            ? false
-            : true;
-    _electrochemical_physics_params->constant_current_density =
-        constant_current_density;
-    evolve_one_time_step(time_step, ConstantCurrent, rebuild);
-    get_voltage(voltage);
-    if (std::abs(power - voltage * current) / std::abs(power) <
-        percent_tolerance)
-      return;
-    _solution->block(0) = old_solution;
-  }
-  throw std::runtime_error("fixed point iteration did not converge in " +
-                           std::to_string(max_iterations) + " iterations");
+  // The system is solved without current and the power only enters through
+  // impose_constant_power(). A new power does not change the system, so the
+  // unit current response, the preconditioner, and the history of the time
+  // integrator are all kept.
+  _electrochemical_physics_params->constant_power_density =
+      power / _surface_area;
+  evolve_one_time_step(time_step, ConstantPower, false);
 }
 
 template <int dim>
 void SuperCapacitor<dim>::evolve_one_time_step_constant_load(
     double const time_step, double const load)
 {
-  std::ignore = time_step;
-  std::ignore = load;
-  throw std::runtime_error("This function is not implemented.");
+  BOOST_ASSERT_MSG(_surface_area > 0.,
+                   "The surface area should be greater than zero.");
+  if (!(load > 0.))
+    throw std::runtime_error("The load should be greater than zero.");
+  if (_matrix_free)
+    throw std::runtime_error(
+        "The constant load is not implemented with the matrix-free operator.");
+  double const constant_load_density = load * _surface_area;
+  bool const rebuild =
+      (_electrochemical_physics_params->constant_load_density ==
+       constant_load_density)
+          ? false
+          : true;
+  _electrochemical_physics_params->constant_load_density =
+      constant_load_density;
+  evolve_one_time_step(time_step, ConstantLoad, rebuild);
 }
 
 template <int dim>
@@ -271,27 +390,108 @@ void SuperCapacitor<dim>::evolve_one_time_step(
 {
   // The first time evolve_one_time_step is called, the solution and the
   // post-processor need to be iniatialized.
-  if (_electrochemical_physics_params->supercapacitor_state == Uninitialized)
+  bool const initialize =
+      (_electrochemical_physics_params->supercapacitor_state == Uninitialized);
+  bool const new_time_step =
+      (!initialize) &&
+      (std::abs(time_step / _electrochemical_physics_params->time_step - 1.0) >
+       1e-14);
+  bool const new_state =
+      (!initialize) &&
+      (supercapacitor_state !=
+       _electrochemical_physics_params->supercapacitor_state);
+  // The first time step after a change of the operating condition is done
+  // with backward Euler. It damps the stiff components that the implicit
+  // midpoint rule would keep and it provides the second solution needed by
+  // BDF2. BDF2 also needs to restart when the time step changes.
+  bool const restart =
+      initialize || rebuild || new_state || (!_valid_history) ||
+      ((_time_integrator == TimeIntegrator::bdf2) && new_time_step);
+  TimeIntegrator const time_integrator =
+      restart ? TimeIntegrator::backward_euler : _time_integrator;
+  bool const new_time_integrator =
+      (time_integrator != _electrochemical_physics_params->time_integrator);
+  bool const update = initialize || rebuild || new_time_step || new_state ||
+                      new_time_integrator;
+  if (update)
   {
     _electrochemical_physics_params->time_step = time_step;
     _electrochemical_physics_params->supercapacitor_state =
         supercapacitor_state;
-    _electrochemical_physics.reset(new ElectrochemicalPhysics<dim>(
-        _electrochemical_physics_params, this->_communicator));
+    _electrochemical_physics_params->time_integrator = time_integrator;
   }
-  // Rebuild the system if necessary
-  else if ((rebuild == true) ||
-           (std::abs(time_step / _electrochemical_physics_params->time_step -
-                     1.0) > 1e-14) ||
-           (supercapacitor_state !=
-            _electrochemical_physics_params->supercapacitor_state))
+  // The unit current response only depends on the system matrix without
+  // current, i.e. on the time step and on the time integrator.
+  if (new_time_step || new_time_integrator)
+    _valid_unit_current_response = false;
+
+  // Keep u_n, it is needed by the implicit midpoint rule at the end of the
+  // time step and by BDF2 and the extrapolation of the initial guess at the
+  // next time step. The system solved by BDF2 uses (4 u_n - u_{n-1}) / 3 in
+  // place of u_n.
+  dealii::Trilinos::MPI::Vector previous_solution;
+  if (keep_history())
   {
-    _electrochemical_physics_params->time_step = time_step;
-    _electrochemical_physics_params->supercapacitor_state =
-        supercapacitor_state;
+    previous_solution = _solution->block(0);
+    if (time_integrator == TimeIntegrator::bdf2)
+      _solution->block(0).sadd(4. / 3., -1. / 3., _old_solution);
+  }
+
+  // The Krylov solver starts from the solution at the previous time step
+  // unless the solution is extrapolated from the last two time steps. The
+  // extrapolation is only used when the solution is smooth, i.e. when the
+  // operating condition and the time step have not changed. With a constant
+  // power, the system is solved without current so the extrapolated solution
+  // is not a better guess.
+  bool const extrapolate =
+      _extrapolate_initial_guess && _valid_history && (!update) &&
+      (supercapacitor_state != ConstantPower);
+  dealii::Trilinos::MPI::Vector initial_guess;
+  if (extrapolate)
+  {
+    // The implicit midpoint rule solves for u_{n+1/2}.
+    double const c =
+        (time_integrator == TimeIntegrator::crank_nicolson) ? 0.5 : 1.;
+    initial_guess = previous_solution;
+    initial_guess.sadd(1. + c, -c, _old_solution);
+  }
+
+  if (_matrix_free)
+  {
+    if (initialize)
+      _electrochemical_operator = ElectrochemicalOperatorFactory<dim>::build(
+          _electrochemical_physics_params, this->_communicator);
+    else if (update)
+      _electrochemical_operator->reinit(_electrochemical_physics_params);
+
+    _solver_timer.start();
+    dealii::SolverControl solver_control(_max_iter, _abs_tolerance);
+    _electrochemical_operator->evolve_one_time_step(
+        solver_control, _rel_tolerance, _solution->block(0),
+        extrapolate ? initial_guess : _solution->block(0));
+    _solver_timer.stop();
+    _n_iterations.push_back(solver_control.last_step());
+
+    complete_time_step(supercapacitor_state, time_integrator,
+                       previous_solution);
+
+    return;
+  }
+
+  // Update the system if necessary. ElectrochemicalPhysics forms the new
+  // system from its cached matrices instead of assembling them again. When
+  // only the current or the voltage imposed on the cathode changes, the system
+  // matrix stays the same and the preconditioner can be reused. The load is
+  // part of the system matrix.
+  bool const rebuild_preconditioner =
+      initialize || new_time_step || new_state || new_time_integrator ||
+      (rebuild && (supercapacitor_state == ConstantLoad)) ||
+      (_preconditioner == nullptr);
+  if (initialize)
     _electrochemical_physics.reset(new ElectrochemicalPhysics<dim>(
         _electrochemical_physics_params, this->_communicator));
-  }
+  else if (update)
+    _electrochemical_physics->reinit(_electrochemical_physics_params);
 
   // Get the system from the ElectrochemicalPhysiscs object.
   dealii::Trilinos::SparseMatrix const &system_matrix =
@@ -304,11 +504,24 @@ void SuperCapacitor<dim>::evolve_one_time_step(
       _electrochemical_physics->get_system_rhs();
   dealii::Trilinos::MPI::Vector time_dep_rhs = system_rhs;
   mass_matrix.vmult_add(time_dep_rhs, _solution->block(0));
+  if (extrapolate)
+    _solution->block(0).swap(initial_guess);
+
+  // The AMG setup is expensive so the preconditioner is only rebuilt when the
+  // system matrix has changed.
+  if (rebuild_preconditioner)
+  {
+    _preconditioner_timer.start();
+    // Temporary preconditioner. Need to find what parameters work best.
+    _preconditioner = std::make_shared<dealii::Trilinos::PreconditionAMG>();
+    _preconditioner->initialize(system_matrix);
+    _preconditioner_timer.stop();
+  }
 
   // Solve the system
   _solver_timer.start();
   double tolerance =
-      std::max(_abs_tolerance, _rel_tolerance * system_rhs.l2_norm());
+      std::max(_abs_tolerance, _rel_tolerance * time_dep_rhs.l2_norm());
   dealii::SolverControl solver_control(_max_iter, tolerance);
   dealii::SolverCG<dealii::Trilinos::MPI::Vector> solver(solver_control);
   // Compute the condition number at the end of the CG iterations.
@@ -323,12 +536,9 @@ void SuperCapacitor<dim>::evolve_one_time_step(
         std::bind(&SuperCapacitor<dim>::output_eigenvalues, this,
                   std::placeholders::_1),
         false);
-  dealii::Trilinos::PreconditionAMG preconditioner;
-  // Temporary preconditioner. Need to find what parameters work best.
-  preconditioner.initialize(system_matrix);
   constraint_matrix.distribute(_solution->block(0));
   solver.solve(system_matrix, _solution->block(0), time_dep_rhs,
-               preconditioner);
+               *_preconditioner);
   constraint_matrix.distribute(_solution->block(0));
   if ((_verbose_lvl > 0) && (_communicator.rank() == 0))
   {
@@ -340,11 +550,208 @@ void SuperCapacitor<dim>::evolve_one_time_step(
               << std::endl;
   }
   _solver_timer.stop();
+  _n_iterations.push_back(solver_control.last_step());
+
+  complete_time_step(supercapacitor_state, time_integrator, previous_solution);
+}
+
+template <int dim>
+void SuperCapacitor<dim>::complete_time_step(
+    SuperCapacitorState const supercapacitor_state,
+    TimeIntegrator const time_integrator,
+    dealii::Trilinos::MPI::Vector &previous_solution)
+{
+  // u_{n+1} = 2 u_{n+1/2} - u_n. The values imposed on the boundary are the
+  // same at both times since the operating condition has not changed.
+  bool const midpoint = (time_integrator == TimeIntegrator::crank_nicolson);
+  if (midpoint)
+    _solution->block(0).sadd(2., -1., previous_solution);
+
+  if (supercapacitor_state == ConstantPower)
+    impose_constant_power(midpoint ? 2. : 1.);
+
+  if (keep_history())
+  {
+    _old_solution.swap(previous_solution);
+    _valid_history = true;
+  }
 
   // Update the data in post-processor
   _post_processor->reset(_post_processor_params);
 }
 
+template <int dim>
+bool SuperCapacitor<dim>::keep_history() const
+{
+  return (_time_integrator != TimeIntegrator::backward_euler) ||
+         _extrapolate_initial_guess;
+}
+
+template <int dim>
+void SuperCapacitor<dim>::impose_constant_power(double const response_factor)
+{
+  // The solution at the end of the time step is affine in the current I
+  // imposed on the cathode: u(I) = u_0 + I r, where u_0 is the solution
+  // computed without current and r is the response to a unit current. r only
+  // depends on the system matrix so it is computed once and reused until the
+  // time step or the time integrator changes. The voltage V(I) = V_0 + R I is
+  // affine too and the current is the root of V(I) I = P that goes to P / V_0
+  // when the power goes to zero. This is the same equation as for an RC
+  // circuit with an effective resistance R.
+  if (!_valid_unit_current_response)
+    compute_unit_current_response();
+
+  double const power =
+      _electrochemical_physics_params->constant_power_density * _surface_area;
+  double const voltage =
+      integrate_cathode_potential(_solution->block(0)) / _surface_area;
+  double const resistance =
+      response_factor * _unit_current_voltage / _surface_area;
+  double const discriminant = voltage * voltage + 4. * resistance * power;
+  if (discriminant < 0.)
+    throw std::runtime_error("The power " + std::to_string(power) +
+                             " W cannot be imposed during the time step.");
+  double const current =
+      (power == 0.)
+          ? 0.
+          : 2. * power /
+                (voltage + std::copysign(std::sqrt(discriminant), voltage));
+  _solution->block(0).add(response_factor * current / _surface_area,
+                          _unit_current_response);
+}
+
+template <int dim>
+void SuperCapacitor<dim>::compute_unit_current_response()
+{
+  _solver_timer.start();
+  _unit_current_response.reinit(_solution->block(0));
+  if (_matrix_free)
+  {
+    dealii::SolverControl solver_control(_max_iter, _abs_tolerance);
+    _electrochemical_operator->compute_unit_current_response(
+        solver_control, _rel_tolerance, _unit_current_response);
+  }
+  else
+  {
+    // alpha * dt * N
+    dealii::Trilinos::MPI::Vector rhs(
+        _electrochemical_physics->get_neumann_load());
+    rhs *= get_implicit_factor(
+               _electrochemical_physics_params->time_integrator) *
+           _electrochemical_physics_params->time_step;
+    double const tolerance =
+        std::max(_abs_tolerance, _rel_tolerance * rhs.l2_norm());
+    dealii::SolverControl solver_control(_max_iter, tolerance);
+    dealii::SolverCG<dealii::Trilinos::MPI::Vector> solver(solver_control);
+    solver.solve(_electrochemical_physics->get_system_matrix(),
+                 _unit_current_response, rhs, *_preconditioner);
+    _electrochemical_physics->get_constraint_matrix().distribute(
+        _unit_current_response);
+  }
+  _solver_timer.stop();
+
+  // Voltage for a unit current density.
+  _unit_current_voltage =
+      integrate_cathode_potential(_unit_current_response) / _surface_area;
+  _valid_unit_current_response = true;
+}
+
+template <int dim>
+std::vector<std::complex<double>> SuperCapacitor<dim>::compute_impedance(
+    std::vector<double> const &frequencies) const
+{
+  std::vector<double> const angular_frequencies =
+      to_angular_frequencies(frequencies);
+
+  // The impedance is the response to a small sinusoidal current, so only the
+  // matrices assembled for an imposed current are needed. With
+  // u = x + i y, (K + i omega M) u = N becomes
+  //   K x - omega M y = N
+  //   omega M x + K y = 0
+  // The voltage is the average of the solid potential on the cathode and the
+  // current is the current density times the area of the cathode.
+  std::unique_ptr<ElectrochemicalPhysics<dim>> physics =
+      build_constant_current_physics();
+  dealii::Trilinos::SparseMatrix const &mass_matrix =
+      physics->get_constrained_mass_matrix();
+  dealii::Trilinos::SparseMatrix const &stiffness_matrix =
+      physics->get_stiffness_matrix();
+  dealii::Trilinos::MPI::Vector const &neumann_load =
+      physics->get_neumann_load();
+  dealii::ConstraintMatrix const &constraint_matrix =
+      physics->get_constraint_matrix();
+
+  std::vector<dealii::IndexSet> index_set(2,
+                                          _dof_handler->locally_owned_dofs());
+  dealii::Trilinos::MPI::BlockVector rhs(index_set, _communicator);
+  rhs.block(0) = neumann_load;
+  dealii::Trilinos::MPI::BlockVector solution(index_set, _communicator);
+  double const tolerance =
+      std::max(_abs_tolerance, _rel_tolerance * rhs.l2_norm());
+  double const factor = 1. / (_surface_area * _surface_area);
+
+  // The frequencies are solved one after the other. Each solve is
+  // distributed with MPI but the AMG preconditioners of Trilinos cannot be
+  // set up concurrently by several threads.
+  std::vector<std::complex<double>> impedance;
+  impedance.reserve(angular_frequencies.size());
+  dealii::Trilinos::SparseMatrix preconditioner_matrix;
+  for (unsigned int k = 0; k < angular_frequencies.size(); ++k)
+  {
+    double const omega = angular_frequencies[k];
+    preconditioner_matrix.copy_from(stiffness_matrix);
+    preconditioner_matrix.add(omega, mass_matrix);
+    dealii::Trilinos::PreconditionAMG amg;
+    amg.initialize(preconditioner_matrix);
+
+    internal::ImpedanceOperator const system_matrix(stiffness_matrix,
+                                                    mass_matrix, omega);
+    internal::ImpedancePreconditioner const preconditioner(mass_matrix, amg,
+                                                           omega);
+    dealii::SolverControl solver_control(_max_iter, tolerance);
+    dealii::SolverGMRES<dealii::Trilinos::MPI::BlockVector> solver(
+        solver_control,
+        dealii::SolverGMRES<dealii::Trilinos::MPI::BlockVector>::AdditionalData(
+            100, true));
+    solver.solve(system_matrix, solution, rhs, preconditioner);
+    constraint_matrix.distribute(solution.block(0));
+    constraint_matrix.distribute(solution.block(1));
+    if ((_verbose_lvl > 0) && (_communicator.rank() == 0))
+      std::cout << "Impedance at " << frequencies[k]
+                << " Hz: " << solver_control.last_step() << " iterations"
+                << std::endl;
+
+    impedance.emplace_back(factor * (neumann_load * solution.block(0)),
+                           factor * (neumann_load * solution.block(1)));
+  }
+
+  return impedance;
+}
+
+template <int dim>
+std::unique_ptr<ElectrochemicalPhysics<dim>>
+SuperCapacitor<dim>::build_constant_current_physics() const
+{
+  auto params = std::make_shared<ElectrochemicalPhysicsParameters<dim>>(
+      *_electrochemical_physics_params);
+  params->supercapacitor_state = ConstantCurrent;
+  params->constant_current_density = 0.;
+  params->time_step = 1.;
+  params->time_integrator = TimeIntegrator::backward_euler;
+  return std::unique_ptr<ElectrochemicalPhysics<dim>>(
+      new ElectrochemicalPhysics<dim>(params, _communicator));
+}
+
+template <int dim>
+double SuperCapacitor<dim>::integrate_cathode_potential(
+    dealii::Trilinos::MPI::Vector const &solution) const
+{
+  if (_matrix_free)
+    return _electrochemical_operator->integrate_cathode_potential(solution);
+  else
+    return _electrochemical_physics->get_neumann_load() * solution;
+}
+
 template <int dim>
 void SuperCapacitor<dim>::output_condition_number(double condition_number)
 {
@@ -482,6 +889,37 @@ void SuperCapacitor<dim>::load(const std::string &filename)
   _post_processor->reset(_post_processor_params);
 }
 
+template <int dim>
+std::unique_ptr<EnergyStorageDeviceSnapshot>
+SuperCapacitor<dim>::snapshot() const
+{
+  return std::unique_ptr<EnergyStorageDeviceSnapshot>(
+      new internal::SuperCapacitorSnapshot<dim>(*_solution));
+}
+
+template <int dim>
+void SuperCapacitor<dim>::restore(EnergyStorageDeviceSnapshot const &snapshot)
+{
+  auto const *state =
+      dynamic_cast<internal::SuperCapacitorSnapshot<dim> const *>(&snapshot);
+  if (state == nullptr)
+    throw std::runtime_error(
+        "The snapshot was taken on a different type of device.");
+  if (state->solution.size() != _solution->size())
+    throw std::runtime_error("The snapshot was taken on a different mesh.");
+  *_solution = state->solution;
+  // The snapshot does not contain the solution at the previous time step.
+  _valid_history = false;
+  // Update the voltage and the current returned by the post-processor.
+  _post_processor->reset(_post_processor_params);
+}
+
+template <int dim>
+std::vector<unsigned int> const &SuperCapacitor<dim>::get_n_iterations() const
+{
+  return _n_iterations;
+}
+
 template <int dim>
 void SuperCapacitor<dim>::setup()
 {
@@ -518,31 +956,17 @@ void SuperCapacitor<dim>::setup()
   _electrochemical_physics_params->dof_handler = _dof_handler;
   _electrochemical_physics_params->mp_values =
       std::dynamic_pointer_cast<MPValues<dim> const>(mp_values);
-
-  // Compute the surface area. This is neeeded by several evolve_one_time_step_*
-  _surface_area = 0.;
-  auto const &cathode_boundary_ids = (*_geometry->get_boundaries())["cathode"];
-  dealii::QGauss<dim - 1> face_quadrature_rule(_fe->degree + 1);
-  unsigned int const n_face_q_points = face_quadrature_rule.size();
-  dealii::FEFaceValues<dim> fe_face_values(*_fe, face_quadrature_rule,
-                                           dealii::update_JxW_values);
-  for (auto cell :
-       dealii::filter_iterators(_dof_handler->active_cell_iterators(),
-                                dealii::IteratorFilters::LocallyOwnedCell(),
-                                dealii::IteratorFilters::AtBoundary()))
-    for (unsigned int face = 0;
-         face < dealii::GeometryInfo<dim>::faces_per_cell; ++face)
-      if ((cell->face(face)->at_boundary()) &&
-          (cathode_boundary_ids.count(cell->face(face)->boundary_id()) > 0))
-        for (unsigned int face_q_point = 0; face_q_point < n_face_q_points;
-             ++face_q_point)
-        {
-          fe_face_values.reinit(cell, face);
-          _surface_area += fe_face_values.JxW(face_q_point);
-        }
-  // Reduce the value computed on each processor.
-  _surface_area =
-      dealii::Utilities::MPI::sum(_surface_area, this->_communicator);
+  // Evaluate the material properties once. The same values are used by the
+  // physics and by the post-processor.
+  _electrochemical_physics_params->mp_values_cache =
+      std::make_shared<MPValuesCache<dim>>(*mp_values, *_dof_handler,
+                                           dealii::QGauss<dim>(fe_degree + 1));
+  // The system will be assembled the next time evolve_one_time_step is called.
+  _electrochemical_physics.reset();
+  _preconditioner.reset();
+  _electrochemical_operator.reset();
+  _valid_history = false;
+  _valid_unit_current_response = false;
 
   // Create the post-processor parameters
   _post_processor_params =
@@ -559,9 +983,16 @@ void SuperCapacitor<dim>::setup()
   _post_processor_params->solution = _solution;
   _post_processor_params->mp_values =
       _electrochemical_physics_params->mp_values;
+  _post_processor_params->mp_values_cache =
+      _electrochemical_physics_params->mp_values_cache;
   _post_processor = std::make_shared<SuperCapacitorPostprocessor<dim>>(
       _post_processor_params, _geometry, this->_communicator);
 
+  // The surface area of the cathode is needed by several
+  // evolve_one_time_step_* functions. It is computed once by the
+  // post-processor.
+  _post_processor->get("surface_area", _surface_area);
+
   _post_processor->reset(_post_processor_params);
 
   _setup_timer.stop();
@@ -94,4 +94,19 @@ std::map<std::string, double> DefaultInspector::get_data() const
   return _data;
 }
 
+double get_post_processor_value(EnergyStorageDevice const &device,
+                                std::string const &key)
+{
+  double value;
+  if (auto super_capacitor =
+          dynamic_cast<SuperCapacitor<2> const *>(&device))
+    super_capacitor->get_post_processor()->get(key, value);
+  else if (auto super_capacitor =
+               dynamic_cast<SuperCapacitor<3> const *>(&device))
+    super_capacitor->get_post_processor()->get(key, value);
+  else
+    throw std::runtime_error("Only the SuperCapacitor has a postprocessor");
+  return value;
+}
+
 } // end namespace cap
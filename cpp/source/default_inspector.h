@@ -9,6 +9,8 @@
 #define CAP_DEFAULT_INSPECTOR_H
 
 #include <cap/energy_storage_device.h>
+#include <map>
+#include <string>
 
 namespace cap
 {
@@ -24,6 +26,14 @@ protected:
   std::map<std::string, double> _data;
 };
 
+/**
+ * Return the value of @p key computed by the postprocessor of @p device. The
+ * device must be a SuperCapacitor. Since some quantities require a reduction,
+ * the function must be called on all the processors.
+ */
+double get_post_processor_value(EnergyStorageDevice const &device,
+                                std::string const &key);
+
 } // end namespace cap
 
 #endif // CAP_DEFAULT_INSPECTOR_H
@@ -0,0 +1,233 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/end_criterion.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+namespace internal
+{
+class TimeLimit : public EndCriterion
+{
+public:
+  TimeLimit(boost::property_tree::ptree const &ptree)
+      : _duration(ptree.get<double>("duration")), _tick(0.)
+  {
+  }
+
+  bool check(double const time, EnergyStorageDevice const &) const override
+  {
+    return time - _tick >= _duration;
+  }
+
+  void reset(double const time, EnergyStorageDevice const &) override
+  {
+    _tick = time;
+  }
+
+  double get_max_duration() const override { return _duration; }
+
+private:
+  double const _duration;
+  double _tick;
+};
+
+class VoltageLimit : public EndCriterion
+{
+public:
+  VoltageLimit(boost::property_tree::ptree const &ptree,
+               std::function<bool(double, double)> const &compare)
+      : _voltage_limit(ptree.get<double>("voltage_limit")), _compare(compare)
+  {
+  }
+
+  bool check(double const, EnergyStorageDevice const &device) const override
+  {
+    double voltage;
+    device.get_voltage(voltage);
+    return _compare(voltage, _voltage_limit);
+  }
+
+  void reset(double const, EnergyStorageDevice const &) override {}
+
+private:
+  double const _voltage_limit;
+  std::function<bool(double, double)> const _compare;
+};
+
+class CurrentLimit : public EndCriterion
+{
+public:
+  CurrentLimit(boost::property_tree::ptree const &ptree,
+               std::function<bool(double, double)> const &compare)
+      : _current_limit(ptree.get<double>("current_limit")), _compare(compare)
+  {
+    if (!(_current_limit > 0.))
+      throw std::runtime_error(
+          "CurrentLimit end criterion check for absolute value of the "
+          "current. 'current_limit' (=" +
+          std::to_string(_current_limit) + ") must be greater than zero.");
+  }
+
+  bool check(double const, EnergyStorageDevice const &device) const override
+  {
+    double current;
+    device.get_current(current);
+    return _compare(std::abs(current), _current_limit);
+  }
+
+  void reset(double const, EnergyStorageDevice const &) override {}
+
+private:
+  double const _current_limit;
+  std::function<bool(double, double)> const _compare;
+};
+
+enum class LogicalOperator
+{
+  logical_or,
+  logical_and,
+  logical_xor
+};
+
+LogicalOperator to_logical_operator(std::string const &logical_operator)
+{
+  if (logical_operator == "or")
+    return LogicalOperator::logical_or;
+  else if (logical_operator == "and")
+    return LogicalOperator::logical_and;
+  else if (logical_operator == "xor")
+    return LogicalOperator::logical_xor;
+  else
+    throw std::runtime_error("Invalid logical operator '" + logical_operator +
+                             "' in CompoundCriterion");
+}
+
+class CompoundCriterion : public EndCriterion
+{
+public:
+  CompoundCriterion(boost::property_tree::ptree const &ptree)
+      : _logical_operator(to_logical_operator(
+            ptree.get<std::string>("logical_operator"))),
+        _criterion_0(EndCriterion::build(ptree.get_child("criterion_0"))),
+        _criterion_1(EndCriterion::build(ptree.get_child("criterion_1")))
+  {
+  }
+
+  bool check(double const time,
+             EnergyStorageDevice const &device) const override
+  {
+    // Both criteria are always evaluated, as in the Python implementation.
+    bool const check_0 = _criterion_0->check(time, device);
+    bool const check_1 = _criterion_1->check(time, device);
+    switch (_logical_operator)
+    {
+    case LogicalOperator::logical_or:
+      return check_0 || check_1;
+    case LogicalOperator::logical_and:
+      return check_0 && check_1;
+    default:
+      return check_0 != check_1;
+    }
+  }
+
+  void reset(double const time, EnergyStorageDevice const &device) override
+  {
+    _criterion_0->reset(time, device);
+    _criterion_1->reset(time, device);
+  }
+
+  double get_max_duration() const override
+  {
+    double const duration_0 = _criterion_0->get_max_duration();
+    double const duration_1 = _criterion_1->get_max_duration();
+    switch (_logical_operator)
+    {
+    case LogicalOperator::logical_or:
+      return std::min(duration_0, duration_1);
+    case LogicalOperator::logical_and:
+      return std::max(duration_0, duration_1);
+    default:
+      return std::numeric_limits<double>::infinity();
+    }
+  }
+
+private:
+  LogicalOperator const _logical_operator;
+  std::unique_ptr<EndCriterion> _criterion_0;
+  std::unique_ptr<EndCriterion> _criterion_1;
+};
+
+class NeverSatisfied : public EndCriterion
+{
+public:
+  bool check(double const, EnergyStorageDevice const &) const override
+  {
+    return false;
+  }
+
+  void reset(double const, EnergyStorageDevice const &) override {}
+};
+
+class AlwaysSatisfied : public EndCriterion
+{
+public:
+  bool check(double const, EnergyStorageDevice const &) const override
+  {
+    return true;
+  }
+
+  void reset(double const, EnergyStorageDevice const &) override {}
+
+  double get_max_duration() const override { return 0.; }
+};
+}
+
+EndCriterion::~EndCriterion() = default;
+
+double EndCriterion::get_max_duration() const
+{
+  return std::numeric_limits<double>::infinity();
+}
+
+std::unique_ptr<EndCriterion>
+EndCriterion::build(boost::property_tree::ptree const &ptree)
+{
+  std::string const type = ptree.get<std::string>("end_criterion");
+  if (type == "time")
+    return std::unique_ptr<EndCriterion>(new internal::TimeLimit(ptree));
+  else if (type == "voltage_greater_than")
+    return std::unique_ptr<EndCriterion>(
+        new internal::VoltageLimit(ptree, std::greater_equal<double>()));
+  else if (type == "voltage_less_than")
+    return std::unique_ptr<EndCriterion>(
+        new internal::VoltageLimit(ptree, std::less_equal<double>()));
+  else if (type == "current_greater_than")
+    return std::unique_ptr<EndCriterion>(
+        new internal::CurrentLimit(ptree, std::greater_equal<double>()));
+  else if (type == "current_less_than")
+    return std::unique_ptr<EndCriterion>(
+        new internal::CurrentLimit(ptree, std::less_equal<double>()));
+  else if (type == "compound")
+    return std::unique_ptr<EndCriterion>(
+        new internal::CompoundCriterion(ptree));
+  else if (type == "none")
+    return std::unique_ptr<EndCriterion>(new internal::NeverSatisfied());
+  else if (type == "skip")
+    return std::unique_ptr<EndCriterion>(new internal::AlwaysSatisfied());
+  else
+    throw std::runtime_error("invalid EndCriterion type '" + type + "'");
+}
+
+} // end namespace cap
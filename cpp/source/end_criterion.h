@@ -0,0 +1,63 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_END_CRITERION_H
+#define CAP_END_CRITERION_H
+
+#include <cap/energy_storage_device.h>
+#include <boost/property_tree/ptree.hpp>
+#include <memory>
+
+namespace cap
+{
+
+/**
+ * Condition that ends a Stage. The criteria are built from a ptree with the
+ * same schema as the Python EndCriterion. The type is read from the key
+ * end_criterion:
+ *  - time: satisfied once duration seconds have elapsed since reset()
+ *  - voltage_greater_than, voltage_less_than: compare the voltage to
+ *  voltage_limit
+ *  - current_greater_than, current_less_than: compare the absolute value of
+ *  the current to current_limit, which must be greater than zero
+ *  - compound: combine criterion_0 and criterion_1 with the logical_operator
+ *  or, and, or xor
+ *  - none: never satisfied
+ *  - skip: always satisfied
+ */
+class EndCriterion
+{
+public:
+  virtual ~EndCriterion();
+
+  /**
+   * Return true if the stage must end at @p time.
+   */
+  virtual bool check(double const time,
+                     EnergyStorageDevice const &device) const = 0;
+
+  /**
+   * Start a new stage at @p time.
+   */
+  virtual void reset(double const time, EnergyStorageDevice const &device) = 0;
+
+  /**
+   * Return an upper bound of the duration of the stage, or infinity if the
+   * criterion does not bound it. Used to preallocate the recorded data.
+   */
+  virtual double get_max_duration() const;
+
+  /**
+   * Factory function that creates an EndCriterion object.
+   */
+  static std::unique_ptr<EndCriterion>
+  build(boost::property_tree::ptree const &ptree);
+};
+
+} // end namespace cap
+
+#endif // CAP_END_CRITERION_H
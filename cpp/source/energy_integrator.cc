@@ -0,0 +1,95 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/energy_integrator.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+EnergyIntegrator::EnergyIntegrator()
+    : _empty(true), _time(0.), _power(0.), _energy(0.)
+{
+}
+
+double EnergyIntegrator::add(double const time, double const power)
+{
+  if (!_empty)
+    _energy += 0.5 * (time - _time) * (power + _power);
+  _empty = false;
+  _time = time;
+  _power = power;
+
+  return _energy;
+}
+
+double EnergyIntegrator::get_energy() const { return _energy; }
+
+void EnergyIntegrator::reset()
+{
+  _empty = true;
+  _time = 0.;
+  _power = 0.;
+  _energy = 0.;
+}
+
+EnergyIntegratorBatch::EnergyIntegratorBatch(std::size_t const n)
+    : _empty(true), _time(0.), _power(n, 0.), _energy(n, 0.)
+{
+}
+
+std::size_t EnergyIntegratorBatch::size() const { return _energy.size(); }
+
+void EnergyIntegratorBatch::add(double const time,
+                                std::vector<double> const &power)
+{
+  std::size_t const n = _energy.size();
+  if (power.size() != n)
+    throw std::runtime_error("Expected " + std::to_string(n) +
+                             " values but got " +
+                             std::to_string(power.size()));
+  if (!_empty)
+  {
+    double const half_delta_t = 0.5 * (time - _time);
+    for (std::size_t k = 0; k < n; ++k)
+      _energy[k] += half_delta_t * (power[k] + _power[k]);
+  }
+  _empty = false;
+  _time = time;
+  _power = power;
+}
+
+std::vector<double> const &EnergyIntegratorBatch::get_energy() const
+{
+  return _energy;
+}
+
+void EnergyIntegratorBatch::reset()
+{
+  _empty = true;
+  _time = 0.;
+  std::fill(_power.begin(), _power.end(), 0.);
+  std::fill(_energy.begin(), _energy.end(), 0.);
+}
+
+void compute_energy(std::vector<double> const &time,
+                    std::vector<double> const &power,
+                    std::vector<double> &energy)
+{
+  bool const valid_input =
+      (time.size() == power.size()) && (time.size() == energy.size());
+  if (!valid_input)
+    throw std::runtime_error("invalid input");
+
+  EnergyIntegrator integrator;
+  for (std::size_t i = 0; i < time.size(); ++i)
+    energy[i] = integrator.add(time[i], power[i]);
+}
+
+} // end namespace cap
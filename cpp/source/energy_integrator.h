@@ -0,0 +1,101 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_ENERGY_INTEGRATOR_H
+#define CAP_ENERGY_INTEGRATOR_H
+
+#include <cstddef>
+#include <vector>
+
+namespace cap
+{
+
+/**
+ * Integrate the power over time as the samples arrive. The power is linear
+ * between two samples so the trapezoidal rule is exact. Adding a sample is
+ * O(1) and nothing but the last sample is stored.
+ */
+class EnergyIntegrator
+{
+public:
+  EnergyIntegrator();
+
+  /**
+   * Add the sample (@p time, @p power) and return the energy between the
+   * first sample and @p time.
+   */
+  double add(double const time, double const power);
+
+  /**
+   * Return the energy between the first and the last sample.
+   */
+  double get_energy() const;
+
+  /**
+   * Forget all the samples.
+   */
+  void reset();
+
+private:
+  bool _empty;
+  double _time;
+  double _power;
+  double _energy;
+};
+
+/**
+ * Same as EnergyIntegrator for many traces sampled at the same times, e.g.
+ * the circuits of a SeriesRCBatch. The values are stored in contiguous arrays
+ * and all the traces are updated by a single call.
+ */
+class EnergyIntegratorBatch
+{
+public:
+  /**
+   * Build an integrator for @p n traces.
+   */
+  EnergyIntegratorBatch(std::size_t const n);
+
+  /**
+   * Return the number of traces.
+   */
+  std::size_t size() const;
+
+  /**
+   * Add the power of every trace at @p time.
+   */
+  void add(double const time, std::vector<double> const &power);
+
+  /**
+   * Return the energy of every trace between the first and the last sample.
+   */
+  std::vector<double> const &get_energy() const;
+
+  /**
+   * Forget all the samples.
+   */
+  void reset();
+
+private:
+  bool _empty;
+  double _time;
+  std::vector<double> _power;
+  std::vector<double> _energy;
+};
+
+/**
+ * Compute the integral of the power from time[0] to time[i] for every i. The
+ * power is linear between two samples so the trapezoidal rule is exact. The
+ * cost is O(n).
+ */
+void compute_energy(std::vector<double> const &time,
+                    std::vector<double> const &power,
+                    std::vector<double> &energy);
+
+} // end namespace cap
+
+#endif // CAP_ENERGY_INTEGRATOR_H
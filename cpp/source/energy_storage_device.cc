@@ -6,12 +6,16 @@
  */
 
 #include <cap/energy_storage_device.h>
+#include <boost/math/constants/constants.hpp>
+#include <stdexcept>
 
 namespace cap
 {
 
 EnergyStorageDeviceInspector::~EnergyStorageDeviceInspector() = default;
 
+EnergyStorageDeviceSnapshot::~EnergyStorageDeviceSnapshot() = default;
+
 EnergyStorageDeviceBuilder::~EnergyStorageDeviceBuilder() = default;
 
 void EnergyStorageDeviceBuilder::register_energy_storage_device(
@@ -54,4 +58,19 @@ boost::mpi::communicator EnergyStorageDevice::get_mpi_communicator() const
   return _communicator;
 }
 
+std::vector<double> EnergyStorageDevice::to_angular_frequencies(
+    std::vector<double> const &frequencies)
+{
+  std::vector<double> angular_frequencies;
+  angular_frequencies.reserve(frequencies.size());
+  for (double const frequency : frequencies)
+  {
+    if (!(frequency > 0.))
+      throw std::runtime_error("The frequencies should be greater than zero.");
+    angular_frequencies.push_back(
+        2. * boost::math::constants::pi<double>() * frequency);
+  }
+  return angular_frequencies;
+}
+
 } // end namespace cap
@@ -11,8 +11,10 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/mpi/communicator.hpp>
+#include <complex>
 #include <memory>
 #include <map>
+#include <vector>
 
 namespace cap
 {
@@ -20,6 +22,17 @@ namespace cap
 class EnergyStorageDeviceBuilder;
 class EnergyStorageDeviceInspector;
 
+/**
+ * Opaque in-memory copy of the state of an EnergyStorageDevice. It is
+ * returned by EnergyStorageDevice::snapshot() and can only be given back to
+ * EnergyStorageDevice::restore() of a device of the same type.
+ */
+class EnergyStorageDeviceSnapshot
+{
+public:
+  virtual ~EnergyStorageDeviceSnapshot();
+};
+
 /**
  * This class is an abstract representation of an energy storage device. It can
  * evolve in time at various operating conditions and return the voltage drop
@@ -106,6 +119,29 @@ public:
    */
   virtual void load(const std::string &filename) = 0;
 
+  /**
+   * Return an in-memory copy of the current state of the energy storage
+   * device. Unlike save(), this does not touch the filesystem so it can be
+   * used to roll back rejected time steps.
+   */
+  virtual std::unique_ptr<EnergyStorageDeviceSnapshot> snapshot() const = 0;
+
+  /**
+   * Set the state of the energy storage device to @p snapshot. An exception
+   * is thrown if @p snapshot was taken on a device of a different type.
+   */
+  virtual void restore(EnergyStorageDeviceSnapshot const &snapshot) = 0;
+
+  /**
+   * Return the impedance \f$Z(f) = \hat{U}/\hat{I}\f$ in ohms of the device
+   * for a small sinusoidal excitation at each of the @p frequencies in hertz.
+   * The impedance is computed directly in the frequency domain, the state of
+   * the device is not modified. An exception is thrown if a frequency is not
+   * greater than zero.
+   */
+  virtual std::vector<std::complex<double>>
+  compute_impedance(std::vector<double> const &frequencies) const = 0;
+
   /**
    * Factory function that creates an EnergyStorageDevice object.
    */
@@ -126,6 +162,14 @@ public:
   boost::mpi::communicator get_mpi_communicator() const;
 
 protected:
+  /**
+   * Return the angular frequencies \f$\omega = 2 \pi f\f$ associated with
+   * @p frequencies. Throw an exception if a frequency is not greater than
+   * zero.
+   */
+  static std::vector<double>
+  to_angular_frequencies(std::vector<double> const &frequencies);
+
   boost::mpi::communicator _communicator;
 
 private:
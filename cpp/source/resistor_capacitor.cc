@@ -9,6 +9,7 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <stdexcept>
@@ -19,6 +20,184 @@ namespace cap
 REGISTER_ENERGY_STORAGE_DEVICE(SeriesRC)
 REGISTER_ENERGY_STORAGE_DEVICE(ParallelRC)
 
+namespace internal
+{
+/**
+ * Return the current flowing through a resistance @p R in series with a
+ * capacitor at voltage @p U_C when the power @p P is imposed. This is the
+ * root of \f$ R I^2 + U_C I - P = 0 \f$ that vanishes with the power.
+ */
+double current_at_constant_power(double const R, double const U_C,
+                                 double const P)
+{
+  if (P == 0.0)
+    return 0.0;
+  return 2.0 * P / (U_C + std::copysign(std::sqrt(U_C * U_C + 4.0 * R * P),
+                                        U_C));
+}
+
+/**
+ * Return the load at the beginning of the time step, i.e. \f$ -U/I \f$. If
+ * the device is not discharging through a load, there is nothing to ramp from
+ * and @p load is returned so that the load is constant during the time step.
+ */
+double load_at_beginning_of_time_step(double const U, double const I,
+                                      double const load)
+{
+  double const previous_load = -U / I;
+  return (std::isfinite(previous_load) && (previous_load > 0.0))
+             ? previous_load
+             : load;
+}
+
+/**
+ * Return \f$ \log(1+x)/x \f$.
+ */
+double log1p_ratio(double const x)
+{
+  return (x == 0.0) ? 1.0 : std::log1p(x) / x;
+}
+
+/**
+ * Integrate \f$ y' = f(t, y) \f$ from \f$ t = 0 \f$ to @p delta_t using
+ * the embedded Runge-Kutta 5(4) pair of Dormand and Prince. The time step is
+ * only subdivided when the embedded error estimate requires it, so that
+ * smooth problems are integrated in a single step. The last stage of an
+ * accepted step is the first stage of the next one (first same as last), so a
+ * step costs six evaluations of @p f.
+ */
+template <typename Function>
+double integrate(Function const &f, double y, double const delta_t)
+{
+  double const ATOL = 1.0e-14;
+  double const RTOL = 1.0e-12;
+  std::size_t const MAXIT = 1000;
+  double t = 0.0;
+  double h = delta_t;
+  double k1 = f(t, y);
+  for (std::size_t it = 0; it < MAXIT; ++it)
+  {
+    bool const last = (h >= delta_t - t);
+    if (last)
+      h = delta_t - t;
+    double const k2 = f(t + h / 5.0, y + h * (k1 / 5.0));
+    double const k3 =
+        f(t + 3.0 * h / 10.0, y + h * (3.0 / 40.0 * k1 + 9.0 / 40.0 * k2));
+    double const k4 =
+        f(t + 4.0 * h / 5.0,
+          y + h * (44.0 / 45.0 * k1 - 56.0 / 15.0 * k2 + 32.0 / 9.0 * k3));
+    double const k5 =
+        f(t + 8.0 * h / 9.0,
+          y + h * (19372.0 / 6561.0 * k1 - 25360.0 / 2187.0 * k2 +
+                   64448.0 / 6561.0 * k3 - 212.0 / 729.0 * k4));
+    double const k6 =
+        f(t + h, y + h * (9017.0 / 3168.0 * k1 - 355.0 / 33.0 * k2 +
+                          46732.0 / 5247.0 * k3 + 49.0 / 176.0 * k4 -
+                          5103.0 / 18656.0 * k5));
+    double const y_new =
+        y + h * (35.0 / 384.0 * k1 + 500.0 / 1113.0 * k3 +
+                 125.0 / 192.0 * k4 - 2187.0 / 6784.0 * k5 + 11.0 / 84.0 * k6);
+    double const k7 = f(t + h, y_new);
+    double const error =
+        std::abs(h * (71.0 / 57600.0 * k1 - 71.0 / 16695.0 * k3 +
+                      71.0 / 1920.0 * k4 - 17253.0 / 339200.0 * k5 +
+                      22.0 / 525.0 * k6 - 1.0 / 40.0 * k7));
+    double const tolerance =
+        ATOL + RTOL * std::max(std::abs(y), std::abs(y_new));
+    if (std::isfinite(error) && (error <= tolerance))
+    {
+      if (last)
+        return y_new;
+      t += h;
+      y = y_new;
+      k1 = k7;
+    }
+    // Shrink the step if the error is not finite, e.g. when the power cannot
+    // be delivered by the device.
+    h *= std::isfinite(error)
+             ? std::min(5.0,
+                        std::max(0.2, 0.9 * std::pow(tolerance / error, 0.2)))
+             : 0.1;
+  }
+  throw std::runtime_error("Runge-Kutta integration fail to converge within " +
+                           std::to_string(MAXIT) + " steps");
+}
+
+/**
+ * State of a SeriesRC.
+ */
+class SeriesRCSnapshot : public EnergyStorageDeviceSnapshot
+{
+public:
+  SeriesRCSnapshot(SeriesRC const &rc)
+      : R(rc.R), C(rc.C), U_C(rc.U_C), U(rc.U), I(rc.I)
+  {
+  }
+
+  double const R;
+  double const C;
+  double const U_C;
+  double const U;
+  double const I;
+};
+
+/**
+ * State of a ParallelRC.
+ */
+class ParallelRCSnapshot : public EnergyStorageDeviceSnapshot
+{
+public:
+  ParallelRCSnapshot(ParallelRC const &rc)
+      : R_series(rc.R_series), R_parallel(rc.R_parallel), C(rc.C),
+        U_C(rc.U_C), U(rc.U), I(rc.I)
+  {
+  }
+
+  double const R_series;
+  double const R_parallel;
+  double const C;
+  double const U_C;
+  double const U;
+  double const I;
+};
+
+/**
+ * Cast @p snapshot to the snapshot type of the device restoring it.
+ */
+template <typename Snapshot>
+Snapshot const &cast_snapshot(EnergyStorageDeviceSnapshot const &snapshot)
+{
+  auto const *ptr = dynamic_cast<Snapshot const *>(&snapshot);
+  if (ptr == nullptr)
+    throw std::runtime_error(
+        "The snapshot was taken on a different type of device.");
+  return *ptr;
+}
+}
+
+NonlinearSolver to_nonlinear_solver(std::string const &method)
+{
+  if (method.compare("FIXED_POINT") == 0)
+    return NonlinearSolver::fixed_point;
+  else if (method.compare("NEWTON") == 0)
+    return NonlinearSolver::newton;
+  else
+    throw std::runtime_error("invalid method " + method);
+}
+
+std::string to_string(NonlinearSolver const solver)
+{
+  switch (solver)
+  {
+  case NonlinearSolver::fixed_point:
+    return "FIXED_POINT";
+  case NonlinearSolver::newton:
+    return "NEWTON";
+  default:
+    throw std::runtime_error("Unknown NonlinearSolver");
+  }
+}
+
 void ParallelRC::inspect(EnergyStorageDeviceInspector *inspector)
 {
   inspector->inspect(this);
@@ -90,23 +269,42 @@ void SeriesRC::evolve_one_time_step_linear_voltage(double const delta_t,
 void SeriesRC::evolve_one_time_step_linear_power(double const delta_t,
                                                  double const power)
 {
-  std::ignore = delta_t;
-  std::ignore = power;
-
-  throw std::runtime_error("This function is not implemented.");
+  double const power_begin = U * I;
+  double const power_slope = (power - power_begin) / delta_t;
+  U_C = internal::integrate(
+      [&](double const t, double const voltage) {
+        return internal::current_at_constant_power(
+                   R, voltage, power_begin + power_slope * t) /
+               C;
+      },
+      U_C, delta_t);
+  I = internal::current_at_constant_power(R, U_C, power);
+  U = R * I + U_C;
 }
 
 void SeriesRC::evolve_one_time_step_linear_load(double const delta_t,
                                                 double const load)
 {
-  std::ignore = delta_t;
-  std::ignore = load;
-
-  throw std::runtime_error("This function is not implemented.");
+  // The time constant C(R+load) is linear in time so the decay of the
+  // capacitor voltage is known in closed form.
+  double const load_begin =
+      internal::load_at_beginning_of_time_step(U, I, load);
+  U_C *= std::exp(-delta_t / ((R + load_begin) * C) *
+                  internal::log1p_ratio((load - load_begin) /
+                                        (R + load_begin)));
+  I = -U_C / (R + load);
+  U = U_C + R * I;
 }
 
 std::size_t SeriesRC::evolve_one_time_step_constant_power(
     double const delta_t, double const power, std::string const &method)
+{
+  return evolve_one_time_step_constant_power(delta_t, power,
+                                             to_nonlinear_solver(method));
+}
+
+std::size_t SeriesRC::evolve_one_time_step_constant_power(
+    double const delta_t, double const power, NonlinearSolver const method)
 {
   // TODO: if P is zero do constant current 0
   double const P = power;
@@ -114,22 +312,21 @@ std::size_t SeriesRC::evolve_one_time_step_constant_power(
   double const RTOL = 1.0e-14;
   std::size_t const MAXIT = 30;
   double const TOL = std::abs(P) * RTOL + ATOL;
+  double const R_eff = R + delta_t / C;
+  bool const newton = (method == NonlinearSolver::newton);
   std::size_t k = 0;
   while (true)
   {
     ++k;
     I = P / U;
-    if (method.compare("FIXED_POINT") == 0)
-      U = (R + delta_t / C) * I + U_C;
-    else if (method.compare("NEWTON") == 0)
-      U += ((R + delta_t / C) * P / U - U + U_C) /
-           ((R + delta_t / C) * P / (U * U) + 1.0);
+    if (newton)
+      U += (R_eff * P / U - U + U_C) / (R_eff * P / (U * U) + 1.0);
     else
-      throw std::runtime_error("invalid method " + method);
+      U = R_eff * I + U_C;
     if (std::abs(P - U * I) < TOL)
       break;
     if (k >= MAXIT)
-      throw std::runtime_error(method + " fail to converge within " +
+      throw std::runtime_error(to_string(method) + " fail to converge within " +
                                std::to_string(MAXIT) + " iterations");
   }
   U_C += I * delta_t / C;
@@ -146,6 +343,23 @@ void SeriesRC::save(const std::string &filename) const
   }
 }
 
+std::unique_ptr<EnergyStorageDeviceSnapshot> SeriesRC::snapshot() const
+{
+  return std::unique_ptr<EnergyStorageDeviceSnapshot>(
+      new internal::SeriesRCSnapshot(*this));
+}
+
+void SeriesRC::restore(EnergyStorageDeviceSnapshot const &snapshot)
+{
+  auto const &state =
+      internal::cast_snapshot<internal::SeriesRCSnapshot>(snapshot);
+  R = state.R;
+  C = state.C;
+  U_C = state.U_C;
+  U = state.U;
+  I = state.I;
+}
+
 void SeriesRC::load(const std::string &filename)
 {
   if (_comm.rank() == 0)
@@ -224,19 +438,33 @@ void ParallelRC::evolve_one_time_step_linear_voltage(double const delta_t,
 void ParallelRC::evolve_one_time_step_linear_power(double const delta_t,
                                                    double const power)
 {
-  std::ignore = delta_t;
-  std::ignore = power;
-
-  throw std::runtime_error("This function is not implemented.");
+  double const power_begin = U * I;
+  double const power_slope = (power - power_begin) / delta_t;
+  U_C = internal::integrate(
+      [&](double const t, double const voltage) {
+        return (internal::current_at_constant_power(
+                    R_series, voltage, power_begin + power_slope * t) -
+                voltage / R_parallel) /
+               C;
+      },
+      U_C, delta_t);
+  I = internal::current_at_constant_power(R_series, U_C, power);
+  U = R_series * I + U_C;
 }
 
 void ParallelRC::evolve_one_time_step_linear_load(double const delta_t,
                                                   double const load)
 {
-  std::ignore = delta_t;
-  std::ignore = load;
-
-  throw std::runtime_error("This function is not implemented.");
+  // Same as SeriesRC but the capacitor also discharges through the parallel
+  // resistance.
+  double const load_begin =
+      internal::load_at_beginning_of_time_step(U, I, load);
+  U_C *= std::exp(-delta_t / ((R_series + load_begin) * C) *
+                      internal::log1p_ratio((load - load_begin) /
+                                            (R_series + load_begin)) -
+                  delta_t / (R_parallel * C));
+  I = -U_C / (R_series + load);
+  U = U_C + R_series * I;
 }
 
 void ParallelRC::evolve_one_time_step_constant_load(double const delta_t,
@@ -256,6 +484,13 @@ void ParallelRC::evolve_one_time_step_constant_power(double const delta_t,
 
 std::size_t ParallelRC::evolve_one_time_step_constant_power(
     double const delta_t, double const power, std::string const &method)
+{
+  return evolve_one_time_step_constant_power(delta_t, power,
+                                             to_nonlinear_solver(method));
+}
+
+std::size_t ParallelRC::evolve_one_time_step_constant_power(
+    double const delta_t, double const power, NonlinearSolver const method)
 {
   // TODO: if P is zero do constant current 0
   double const P = power;
@@ -263,29 +498,26 @@ std::size_t ParallelRC::evolve_one_time_step_constant_power(
   double const RTOL = 1.0e-14;
   std::size_t const MAXIT = 30;
   double const TOL = std::abs(P) * RTOL + ATOL;
+  // Neither the decay of the capacitor voltage nor the effective resistance
+  // depend on the iterate. expm1 avoids the cancellation in 1 - exp when the
+  // parallel resistance is large.
+  double const decay_m1 = std::expm1(-delta_t / (R_parallel * C));
+  double const decay = 1.0 + decay_m1;
+  double const R_eff = R_series - R_parallel * decay_m1;
+  bool const newton = (method == NonlinearSolver::newton);
   std::size_t k = 0;
   while (true)
   {
     ++k;
     I = P / U;
-    if (method.compare("FIXED_POINT") == 0)
-      U = (R_series + R_parallel) * I +
-          (U_C - R_parallel * I) * std::exp(-delta_t / (R_parallel * C));
-    else if (method.compare("NEWTON") == 0)
-      U += ((R_series +
-             R_parallel * (1.0 - std::exp(-delta_t / (R_parallel * C)))) *
-                P / U -
-            U + U_C * std::exp(-delta_t / (R_parallel * C))) /
-           ((R_series +
-             R_parallel * (1.0 - std::exp(-delta_t / (R_parallel * C)))) *
-                P / (U * U) +
-            1.0);
+    if (newton)
+      U += (R_eff * P / U - U + U_C * decay) / (R_eff * P / (U * U) + 1.0);
     else
-      throw std::runtime_error("invalid method " + method);
+      U = (R_series + R_parallel) * I + (U_C - R_parallel * I) * decay;
     if (std::abs(P - U * I) < TOL)
       break;
     if (k >= MAXIT)
-      throw std::runtime_error(method + " fail to converge within " +
+      throw std::runtime_error(to_string(method) + " fail to converge within " +
                                std::to_string(MAXIT) + " iterations");
   }
   U_C = U - R_series * I;
@@ -302,6 +534,24 @@ void ParallelRC::save(const std::string &filename) const
   }
 }
 
+std::unique_ptr<EnergyStorageDeviceSnapshot> ParallelRC::snapshot() const
+{
+  return std::unique_ptr<EnergyStorageDeviceSnapshot>(
+      new internal::ParallelRCSnapshot(*this));
+}
+
+void ParallelRC::restore(EnergyStorageDeviceSnapshot const &snapshot)
+{
+  auto const &state =
+      internal::cast_snapshot<internal::ParallelRCSnapshot>(snapshot);
+  R_series = state.R_series;
+  R_parallel = state.R_parallel;
+  C = state.C;
+  U_C = state.U_C;
+  U = state.U;
+  I = state.I;
+}
+
 void ParallelRC::load(const std::string &filename)
 {
   if (_comm.rank() == 0)
@@ -318,4 +568,26 @@ void ParallelRC::load(const std::string &filename)
   }
 }
 
+std::vector<std::complex<double>>
+SeriesRC::compute_impedance(std::vector<double> const &frequencies) const
+{
+  std::vector<std::complex<double>> impedance;
+  impedance.reserve(frequencies.size());
+  for (double const omega : to_angular_frequencies(frequencies))
+    impedance.push_back(R + 1. / std::complex<double>(0., omega * C));
+  return impedance;
+}
+
+std::vector<std::complex<double>>
+ParallelRC::compute_impedance(std::vector<double> const &frequencies) const
+{
+  std::vector<std::complex<double>> impedance;
+  impedance.reserve(frequencies.size());
+  for (double const omega : to_angular_frequencies(frequencies))
+    impedance.push_back(R_series +
+                        R_parallel /
+                            std::complex<double>(1., omega * R_parallel * C));
+  return impedance;
+}
+
 } // end namespace
@@ -17,6 +17,27 @@
 namespace cap
 {
 
+/**
+ * Non-linear solver used to advance the RC circuits when the power is
+ * imposed.
+ */
+enum class NonlinearSolver
+{
+  fixed_point,
+  newton
+};
+
+/**
+ * Convert FIXED_POINT or NEWTON to the corresponding NonlinearSolver. An
+ * exception is thrown for any other string.
+ */
+NonlinearSolver to_nonlinear_solver(std::string const &method);
+
+/**
+ * Return the string corresponding to @p solver.
+ */
+std::string to_string(NonlinearSolver const solver);
+
 class SeriesRC : public EnergyStorageDevice
 {
 public:
@@ -44,13 +65,17 @@ public:
                                            double const voltage) override;
 
   /**
-   * This function is not implemented and throws an exception.
+   * The power ramps from \f$ UI \f$ to @p power during the time step. The
+   * voltage of the capacitor is integrated with an embedded Runge-Kutta
+   * method that only subdivides the time step when it is needed.
    */
   void evolve_one_time_step_linear_power(double const delta_t,
                                          double const power) override;
 
   /**
-   * This function is not implemented and throws an exception.
+   * The load ramps from \f$ -U/I \f$ to @p load during the time step and
+   * the solution is computed in closed form. If the device is not
+   * discharging, the load is constant during the time step.
    */
   void evolve_one_time_step_linear_load(double const delta_t,
                                         double const load) override;
@@ -71,6 +96,15 @@ public:
   evolve_one_time_step_constant_power(double const delta_t, double const power,
                                       std::string const &method = "NEWTON");
 
+  /**
+   * Same as above but the non-linear solver is given by @p method. The
+   * string is only converted once so this is the overload to use when
+   * advancing the circuit over many time steps.
+   */
+  std::size_t
+  evolve_one_time_step_constant_power(double const delta_t, double const power,
+                                      NonlinearSolver const method);
+
   /**
    * Save the current state of energy device in a file.
    */
@@ -81,6 +115,16 @@ public:
    */
   void load(const std::string &filename) override;
 
+  std::unique_ptr<EnergyStorageDeviceSnapshot> snapshot() const override;
+
+  void restore(EnergyStorageDeviceSnapshot const &snapshot) override;
+
+  /**
+   * \f$Z = R + 1/(i \omega C)\f$
+   */
+  std::vector<std::complex<double>>
+  compute_impedance(std::vector<double> const &frequencies) const override;
+
   // TODO: make these variables private
   double R;
   double C;
@@ -128,13 +172,17 @@ public:
                                            double const voltage) override;
 
   /**
-   * This function is not implemented and throws an exception.
+   * The power ramps from \f$ UI \f$ to @p power during the time step. The
+   * voltage of the capacitor is integrated with an embedded Runge-Kutta
+   * method that only subdivides the time step when it is needed.
    */
   void evolve_one_time_step_linear_power(double const delta_t,
                                          double const power) override;
 
   /**
-   * This function is not implemented and throws an exception.
+   * The load ramps from \f$ -U/I \f$ to @p load during the time step and
+   * the solution is computed in closed form. If the device is not
+   * discharging, the load is constant during the time step.
    */
   void evolve_one_time_step_linear_load(double const delta_t,
                                         double const load) override;
@@ -155,6 +203,15 @@ public:
   evolve_one_time_step_constant_power(double const delta_t, double const power,
                                       std::string const &method = "NEWTON");
 
+  /**
+   * Same as above but the non-linear solver is given by @p method. The
+   * string is only converted once so this is the overload to use when
+   * advancing the circuit over many time steps.
+   */
+  std::size_t
+  evolve_one_time_step_constant_power(double const delta_t, double const power,
+                                      NonlinearSolver const method);
+
   /**
    * Save the current state of energy device in a file.
    */
@@ -165,6 +222,16 @@ public:
    */
   void load(const std::string &filename) override;
 
+  std::unique_ptr<EnergyStorageDeviceSnapshot> snapshot() const override;
+
+  void restore(EnergyStorageDeviceSnapshot const &snapshot) override;
+
+  /**
+   * \f$Z = R_{series} + R_{parallel}/(1 + i \omega R_{parallel} C)\f$
+   */
+  std::vector<std::complex<double>>
+  compute_impedance(std::vector<double> const &frequencies) const override;
+
   // TODO: make these variables private
   double R_series;
   double R_parallel;
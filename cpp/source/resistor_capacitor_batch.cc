@@ -0,0 +1,549 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/resistor_capacitor_batch.h>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+namespace internal
+{
+void check_size(std::vector<double> const &values, std::size_t const n)
+{
+  if (values.size() != n)
+    throw std::runtime_error("Expected " + std::to_string(n) +
+                             " values but got " +
+                             std::to_string(values.size()));
+}
+
+/**
+ * Operating condition shared by all the circuits of a batch.
+ */
+class UniformControl
+{
+public:
+  UniformControl(double const value) : _value(value) {}
+
+  double operator[](std::size_t const) const { return _value; }
+
+private:
+  double const _value;
+};
+
+/**
+ * Operating condition given for each circuit of a batch.
+ */
+class VectorControl
+{
+public:
+  VectorControl(std::vector<double> const &values, std::size_t const n)
+      : _values(values.data())
+  {
+    check_size(values, n);
+  }
+
+  double operator[](std::size_t const k) const { return _values[k]; }
+
+private:
+  double const *const _values;
+};
+
+double const ATOL = 1.0e-14;
+double const RTOL = 1.0e-14;
+std::size_t const MAXIT = 30;
+
+/**
+ * Solve \f$ P = UI \f$ with \f$ U = R_{eff} I + U_{oc} \f$ for all the
+ * circuits of a batch. The voltage is initialized with the root of
+ * \f$ U^2 - U_{oc} U - R_{eff} P = 0 \f$ that has the same sign as the
+ * current voltage @p U and then Newton sweeps are performed over the whole
+ * batch. The loops do not branch on the circuit: the circuits that have
+ * converged keep their values and are only counted. The solution is written
+ * in @p U_new and @p I_new. An exception is thrown if the power exceeds the
+ * maximum power transfer of some circuits or if some circuits have not
+ * converged after MAXIT sweeps. @p U is never modified so that the state of
+ * the batch is unchanged when the solver throws.
+ */
+template <typename Control>
+void solve_constant_power(std::size_t const n, Control const &power,
+                          double const *R_eff, double const *U_oc,
+                          double const *U, double *U_new, double *I_new,
+                          unsigned char *converged)
+{
+  std::size_t n_invalid = 0;
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    double const discriminant =
+        U_oc[k] * U_oc[k] + 4.0 * R_eff[k] * power[k];
+    n_invalid += (discriminant < 0.0);
+    U_new[k] = 0.5 * (U_oc[k] + std::copysign(std::sqrt(discriminant), U[k]));
+    converged[k] = 0;
+  }
+  if (n_invalid > 0)
+    throw std::runtime_error(
+        "The power exceeds the maximum power transfer of " +
+        std::to_string(n_invalid) + " circuits");
+  for (std::size_t it = 1;; ++it)
+  {
+    std::size_t n_converged = 0;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+      double const P = power[k];
+      double const I_k = P / U_new[k];
+      double const U_k =
+          U_new[k] + (R_eff[k] * I_k - U_new[k] + U_oc[k]) /
+                         (R_eff[k] * I_k / U_new[k] + 1.0);
+      bool const done = converged[k] != 0;
+      I_new[k] = done ? I_new[k] : I_k;
+      U_new[k] = done ? U_new[k] : U_k;
+      converged[k] =
+          done || (std::abs(P - U_k * I_k) < std::abs(P) * RTOL + ATOL);
+      n_converged += converged[k];
+    }
+    if (n_converged == n)
+      return;
+    if (it >= MAXIT)
+      throw std::runtime_error("NEWTON fail to converge within " +
+                               std::to_string(MAXIT) + " iterations for " +
+                               std::to_string(n - n_converged) + " circuits");
+  }
+}
+}
+
+//------------------------------------------------------------------
+
+SeriesRCBatch::SeriesRCBatch(std::size_t const n,
+                             boost::property_tree::ptree const &ptree)
+    : R(n, ptree.get<double>("series_resistance")),
+      C(n, ptree.get<double>("capacitance")),
+      U_C(n, ptree.get<double>("initial_voltage", 0.0)), U(U_C), I(n, 0.0),
+      _delta_t(std::numeric_limits<double>::quiet_NaN()), _expm1(n),
+      _R_eff(n), _U_new(n), _I_new(n), _converged(n)
+{
+}
+
+SeriesRCBatch::SeriesRCBatch(std::vector<double> const &series_resistance,
+                             std::vector<double> const &capacitance,
+                             std::vector<double> const &initial_voltage)
+    : R(series_resistance), C(capacitance), U_C(initial_voltage), U(U_C),
+      I(U_C.size(), 0.0), _delta_t(std::numeric_limits<double>::quiet_NaN()),
+      _expm1(U_C.size()), _R_eff(U_C.size()), _U_new(U_C.size()),
+      _I_new(U_C.size()), _converged(U_C.size())
+{
+  internal::check_size(R, size());
+  internal::check_size(C, size());
+}
+
+std::size_t SeriesRCBatch::size() const { return U.size(); }
+
+void SeriesRCBatch::update_factors(double const delta_t)
+{
+  if (delta_t == _delta_t)
+    return;
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    _expm1[k] = std::expm1(-delta_t / (R[k] * C[k]));
+    _R_eff[k] = R[k] + delta_t / C[k];
+  }
+  _delta_t = delta_t;
+}
+
+template <typename Control>
+void SeriesRCBatch::constant_current(double const delta_t,
+                                     Control const &current)
+{
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] += current[k] * delta_t / C[k];
+    I[k] = current[k];
+    U[k] = R[k] * I[k] + U_C[k];
+  }
+}
+
+template <typename Control>
+void SeriesRCBatch::constant_voltage(double const delta_t,
+                                     Control const &voltage)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] -= (voltage[k] - U_C[k]) * _expm1[k];
+    U[k] = voltage[k];
+    I[k] = (U[k] - U_C[k]) / R[k];
+  }
+}
+
+template <typename Control>
+void SeriesRCBatch::constant_power(double const delta_t, Control const &power)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  internal::solve_constant_power(n, power, _R_eff.data(), U_C.data(),
+                                 U.data(), _U_new.data(), _I_new.data(),
+                                 _converged.data());
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U[k] = _U_new[k];
+    I[k] = _I_new[k];
+    U_C[k] += I[k] * delta_t / C[k];
+  }
+}
+
+template <typename Control>
+void SeriesRCBatch::constant_load(double const delta_t, Control const &load)
+{
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] *= std::exp(-delta_t / ((R[k] + load[k]) * C[k]));
+    I[k] = -U_C[k] / (R[k] + load[k]);
+    U[k] = U_C[k] + R[k] * I[k];
+  }
+}
+
+template <typename Control>
+void SeriesRCBatch::linear_current(double const delta_t,
+                                   Control const &current)
+{
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] += (I[k] + current[k]) * 0.5 * delta_t / C[k];
+    I[k] = current[k];
+    U[k] = R[k] * I[k] + U_C[k];
+  }
+}
+
+template <typename Control>
+void SeriesRCBatch::linear_voltage(double const delta_t,
+                                   Control const &voltage)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] -= (U[k] - U_C[k]) * _expm1[k];
+    U_C[k] +=
+        (voltage[k] - U[k]) / delta_t * (delta_t + R[k] * C[k] * _expm1[k]);
+    U[k] = voltage[k];
+    I[k] = (U[k] - U_C[k]) / R[k];
+  }
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_current(double const delta_t,
+                                                          double const current)
+{
+  constant_current(delta_t, internal::UniformControl(current));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_current(
+    double const delta_t, std::vector<double> const &current)
+{
+  constant_current(delta_t, internal::VectorControl(current, size()));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_voltage(double const delta_t,
+                                                          double const voltage)
+{
+  constant_voltage(delta_t, internal::UniformControl(voltage));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_voltage(
+    double const delta_t, std::vector<double> const &voltage)
+{
+  constant_voltage(delta_t, internal::VectorControl(voltage, size()));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_power(double const delta_t,
+                                                        double const power)
+{
+  constant_power(delta_t, internal::UniformControl(power));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_power(
+    double const delta_t, std::vector<double> const &power)
+{
+  constant_power(delta_t, internal::VectorControl(power, size()));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_load(double const delta_t,
+                                                       double const load)
+{
+  constant_load(delta_t, internal::UniformControl(load));
+}
+
+void SeriesRCBatch::evolve_one_time_step_constant_load(
+    double const delta_t, std::vector<double> const &load)
+{
+  constant_load(delta_t, internal::VectorControl(load, size()));
+}
+
+void SeriesRCBatch::evolve_one_time_step_linear_current(double const delta_t,
+                                                        double const current)
+{
+  linear_current(delta_t, internal::UniformControl(current));
+}
+
+void SeriesRCBatch::evolve_one_time_step_linear_current(
+    double const delta_t, std::vector<double> const &current)
+{
+  linear_current(delta_t, internal::VectorControl(current, size()));
+}
+
+void SeriesRCBatch::evolve_one_time_step_linear_voltage(double const delta_t,
+                                                        double const voltage)
+{
+  linear_voltage(delta_t, internal::UniformControl(voltage));
+}
+
+void SeriesRCBatch::evolve_one_time_step_linear_voltage(
+    double const delta_t, std::vector<double> const &voltage)
+{
+  linear_voltage(delta_t, internal::VectorControl(voltage, size()));
+}
+
+//------------------------------------------------------------------
+
+ParallelRCBatch::ParallelRCBatch(std::size_t const n,
+                                 boost::property_tree::ptree const &ptree)
+    : R_series(n, ptree.get<double>("series_resistance")),
+      R_parallel(n, ptree.get<double>("parallel_resistance")),
+      C(n, ptree.get<double>("capacitance")),
+      U_C(n, ptree.get<double>("initial_voltage", 0.0)), U(n), I(n),
+      _delta_t(std::numeric_limits<double>::quiet_NaN()), _parallel_expm1(n),
+      _expm1(n), _R_eff(n), _open_circuit_voltage(n), _U_new(n), _I_new(n),
+      _converged(n)
+{
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U[k] = (R_series[k] + R_parallel[k]) / R_parallel[k] * U_C[k];
+    I[k] = U[k] / (R_series[k] + R_parallel[k]);
+  }
+}
+
+ParallelRCBatch::ParallelRCBatch(
+    std::vector<double> const &series_resistance,
+    std::vector<double> const &parallel_resistance,
+    std::vector<double> const &capacitance,
+    std::vector<double> const &initial_voltage)
+    : R_series(series_resistance), R_parallel(parallel_resistance),
+      C(capacitance), U_C(initial_voltage), U(U_C.size()), I(U_C.size()),
+      _delta_t(std::numeric_limits<double>::quiet_NaN()),
+      _parallel_expm1(U_C.size()), _expm1(U_C.size()), _R_eff(U_C.size()),
+      _open_circuit_voltage(U_C.size()), _U_new(U_C.size()),
+      _I_new(U_C.size()), _converged(U_C.size())
+{
+  std::size_t const n = size();
+  internal::check_size(R_series, n);
+  internal::check_size(R_parallel, n);
+  internal::check_size(C, n);
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U[k] = (R_series[k] + R_parallel[k]) / R_parallel[k] * U_C[k];
+    I[k] = U[k] / (R_series[k] + R_parallel[k]);
+  }
+}
+
+std::size_t ParallelRCBatch::size() const { return U.size(); }
+
+void ParallelRCBatch::update_factors(double const delta_t)
+{
+  if (delta_t == _delta_t)
+    return;
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    _parallel_expm1[k] = std::expm1(-delta_t / (R_parallel[k] * C[k]));
+    _expm1[k] = std::expm1(-delta_t * (R_series[k] + R_parallel[k]) /
+                           (R_series[k] * R_parallel[k] * C[k]));
+    _R_eff[k] = R_series[k] - R_parallel[k] * _parallel_expm1[k];
+  }
+  _delta_t = delta_t;
+}
+
+template <typename Control>
+void ParallelRCBatch::constant_current(double const delta_t,
+                                       Control const &current)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] = R_parallel[k] * current[k] +
+             (U_C[k] - R_parallel[k] * current[k]) *
+                 (1.0 + _parallel_expm1[k]);
+    I[k] = current[k];
+    U[k] = R_series[k] * I[k] + U_C[k];
+  }
+}
+
+template <typename Control>
+void ParallelRCBatch::constant_voltage(double const delta_t,
+                                       Control const &voltage)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U_C[k] -= (voltage[k] * R_parallel[k] / (R_series[k] + R_parallel[k]) -
+               U_C[k]) *
+              _expm1[k];
+    U[k] = voltage[k];
+    I[k] = (U[k] - U_C[k]) / R_series[k];
+  }
+}
+
+template <typename Control>
+void ParallelRCBatch::constant_power(double const delta_t,
+                                     Control const &power)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+    _open_circuit_voltage[k] = U_C[k] * (1.0 + _parallel_expm1[k]);
+  internal::solve_constant_power(n, power, _R_eff.data(),
+                                 _open_circuit_voltage.data(), U.data(),
+                                 _U_new.data(), _I_new.data(),
+                                 _converged.data());
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    U[k] = _U_new[k];
+    I[k] = _I_new[k];
+    U_C[k] = U[k] - R_series[k] * I[k];
+  }
+}
+
+template <typename Control>
+void ParallelRCBatch::constant_load(double const delta_t, Control const &load)
+{
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    double const R_load = R_series[k] + load[k];
+    U_C[k] *= std::exp(-delta_t * (1.0 + R_load / R_parallel[k]) /
+                       (R_load * C[k]));
+    I[k] = -U_C[k] / R_load;
+    U[k] = U_C[k] + R_series[k] * I[k];
+  }
+}
+
+template <typename Control>
+void ParallelRCBatch::linear_current(double const delta_t,
+                                     Control const &current)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    double const tau = R_parallel[k] * C[k];
+    U_C[k] = R_parallel[k] * I[k] +
+             (U_C[k] - R_parallel[k] * I[k]) * (1.0 + _parallel_expm1[k]);
+    U_C[k] += R_parallel[k] * (current[k] - I[k]) / delta_t *
+              (delta_t + tau * _parallel_expm1[k]);
+    I[k] = current[k];
+    U[k] = R_series[k] * I[k] + U_C[k];
+  }
+}
+
+template <typename Control>
+void ParallelRCBatch::linear_voltage(double const delta_t,
+                                     Control const &voltage)
+{
+  update_factors(delta_t);
+  std::size_t const n = size();
+  for (std::size_t k = 0; k < n; ++k)
+  {
+    double const R_sum = R_series[k] + R_parallel[k];
+    double const tau = R_series[k] * R_parallel[k] * C[k] / R_sum;
+    U_C[k] -= (U[k] * R_parallel[k] / R_sum - U_C[k]) * _expm1[k];
+    U_C[k] += (voltage[k] - U[k]) / delta_t * R_parallel[k] / R_sum *
+              (delta_t + tau * _expm1[k]);
+    U[k] = voltage[k];
+    I[k] = (U[k] - U_C[k]) / R_series[k];
+  }
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_current(
+    double const delta_t, double const current)
+{
+  constant_current(delta_t, internal::UniformControl(current));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_current(
+    double const delta_t, std::vector<double> const &current)
+{
+  constant_current(delta_t, internal::VectorControl(current, size()));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_voltage(
+    double const delta_t, double const voltage)
+{
+  constant_voltage(delta_t, internal::UniformControl(voltage));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_voltage(
+    double const delta_t, std::vector<double> const &voltage)
+{
+  constant_voltage(delta_t, internal::VectorControl(voltage, size()));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_power(double const delta_t,
+                                                          double const power)
+{
+  constant_power(delta_t, internal::UniformControl(power));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_power(
+    double const delta_t, std::vector<double> const &power)
+{
+  constant_power(delta_t, internal::VectorControl(power, size()));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_load(double const delta_t,
+                                                         double const load)
+{
+  constant_load(delta_t, internal::UniformControl(load));
+}
+
+void ParallelRCBatch::evolve_one_time_step_constant_load(
+    double const delta_t, std::vector<double> const &load)
+{
+  constant_load(delta_t, internal::VectorControl(load, size()));
+}
+
+void ParallelRCBatch::evolve_one_time_step_linear_current(double const delta_t,
+                                                          double const current)
+{
+  linear_current(delta_t, internal::UniformControl(current));
+}
+
+void ParallelRCBatch::evolve_one_time_step_linear_current(
+    double const delta_t, std::vector<double> const &current)
+{
+  linear_current(delta_t, internal::VectorControl(current, size()));
+}
+
+void ParallelRCBatch::evolve_one_time_step_linear_voltage(double const delta_t,
+                                                          double const voltage)
+{
+  linear_voltage(delta_t, internal::UniformControl(voltage));
+}
+
+void ParallelRCBatch::evolve_one_time_step_linear_voltage(
+    double const delta_t, std::vector<double> const &voltage)
+{
+  linear_voltage(delta_t, internal::VectorControl(voltage, size()));
+}
+
+} // end namespace cap
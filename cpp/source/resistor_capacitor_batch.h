@@ -0,0 +1,280 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_RESISTOR_CAPACITOR_BATCH_H
+#define CAP_RESISTOR_CAPACITOR_BATCH_H
+
+#include <boost/property_tree/ptree.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace cap
+{
+
+/**
+ * Batch of series RC circuits. Instead of building one SeriesRC object per
+ * circuit, the resistance, the capacitance, and the state of all the circuits
+ * are stored in contiguous arrays (structure of arrays) and all the circuits
+ * are advanced in time by a single call. The updates are the same as the ones
+ * of SeriesRC.
+ *
+ * The operating condition can be the same for all the circuits or it can be
+ * given for each circuit. The exponential factors only depend on the time
+ * step and on the parameters of the circuits, which cannot be modified, so
+ * they are only recomputed when the time step changes.
+ *
+ * When the power is imposed, the voltage of every circuit is initialized with
+ * the root of the quadratic power equation and all the circuits are then
+ * polished together by Newton sweeps over the whole batch. The circuits that
+ * have converged are masked out of the following sweeps.
+ */
+class SeriesRCBatch
+{
+public:
+  /**
+   * Build @p n identical circuits. The parameters are read from @p ptree using
+   * the same keys as SeriesRC.
+   */
+  SeriesRCBatch(std::size_t const n, boost::property_tree::ptree const &ptree);
+
+  /**
+   * Build one circuit per entry of @p series_resistance, @p capacitance, and
+   * @p initial_voltage.
+   */
+  SeriesRCBatch(std::vector<double> const &series_resistance,
+                std::vector<double> const &capacitance,
+                std::vector<double> const &initial_voltage);
+
+  /**
+   * Return the number of circuits.
+   */
+  std::size_t size() const;
+
+  void evolve_one_time_step_constant_current(double const delta_t,
+                                             double const current);
+
+  void
+  evolve_one_time_step_constant_current(double const delta_t,
+                                        std::vector<double> const &current);
+
+  void evolve_one_time_step_constant_voltage(double const delta_t,
+                                             double const voltage);
+
+  void
+  evolve_one_time_step_constant_voltage(double const delta_t,
+                                        std::vector<double> const &voltage);
+
+  void evolve_one_time_step_constant_power(double const delta_t,
+                                           double const power);
+
+  void evolve_one_time_step_constant_power(double const delta_t,
+                                           std::vector<double> const &power);
+
+  void evolve_one_time_step_constant_load(double const delta_t,
+                                          double const load);
+
+  void evolve_one_time_step_constant_load(double const delta_t,
+                                          std::vector<double> const &load);
+
+  void evolve_one_time_step_linear_current(double const delta_t,
+                                           double const current);
+
+  void evolve_one_time_step_linear_current(double const delta_t,
+                                           std::vector<double> const &current);
+
+  void evolve_one_time_step_linear_voltage(double const delta_t,
+                                           double const voltage);
+
+  void evolve_one_time_step_linear_voltage(double const delta_t,
+                                           std::vector<double> const &voltage);
+
+  std::vector<double> const R;
+  std::vector<double> const C;
+  // The arrays are public so that they can be shared with numpy as views.
+  std::vector<double> U_C;
+  std::vector<double> U;
+  std::vector<double> I;
+
+private:
+  /**
+   * Compute the exponential factors if @p delta_t is different from the time
+   * step used to compute them previously.
+   */
+  void update_factors(double const delta_t);
+
+  template <typename Control>
+  void constant_current(double const delta_t, Control const &current);
+
+  template <typename Control>
+  void constant_voltage(double const delta_t, Control const &voltage);
+
+  template <typename Control>
+  void constant_power(double const delta_t, Control const &power);
+
+  template <typename Control>
+  void constant_load(double const delta_t, Control const &load);
+
+  template <typename Control>
+  void linear_current(double const delta_t, Control const &current);
+
+  template <typename Control>
+  void linear_voltage(double const delta_t, Control const &voltage);
+
+  double _delta_t;
+  /**
+   * \f$ \exp(-\Delta t/(RC)) - 1 \f$
+   */
+  std::vector<double> _expm1;
+  /**
+   * \f$ R + \Delta t/C \f$
+   */
+  std::vector<double> _R_eff;
+  /**
+   * Solution of the constant power solver. It is copied to U and I only when
+   * the solver has converged.
+   */
+  std::vector<double> _U_new;
+  std::vector<double> _I_new;
+  /**
+   * Convergence flags of the constant power solver.
+   */
+  std::vector<unsigned char> _converged;
+};
+
+/**
+ * Batch of parallel RC circuits. This is the structure of arrays counterpart
+ * of ParallelRC.
+ */
+class ParallelRCBatch
+{
+public:
+  /**
+   * Build @p n identical circuits. The parameters are read from @p ptree using
+   * the same keys as ParallelRC.
+   */
+  ParallelRCBatch(std::size_t const n,
+                  boost::property_tree::ptree const &ptree);
+
+  /**
+   * Build one circuit per entry of @p series_resistance, @p
+   * parallel_resistance, @p capacitance, and @p initial_voltage.
+   */
+  ParallelRCBatch(std::vector<double> const &series_resistance,
+                  std::vector<double> const &parallel_resistance,
+                  std::vector<double> const &capacitance,
+                  std::vector<double> const &initial_voltage);
+
+  /**
+   * Return the number of circuits.
+   */
+  std::size_t size() const;
+
+  void evolve_one_time_step_constant_current(double const delta_t,
+                                             double const current);
+
+  void
+  evolve_one_time_step_constant_current(double const delta_t,
+                                        std::vector<double> const &current);
+
+  void evolve_one_time_step_constant_voltage(double const delta_t,
+                                             double const voltage);
+
+  void
+  evolve_one_time_step_constant_voltage(double const delta_t,
+                                        std::vector<double> const &voltage);
+
+  void evolve_one_time_step_constant_power(double const delta_t,
+                                           double const power);
+
+  void evolve_one_time_step_constant_power(double const delta_t,
+                                           std::vector<double> const &power);
+
+  void evolve_one_time_step_constant_load(double const delta_t,
+                                          double const load);
+
+  void evolve_one_time_step_constant_load(double const delta_t,
+                                          std::vector<double> const &load);
+
+  void evolve_one_time_step_linear_current(double const delta_t,
+                                           double const current);
+
+  void evolve_one_time_step_linear_current(double const delta_t,
+                                           std::vector<double> const &current);
+
+  void evolve_one_time_step_linear_voltage(double const delta_t,
+                                           double const voltage);
+
+  void evolve_one_time_step_linear_voltage(double const delta_t,
+                                           std::vector<double> const &voltage);
+
+  std::vector<double> const R_series;
+  std::vector<double> const R_parallel;
+  std::vector<double> const C;
+  // The arrays are public so that they can be shared with numpy as views.
+  std::vector<double> U_C;
+  std::vector<double> U;
+  std::vector<double> I;
+
+private:
+  /**
+   * Compute the exponential factors if @p delta_t is different from the time
+   * step used to compute them previously.
+   */
+  void update_factors(double const delta_t);
+
+  template <typename Control>
+  void constant_current(double const delta_t, Control const &current);
+
+  template <typename Control>
+  void constant_voltage(double const delta_t, Control const &voltage);
+
+  template <typename Control>
+  void constant_power(double const delta_t, Control const &power);
+
+  template <typename Control>
+  void constant_load(double const delta_t, Control const &load);
+
+  template <typename Control>
+  void linear_current(double const delta_t, Control const &current);
+
+  template <typename Control>
+  void linear_voltage(double const delta_t, Control const &voltage);
+
+  double _delta_t;
+  /**
+   * \f$ \exp(-\Delta t/(R_{parallel}C)) - 1 \f$
+   */
+  std::vector<double> _parallel_expm1;
+  /**
+   * \f$ \exp(-\Delta t/\tau) - 1 \f$ with
+   * \f$ \tau = R_{series}R_{parallel}C/(R_{series}+R_{parallel}) \f$
+   */
+  std::vector<double> _expm1;
+  /**
+   * \f$ R_{series} + R_{parallel}(1-\exp(-\Delta t/(R_{parallel}C))) \f$
+   */
+  std::vector<double> _R_eff;
+  /**
+   * Voltage of the capacitors at the end of the time step if no current
+   * flowed through the circuits.
+   */
+  std::vector<double> _open_circuit_voltage;
+  /**
+   * Solution of the constant power solver. It is copied to U and I only when
+   * the solver has converged.
+   */
+  std::vector<double> _U_new;
+  std::vector<double> _I_new;
+  /**
+   * Convergence flags of the constant power solver.
+   */
+  std::vector<unsigned char> _converged;
+};
+
+} // end namespace cap
+
+#endif // CAP_RESISTOR_CAPACITOR_BATCH_H
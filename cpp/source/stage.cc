@@ -0,0 +1,232 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/stage.h>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace cap
+{
+
+void CyclingData::reserve(std::size_t const n)
+{
+  time.reserve(time.size() + n);
+  current.reserve(current.size() + n);
+  voltage.reserve(voltage.size() + n);
+}
+
+void CyclingData::report(double const t, EnergyStorageDevice const &device)
+{
+  double i;
+  double u;
+  device.get_current(i);
+  device.get_voltage(u);
+  time.push_back(t);
+  current.push_back(i);
+  voltage.push_back(u);
+}
+
+std::size_t CyclingData::size() const { return time.size(); }
+
+TimeEvolution build_time_evolution(boost::property_tree::ptree const &ptree)
+{
+  std::string const mode = ptree.get<std::string>("mode");
+  if ((mode == "constant_voltage") || (mode == "potentiostatic"))
+  {
+    double const voltage = ptree.get<double>("voltage");
+    return [voltage](EnergyStorageDevice &device, double time_step)
+    {
+      device.evolve_one_time_step_constant_voltage(time_step, voltage);
+    };
+  }
+  else if ((mode == "constant_current") || (mode == "galvanostatic"))
+  {
+    double const current = ptree.get<double>("current");
+    return [current](EnergyStorageDevice &device, double time_step)
+    {
+      device.evolve_one_time_step_constant_current(time_step, current);
+    };
+  }
+  else if (mode == "constant_power")
+  {
+    double const power = ptree.get<double>("power");
+    return [power](EnergyStorageDevice &device, double time_step)
+    {
+      device.evolve_one_time_step_constant_power(time_step, power);
+    };
+  }
+  else if (mode == "constant_load")
+  {
+    double const load = ptree.get<double>("load");
+    return [load](EnergyStorageDevice &device, double time_step)
+    {
+      device.evolve_one_time_step_constant_load(time_step, load);
+    };
+  }
+  else if (mode == "hold")
+  {
+    return [](EnergyStorageDevice &device, double time_step)
+    {
+      double voltage;
+      device.get_voltage(voltage);
+      device.evolve_one_time_step_constant_voltage(time_step, voltage);
+    };
+  }
+  else if (mode == "rest")
+  {
+    return [](EnergyStorageDevice &device, double time_step)
+    {
+      device.evolve_one_time_step_constant_current(time_step, 0.);
+    };
+  }
+  else
+    throw std::runtime_error("invalid TimeEvolution mode '" + mode + "'");
+}
+
+Stage::Stage(boost::property_tree::ptree const &ptree)
+    : _evolve_one_time_step(build_time_evolution(ptree)),
+      _end_criterion(EndCriterion::build(ptree)),
+      _time_step(ptree.get<double>("time_step"))
+{
+  if (!(_time_step > 0.))
+    throw std::runtime_error("time_step should be positive");
+  if (ptree.get_child_optional("adaptive_time_stepping"))
+  {
+    boost::property_tree::ptree adaptive_time_stepping =
+        ptree.get_child("adaptive_time_stepping");
+    if (!adaptive_time_stepping.get_optional<double>("initial_time_step"))
+      adaptive_time_stepping.put("initial_time_step", _time_step);
+    _adaptive_time_stepper.reset(
+        new AdaptiveTimeStepper(adaptive_time_stepping));
+  }
+}
+
+template <typename Data>
+std::size_t Stage::run(EnergyStorageDevice &device, double &time, Data *data)
+{
+  // The end criterion is checked slightly after the end of the time step so
+  // that a time limit is not missed because of round-off in the time. The
+  // adaptive time steps stop at the end of the stage, which is infinitely far
+  // if the end criterion does not bound the duration.
+  std::size_t n_time_steps = 0;
+  _end_criterion->reset(time, device);
+  if (_adaptive_time_stepper)
+    _adaptive_time_stepper->reset();
+  double const end_time = time + _end_criterion->get_max_duration();
+  while (!_end_criterion->check(time + 0.01 * _time_step, device))
+  {
+    ++n_time_steps;
+    if (_adaptive_time_stepper)
+      time += _adaptive_time_stepper->evolve_one_time_step(
+          device, _evolve_one_time_step, end_time - time);
+    else
+    {
+      time += _time_step;
+      _evolve_one_time_step(device, _time_step);
+    }
+    if (data != nullptr)
+      data->report(time, device);
+  }
+
+  return n_time_steps;
+}
+
+std::size_t Stage::run(EnergyStorageDevice &device, double &time,
+                       CyclingData *data)
+{
+  return run<CyclingData>(device, time, data);
+}
+
+std::size_t Stage::run(EnergyStorageDevice &device, double &time,
+                       DataRecorder &recorder)
+{
+  return run<DataRecorder>(device, time, &recorder);
+}
+
+std::size_t Stage::get_max_n_time_steps() const
+{
+  double const max_duration = _end_criterion->get_max_duration();
+  if (_adaptive_time_stepper || std::isinf(max_duration))
+    return 0;
+  return static_cast<std::size_t>(std::ceil(max_duration / _time_step)) + 1;
+}
+
+MultiStage::MultiStage(boost::property_tree::ptree const &ptree)
+    : _cycles(ptree.get("cycles", 1u))
+{
+  auto const n_stages = ptree.get_optional<unsigned int>("stages");
+  if (!n_stages)
+  {
+    _stages.emplace_back(ptree);
+    return;
+  }
+
+  for (unsigned int i = 0; i < *n_stages; ++i)
+  {
+    boost::property_tree::ptree stage_database =
+        ptree.get_child("stage_" + std::to_string(i));
+    if (!stage_database.get_optional<double>("time_step"))
+      stage_database.put("time_step", ptree.get<double>("time_step"));
+    auto const adaptive_time_stepping =
+        ptree.get_child_optional("adaptive_time_stepping");
+    if (adaptive_time_stepping &&
+        !stage_database.get_child_optional("adaptive_time_stepping"))
+      stage_database.put_child("adaptive_time_stepping",
+                               *adaptive_time_stepping);
+    _stages.emplace_back(stage_database);
+  }
+}
+
+std::size_t MultiStage::run(EnergyStorageDevice &device, double &time,
+                            CyclingData *data)
+{
+  std::size_t n_time_steps = 0;
+  for (unsigned int cycle = 0; cycle < _cycles; ++cycle)
+    for (auto &stage : _stages)
+      n_time_steps += stage.run(device, time, data);
+
+  return n_time_steps;
+}
+
+std::size_t MultiStage::run(EnergyStorageDevice &device, double &time,
+                            DataRecorder &recorder)
+{
+  std::size_t n_time_steps = 0;
+  for (unsigned int cycle = 0; cycle < _cycles; ++cycle)
+    for (auto &stage : _stages)
+      n_time_steps += stage.run(device, time, recorder);
+
+  return n_time_steps;
+}
+
+CyclingData MultiStage::run(EnergyStorageDevice &device,
+                            double const initial_time)
+{
+  // Reserve the memory once if the number of time steps of every stage is
+  // bounded. Otherwise the vectors grow as needed.
+  std::size_t max_n_time_steps = 0;
+  for (auto const &stage : _stages)
+  {
+    std::size_t const n = stage.get_max_n_time_steps();
+    if (n == 0)
+    {
+      max_n_time_steps = 0;
+      break;
+    }
+    max_n_time_steps += n;
+  }
+
+  CyclingData data;
+  data.reserve(_cycles * max_n_time_steps);
+  double time = initial_time;
+  run(device, time, &data);
+
+  return data;
+}
+
+} // end namespace cap
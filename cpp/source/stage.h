@@ -0,0 +1,159 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#ifndef CAP_STAGE_H
+#define CAP_STAGE_H
+
+#include <cap/adaptive_time_stepper.h>
+#include <cap/data_recorder.h>
+#include <cap/end_criterion.h>
+#include <cap/energy_storage_device.h>
+#include <boost/property_tree/ptree.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cap
+{
+
+/**
+ * Time, current, and voltage recorded after each time step.
+ */
+class CyclingData
+{
+public:
+  /**
+   * Reserve the memory for @p n more time steps.
+   */
+  void reserve(std::size_t const n);
+
+  /**
+   * Append @p time and the current and the voltage of @p device.
+   */
+  void report(double const time, EnergyStorageDevice const &device);
+
+  /**
+   * Return the number of recorded time steps.
+   */
+  std::size_t size() const;
+
+  std::vector<double> time;
+  std::vector<double> current;
+  std::vector<double> voltage;
+};
+
+/**
+ * Function advancing the device by the given time step.
+ */
+typedef std::function<void(EnergyStorageDevice &device, double time_step)>
+    TimeEvolution;
+
+/**
+ * Build the TimeEvolution of the operating condition given by the key mode
+ * of @p ptree: constant_voltage (or potentiostatic) with voltage,
+ * constant_current (or galvanostatic) with current, constant_power with
+ * power, constant_load with load, hold, or rest.
+ */
+TimeEvolution build_time_evolution(boost::property_tree::ptree const &ptree);
+
+/**
+ * Stage of a charge or discharge. The device is advanced with a constant time
+ * step and a constant operating condition until the end criterion is
+ * satisfied. The parameters are the same as for the Python Stage: the keys of
+ * build_time_evolution(), the keys of EndCriterion, and time_step.
+ *
+ * If the ptree has a child adaptive_time_stepping, the time steps are chosen
+ * by an AdaptiveTimeStepper built from it instead, with time_step as the
+ * default initial_time_step. The time steps are then capped so that the
+ * stage does not overshoot the duration given by the end criterion, and rests
+ * and holds take a handful of time steps.
+ */
+class Stage
+{
+public:
+  Stage(boost::property_tree::ptree const &ptree);
+
+  /**
+   * Run the stage starting at @p time, which is updated, and append the
+   * state of the device after each time step to @p data if it is not
+   * nullptr. Return the number of time steps.
+   */
+  std::size_t run(EnergyStorageDevice &device, double &time,
+                  CyclingData *data = nullptr);
+
+  /**
+   * Same as above but the state of the device is recorded in @p recorder.
+   */
+  std::size_t run(EnergyStorageDevice &device, double &time,
+                  DataRecorder &recorder);
+
+  /**
+   * Return an upper bound of the number of time steps of the stage, or zero
+   * if it is not known, e.g. when the time step is adaptive.
+   */
+  std::size_t get_max_n_time_steps() const;
+
+private:
+  template <typename Data>
+  std::size_t run(EnergyStorageDevice &device, double &time, Data *data);
+
+  TimeEvolution _evolve_one_time_step;
+  std::unique_ptr<EndCriterion> _end_criterion;
+  double const _time_step;
+  /**
+   * Nullptr if the time step is constant.
+   */
+  std::unique_ptr<AdaptiveTimeStepper> _adaptive_time_stepper;
+};
+
+/**
+ * Sequence of stages repeated over a number of cycles. The ptree has the same
+ * schema as for the Python MultiStage: cycles, stages, and the children
+ * stage_0, stage_1, ... The time_step of the parent is used for the stages
+ * that do not define their own, and so is its adaptive_time_stepping
+ * child. If the key stages is missing, the ptree
+ * describes a single Stage and cycles defaults to one.
+ *
+ * The whole loop is done in C++ so the cost of a time step is the cost of
+ * the device alone.
+ */
+class MultiStage
+{
+public:
+  MultiStage(boost::property_tree::ptree const &ptree);
+
+  /**
+   * Run all the stages starting at @p time, which is updated, and append the
+   * state of the device after each time step to @p data if it is not
+   * nullptr. Return the number of time steps.
+   */
+  std::size_t run(EnergyStorageDevice &device, double &time,
+                  CyclingData *data = nullptr);
+
+  /**
+   * Same as above but the state of the device is recorded in @p recorder.
+   */
+  std::size_t run(EnergyStorageDevice &device, double &time,
+                  DataRecorder &recorder);
+
+  /**
+   * Run all the stages starting at @p initial_time and return the recorded
+   * data. The memory is reserved up front when the duration of every stage
+   * is bounded.
+   */
+  CyclingData run(EnergyStorageDevice &device,
+                  double const initial_time = 0.);
+
+private:
+  std::vector<Stage> _stages;
+  unsigned int const _cycles;
+};
+
+} // end namespace cap
+
+#endif // CAP_STAGE_H
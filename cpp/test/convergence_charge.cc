@@ -5,22 +5,32 @@
  * for the text and further information on this license.
  */
 
-#define BOOST_TEST_MODULE ExactTransientSolution
-#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE ConvergenceCharge
+
+#include "main.cc"
+
 #include <cap/energy_storage_device.h>
+#include <cap/geometry.h>
 #include <cap/mp_values.h>
+#include <deal.II/base/quadrature_lib.h>
 #include <deal.II/base/types.h>
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/dofs/dof_handler.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/fe/fe_values.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/info_parser.hpp>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <numeric>
+#include <string>
+#include <vector>
 
 namespace cap
 {
@@ -43,36 +53,42 @@ void compute_parameters(
   std::shared_ptr<boost::property_tree::ptree> material_properties_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("material_properties"));
-  cap::MPValuesParameters<2> mp_values_params(material_properties_database);
   std::shared_ptr<boost::property_tree::ptree> geometry_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("geometry"));
-  mp_values_params.geometry =
-      std::make_shared<cap::DummyGeometry<2>>(geometry_database);
+  std::shared_ptr<cap::Geometry<2>> geometry =
+      std::make_shared<cap::Geometry<2>>(geometry_database,
+                                         boost::mpi::communicator());
+  cap::MPValuesParameters<2> mp_values_params(material_properties_database);
+  mp_values_params.geometry = geometry;
   std::shared_ptr<cap::MPValues<2>> mp_values =
-      std::shared_ptr<cap::MPValues<2>>(new cap::MPValues<2>(mp_values_params));
+      cap::SuperCapacitorMPValuesFactory<2>::build(mp_values_params);
   // build dummy cell itertor and set its material id
   dealii::Triangulation<2> triangulation;
   dealii::GridGenerator::hyper_cube(triangulation);
+  dealii::FE_Q<2> fe(1);
   dealii::DoFHandler<2> dof_handler(triangulation);
+  dof_handler.distribute_dofs(fe);
   dealii::DoFHandler<2>::active_cell_iterator cell = dof_handler.begin_active();
+  dealii::FEValues<2> fe_values(fe, dealii::QGauss<2>(1),
+                                dealii::update_default);
   // electrode
-  cell->set_material_id(input_database->get<dealii::types::material_id>(
-      "geometry.anode_electrode_material_id"));
+  cell->set_material_id(*(*geometry->get_materials())["anode"].begin());
+  fe_values.reinit(cell);
   std::vector<double> electrode_solid_electrical_conductivity_values(1);
   std::vector<double> electrode_liquid_electrical_conductivity_values(1);
   std::vector<double> electrode_specific_capacitance_values(1);
   std::vector<double> electrode_exchange_current_density_values(1);
   std::vector<double> electrode_electron_thermal_voltage_values(1);
-  mp_values->get_values("solid_electrical_conductivity", cell,
+  mp_values->get_values("solid_electrical_conductivity", fe_values,
                         electrode_solid_electrical_conductivity_values);
-  mp_values->get_values("liquid_electrical_conductivity", cell,
+  mp_values->get_values("liquid_electrical_conductivity", fe_values,
                         electrode_liquid_electrical_conductivity_values);
-  mp_values->get_values("specific_capacitance", cell,
+  mp_values->get_values("specific_capacitance", fe_values,
                         electrode_specific_capacitance_values);
-  mp_values->get_values("faradaic_reaction_coefficient", cell,
+  mp_values->get_values("faradaic_reaction_coefficient", fe_values,
                         electrode_exchange_current_density_values);
-  mp_values->get_values("electron_thermal_voltage", cell,
+  mp_values->get_values("electron_thermal_voltage", fe_values,
                         electrode_electron_thermal_voltage_values);
   if (electrode_exchange_current_density_values[0] == 0.0)
     throw std::runtime_error("test assumes faradaic processes are present, "
@@ -107,10 +123,10 @@ void compute_parameters(
           std::pow(electrode_width, 2));
 
   // separator
-  cell->set_material_id(input_database->get<dealii::types::material_id>(
-      "geometry.separator_material_id"));
+  cell->set_material_id(*(*geometry->get_materials())["separator"].begin());
+  fe_values.reinit(cell);
   std::vector<double> separator_liquid_electrical_conductivity_values(1);
-  mp_values->get_values("liquid_electrical_conductivity", cell,
+  mp_values->get_values("liquid_electrical_conductivity", fe_values,
                         separator_liquid_electrical_conductivity_values);
 
   double const potential_drop_across_the_separator =
@@ -125,7 +141,11 @@ void compute_parameters(
   output_database->put("cross_sectional_area", cross_sectional_area);
 }
 
-void verification_problem(
+/**
+ * Charge @p dev at constant current and compare the voltage to the exact
+ * solution every millisecond. Return the computed voltages.
+ */
+std::vector<double> verification_problem(
     std::shared_ptr<cap::EnergyStorageDevice> dev,
     std::shared_ptr<boost::property_tree::ptree const> database,
     std::ostream &os = std::cout)
@@ -252,7 +272,7 @@ void verification_problem(
 
   double computed_voltage;
   double exact_voltage;
-  double const percent_tolerance = database->get<double>("percent_tolerance");
+  std::vector<double> computed_voltages;
   for (double time = 0.0; time <= charge_time + epsilon; time += time_step)
   {
     double const dimensionless_time =
@@ -275,9 +295,14 @@ void verification_problem(
         (std::abs(time + time_step - 8e-3) < 1e-7) ||
         (std::abs(time + time_step - 9e-3) < 1e-7) ||
         (std::abs(time + time_step - 10e-3) < 1e-7))
+    {
       os << boost::format("  %22.15e  %22.15e  %22.15e  \n") %
                 (time + time_step) % exact_voltage % computed_voltage;
+      computed_voltages.push_back(computed_voltage);
+    }
   }
+
+  return computed_voltages;
 }
 
 } // end namespace cap
@@ -295,12 +320,12 @@ BOOST_AUTO_TEST_CASE(test_exact_transient_solution)
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("device"));
   std::shared_ptr<cap::EnergyStorageDevice> device =
-      cap::EnergyStorageDevice::build(boost::mpi::communicator(),
-                                      *device_database);
+      cap::EnergyStorageDevice::build(*device_database,
+                                      boost::mpi::communicator());
 
   // measure discharge curve
   std::fstream fout;
-  fout.open("verification_problem_data", std::fstream::out);
+  fout.open("convergence_charge_data", std::fstream::out);
 
   std::shared_ptr<boost::property_tree::ptree> verification_problem_database =
       std::make_shared<boost::property_tree::ptree>(
@@ -312,3 +337,86 @@ BOOST_AUTO_TEST_CASE(test_exact_transient_solution)
 
   fout.close();
 }
+
+BOOST_AUTO_TEST_CASE(test_time_integrators)
+{
+  std::shared_ptr<boost::property_tree::ptree> input_database =
+      std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("verification_problems.info",
+                                               *input_database);
+  std::shared_ptr<boost::property_tree::ptree> device_database =
+      std::make_shared<boost::property_tree::ptree>(
+          input_database->get_child("device"));
+  std::shared_ptr<boost::property_tree::ptree> verification_problem_database =
+      std::make_shared<boost::property_tree::ptree>(
+          input_database->get_child("verification_problem_subramanian"));
+  cap::compute_parameters(device_database, verification_problem_database);
+
+  auto compute_voltages = [&](std::string const &time_integrator,
+                              double const time_step) {
+    device_database->put("solver.time_integrator", time_integrator);
+    verification_problem_database->put("time_step", time_step);
+    std::shared_ptr<cap::EnergyStorageDevice> device =
+        cap::EnergyStorageDevice::build(*device_database,
+                                        boost::mpi::communicator());
+    std::fstream fout;
+    fout.open("convergence_charge_data_" + time_integrator,
+              std::fstream::out);
+    return cap::verification_problem(device, verification_problem_database,
+                                     fout);
+  };
+
+  // The spatial discretization error does not depend on the time integrator.
+  // To measure the error of the time integration alone, the reference is
+  // computed on the same mesh with a time step much smaller than the ones of
+  // the study.
+  std::vector<double> const reference_voltages =
+      compute_voltages("bdf2", 1.0e-3 / 256);
+
+  // All the time steps divide the sampling period of the voltage. The
+  // smallest time step times four is also in the list.
+  std::vector<double> const time_steps = {5.0e-4, 2.5e-4, 1.25e-4, 6.25e-5};
+  double const charge_time =
+      verification_problem_database->get<double>("charge_time");
+  std::map<std::string, int> const expected_orders = {
+      {"backward_euler", 1}, {"bdf2", 2}, {"crank_nicolson", 2}};
+  std::map<std::string, std::vector<double>> errors;
+  std::cout << boost::format("%16s  %12s  %8s  %12s  %6s\n") %
+                   "time integrator" % "time step" % "steps" % "error" %
+                   "order";
+  for (auto const &expected_order : expected_orders)
+  {
+    std::string const &time_integrator = expected_order.first;
+    double order = 0.;
+    for (double const time_step : time_steps)
+    {
+      std::vector<double> const voltages =
+          compute_voltages(time_integrator, time_step);
+      BOOST_TEST(voltages.size() == reference_voltages.size());
+      double error = 0.;
+      for (unsigned int i = 0; i < voltages.size(); ++i)
+        error = std::max(error, std::abs(voltages[i] - reference_voltages[i]));
+      if (!errors[time_integrator].empty())
+      {
+        double const previous_error = errors[time_integrator].back();
+        BOOST_TEST(error < previous_error);
+        order = std::log2(previous_error / error);
+      }
+      std::cout << boost::format("%16s  %12.4e  %8d  %12.4e  %6.2f\n") %
+                       time_integrator % time_step %
+                       std::lround(charge_time / time_step) % error % order;
+      errors[time_integrator].push_back(error);
+    }
+    // The observed order on the two smallest time steps is close to the
+    // theoretical one.
+    BOOST_TEST(order > 0.8 * expected_order.second);
+  }
+
+  // BDF2 and Crank-Nicolson with a time step four times larger are at least
+  // as accurate as backward Euler.
+  double const backward_euler_error = errors["backward_euler"].back();
+  std::size_t const n = time_steps.size();
+  BOOST_TEST(time_steps[n - 3] == 4. * time_steps[n - 1]);
+  BOOST_TEST(errors["bdf2"][n - 3] <= backward_euler_error);
+  BOOST_TEST(errors["crank_nicolson"][n - 3] <= backward_euler_error);
+}
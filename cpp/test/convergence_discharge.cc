@@ -5,13 +5,19 @@
  * for the text and further information on this license.
  */
 
-#define BOOST_TEST_MODULE ExactTransientSolution
-#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE ConvergenceDischarge
+
+#include "main.cc"
+
 #include <cap/energy_storage_device.h>
+#include <cap/geometry.h>
 #include <cap/mp_values.h>
+#include <deal.II/base/quadrature_lib.h>
 #include <deal.II/base/types.h>
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/dofs/dof_handler.h>
+#include <deal.II/fe/fe_q.h>
+#include <deal.II/fe/fe_values.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
@@ -19,10 +25,12 @@
 #include <boost/property_tree/info_parser.hpp>
 #include <boost/math/tools/roots.hpp>
 #include <boost/math/distributions/beta.hpp>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 #include <numeric>
+#include <string>
 
 namespace cap
 {
@@ -45,34 +53,40 @@ void compute_parameters(
   std::shared_ptr<boost::property_tree::ptree> material_properties_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("material_properties"));
-  cap::MPValuesParameters<2> mp_values_params(material_properties_database);
   std::shared_ptr<boost::property_tree::ptree> geometry_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("geometry"));
-  mp_values_params.geometry =
-      std::make_shared<cap::DummyGeometry<2>>(geometry_database);
+  std::shared_ptr<cap::Geometry<2>> geometry =
+      std::make_shared<cap::Geometry<2>>(geometry_database,
+                                         boost::mpi::communicator());
+  cap::MPValuesParameters<2> mp_values_params(material_properties_database);
+  mp_values_params.geometry = geometry;
   std::shared_ptr<cap::MPValues<2>> mp_values =
-      std::shared_ptr<cap::MPValues<2>>(new cap::MPValues<2>(mp_values_params));
+      cap::SuperCapacitorMPValuesFactory<2>::build(mp_values_params);
   // build dummy cell itertor and set its material id
   dealii::Triangulation<2> triangulation;
   dealii::GridGenerator::hyper_cube(triangulation);
+  dealii::FE_Q<2> fe(1);
   dealii::DoFHandler<2> dof_handler(triangulation);
+  dof_handler.distribute_dofs(fe);
   dealii::DoFHandler<2>::active_cell_iterator cell = dof_handler.begin_active();
+  dealii::FEValues<2> fe_values(fe, dealii::QGauss<2>(1),
+                                dealii::update_default);
   // electrode
-  cell->set_material_id(input_database->get<dealii::types::material_id>(
-      "geometry.anode_electrode_material_id"));
+  cell->set_material_id(*(*geometry->get_materials())["anode"].begin());
+  fe_values.reinit(cell);
   std::vector<double> electrode_solid_electrical_conductivity_values(1);
   std::vector<double> electrode_liquid_electrical_conductivity_values(1);
   std::vector<double> electrode_specific_capacitance_values(1);
   std::vector<double> electrode_exchange_current_density_values(1);
   std::vector<double> electrode_electron_thermal_voltage_values(1);
-  mp_values->get_values("solid_electrical_conductivity", cell,
+  mp_values->get_values("solid_electrical_conductivity", fe_values,
                         electrode_solid_electrical_conductivity_values);
-  mp_values->get_values("liquid_electrical_conductivity", cell,
+  mp_values->get_values("liquid_electrical_conductivity", fe_values,
                         electrode_liquid_electrical_conductivity_values);
-  mp_values->get_values("specific_capacitance", cell,
+  mp_values->get_values("specific_capacitance", fe_values,
                         electrode_specific_capacitance_values);
-  mp_values->get_values("faradaic_reaction_coefficient", cell,
+  mp_values->get_values("faradaic_reaction_coefficient", fe_values,
                         electrode_exchange_current_density_values);
   double const cell_current_density = 1.0;
   double const initial_voltage = 1.0;
@@ -108,10 +122,10 @@ void compute_parameters(
        electrode_liquid_electrical_conductivity_values[0]);
 
   // separator
-  cell->set_material_id(input_database->get<dealii::types::material_id>(
-      "geometry.separator_material_id"));
+  cell->set_material_id(*(*geometry->get_materials())["separator"].begin());
+  fe_values.reinit(cell);
   std::vector<double> separator_liquid_electrical_conductivity_values(1);
-  mp_values->get_values("liquid_electrical_conductivity", cell,
+  mp_values->get_values("liquid_electrical_conductivity", fe_values,
                         separator_liquid_electrical_conductivity_values);
   double const separator_resitance =
       separator_width / separator_liquid_electrical_conductivity_values[0];
@@ -123,7 +137,12 @@ void compute_parameters(
   output_database->put("cross_sectional_area", cross_sectional_area);
 }
 
-void verification_problem(
+/**
+ * Charge @p dev at constant voltage, discharge it at constant current, and
+ * compare the voltage to the exact solution after each time step. Return the
+ * largest difference.
+ */
+double verification_problem(
     std::shared_ptr<cap::EnergyStorageDevice> dev,
     std::shared_ptr<boost::property_tree::ptree const> database,
     std::ostream &os = std::cout)
@@ -344,6 +363,7 @@ void verification_problem(
 
   double computed_voltage;
   double exact_voltage;
+  double error = 0.;
   for (double time = 0.0; time <= discharge_time + epsilon; time += time_step)
   {
     double const dimensionless_time =
@@ -353,6 +373,7 @@ void verification_problem(
     exact_voltage = initial_voltage * dimensionless_cell_voltage;
     dev->evolve_one_time_step_constant_current(time_step, -discharge_current);
     dev->get_voltage(computed_voltage);
+    error = std::max(error, std::abs(computed_voltage - exact_voltage));
     if ((std::abs(time + time_step - 1e-3) < 1e-7) ||
         (std::abs(time + time_step - 2e-3) < 1e-7) ||
         (std::abs(time + time_step - 3e-3) < 1e-7) ||
@@ -447,6 +468,8 @@ void verification_problem(
            2.0 * std::pow(I_star, 2) *
                std::accumulate(&(coefficients[1]), &(coefficients[infty]), 0.0);
   };
+
+  return error;
 }
 
 } // end namespace cap
@@ -464,25 +487,47 @@ BOOST_AUTO_TEST_CASE(test_exact_transient_solution)
       "device.material_properties.electrode_material.exchange_current_density",
       0.0);
 
-  // build an energy storage system
   std::shared_ptr<boost::property_tree::ptree> device_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("device"));
-  std::shared_ptr<cap::EnergyStorageDevice> device =
-      cap::EnergyStorageDevice::build(boost::mpi::communicator(),
-                                      *device_database);
-
-  // measure discharge curve
-  std::fstream fout;
-  fout.open("verification_problem_data", std::fstream::out);
-
   std::shared_ptr<boost::property_tree::ptree> verification_problem_database =
       std::make_shared<boost::property_tree::ptree>(
           input_database->get_child("verification_problem_srinivasan"));
 
   cap::compute_parameters(device_database, verification_problem_database);
 
-  cap::verification_problem(device, verification_problem_database, fout);
+  // The second order time integrators use a time step four times larger than
+  // backward Euler and must reach a comparable accuracy. The error includes
+  // the spatial discretization error, which is the same for all the time
+  // integrators.
+  double const time_step =
+      verification_problem_database->get<double>("time_step");
+  double backward_euler_error = 0.;
+  for (std::string const time_integrator :
+       {"backward_euler", "bdf2", "crank_nicolson"})
+  {
+    // build an energy storage system
+    device_database->put("solver.time_integrator", time_integrator);
+    std::shared_ptr<cap::EnergyStorageDevice> device =
+        cap::EnergyStorageDevice::build(*device_database,
+                                        boost::mpi::communicator());
+    verification_problem_database->put(
+        "time_step",
+        (time_integrator == "backward_euler") ? time_step : 4. * time_step);
 
-  fout.close();
+    // measure discharge curve
+    std::fstream fout;
+    fout.open("convergence_discharge_data_" + time_integrator,
+              std::fstream::out);
+
+    double const error =
+        cap::verification_problem(device, verification_problem_database, fout);
+    std::cout << time_integrator << " error = " << error << "\n";
+    if (time_integrator == "backward_euler")
+      backward_euler_error = error;
+    else
+      BOOST_TEST(error <= 1.5 * backward_euler_error);
+
+    fout.close();
+  }
 }
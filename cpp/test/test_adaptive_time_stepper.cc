@@ -0,0 +1,238 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE AdaptiveTimeStepper
+
+#include "main.cc"
+
+#include <cap/adaptive_time_stepper.h>
+#include <cap/resistor_capacitor.h>
+#include <boost/mpi/communicator.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+
+double const R_SERIES = 55.0e-3;
+double const R_PARALLEL = 2.5e6;
+double const C = 3.0;
+double const TAU = R_SERIES * C;
+
+std::unique_ptr<cap::EnergyStorageDevice> build_device(std::string const &type)
+{
+  boost::property_tree::ptree database;
+  database.put("type", type);
+  database.put("series_resistance", R_SERIES);
+  database.put("parallel_resistance", R_PARALLEL);
+  database.put("capacitance", C);
+  database.put("initial_voltage", 1.2);
+  return cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+}
+
+boost::property_tree::ptree
+initialize_database(std::string const &error_estimator)
+{
+  boost::property_tree::ptree database;
+  database.put("initial_time_step", 0.01 * TAU);
+  database.put("rel_tolerance", 1.0e-4);
+  database.put("error_estimator", error_estimator);
+  return database;
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot)
+{
+  for (auto const &type : {"SeriesRC", "ParallelRC"})
+  {
+    auto device = build_device(type);
+    device->evolve_one_time_step_constant_current(0.1, 2.0);
+    auto snapshot = device->snapshot();
+    double voltage;
+    double current;
+    device->get_voltage(voltage);
+    device->get_current(current);
+
+    device->evolve_one_time_step_constant_voltage(0.1, 2.5);
+    device->restore(*snapshot);
+    double restored_voltage;
+    double restored_current;
+    device->get_voltage(restored_voltage);
+    device->get_current(restored_current);
+    BOOST_TEST(restored_voltage == voltage);
+    BOOST_TEST(restored_current == current);
+
+    // The snapshot does not depend on the device after it has been taken.
+    device->evolve_one_time_step_constant_current(0.1, 2.0);
+    auto other_device = build_device(type);
+    other_device->restore(*snapshot);
+    other_device->evolve_one_time_step_constant_current(0.1, 2.0);
+    double other_voltage;
+    device->get_voltage(voltage);
+    other_device->get_voltage(other_voltage);
+    BOOST_TEST(other_voltage == voltage);
+  }
+
+  // A snapshot can only be restored on a device of the same type.
+  auto series_rc = build_device("SeriesRC");
+  auto parallel_rc = build_device("ParallelRC");
+  BOOST_CHECK_THROW(parallel_rc->restore(*series_rc->snapshot()),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_rest_and_hold)
+{
+  for (auto const &error_estimator : {"step_doubling", "extrapolation"})
+  {
+    // The updates of the RC circuits are exact for a constant current or a
+    // constant voltage so step doubling lets the time step grow at each time
+    // step.
+    cap::AdaptiveTimeStepper stepper(initialize_database(error_estimator));
+    auto device = build_device("SeriesRC");
+    std::size_t const n_rest_steps = stepper.evolve(
+        *device,
+        [](cap::EnergyStorageDevice &device, double const time_step) {
+          device.evolve_one_time_step_constant_current(time_step, 0.0);
+        },
+        1.0e4 * TAU);
+    BOOST_TEST(n_rest_steps < 20);
+    double voltage;
+    device->get_voltage(voltage);
+    BOOST_TEST(voltage == 1.2, boost::test_tools::tolerance(1e-12));
+
+    stepper.reset();
+    std::size_t const n_hold_steps = stepper.evolve(
+        *device,
+        [](cap::EnergyStorageDevice &device, double const time_step) {
+          device.evolve_one_time_step_constant_voltage(time_step, 2.1);
+        },
+        100.0 * TAU);
+    // The extrapolation follows the decay of the current until it is
+    // smaller than the tolerance even though the device is exact.
+    if (std::string(error_estimator) == "step_doubling")
+    {
+      BOOST_TEST(n_hold_steps < 25);
+      BOOST_TEST(stepper.get_n_rejected_steps() == 0);
+    }
+    double current;
+    device->get_current(current);
+    BOOST_TEST(std::abs(current) < 1.0e-12);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_constant_power)
+{
+  // The constant power time step of the RC circuits is first order accurate.
+  // Compare the adaptive time stepping to very small fixed time steps.
+  double const power = -1.0;
+  double const duration = 2.0 * TAU;
+  auto constant_power = [&](cap::EnergyStorageDevice &device,
+                            double const time_step) {
+    device.evolve_one_time_step_constant_power(time_step, power);
+  };
+  for (auto const &type : {"SeriesRC", "ParallelRC"})
+  {
+    auto reference = build_device(type);
+    int const n_reference_steps = 100000;
+    for (int i = 0; i < n_reference_steps; ++i)
+      constant_power(*reference, duration / n_reference_steps);
+    double reference_voltage;
+    reference->get_voltage(reference_voltage);
+
+    for (auto const &error_estimator : {"step_doubling", "extrapolation"})
+    {
+      cap::AdaptiveTimeStepper stepper(initialize_database(error_estimator));
+      auto device = build_device(type);
+      std::size_t const n_steps =
+          stepper.evolve(*device, constant_power, duration);
+      BOOST_TEST(n_steps < 1000);
+      double voltage;
+      device->get_voltage(voltage);
+      BOOST_TEST(voltage == reference_voltage,
+                 boost::test_tools::tolerance(1e-3));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_rejection)
+{
+  // Start with a time step that is much too large. It is rejected and the
+  // device is rolled back before trying again.
+  boost::property_tree::ptree database = initialize_database("step_doubling");
+  database.put("initial_time_step", 0.5 * TAU);
+  database.put("min_time_step", 1.0e-6 * TAU);
+  cap::AdaptiveTimeStepper stepper(database);
+  auto device = build_device("SeriesRC");
+  auto constant_power = [](cap::EnergyStorageDevice &device,
+                           double const time_step) {
+    device.evolve_one_time_step_constant_power(time_step, -1.0);
+  };
+  double const time_step =
+      stepper.evolve_one_time_step(*device, constant_power, TAU);
+  BOOST_TEST(time_step < 0.5 * TAU);
+  BOOST_TEST(stepper.get_n_rejected_steps() > 0);
+  BOOST_TEST(stepper.get_n_accepted_steps() == 1);
+
+  // The accepted time step is the same as the one of a device advanced
+  // directly with the same two half steps.
+  auto other_device = build_device("SeriesRC");
+  constant_power(*other_device, 0.5 * time_step);
+  constant_power(*other_device, 0.5 * time_step);
+  double voltage;
+  double other_voltage;
+  device->get_voltage(voltage);
+  other_device->get_voltage(other_voltage);
+  BOOST_TEST(voltage == other_voltage);
+
+  // Invalid parameters
+  database.put("error_estimator", "richardson");
+  BOOST_CHECK_THROW(cap::AdaptiveTimeStepper{database}, std::runtime_error);
+  database.put("error_estimator", "extrapolation");
+  database.put("min_time_step", TAU);
+  BOOST_CHECK_THROW(cap::AdaptiveTimeStepper{database}, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_not_a_number)
+{
+  // The device produces NaN whatever the time step. The time step must be
+  // rejected, shrunk, and the stepper must eventually throw with the device
+  // rolled back instead of retrying the same time step forever.
+  auto nan_voltage = [](cap::EnergyStorageDevice &device,
+                        double const time_step) {
+    device.evolve_one_time_step_constant_voltage(
+        time_step, std::numeric_limits<double>::quiet_NaN());
+  };
+  for (auto const &error_estimator : {"step_doubling", "extrapolation"})
+  {
+    // Stopped by min_time_step: each rejection shrinks the time step by the
+    // largest factor allowed so it takes a handful of tries.
+    boost::property_tree::ptree database = initialize_database(error_estimator);
+    database.put("min_time_step", 1.0e-3 * TAU);
+    cap::AdaptiveTimeStepper stepper(database);
+    auto device = build_device("SeriesRC");
+    BOOST_CHECK_THROW(stepper.evolve_one_time_step(*device, nan_voltage, TAU),
+                      std::runtime_error);
+    BOOST_TEST(stepper.get_n_accepted_steps() == 0);
+    BOOST_TEST(stepper.get_n_rejected_steps() > 0);
+    BOOST_TEST(stepper.get_n_rejected_steps() < 10);
+    BOOST_TEST(stepper.get_time_step() < 1.0e-3 * TAU);
+    double voltage;
+    device->get_voltage(voltage);
+    BOOST_TEST(voltage == 1.2);
+
+    // Stopped by max_rejected_steps
+    database.put("min_time_step", 0.0);
+    database.put("max_rejected_steps", 20);
+    cap::AdaptiveTimeStepper other_stepper(database);
+    BOOST_CHECK_THROW(
+        other_stepper.evolve_one_time_step(*device, nan_voltage, TAU),
+        std::runtime_error);
+    BOOST_TEST(other_stepper.get_n_rejected_steps() == 20);
+    device->get_voltage(voltage);
+    BOOST_TEST(voltage == 1.2);
+  }
+}
@@ -15,6 +15,8 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/test/unit_test.hpp>
 #include <cstdio>
+#include <stdexcept>
+#include <vector>
 
 boost::property_tree::ptree initialize_database()
 {
@@ -172,3 +174,57 @@ BOOST_AUTO_TEST_CASE(test_supercapacitor)
   if (comm.rank() == 0)
     BOOST_TEST(std::remove(filename.c_str()) == 0);
 }
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_snapshot)
+{
+  // Unlike save() and load(), snapshot() and restore() do not touch the
+  // filesystem and do not require the checkpoint option of the geometry.
+  boost::mpi::communicator comm;
+  boost::property_tree::ptree device_database;
+  boost::property_tree::info_parser::read_info("super_capacitor.info",
+                                               device_database);
+  std::shared_ptr<cap::EnergyStorageDevice> device =
+      cap::EnergyStorageDevice::build(device_database, comm);
+  double const charge_current = 5e-3;
+  double const time_step = 1e-2;
+  for (unsigned int i = 0; i < 3; ++i)
+    device->evolve_one_time_step_constant_current(time_step, charge_current);
+  auto const snapshot = device->snapshot();
+  double voltage, current;
+  device->get_voltage(voltage);
+  device->get_current(current);
+
+  // Branch twice from the snapshot.
+  std::vector<double> branch_voltage(2);
+  for (double &branch : branch_voltage)
+  {
+    device->restore(*snapshot);
+    double restored_voltage;
+    device->get_voltage(restored_voltage);
+    BOOST_CHECK_CLOSE(restored_voltage, voltage, 1e-6);
+    device->evolve_one_time_step_constant_current(time_step, -charge_current);
+    device->get_voltage(branch);
+  }
+  BOOST_CHECK_CLOSE(branch_voltage[0], branch_voltage[1], 1e-6);
+  BOOST_TEST(branch_voltage[0] < voltage);
+
+  // The snapshot can be restored on another device built from the same
+  // database.
+  std::shared_ptr<cap::EnergyStorageDevice> new_device =
+      cap::EnergyStorageDevice::build(device_database, comm);
+  new_device->restore(*snapshot);
+  double new_voltage, new_current;
+  new_device->get_voltage(new_voltage);
+  new_device->get_current(new_current);
+  BOOST_CHECK_CLOSE(new_voltage, voltage, 1e-6);
+  BOOST_CHECK_CLOSE(new_current, current, 1e-6);
+
+  // but not on a device of another type.
+  boost::property_tree::ptree rc_database = initialize_database();
+  rc_database.put("type", "SeriesRC");
+  std::shared_ptr<cap::EnergyStorageDevice> rc_device =
+      cap::EnergyStorageDevice::build(rc_database, comm);
+  BOOST_CHECK_THROW(rc_device->restore(*snapshot), std::runtime_error);
+  BOOST_CHECK_THROW(device->restore(*rc_device->snapshot()),
+                    std::runtime_error);
+}
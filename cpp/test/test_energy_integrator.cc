@@ -0,0 +1,87 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE EnergyIntegrator
+
+#include "main.cc"
+
+#include <cap/energy_integrator.h>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(test_compute_energy)
+{
+  // The trapezoidal rule is exact for a piecewise linear power so only the
+  // interpolation error of the cosine remains.
+  double const pi = M_PI;
+  std::size_t const n = 10001;
+  std::vector<double> time(n);
+  std::vector<double> power(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    time[i] = static_cast<double>(i) / (n - 1) * 2.0 * pi;
+    power[i] = std::cos(time[i]);
+  }
+
+  std::vector<double> energy(n);
+  cap::compute_energy(time, power, energy);
+  BOOST_TEST(energy[0] == 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+    BOOST_TEST(std::abs(energy[i] - std::sin(time[i])) < 1e-6);
+
+  std::vector<double> wrong_size(n - 1);
+  BOOST_CHECK_THROW(cap::compute_energy(time, power, wrong_size),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_streaming)
+{
+  // Linear power on non-uniform time steps is integrated exactly.
+  cap::EnergyIntegrator integrator;
+  BOOST_TEST(integrator.get_energy() == 0.0);
+  BOOST_TEST(integrator.add(1.0, 3.0) == 0.0);
+  double time = 1.0;
+  for (double delta_t : {0.1, 0.5, 0.01, 2.0})
+  {
+    time += delta_t;
+    integrator.add(time, 2.0 * time + 1.0);
+  }
+  // integral of 2 t + 1 between 1 and 3.61
+  BOOST_TEST(integrator.get_energy() == 3.61 * 3.61 + 3.61 - 2.0,
+             boost::test_tools::tolerance(1e-12));
+  integrator.reset();
+  BOOST_TEST(integrator.add(5.0, 1.0) == 0.0);
+  BOOST_TEST(integrator.add(6.0, 1.0) == 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_batch)
+{
+  std::size_t const n = 3;
+  cap::EnergyIntegratorBatch batch(n);
+  BOOST_TEST(batch.size() == n);
+  std::vector<cap::EnergyIntegrator> integrators(n);
+  std::vector<double> power(n);
+  for (int step = 0; step < 100; ++step)
+  {
+    double const time = 0.1 * step;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+      power[k] = std::exp(-time * (k + 1));
+      integrators[k].add(time, power[k]);
+    }
+    batch.add(time, power);
+  }
+  for (std::size_t k = 0; k < n; ++k)
+    BOOST_TEST(batch.get_energy()[k] == integrators[k].get_energy());
+
+  BOOST_CHECK_THROW(batch.add(10.0, std::vector<double>(n + 1)),
+                    std::runtime_error);
+  batch.reset();
+  BOOST_TEST(batch.get_energy()[0] == 0.0);
+}
@@ -258,6 +258,30 @@ BOOST_AUTO_TEST_CASE(test_inhomogenous_mp_values)
       std::dynamic_pointer_cast<cap::InhomogeneousSuperCapacitorMPValues<2>>(
           mp_values));
 
+  // Check that the sampling is reproducible.
+  std::shared_ptr<cap::MPValues<2>> other_mp_values =
+      cap::SuperCapacitorMPValuesFactory<2>::build(params);
+  dealii::FE_Q<2> fe(1);
+  dealii::DoFHandler<2> dof_handler(*params.geometry->get_triangulation());
+  dof_handler.distribute_dofs(fe);
+  dealii::FEValues<2> fe_values(fe, dealii::QGauss<2>(1),
+                                dealii::update_quadrature_points);
+  std::vector<double> values(1);
+  std::vector<double> other_values(1);
+  for (auto cell : dof_handler.active_cell_iterators())
+    if (cell->is_locally_owned())
+    {
+      fe_values.reinit(cell);
+      for (std::string const key :
+           {"density", "liquid_electrical_conductivity",
+            "specific_capacitance"})
+      {
+        mp_values->get_values(key, fe_values, values);
+        other_mp_values->get_values(key, fe_values, other_values);
+        BOOST_TEST(values[0] == other_values[0]);
+      }
+    }
+
   // Check that an exception is thrown if the same path is registered for
   // multiple parameters.
   database->put("parameter_1.path", "separator_material.void_volume_fraction");
@@ -479,3 +503,50 @@ BOOST_AUTO_TEST_CASE(test_mp_values)
   mp_values->get_values("solid_electrical_conductivity", fe_values, values);
   BOOST_TEST(std::abs(values[0]) == 0.);
 }
+
+// the cache returns the same values as MPValues
+BOOST_AUTO_TEST_CASE(mp_values_cache, *boost::unit_test::tolerance(1e-15))
+{
+  int constexpr dim = 2;
+  dealii::Triangulation<dim> triangulation;
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(2);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+  dof_handler.distribute_dofs(fe);
+  dealii::QGauss<dim> quadrature(2);
+  dealii::FEValues<dim> fe_values(fe, quadrature,
+                                  dealii::update_quadrature_points);
+  std::vector<double> expected_values(quadrature.size());
+  std::vector<double> values(quadrature.size());
+
+  // space varying property: one value is stored per quadrature point
+  boost::property_tree::ptree ptree;
+  ptree.put("expression", "x+2*y");
+  cap::FunctionSpaceMPValues<dim> function_space(ptree);
+  cap::MPValuesCache<dim> function_space_cache(function_space, dof_handler,
+                                               quadrature);
+  BOOST_TEST(function_space_cache.n_quadrature_points() == quadrature.size());
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    fe_values.reinit(cell);
+    function_space.get_values("density", fe_values, expected_values);
+    function_space_cache.get_values(cap::MaterialProperty::density,
+                                    cell->active_cell_index(), values);
+    for (unsigned int q = 0; q < quadrature.size(); ++q)
+      BOOST_TEST(values[q] == expected_values[q]);
+  }
+
+  // uniform property: one value is stored per cell
+  cap::UniformConstantMPValues<dim> uniform_constant(3.14);
+  cap::MPValuesCache<dim> uniform_constant_cache(uniform_constant, dof_handler,
+                                                 quadrature);
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    uniform_constant_cache.get_values(
+        cap::MaterialProperty::specific_capacitance, cell->active_cell_index(),
+        values);
+    for (auto const &v : values)
+      BOOST_TEST(v == 3.14);
+  }
+}
@@ -152,3 +152,41 @@ BOOST_AUTO_TEST_CASE(test_throw)
     BOOST_CHECK_NO_THROW(cap::EnergyStorageDevice::build(ptree, world));
   }
 }
+
+// Check that the lightweight postprocessor computes the same quantities as the
+// default one
+BOOST_AUTO_TEST_CASE(test_lightweight, *boost::unit_test::tolerance(1e-8))
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+  std::shared_ptr<cap::EnergyStorageDevice> device =
+      cap::EnergyStorageDevice::build(ptree, world);
+  ptree.put("postprocessor.lightweight", true);
+  std::shared_ptr<cap::EnergyStorageDevice> lightweight_device =
+      cap::EnergyStorageDevice::build(ptree, world);
+
+  double const time_step = 0.1;
+  double const current = 0.1;
+  for (int i = 0; i < 5; ++i)
+  {
+    device->evolve_one_time_step_constant_current(time_step, current);
+    lightweight_device->evolve_one_time_step_constant_current(time_step,
+                                                              current);
+  }
+
+  for (std::string const key : {"voltage", "current", "surface_area",
+                                "joule_heating", "volume", "mass",
+                                "anode_potential", "cathode_potential"})
+  {
+    double value = 0.;
+    double lightweight_value = 0.;
+    std::dynamic_pointer_cast<cap::SuperCapacitor<2>>(device)
+        ->get_post_processor()
+        ->get(key, value);
+    std::dynamic_pointer_cast<cap::SuperCapacitor<2>>(lightweight_device)
+        ->get_post_processor()
+        ->get(key, lightweight_value);
+    BOOST_TEST(lightweight_value == value);
+  }
+}
@@ -0,0 +1,240 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE ReducedOrderSuperCapacitor
+
+#include "main.cc"
+
+#include <cap/energy_storage_device.h>
+#include <cap/reduced_order_supercapacitor.h>
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/unit_test.hpp>
+#include <complex>
+#include <memory>
+#include <vector>
+
+double const TIME_STEP = 0.01;
+double const CHARGE_CURRENT = 5e-3;
+
+boost::property_tree::ptree initialize_database()
+{
+  boost::property_tree::ptree database;
+  boost::property_tree::info_parser::read_info("super_capacitor.info",
+                                               database);
+  database.put("reduced_order_model.training.current", CHARGE_CURRENT);
+  database.put("reduced_order_model.training.time_step", TIME_STEP);
+  database.put("reduced_order_model.training.n_time_steps", 100);
+  return database;
+}
+
+std::unique_ptr<cap::ReducedOrderSuperCapacitor<2>>
+build_reduced_order_model(boost::property_tree::ptree database)
+{
+  database.put("type", "ReducedOrderSuperCapacitor");
+  std::unique_ptr<cap::EnergyStorageDevice> device =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+  auto *reduced_order_model =
+      dynamic_cast<cap::ReducedOrderSuperCapacitor<2> *>(device.get());
+  BOOST_REQUIRE(reduced_order_model != nullptr);
+  device.release();
+  return std::unique_ptr<cap::ReducedOrderSuperCapacitor<2>>(
+      reduced_order_model);
+}
+
+BOOST_AUTO_TEST_CASE(test_charge)
+{
+  boost::property_tree::ptree database = initialize_database();
+  auto reduced_order_model = build_reduced_order_model(database);
+  BOOST_TEST(reduced_order_model->get_basis_size() > 0u);
+  BOOST_TEST(reduced_order_model->get_basis_size() <= 50u);
+  auto full_model =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+
+  // The reduced model is trained on this charge so it reproduces the voltage
+  // of the full model.
+  for (unsigned int i = 0; i < 50; ++i)
+  {
+    reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                               CHARGE_CURRENT);
+    full_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                      CHARGE_CURRENT);
+  }
+  double voltage;
+  double reference_voltage;
+  double current;
+  reduced_order_model->get_voltage(voltage);
+  reduced_order_model->get_current(current);
+  full_model->get_voltage(reference_voltage);
+  BOOST_TEST(voltage == reference_voltage, boost::test_tools::tolerance(1e-3));
+  BOOST_TEST(current == CHARGE_CURRENT, boost::test_tools::tolerance(1e-8));
+
+  // The operating conditions are imposed exactly, whether the time step is
+  // done by the reduced model or by the full model. The voltage is always
+  // imposed by the full model.
+  std::size_t const n_full_model_steps =
+      reduced_order_model->get_n_full_model_steps();
+  double const imposed_voltage = 0.9 * voltage;
+  reduced_order_model->evolve_one_time_step_constant_voltage(TIME_STEP,
+                                                             imposed_voltage);
+  reduced_order_model->get_voltage(voltage);
+  BOOST_TEST(voltage == imposed_voltage, boost::test_tools::tolerance(1e-8));
+  BOOST_TEST(reduced_order_model->get_n_full_model_steps() ==
+             n_full_model_steps + 1);
+
+  double const power = -1e-3;
+  reduced_order_model->evolve_one_time_step_constant_power(TIME_STEP, power);
+  reduced_order_model->get_voltage(voltage);
+  reduced_order_model->get_current(current);
+  BOOST_TEST(voltage * current == power, boost::test_tools::tolerance(1e-8));
+
+  double const load = 100.;
+  reduced_order_model->evolve_one_time_step_constant_load(TIME_STEP, load);
+  reduced_order_model->get_voltage(voltage);
+  reduced_order_model->get_current(current);
+  BOOST_TEST(-voltage / current == load, boost::test_tools::tolerance(1e-8));
+  BOOST_CHECK_THROW(
+      reduced_order_model->evolve_one_time_step_constant_load(TIME_STEP, 0.),
+      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_load)
+{
+  // The reduced model projects the Robin boundary condition of the full
+  // model so a discharge through a load follows the full model.
+  boost::property_tree::ptree database = initialize_database();
+  auto reduced_order_model = build_reduced_order_model(database);
+  auto full_model =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+  for (unsigned int i = 0; i < 50; ++i)
+  {
+    reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                               CHARGE_CURRENT);
+    full_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                      CHARGE_CURRENT);
+  }
+  double const load = 100.;
+  for (unsigned int i = 0; i < 10; ++i)
+  {
+    reduced_order_model->evolve_one_time_step_constant_load(TIME_STEP, load);
+    full_model->evolve_one_time_step_constant_load(TIME_STEP, load);
+  }
+  double voltage;
+  double reference_voltage;
+  double current;
+  double reference_current;
+  reduced_order_model->get_voltage(voltage);
+  reduced_order_model->get_current(current);
+  full_model->get_voltage(reference_voltage);
+  full_model->get_current(reference_current);
+  BOOST_TEST(voltage == reference_voltage, boost::test_tools::tolerance(1e-3));
+  BOOST_TEST(current == reference_current, boost::test_tools::tolerance(1e-3));
+}
+
+BOOST_AUTO_TEST_CASE(test_linear)
+{
+  // The linear operating conditions are forwarded to the constant ones, as
+  // for the full model, so that the reduced model can be used for the
+  // voltammetry and the impedance spectroscopy in the time domain.
+  boost::property_tree::ptree database = initialize_database();
+  auto reduced_order_model = build_reduced_order_model(database);
+  auto full_model =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+  for (unsigned int i = 0; i < 10; ++i)
+  {
+    reduced_order_model->evolve_one_time_step_linear_current(TIME_STEP,
+                                                             CHARGE_CURRENT);
+    full_model->evolve_one_time_step_linear_current(TIME_STEP,
+                                                    CHARGE_CURRENT);
+  }
+  double voltage;
+  double reference_voltage;
+  double current;
+  reduced_order_model->get_voltage(voltage);
+  reduced_order_model->get_current(current);
+  full_model->get_voltage(reference_voltage);
+  BOOST_TEST(voltage == reference_voltage, boost::test_tools::tolerance(1e-3));
+  BOOST_TEST(current == CHARGE_CURRENT, boost::test_tools::tolerance(1e-8));
+
+  double const imposed_voltage = 1.1 * voltage;
+  reduced_order_model->evolve_one_time_step_linear_voltage(TIME_STEP,
+                                                           imposed_voltage);
+  reduced_order_model->get_voltage(voltage);
+  BOOST_TEST(voltage == imposed_voltage, boost::test_tools::tolerance(1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot)
+{
+  auto reduced_order_model = build_reduced_order_model(initialize_database());
+  reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                             CHARGE_CURRENT);
+  auto const snapshot = reduced_order_model->snapshot();
+  reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                             CHARGE_CURRENT);
+  double voltage;
+  reduced_order_model->get_voltage(voltage);
+
+  reduced_order_model->restore(*snapshot);
+  reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                             CHARGE_CURRENT);
+  double restored_voltage;
+  reduced_order_model->get_voltage(restored_voltage);
+  BOOST_TEST(restored_voltage == voltage, boost::test_tools::tolerance(1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_fallback)
+{
+  // A single mode cannot represent the charge. The error indicator detects it
+  // and the time steps are done with the full model instead.
+  boost::property_tree::ptree database = initialize_database();
+  database.put("reduced_order_model.max_basis_size", 1);
+  auto reduced_order_model = build_reduced_order_model(database);
+  BOOST_TEST(reduced_order_model->get_basis_size() == 1u);
+  auto full_model =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+  unsigned int const n_time_steps = 10;
+  for (unsigned int i = 0; i < n_time_steps; ++i)
+  {
+    reduced_order_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                               CHARGE_CURRENT);
+    full_model->evolve_one_time_step_constant_current(TIME_STEP,
+                                                      CHARGE_CURRENT);
+  }
+  BOOST_TEST(reduced_order_model->get_n_full_model_steps() > 0u);
+  double voltage;
+  double reference_voltage;
+  reduced_order_model->get_voltage(voltage);
+  full_model->get_voltage(reference_voltage);
+  BOOST_TEST(voltage == reference_voltage, boost::test_tools::tolerance(1e-3));
+
+  // Missing training parameters
+  database.get_child("reduced_order_model").erase("training");
+  BOOST_CHECK_THROW(build_reduced_order_model(database), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_impedance)
+{
+  boost::property_tree::ptree database = initialize_database();
+  auto reduced_order_model = build_reduced_order_model(database);
+  auto full_model =
+      cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+
+  // The training charge lasts one second so the reduced model represents the
+  // response at frequencies of the order of one hertz.
+  std::vector<double> const frequencies = {0.1, 1.};
+  std::vector<std::complex<double>> const impedance =
+      reduced_order_model->compute_impedance(frequencies);
+  std::vector<std::complex<double>> const reference_impedance =
+      full_model->compute_impedance(frequencies);
+  BOOST_TEST(impedance.size() == frequencies.size());
+  for (unsigned int i = 0; i < frequencies.size(); ++i)
+    BOOST_TEST(std::abs(impedance[i] - reference_impedance[i]) <=
+               1e-2 * std::abs(reference_impedance[i]));
+
+  BOOST_CHECK_THROW(reduced_order_model->compute_impedance({-1.}),
+                    std::runtime_error);
+}
@@ -0,0 +1,252 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE ResistorCapacitorBatch
+
+#include "main.cc"
+
+#include <cap/resistor_capacitor.h>
+#include <cap/resistor_capacitor_batch.h>
+#include <boost/mpi/communicator.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <vector>
+
+// Check that the batches give the same results as the circuits advanced one
+// by one.
+
+std::size_t const N = 17;
+
+boost::property_tree::ptree initialize_database()
+{
+  boost::property_tree::ptree database;
+  database.put("series_resistance", 55.0e-3);
+  database.put("parallel_resistance", 2.5e6);
+  database.put("capacitance", 3.0);
+  database.put("initial_voltage", 1.2);
+  return database;
+}
+
+// Each circuit of the batch uses a different series resistance.
+std::vector<double> series_resistances()
+{
+  std::vector<double> R(N);
+  for (std::size_t k = 0; k < N; ++k)
+    R[k] = 55.0e-3 * (1.0 + 0.1 * k);
+  return R;
+}
+
+std::vector<std::shared_ptr<cap::SeriesRC>>
+build_circuits(cap::SeriesRCBatch const &batch)
+{
+  boost::property_tree::ptree database = initialize_database();
+  boost::mpi::communicator comm;
+  std::vector<std::shared_ptr<cap::SeriesRC>> circuits;
+  for (std::size_t k = 0; k < batch.size(); ++k)
+  {
+    database.put("series_resistance", batch.R[k]);
+    circuits.push_back(std::make_shared<cap::SeriesRC>(database, comm));
+  }
+  return circuits;
+}
+
+std::vector<std::shared_ptr<cap::ParallelRC>>
+build_circuits(cap::ParallelRCBatch const &batch)
+{
+  boost::property_tree::ptree database = initialize_database();
+  boost::mpi::communicator comm;
+  std::vector<std::shared_ptr<cap::ParallelRC>> circuits;
+  for (std::size_t k = 0; k < batch.size(); ++k)
+  {
+    database.put("series_resistance", batch.R_series[k]);
+    circuits.push_back(std::make_shared<cap::ParallelRC>(database, comm));
+  }
+  return circuits;
+}
+
+template <typename Batch, typename Circuits>
+void check(Batch const &batch, Circuits const &circuits)
+{
+  for (std::size_t k = 0; k < batch.size(); ++k)
+  {
+    double voltage;
+    double current;
+    circuits[k]->get_voltage(voltage);
+    circuits[k]->get_current(current);
+    BOOST_TEST(batch.U[k] == voltage);
+    BOOST_TEST(batch.I[k] == current);
+    BOOST_TEST(batch.U_C[k] == circuits[k]->U_C);
+  }
+}
+
+template <typename Batch>
+void run(Batch &batch)
+{
+  auto circuits = build_circuits(batch);
+  double const delta_t = 0.1;
+  std::vector<double> values(batch.size());
+  for (std::size_t k = 0; k < batch.size(); ++k)
+    values[k] = 1.0e-3 * (k + 1);
+
+  for (int step = 0; step < 10; ++step)
+  {
+    // constant current
+    batch.evolve_one_time_step_constant_current(delta_t, 2.0e-3);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_constant_current(delta_t, 2.0e-3);
+    check(batch, circuits);
+    batch.evolve_one_time_step_constant_current(delta_t, values);
+    for (std::size_t k = 0; k < batch.size(); ++k)
+      circuits[k]->evolve_one_time_step_constant_current(delta_t, values[k]);
+    check(batch, circuits);
+    // linear current
+    batch.evolve_one_time_step_linear_current(delta_t, -1.0e-3);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_linear_current(delta_t, -1.0e-3);
+    check(batch, circuits);
+    // constant power
+    batch.evolve_one_time_step_constant_power(delta_t, 1.0e-3);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_constant_power(delta_t, 1.0e-3, "NEWTON");
+    check(batch, circuits);
+    batch.evolve_one_time_step_constant_power(delta_t, values);
+    for (std::size_t k = 0; k < batch.size(); ++k)
+      circuits[k]->evolve_one_time_step_constant_power(delta_t, values[k],
+                                                       "NEWTON");
+    check(batch, circuits);
+    // constant voltage
+    batch.evolve_one_time_step_constant_voltage(delta_t, 2.1);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_constant_voltage(delta_t, 2.1);
+    check(batch, circuits);
+    // linear voltage
+    batch.evolve_one_time_step_linear_voltage(delta_t, 1.9);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_linear_voltage(delta_t, 1.9);
+    check(batch, circuits);
+    // constant load
+    batch.evolve_one_time_step_constant_load(delta_t, 2.0);
+    for (auto circuit : circuits)
+      circuit->evolve_one_time_step_constant_load(delta_t, 2.0);
+    check(batch, circuits);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_series_rc_batch, *boost::unit_test::tolerance(1e-10))
+{
+  cap::SeriesRCBatch uniform_batch(N, initialize_database());
+  BOOST_TEST(uniform_batch.size() == N);
+  run(uniform_batch);
+
+  cap::SeriesRCBatch batch(series_resistances(), std::vector<double>(N, 3.0),
+                           std::vector<double>(N, 1.2));
+  run(batch);
+
+  // Check that the batch throws if the number of values is wrong
+  BOOST_CHECK_THROW(batch.evolve_one_time_step_constant_current(
+                        0.1, std::vector<double>(N + 1)),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(cap::SeriesRCBatch(series_resistances(),
+                                      std::vector<double>(N - 1, 3.0),
+                                      std::vector<double>(N, 1.2)),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_rc_batch,
+                     *boost::unit_test::tolerance(1e-10))
+{
+  cap::ParallelRCBatch uniform_batch(N, initialize_database());
+  BOOST_TEST(uniform_batch.size() == N);
+  run(uniform_batch);
+
+  cap::ParallelRCBatch batch(series_resistances(),
+                             std::vector<double>(N, 2.5e6),
+                             std::vector<double>(N, 3.0),
+                             std::vector<double>(N, 1.2));
+  run(batch);
+
+  // Check that the batch throws if the number of values is wrong
+  BOOST_CHECK_THROW(batch.evolve_one_time_step_constant_voltage(
+                        0.1, std::vector<double>(N - 1)),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_constant_power_from_rest)
+{
+  // The circuits are initially discharged so U = 0 and the Newton iterations
+  // of the circuits advanced one by one would divide by zero. The batch is
+  // initialized with the root of the power equation and does not need the
+  // previous voltage.
+  boost::property_tree::ptree database = initialize_database();
+  database.put("initial_voltage", 0.0);
+  double const delta_t = 0.1;
+  std::vector<double> power(N);
+  for (std::size_t k = 0; k < N; ++k)
+    power[k] = 1.0e-3 * (k + 1);
+
+  cap::SeriesRCBatch series_batch(N, database);
+  cap::ParallelRCBatch parallel_batch(N, database);
+  for (int step = 0; step < 10; ++step)
+  {
+    series_batch.evolve_one_time_step_constant_power(delta_t, power);
+    parallel_batch.evolve_one_time_step_constant_power(delta_t, power);
+    for (std::size_t k = 0; k < N; ++k)
+    {
+      BOOST_TEST(series_batch.U[k] > 0.0);
+      BOOST_TEST(series_batch.U[k] * series_batch.I[k] == power[k],
+                 boost::test_tools::tolerance(1e-12));
+      BOOST_TEST(parallel_batch.U[k] > 0.0);
+      BOOST_TEST(parallel_batch.U[k] * parallel_batch.I[k] == power[k],
+                 boost::test_tools::tolerance(1e-12));
+    }
+  }
+
+  // The power cannot be drawn from the circuits when it exceeds the maximum
+  // power transfer. The state of the batches must be left untouched.
+  std::vector<double> const series_U = series_batch.U;
+  std::vector<double> const series_I = series_batch.I;
+  std::vector<double> const series_U_C = series_batch.U_C;
+  std::vector<double> const parallel_U = parallel_batch.U;
+  std::vector<double> const parallel_I = parallel_batch.I;
+  std::vector<double> const parallel_U_C = parallel_batch.U_C;
+  // Only the last circuit cannot deliver the power.
+  std::vector<double> discharge_power(N, -1.0e-3);
+  discharge_power[N - 1] = -1.0e3;
+  BOOST_CHECK_THROW(
+      series_batch.evolve_one_time_step_constant_power(delta_t, -1.0e3),
+      std::runtime_error);
+  BOOST_CHECK_THROW(series_batch.evolve_one_time_step_constant_power(
+                        delta_t, discharge_power),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(
+      parallel_batch.evolve_one_time_step_constant_power(delta_t, -1.0e3),
+      std::runtime_error);
+  BOOST_CHECK_THROW(parallel_batch.evolve_one_time_step_constant_power(
+                        delta_t, discharge_power),
+                    std::runtime_error);
+  BOOST_TEST(series_batch.U == series_U, boost::test_tools::per_element());
+  BOOST_TEST(series_batch.I == series_I, boost::test_tools::per_element());
+  BOOST_TEST(series_batch.U_C == series_U_C,
+             boost::test_tools::per_element());
+  BOOST_TEST(parallel_batch.U == parallel_U, boost::test_tools::per_element());
+  BOOST_TEST(parallel_batch.I == parallel_I, boost::test_tools::per_element());
+  BOOST_TEST(parallel_batch.U_C == parallel_U_C,
+             boost::test_tools::per_element());
+
+  // The batches can still be advanced after the failure.
+  discharge_power[N - 1] = -1.0e-3;
+  series_batch.evolve_one_time_step_constant_power(delta_t, discharge_power);
+  parallel_batch.evolve_one_time_step_constant_power(delta_t, discharge_power);
+  for (std::size_t k = 0; k < N; ++k)
+  {
+    BOOST_TEST(series_batch.U[k] * series_batch.I[k] == -1.0e-3,
+               boost::test_tools::tolerance(1e-12));
+    BOOST_TEST(parallel_batch.U[k] * parallel_batch.I[k] == -1.0e-3,
+               boost::test_tools::tolerance(1e-12));
+  }
+}
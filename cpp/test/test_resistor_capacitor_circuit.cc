@@ -17,7 +17,9 @@
 #include <string>
 #include <tuple>
 #include <cmath>
+#include <complex>
 #include <iostream>
+#include <vector>
 
 // This file contains the following tests:
 //  - Series RC constant voltage
@@ -28,6 +30,10 @@
 //  - Parallel RC constant voltage
 //  - Parallel RC constant power
 //  - Parallel RC constant load
+//  - Series and parallel RC constant power with a NonlinearSolver
+//  - Series and parallel RC linear power
+//  - Series and parallel RC linear load
+//  - Series and parallel RC impedance
 
 double const R_SERIES = 55.0e-3;
 double const R_PARALLEL = 2.5e6;
@@ -339,3 +345,203 @@ BOOST_AUTO_TEST_CASE(test_parallel_rc_constant_load)
     rc.evolve_one_time_step_constant_load(DELTA_T, R_LOAD);
   }
 }
+
+// The overload taking a NonlinearSolver gives the same result as the one
+// taking the name of the method.
+template <typename RC>
+void check_nonlinear_solver()
+{
+  double const DELTA_T = 0.1 * R_SERIES * C;
+  for (auto const solver :
+       {cap::NonlinearSolver::newton, cap::NonlinearSolver::fixed_point})
+  {
+    RC rc_string(initialize_database(), boost::mpi::communicator());
+    RC rc_enum(initialize_database(), boost::mpi::communicator());
+    set_voltage(rc_string, U);
+    set_voltage(rc_enum, U);
+    for (int step = 0; step < 20; ++step)
+    {
+      double const power = (step < 10) ? P : -P;
+      rc_string.evolve_one_time_step_constant_power(DELTA_T, power,
+                                                    cap::to_string(solver));
+      rc_enum.evolve_one_time_step_constant_power(DELTA_T, power, solver);
+      BOOST_TEST(rc_enum.U == rc_string.U);
+      BOOST_TEST(rc_enum.I == rc_string.I);
+      BOOST_TEST(rc_enum.U_C == rc_string.U_C);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_series_rc_nonlinear_solver)
+{
+  check_nonlinear_solver<cap::SeriesRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_rc_nonlinear_solver)
+{
+  check_nonlinear_solver<cap::ParallelRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_nonlinear_solver_names)
+{
+  for (auto const solver :
+       {cap::NonlinearSolver::newton, cap::NonlinearSolver::fixed_point})
+    BOOST_TEST((cap::to_nonlinear_solver(cap::to_string(solver)) == solver));
+  BOOST_CHECK_THROW(cap::to_nonlinear_solver("INVALID_ROOT_FINDING_METHOD"),
+                    std::runtime_error);
+}
+
+// Advance @p rc by one time step while the power ramps linearly from
+// @p power_begin to @p power_end using many small constant power steps.
+template <typename RC>
+void reference_linear_power(RC &rc, double const delta_t,
+                            double const power_begin, double const power_end)
+{
+  int const n_substeps = 10000;
+  for (int i = 0; i < n_substeps; ++i)
+    rc.evolve_one_time_step_constant_power(
+        delta_t / n_substeps,
+        power_begin + (power_end - power_begin) * (i + 0.5) / n_substeps,
+        cap::NonlinearSolver::newton);
+}
+
+// Same as above for the load.
+template <typename RC>
+void reference_linear_load(RC &rc, double const delta_t,
+                           double const load_begin, double const load_end)
+{
+  int const n_substeps = 1000;
+  for (int i = 0; i < n_substeps; ++i)
+    rc.evolve_one_time_step_constant_load(
+        delta_t / n_substeps,
+        load_begin + (load_end - load_begin) * (i + 0.5) / n_substeps);
+}
+
+// The reference solutions impose the midpoint values of their last substep so
+// only the voltage of the capacitor is compared to them.
+template <typename RC>
+void check_linear_power()
+{
+  double const DELTA_T = 0.1 * R_SERIES * C;
+  double const REFERENCE_TOLERANCE = 1.0e-4; // in percentage units
+  RC rc(initialize_database(), boost::mpi::communicator());
+  RC reference(initialize_database(), boost::mpi::communicator());
+  set_voltage(rc, U);
+  set_voltage(reference, U);
+
+  // The power ramps from charge to discharge.
+  double power_begin = rc.U * rc.I;
+  for (int step = 0; step < 20; ++step)
+  {
+    double const power = P * (1.0 - 0.2 * step);
+    rc.evolve_one_time_step_linear_power(DELTA_T, power);
+    reference_linear_power(reference, DELTA_T, power_begin, power);
+    power_begin = power;
+    BOOST_CHECK_CLOSE(rc.U * rc.I, power, TOLERANCE);
+    BOOST_CHECK_CLOSE(rc.U_C, reference.U_C, REFERENCE_TOLERANCE);
+  }
+
+  // The power cannot be delivered.
+  BOOST_CHECK_THROW(rc.evolve_one_time_step_linear_power(DELTA_T, -1.0e3),
+                    std::runtime_error);
+}
+
+template <typename RC>
+void check_linear_load()
+{
+  double const DELTA_T = 0.1 * R_SERIES * C;
+  double const R_LOAD = 5.0 * R_SERIES;
+  double const REFERENCE_TOLERANCE = 1.0e-4; // in percentage units
+  RC rc(initialize_database(), boost::mpi::communicator());
+  RC reference(initialize_database(), boost::mpi::communicator());
+  set_voltage(rc, U);
+  set_voltage(reference, U);
+
+  // The device is not discharging yet so the load is constant during the
+  // first time step.
+  rc.evolve_one_time_step_linear_load(DELTA_T, R_LOAD);
+  reference.evolve_one_time_step_constant_load(DELTA_T, R_LOAD);
+  BOOST_CHECK_CLOSE(rc.U, reference.U, TOLERANCE);
+  BOOST_CHECK_CLOSE(rc.I, reference.I, TOLERANCE);
+  BOOST_CHECK_CLOSE(rc.U_C, reference.U_C, TOLERANCE);
+
+  // A constant load gives the same result as constant_load.
+  rc.evolve_one_time_step_linear_load(DELTA_T, R_LOAD);
+  reference.evolve_one_time_step_constant_load(DELTA_T, R_LOAD);
+  BOOST_CHECK_CLOSE(rc.U, reference.U, TOLERANCE);
+  BOOST_CHECK_CLOSE(rc.I, reference.I, TOLERANCE);
+  BOOST_CHECK_CLOSE(rc.U_C, reference.U_C, TOLERANCE);
+
+  // The load increases and then decreases.
+  double load_begin = R_LOAD;
+  for (int step = 0; step < 20; ++step)
+  {
+    double const load = R_LOAD * (1.0 + ((step < 10) ? step : 20 - step));
+    rc.evolve_one_time_step_linear_load(DELTA_T, load);
+    reference_linear_load(reference, DELTA_T, load_begin, load);
+    load_begin = load;
+    BOOST_CHECK_CLOSE(-rc.U / rc.I, load, TOLERANCE);
+    BOOST_CHECK_CLOSE(rc.U_C, reference.U_C, REFERENCE_TOLERANCE);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_series_rc_linear_power)
+{
+  check_linear_power<cap::SeriesRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_rc_linear_power)
+{
+  check_linear_power<cap::ParallelRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_series_rc_linear_load)
+{
+  check_linear_load<cap::SeriesRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_rc_linear_load)
+{
+  check_linear_load<cap::ParallelRC>();
+}
+
+BOOST_AUTO_TEST_CASE(test_impedance)
+{
+  double const pi = std::acos(-1.0);
+  // The corner frequency of the parallel RC circuit is 1/(2 pi R_p C).
+  double const corner_frequency = 1.0 / (2.0 * pi * R_PARALLEL * C);
+  std::vector<double> const frequencies = {
+      1e-6 * corner_frequency, corner_frequency, 1e6 * corner_frequency};
+
+  cap::SeriesRC series_rc(initialize_database(), boost::mpi::communicator());
+  std::vector<std::complex<double>> impedance =
+      series_rc.compute_impedance(frequencies);
+  BOOST_TEST(impedance.size() == frequencies.size());
+  for (unsigned int i = 0; i < frequencies.size(); ++i)
+  {
+    BOOST_CHECK_CLOSE(impedance[i].real(), R_SERIES, TOLERANCE);
+    BOOST_CHECK_CLOSE(impedance[i].imag(),
+                      -1.0 / (2.0 * pi * frequencies[i] * C), TOLERANCE);
+  }
+
+  cap::ParallelRC parallel_rc(initialize_database(),
+                              boost::mpi::communicator());
+  impedance = parallel_rc.compute_impedance(frequencies);
+  // Z goes to R_s + R_p at low frequency and to R_s at high frequency. At the
+  // corner frequency, the capacitor and the parallel resistance have the same
+  // impedance.
+  BOOST_CHECK_CLOSE(impedance[0].real(), R_SERIES + R_PARALLEL, 1e-6);
+  BOOST_CHECK_CLOSE(impedance[1].real(), R_SERIES + 0.5 * R_PARALLEL,
+                    TOLERANCE);
+  BOOST_CHECK_CLOSE(impedance[1].imag(), -0.5 * R_PARALLEL, TOLERANCE);
+  BOOST_CHECK_CLOSE(impedance[2].real(), R_SERIES, 1e-2);
+
+  // The state of the device is not modified
+  BOOST_TEST(parallel_rc.U_C == 0.0);
+  BOOST_TEST(parallel_rc.I == 0.0);
+
+  // The frequencies must be greater than zero.
+  BOOST_CHECK_THROW(series_rc.compute_impedance({1.0, 0.0}),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(parallel_rc.compute_impedance({-1.0}), std::runtime_error);
+}
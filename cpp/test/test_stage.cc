@@ -0,0 +1,263 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#define BOOST_TEST_MODULE Stage
+
+#include "main.cc"
+
+#include <cap/data_recorder.h>
+#include <cap/end_criterion.h>
+#include <cap/resistor_capacitor.h>
+#include <cap/stage.h>
+#include <boost/mpi/communicator.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+double const R_SERIES = 50e-3;
+double const C = 3.0;
+
+std::unique_ptr<cap::EnergyStorageDevice> build_device()
+{
+  boost::property_tree::ptree database;
+  database.put("type", "SeriesRC");
+  database.put("series_resistance", R_SERIES);
+  database.put("capacitance", C);
+  return cap::EnergyStorageDevice::build(database, boost::mpi::communicator());
+}
+
+BOOST_AUTO_TEST_CASE(test_constant_current_charge_for_given_time)
+{
+  auto device = build_device();
+  boost::property_tree::ptree ptree;
+  ptree.put("mode", "constant_current");
+  ptree.put("current", 5e-3);
+  ptree.put("end_criterion", "time");
+  ptree.put("duration", 15.0);
+  ptree.put("time_step", 0.1);
+  cap::Stage stage(ptree);
+  BOOST_TEST(stage.get_max_n_time_steps() >= 150u);
+
+  cap::CyclingData data;
+  double time = 0.;
+  std::size_t const n_time_steps = stage.run(*device, time, &data);
+  BOOST_TEST(n_time_steps == 150u);
+  BOOST_TEST(data.size() == n_time_steps);
+  BOOST_TEST(time == 15.0, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.time.back() == time);
+  BOOST_TEST(data.current.back() == 5e-3, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.voltage.back() == R_SERIES * 5e-3 + 5e-3 * 15.0 / C,
+             boost::test_tools::tolerance(1e-10));
+}
+
+BOOST_AUTO_TEST_CASE(test_force_discharge)
+{
+  auto device = build_device();
+  device->evolve_one_time_step_constant_voltage(1.0, 2.0);
+  boost::property_tree::ptree ptree;
+  ptree.put("mode", "constant_voltage");
+  ptree.put("voltage", 0.0);
+  ptree.put("end_criterion", "current_less_than");
+  ptree.put("current_limit", 1e-5);
+  ptree.put("time_step", 0.1);
+  cap::Stage stage(ptree);
+  BOOST_TEST(stage.get_max_n_time_steps() == 0u);
+
+  cap::CyclingData data;
+  double time = 0.;
+  std::size_t const n_time_steps = stage.run(*device, time, &data);
+  BOOST_TEST(n_time_steps >= 1u);
+  BOOST_TEST(data.size() == n_time_steps);
+  BOOST_TEST(data.voltage.back() == 0.0);
+  BOOST_TEST(std::abs(data.current.back()) <= 1e-5);
+  BOOST_TEST(std::abs(data.current[n_time_steps - 2]) > 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_stage)
+{
+  auto device = build_device();
+  boost::property_tree::ptree ptree;
+  ptree.put("stages", 2);
+  ptree.put("cycles", 2);
+  ptree.put("time_step", 1.0);
+  ptree.put("stage_0.mode", "constant_current");
+  ptree.put("stage_0.current", 1.0);
+  ptree.put("stage_0.end_criterion", "compound");
+  ptree.put("stage_0.logical_operator", "or");
+  ptree.put("stage_0.criterion_0.end_criterion", "voltage_greater_than");
+  ptree.put("stage_0.criterion_0.voltage_limit", 2.0);
+  ptree.put("stage_0.criterion_1.end_criterion", "time");
+  ptree.put("stage_0.criterion_1.duration", 100.0);
+  ptree.put("stage_1.mode", "constant_current");
+  ptree.put("stage_1.current", -1.0);
+  ptree.put("stage_1.end_criterion", "time");
+  ptree.put("stage_1.duration", 1.0);
+  ptree.put("stage_1.time_step", 0.1);
+  cap::MultiStage multi_stage(ptree);
+
+  cap::CyclingData const data = multi_stage.run(*device);
+  // The first charge stops as soon as the voltage reaches 2 V, i.e. after 6 s
+  // (R I + t I / C). The capacitor is then discharged during 1 s with 10 time
+  // steps. The second charge starts at 5/3 V so it stops after 1 s.
+  BOOST_TEST(data.size() == 6u + 10u + 1u + 10u);
+  BOOST_TEST(data.time[5] == 6.0, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.time[6] == 6.1, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.voltage[5] >= 2.0);
+  BOOST_TEST(data.voltage[4] < 2.0);
+  BOOST_TEST(data.current[15] == -1.0, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.current[16] == 1.0, boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.time.back() == 9.0, boost::test_tools::tolerance(1e-10));
+  // The memory is reserved once since the duration of every stage is bounded.
+  BOOST_TEST(data.time.capacity() >= data.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_adaptive_time_stepping)
+{
+  auto device = build_device();
+  boost::property_tree::ptree ptree;
+  ptree.put("stages", 3);
+  ptree.put("time_step", 1.0);
+  ptree.put("adaptive_time_stepping.max_time_step", 500.0);
+  ptree.put("stage_0.mode", "constant_current");
+  ptree.put("stage_0.current", 1.0);
+  ptree.put("stage_0.end_criterion", "time");
+  ptree.put("stage_0.duration", 3.0);
+  ptree.put("stage_1.mode", "rest");
+  ptree.put("stage_1.end_criterion", "time");
+  ptree.put("stage_1.duration", 3600.0);
+  ptree.put("stage_2.mode", "hold");
+  ptree.put("stage_2.end_criterion", "time");
+  ptree.put("stage_2.duration", 3600.0);
+  ptree.put("stage_2.adaptive_time_stepping.max_time_step", 1000.0);
+  cap::MultiStage multi_stage(ptree);
+
+  // The closed-form updates of the RC circuit are exact when the current or
+  // the voltage is constant so the time steps grow up to max_time_step.
+  // They are capped so that every stage ends at its duration.
+  cap::CyclingData const data = multi_stage.run(*device);
+  BOOST_TEST(data.size() < 30u);
+  BOOST_TEST(data.time.back() == 7203.0, boost::test_tools::tolerance(1e-10));
+  double const voltage = 3.0 / C;
+  BOOST_TEST(data.voltage.back() == voltage,
+             boost::test_tools::tolerance(1e-10));
+  BOOST_TEST(data.current.back() == 0.0, boost::test_tools::tolerance(1e-10));
+  bool stage_ends_are_recorded[3] = {false, false, false};
+  for (std::size_t i = 0; i < data.size(); ++i)
+  {
+    BOOST_TEST(((i == 0) || (data.time[i] > data.time[i - 1])));
+    if ((i > 0) && (data.time[i] - data.time[i - 1] > 500.0 + 1e-10))
+      BOOST_TEST(data.time[i - 1] >= 3603.0 - 1e-10);
+    for (unsigned int stage = 0; stage < 3; ++stage)
+      if (std::abs(data.time[i] - (3.0 + 3600.0 * stage)) < 1e-10)
+        stage_ends_are_recorded[stage] = true;
+  }
+  for (bool const recorded : stage_ends_are_recorded)
+    BOOST_TEST(recorded);
+
+  // The number of time steps is not bounded anymore.
+  boost::property_tree::ptree stage_database = ptree.get_child("stage_1");
+  stage_database.put("time_step", 1.0);
+  stage_database.put("adaptive_time_stepping.initial_time_step", 2.0);
+  BOOST_TEST(cap::Stage(stage_database).get_max_n_time_steps() == 0u);
+  stage_database.put("adaptive_time_stepping.initial_time_step", -1.0);
+  BOOST_CHECK_THROW(cap::Stage{stage_database}, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_end_criterion)
+{
+  auto device = build_device();
+  boost::property_tree::ptree ptree;
+  ptree.put("end_criterion", "compound");
+  ptree.put("logical_operator", "xor");
+  ptree.put("criterion_0.end_criterion", "skip");
+  ptree.put("criterion_1.end_criterion", "none");
+  auto end_criterion = cap::EndCriterion::build(ptree);
+  end_criterion->reset(0.0, *device);
+  BOOST_TEST(end_criterion->check(0.0, *device));
+  BOOST_TEST(std::isinf(end_criterion->get_max_duration()));
+
+  ptree.put("logical_operator", "and");
+  BOOST_TEST(!cap::EndCriterion::build(ptree)->check(0.0, *device));
+  ptree.put("logical_operator", "nand");
+  BOOST_CHECK_THROW(cap::EndCriterion::build(ptree), std::runtime_error);
+  ptree.put("end_criterion", "energy");
+  BOOST_CHECK_THROW(cap::EndCriterion::build(ptree), std::runtime_error);
+
+  boost::property_tree::ptree current_limit;
+  current_limit.put("end_criterion", "current_less_than");
+  current_limit.put("current_limit", 0.0);
+  BOOST_CHECK_THROW(cap::EndCriterion::build(current_limit),
+                    std::runtime_error);
+
+  boost::property_tree::ptree stage;
+  stage.put("mode", "constant_flux");
+  stage.put("end_criterion", "none");
+  stage.put("time_step", 1.0);
+  BOOST_CHECK_THROW(cap::Stage{stage}, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_data_recorder)
+{
+  auto device = build_device();
+  boost::property_tree::ptree ptree;
+  ptree.put("mode", "constant_current");
+  ptree.put("current", 1.0);
+  ptree.put("end_criterion", "time");
+  ptree.put("duration", 1.0);
+  ptree.put("time_step", 0.1);
+  ptree.put("cycles", 2);
+  cap::MultiStage multi_stage(ptree);
+  cap::CyclingData const reference = multi_stage.run(*device, 0.);
+
+  device = build_device();
+  cap::DataRecorder recorder(8);
+  double time = 0.;
+  BOOST_TEST(multi_stage.run(*device, time, recorder) == 20u);
+  BOOST_TEST(recorder.size() == 20u);
+  BOOST_TEST(recorder.get_last_time() == time);
+  BOOST_TEST(recorder.get_n_chunks() == 3u);
+  BOOST_TEST(recorder.get_n_full_chunks() == 2u);
+  BOOST_TEST(recorder.get_n_values(2) == 4u);
+  BOOST_TEST(recorder.get_n_values_in_memory() == 20u);
+  for (std::size_t i = 0; i < reference.size(); ++i)
+  {
+    BOOST_TEST(recorder.get_values("time", i / 8)[i % 8] ==
+               reference.time[i]);
+    BOOST_TEST(recorder.get_values("current", i / 8)[i % 8] ==
+               reference.current[i]);
+    BOOST_TEST(recorder.get_values("voltage", i / 8)[i % 8] ==
+               reference.voltage[i]);
+  }
+
+  // The chunks that are kept do not move when the others are released, and
+  // the released chunks live as long as they are owned elsewhere.
+  double const *last_chunk = recorder.get_values("voltage", 2);
+  double const *first_chunk = recorder.get_values("time", 0);
+  auto const first_chunk_owner = recorder.get_chunk(0);
+  recorder.release_chunks(2);
+  BOOST_TEST(recorder.get_n_chunks() == 1u);
+  BOOST_TEST(recorder.get_values("voltage", 0) == last_chunk);
+  BOOST_TEST(recorder.size() == 20u);
+  BOOST_TEST(recorder.get_n_values_in_memory() == 4u);
+  BOOST_TEST(first_chunk_owner.use_count() == 1);
+  for (std::size_t i = 0; i < 8; ++i)
+    BOOST_TEST(first_chunk[i] == reference.time[i]);
+  BOOST_CHECK_THROW(recorder.get_values("voltage", 1), std::runtime_error);
+  BOOST_CHECK_THROW(recorder.get_values("power", 0), std::runtime_error);
+  BOOST_CHECK_THROW(recorder.release_chunks(2), std::runtime_error);
+  recorder.release_chunks(1);
+  recorder.report(time, *device);
+  BOOST_TEST(recorder.get_n_values(0) == 1u);
+
+  // Only the SuperCapacitor has a postprocessor.
+  cap::DataRecorder postprocessor_recorder(8, {"joule_heating"});
+  BOOST_CHECK_THROW(postprocessor_recorder.report(time, *device),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(cap::DataRecorder(0), std::runtime_error);
+}
@@ -10,18 +10,25 @@
 #include "main.cc"
 
 #include <cap/energy_storage_device.h>
+#include <cap/supercapacitor.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/info_parser.hpp>
 #include <boost/format.hpp>
+#include <cmath>
+#include <complex>
 #include <memory>
+#include <numeric>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 namespace cap
 {
 
-void check_sanity(std::shared_ptr<cap::EnergyStorageDevice> dev)
+void check_sanity(std::shared_ptr<cap::EnergyStorageDevice> dev,
+                  bool const matrix_free = false)
 {
   for (auto imposed_current : {10e-3, 5e-3, 2e-3})
   {
@@ -51,18 +58,27 @@ void check_sanity(std::shared_ptr<cap::EnergyStorageDevice> dev)
     BOOST_TEST(imposed_power == measured_voltage * measured_current);
   }
 
-  // TODO constant load is not implemented yet
-  BOOST_CHECK_THROW(dev->evolve_one_time_step_constant_load(2.0, 33.0),
+  // The constant load is not implemented with the matrix-free operator.
+  if (matrix_free)
+  {
+    BOOST_CHECK_THROW(dev->evolve_one_time_step_constant_load(2.0, 33.0),
+                      std::runtime_error);
+    return;
+  }
+
+  for (auto imposed_load : {
+           100.0, 33.0,
+       })
+  {
+    dev->evolve_one_time_step_constant_load(2.0, imposed_load);
+    double measured_voltage;
+    dev->get_voltage(measured_voltage);
+    double measured_current;
+    dev->get_current(measured_current);
+    BOOST_TEST(imposed_load == -measured_voltage / measured_current);
+  }
+  BOOST_CHECK_THROW(dev->evolve_one_time_step_constant_load(2.0, 0.0),
                     std::runtime_error);
-  // for (auto imposed_load : { 100.0, 33.0, })
-  // {
-  //     dev->evolve_one_time_step_constant_load(2.0, imposed_load);
-  //     double measured_voltage;
-  //     dev->get_voltage(measured_voltage);
-  //     double measured_current;
-  //     dev->get_current(measured_current);
-  //     BOOST_TEST(imposed_load == - measured_voltage / measured_current);
-  // }
 }
 
 } // end namespace cap
@@ -82,3 +98,230 @@ BOOST_AUTO_TEST_CASE(test_supercapacitor,
   // check sanity
   cap::check_sanity(supercap);
 }
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_matrix_free,
+                     *boost::unit_test::tolerance(relative_tolerance))
+{
+  // build an energy storage device that uses the matrix-free operator
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  ptree.put("solver.matrix_free", true);
+  boost::mpi::communicator world;
+  std::shared_ptr<cap::EnergyStorageDevice> supercap =
+      cap::EnergyStorageDevice::build(ptree, world);
+
+  // check sanity
+  cap::check_sanity(supercap, true);
+}
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_time_integrators,
+                     *boost::unit_test::tolerance(relative_tolerance))
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+
+  // Charge at constant current and return the voltage at the end of the
+  // charge.
+  double const charge_current = 5e-3;
+  double const charge_time = 0.01;
+  auto charge = [&](std::string const &time_integrator, bool const matrix_free,
+                    int const n_time_steps) {
+    ptree.put("solver.time_integrator", time_integrator);
+    ptree.put("solver.matrix_free", matrix_free);
+    std::shared_ptr<cap::EnergyStorageDevice> supercap =
+        cap::EnergyStorageDevice::build(ptree, world);
+    for (int i = 0; i < n_time_steps; ++i)
+      supercap->evolve_one_time_step_constant_current(
+          charge_time / n_time_steps, charge_current);
+    double voltage;
+    supercap->get_voltage(voltage);
+    return voltage;
+  };
+
+  // The error is measured against a solution computed with a much smaller
+  // time step.
+  double const reference_voltage = charge("bdf2", false, 1000);
+  double const backward_euler_error =
+      std::abs(charge("backward_euler", false, 10) - reference_voltage);
+  for (auto const &time_integrator : {"bdf2", "crank_nicolson"})
+  {
+    double const voltage = charge(time_integrator, false, 10);
+    BOOST_TEST(std::abs(voltage - reference_voltage) < backward_euler_error);
+    double const matrix_free_voltage = charge(time_integrator, true, 10);
+    BOOST_TEST(matrix_free_voltage == voltage);
+
+    // Each change of the operating condition restarts with backward Euler.
+    ptree.put("solver.matrix_free", false);
+    cap::check_sanity(cap::EnergyStorageDevice::build(ptree, world));
+  }
+
+  ptree.put("solver.time_integrator", "forward_euler");
+  BOOST_CHECK_THROW(cap::EnergyStorageDevice::build(ptree, world),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_initial_guess)
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+
+  for (bool const matrix_free : {false, true})
+  {
+    ptree.put("solver.matrix_free", matrix_free);
+    std::vector<double> voltages;
+    std::vector<unsigned int> total_iterations;
+    for (auto const &initial_guess : {"previous", "extrapolation"})
+    {
+      ptree.put("solver.initial_guess", initial_guess);
+      std::shared_ptr<cap::EnergyStorageDevice> device =
+          cap::EnergyStorageDevice::build(ptree, world);
+      unsigned int const n_time_steps = 20;
+      for (unsigned int i = 0; i < n_time_steps; ++i)
+        device->evolve_one_time_step_constant_current(1e-3, 5e-3);
+      double voltage;
+      device->get_voltage(voltage);
+      voltages.push_back(voltage);
+
+      // The number of iterations is recorded for each time step.
+      auto supercap = std::dynamic_pointer_cast<cap::SuperCapacitor<2>>(device);
+      BOOST_REQUIRE(supercap != nullptr);
+      std::vector<unsigned int> const &n_iterations =
+          supercap->get_n_iterations();
+      BOOST_TEST(n_iterations.size() == n_time_steps);
+      total_iterations.push_back(std::accumulate(n_iterations.begin(),
+                                                 n_iterations.end(), 0u));
+    }
+    // The initial guess only changes the number of iterations.
+    BOOST_TEST(voltages[1] == voltages[0], boost::test_tools::tolerance(1e-8));
+    BOOST_TEST(total_iterations[1] <= total_iterations[0]);
+  }
+
+  ptree.put("solver.initial_guess", "zero");
+  BOOST_CHECK_THROW(cap::EnergyStorageDevice::build(ptree, world),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_constant_power)
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+
+  for (bool const matrix_free : {false, true})
+  {
+    ptree.put("solver.matrix_free", matrix_free);
+    std::shared_ptr<cap::EnergyStorageDevice> supercap =
+        cap::EnergyStorageDevice::build(ptree, world);
+    double const initial_voltage = 2.0;
+    supercap->evolve_one_time_step_constant_voltage(2.0, initial_voltage);
+    auto const snapshot = supercap->snapshot();
+
+    // The current is computed such that the power is exactly the imposed
+    // power. Imposing this current gives back the same voltage.
+    double const power = -1e-3;
+    supercap->evolve_one_time_step_constant_power(0.1, power);
+    double power_voltage;
+    supercap->get_voltage(power_voltage);
+    BOOST_TEST(power_voltage < initial_voltage);
+
+    supercap->restore(*snapshot);
+    supercap->evolve_one_time_step_constant_current(0.1, power / power_voltage);
+    double current_voltage;
+    supercap->get_voltage(current_voltage);
+    BOOST_TEST(current_voltage == power_voltage,
+               boost::test_tools::tolerance(1e-8));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_power_ramp)
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+
+  for (bool const matrix_free : {false, true})
+  {
+    ptree.put("solver.matrix_free", matrix_free);
+    std::vector<double> voltages;
+    for (std::string const time_integrator : {"backward_euler", "bdf2"})
+    {
+      ptree.put("solver.time_integrator", time_integrator);
+      std::shared_ptr<cap::EnergyStorageDevice> supercap =
+          cap::EnergyStorageDevice::build(ptree, world);
+      supercap->evolve_one_time_step_constant_voltage(2.0, 2.0);
+      // The power changes at every time step. The power is still imposed
+      // exactly.
+      for (int step = 1; step <= 10; ++step)
+      {
+        double const power = -1e-4 * step;
+        supercap->evolve_one_time_step_constant_power(0.1, power);
+        double voltage;
+        double current;
+        supercap->get_voltage(voltage);
+        supercap->get_current(current);
+        BOOST_TEST(voltage * current == power,
+                   boost::test_tools::tolerance(1e-8));
+      }
+      double voltage;
+      supercap->get_voltage(voltage);
+      voltages.push_back(voltage);
+    }
+    // A new power does not restart the time integrator. If it did, BDF2
+    // would fall back to backward Euler at every time step and give the same
+    // voltage.
+    BOOST_TEST(std::abs(voltages[0] - voltages[1]) > 1e-10);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_supercapacitor_impedance)
+{
+  boost::property_tree::ptree ptree;
+  boost::property_tree::info_parser::read_info("super_capacitor.info", ptree);
+  boost::mpi::communicator world;
+
+  std::vector<double> const frequencies = {1e-2, 1e-1, 1e0, 1e1, 1e2};
+  std::vector<std::vector<std::complex<double>>> impedances;
+  for (bool const matrix_free : {false, true})
+  {
+    ptree.put("solver.matrix_free", matrix_free);
+    std::shared_ptr<cap::EnergyStorageDevice> supercap =
+        cap::EnergyStorageDevice::build(ptree, world);
+    supercap->evolve_one_time_step_constant_current(0.1, 5e-3);
+    double voltage;
+    supercap->get_voltage(voltage);
+
+    std::vector<std::complex<double>> const impedance =
+        supercap->compute_impedance(frequencies);
+    BOOST_TEST(impedance.size() == frequencies.size());
+    // The device behaves like a resistance in series with a capacitance: the
+    // resistance is positive, the reactance is negative, and the magnitude
+    // decreases with the frequency.
+    for (unsigned int i = 0; i < frequencies.size(); ++i)
+    {
+      BOOST_TEST(impedance[i].real() > 0.);
+      BOOST_TEST(impedance[i].imag() < 0.);
+      if (i > 0)
+        BOOST_TEST(std::abs(impedance[i]) < std::abs(impedance[i - 1]));
+    }
+    impedances.push_back(impedance);
+
+    // The state of the device is not modified.
+    double new_voltage;
+    supercap->get_voltage(new_voltage);
+    BOOST_TEST(new_voltage == voltage);
+
+    BOOST_CHECK_THROW(supercap->compute_impedance({1e-2, 0.}),
+                      std::runtime_error);
+  }
+
+  // The matrices are assembled even if the matrix-free operator is used.
+  for (unsigned int i = 0; i < frequencies.size(); ++i)
+  {
+    BOOST_TEST(impedances[1][i].real() == impedances[0][i].real(),
+               boost::test_tools::tolerance(1e-8));
+    BOOST_TEST(impedances[1][i].imag() == impedances[0][i].imag(),
+               boost::test_tools::tolerance(1e-8));
+  }
+}
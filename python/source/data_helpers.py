@@ -4,6 +4,7 @@
 # without copyright and license information. Please refer to the file LICENSE
 # for the text and further information on this license.
 
+from .PyCap import DataRecorder
 from matplotlib import pyplot
 from numpy import array, append
 from h5py import File
@@ -12,7 +13,9 @@ from sys import stdout, exit
 __all__ = [
     'initialize_data',
     'report_data',
+    'get_last_time',
     'save_data',
+    'stream_data',
     'plot_data',
     'open_file_in_write_mode',
 ]
@@ -27,17 +30,52 @@ def initialize_data():
 
 
 def report_data(data, time, device):
+    if isinstance(data, DataRecorder):
+        data.report(time, device)
+        return
+    # This copies the whole arrays, use a DataRecorder for long runs.
     data['time'] = append(data['time'], time)
     data['current'] = append(data['current'], device.get_current())
     data['voltage'] = append(data['voltage'], device.get_voltage())
 
 
+def get_last_time(data):
+    if isinstance(data, DataRecorder):
+        return data.get_last_time()
+    if data and len(data['time']) > 0:
+        return data['time'][-1]
+    return 0.0
+
+
 def save_data(data, path, fout):
     fout[path + '/time'] = data['time']
     fout[path + '/current'] = data['current']
     fout[path + '/voltage'] = data['voltage']
 
 
+def stream_data(recorder, path, fout, flush=False):
+    """
+    Append the full chunks of a DataRecorder to resizable datasets and
+    release them. If flush is True, the last chunk is also written even if it
+    is not full; call it only once at the end of the run in that case.
+    """
+    n_chunks = recorder.get_n_chunks() if flush \
+        else recorder.get_n_full_chunks()
+    for key in recorder.get_keys():
+        name = path + '/' + key
+        if name not in fout:
+            fout.create_dataset(name, shape=(0,), maxshape=(None,),
+                                dtype=float,
+                                chunks=(recorder.get_chunk_size(),))
+        dataset = fout[name]
+        for chunk in range(n_chunks):
+            values = recorder.get_chunk(key, chunk)
+            size = dataset.shape[0]
+            dataset.resize((size + len(values),))
+            dataset[size:] = values
+    recorder.release_chunks(n_chunks)
+
+
 def plot_data(data):
     time = data['time']
     current = data['current']
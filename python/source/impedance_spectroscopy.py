@@ -72,7 +72,7 @@ def plot_bode(data):
     axarr[1].yaxis.set_label_coords(labelx, labely)
 
 
-def run_one_cycle(device, ptree):
+def run_one_cycle(device, ptree, data=None):
     frequency = ptree.get_double('frequency')
     dc_voltage = ptree.get_double('dc_voltage')
     harmonics = array(ptree.get_array_int('harmonics'))
@@ -82,7 +82,8 @@ def run_one_cycle(device, ptree):
     cycles = ptree.get_int('cycles')
     time_step = 1. / (frequency * steps_per_cycle)
     time = 0.0
-    data = initialize_data()
+    if data is None:
+        data = initialize_data()
     for cycle in range(cycles):
         for step in range(steps_per_cycle):
             time += time_step
@@ -376,6 +377,14 @@ class ElectrochemicalImpedanceSpectroscopy(Experiment):
     Measures the complex impedance of an energy storage device as a function of
     the frequency,
 
+    The option ``method`` selects how the impedance is measured:
+        - 'time_domain' (default): a sinusoidal voltage is imposed during
+          several cycles at each frequency and the impedance is extracted by
+          Fourier analysis.
+        - 'frequency_domain': the device computes its impedance directly with
+          EnergyStorageDevice.compute_impedance(). It is much faster but it
+          only gives the small-signal impedance and ``fout`` is ignored.
+
     Attributes
     ----------
     _frequencies : numpy.array of float
@@ -440,6 +449,20 @@ class ElectrochemicalImpedanceSpectroscopy(Experiment):
 
     def run(self, device, fout=None):
         self._extra_data = device.inspect()
+        method = self._ptree.get_string_with_default_value('method',
+                                                           'time_domain')
+        if method == 'frequency_domain':
+            # The impedance of the linearized device is computed directly
+            # from its matrices. There is no time series to save.
+            self._data['frequency'] = append(self._data['frequency'],
+                                             self._frequencies)
+            self._data['impedance'] = append(
+                self._data['impedance'],
+                device.compute_impedance(self._frequencies))
+            self.notify()
+            return
+        if method != 'time_domain':
+            raise RuntimeError("invalid EIS method '" + method + "'")
         for frequency in self._frequencies:
             self._ptree.put_double('frequency', frequency)
             data = run_one_cycle(device, self._ptree)
@@ -7,10 +7,11 @@
 from numpy import trapz, count_nonzero, array, append, power, argsort
 from matplotlib import pyplot
 from copy import copy
-from .PyCap import PropertyTree
+from .PyCap import PropertyTree, EnergyStorageDevice
 from .charge_discharge import Charge, Discharge
 from .data_helpers import initialize_data, save_data
 from .observer_pattern import Experiment, Observer
+from mpi4py import MPI
 
 __all__ = ['plot_ragone', 'retrieve_performance_data',
            'RagonePlot', 'RagoneAnalysis']
@@ -35,7 +36,7 @@ def plot_ragone(data, figure=None, ls='r-o'):
     pyplot.gca().get_yaxis().set_tick_params(labelsize=tick_fontsize)
 
 
-def run_discharge(device, ptree):
+def run_charge(device, ptree):
     data = initialize_data()
 
     # (re)charge the device
@@ -57,6 +58,20 @@ def run_discharge(device, ptree):
 
     data['time'] -= data['time'][-1]
 
+    return data
+
+
+def run_discharge(device, ptree, charged_state=None):
+    # charged_state is a snapshot of the charged device together with the
+    # data returned by run_charge(). When it is given, the device is restored
+    # instead of being recharged.
+    if charged_state is None:
+        data = run_charge(device, ptree)
+    else:
+        snapshot, charge_data = charged_state
+        device.restore(snapshot)
+        data = {key: charge_data[key].copy() for key in charge_data}
+
     # discharge at constant power
     discharge_power = ptree.get_double('discharge_power')
     final_voltage = ptree.get_double('final_voltage')
@@ -89,6 +104,14 @@ def examine_discharge(data):
     return [energy_in, energy_out]
 
 
+def save_measurements(measurements, discharge_power, fout):
+    for measurement, data in measurements.items():
+        path = 'ragone_chart_data'
+        path += '/power=' + str(discharge_power) + 'W'
+        path += '/' + measurement
+        save_data(data, path, fout)
+
+
 def retrieve_performance_data(fin):
     path = 'ragone_chart_data'
     performance_data = {'power': array([], dtype=float),
@@ -183,38 +206,119 @@ class RagoneAnalysis(Experiment):
         }
 
     def run(self, device, fout=None):
-        discharge_power = self._discharge_power_lower_limit
-        while discharge_power <= self._discharge_power_upper_limit:
-            # print discharge_power
+        charged_state = self._charge(device)
+        for discharge_power in self._get_discharge_powers():
             self._ptree.put_double('discharge_power', discharge_power)
             try:
-                # this loop control the number of time steps in the discharge
-                for measurement in ['first', 'second']:
-                    data = run_discharge(device, self._ptree)
-                    if fout:
-                        path = 'ragone_chart_data'
-                        path += '/power=' + str(discharge_power) + 'W'
-                        path += '/' + measurement
-                        save_data(data, path, fout)
-                    energy_in, energy_out = examine_discharge(data)
-                    steps = count_nonzero(data['time'] > 0)
-                    if steps >= self._min_steps_per_discharge:
-                        break
-                    else:
-                        time_step = data['time'][-1]
-                        time_step /= self._max_steps_per_discharge
-                        self._ptree.put_double('time_step', time_step)
-
+                energy, measurements = self._measure(device, self._ptree,
+                                                     charged_state)
             except RuntimeError:
                 print('Failed to discharge at {0} watt'.format(
                     discharge_power))
                 break
-            self._data['energy'] = append(self._data['energy'],
-                                          -energy_out)
+            if fout:
+                save_measurements(measurements, discharge_power, fout)
+            self._data['energy'] = append(self._data['energy'], energy)
             self._data['power'] = append(self._data['power'],
                                          discharge_power)
-            discharge_power *= power(10.0, 1.0 / self._steps_per_decade)
             self.notify()
 
+    def run_parallel(self, device_database, fout=None, comm=MPI.COMM_WORLD,
+                     ranks_per_device=1):
+        '''Distribute the discharge powers over groups of processes.
+
+        The processes of comm are split in groups of ranks_per_device. Each
+        group builds its own device from device_database and measures every
+        n-th discharge power, where n is the number of groups. As in run(),
+        the device is charged once and every discharge starts from an
+        in-memory snapshot of the charged device so the points are
+        independent. Unlike in run(), each point starts from the initial time
+        step.
+
+        Parameters
+        ----------
+        device_database : PropertyTree
+            Database used to build the devices.
+        fout : h5py.File
+            Only used on the rank 0 of comm.
+        comm : mpi4py.MPI.Comm
+        ranks_per_device : int
+            Number of processes of the communicator of each device.
+        '''
+        if comm.size % ranks_per_device != 0:
+            raise RuntimeError('The number of processes should be a multiple '
+                               'of ranks_per_device')
+        n_groups = comm.size // ranks_per_device
+        group = comm.rank // ranks_per_device
+        device_comm = comm.Split(group, comm.rank)
+        device = EnergyStorageDevice(device_database, device_comm)
+        charged_state = self._charge(device)
+        save = comm.bcast(bool(fout), root=0)
+        discharge_powers = self._get_discharge_powers()
+        results = []
+        for i in range(group, len(discharge_powers), n_groups):
+            ptree = copy(self._ptree)
+            ptree.put_double('time_step', self._time_step_initial_guess)
+            ptree.put_double('discharge_power', discharge_powers[i])
+            try:
+                energy, measurements = self._measure(device, ptree,
+                                                     charged_state)
+            except RuntimeError:
+                energy, measurements = None, None
+            results.append((i, energy, measurements if save else None))
+        # only the first process of each group sends its results
+        results = comm.gather(results if device_comm.rank == 0 else [],
+                              root=0)
+        energies = None
+        if comm.rank == 0:
+            results = sorted([result for group_results in results
+                              for result in group_results],
+                             key=lambda result: result[0])
+            energies = []
+            # as in run(), stop at the first power that failed
+            for i, energy, measurements in results:
+                if energy is None:
+                    print('Failed to discharge at {0} watt'.format(
+                        discharge_powers[i]))
+                    break
+                if fout:
+                    save_measurements(measurements, discharge_powers[i],
+                                      fout)
+                energies.append(energy)
+        energies = comm.bcast(energies, root=0)
+        self._data['energy'] = append(self._data['energy'], energies)
+        self._data['power'] = append(self._data['power'],
+                                     discharge_powers[:len(energies)])
+        if comm.rank == 0:
+            self.notify()
+
+    def _get_discharge_powers(self):
+        discharge_powers = []
+        discharge_power = self._discharge_power_lower_limit
+        while discharge_power <= self._discharge_power_upper_limit:
+            discharge_powers.append(discharge_power)
+            discharge_power *= power(10.0, 1.0 / self._steps_per_decade)
+        return discharge_powers
+
+    def _charge(self, device):
+        data = run_charge(device, self._ptree)
+        return device.snapshot(), data
+
+    def _measure(self, device, ptree, charged_state):
+        # this loop control the number of time steps in the discharge
+        measurements = {}
+        for measurement in ['first', 'second']:
+            data = run_discharge(device, ptree, charged_state)
+            measurements[measurement] = data
+            energy_in, energy_out = examine_discharge(data)
+            steps = count_nonzero(data['time'] > 0)
+            if steps >= self._min_steps_per_discharge:
+                break
+            else:
+                time_step = data['time'][-1]
+                time_step /= self._max_steps_per_discharge
+                ptree.put_double('time_step', time_step)
+        return -energy_out, measurements
+
 
 Experiment._builders['RagoneAnalysis'] = RagoneAnalysis
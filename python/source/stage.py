@@ -4,39 +4,78 @@
 # without copyright and license information. Please refer to the file LICENSE
 # for the text and further information on this license.
 
+from .PyCap import run_multi_stage, DataRecorder
 from .time_evolution import TimeEvolution
 from .end_criterion import EndCriterion
-from .data_helpers import report_data
+from .data_helpers import get_last_time
+from numpy import concatenate
+from copy import copy
 
 __all__ = ['Stage', 'MultiStage']
 
 
+def _get_recorder(data):
+    # The steps are always recorded in a DataRecorder, the dict of arrays is
+    # extended once at the end of the run by _extend_data().
+    if isinstance(data, DataRecorder):
+        return data
+    if data:
+        return DataRecorder()
+    return None
+
+
+def _extend_data(data, recorder):
+    if data and not isinstance(data, DataRecorder):
+        for key in ['time', 'current', 'voltage']:
+            data[key] = concatenate((data[key], recorder[key]))
+
+
 class Stage:
 
     def __init__(self, ptree):
         self.evolve_one_time_step = TimeEvolution.factory(ptree)
         self.end_criterion = EndCriterion.factory(ptree)
         self.time_step = ptree.get_double('time_step')
+        self._ptree = copy(ptree)
+        self._stock = (self.evolve_one_time_step, self.end_criterion,
+                       self.time_step)
 
     def run(self, device, data=None):
         if data is None:
             data = {}
-        if not data:
-            time = 0.0
-        elif len(data['time']) > 0:
-            time = data['time'][-1]
-        else:
-            time = 0.0
+        recorder = _get_recorder(data)
+        steps, _ = self._run(device, get_last_time(data), recorder)
+        _extend_data(data, recorder)
+
+        return steps
+
+    def _run(self, device, time, recorder):
+        # The loop over the time steps is done in C++ unless the evolution,
+        # the end criterion, or the time step built from the ptree have been
+        # replaced.
+        evolve_one_time_step, end_criterion, time_step = self._stock
+        if self.evolve_one_time_step is evolve_one_time_step and \
+                self.end_criterion is end_criterion and \
+                self.time_step == time_step:
+            if recorder is None:
+                # Only count the time steps, nothing is recorded.
+                return run_multi_stage(device, self._ptree, time, None, False)
+            steps = recorder.size()
+            run_multi_stage(device, self._ptree, time, recorder)
+            steps = recorder.size() - steps
+            return steps, recorder.get_last_time() if steps else time
+
         steps = 0
         self.end_criterion.reset(time, device)
-        while not self.end_criterion.check(time + 0.01 * self.time_step, device):
+        while not self.end_criterion.check(time + 0.01 * self.time_step,
+                                           device):
             steps += 1
             time += self.time_step
             self.evolve_one_time_step(device, self.time_step)
-            if data:
-                report_data(data, time, device)
+            if recorder is not None:
+                recorder.report(time, device)
 
-        return steps
+        return steps, time
 
 
 class MultiStage(Stage):
@@ -56,9 +95,13 @@ class MultiStage(Stage):
     def run(self, device, data=None):
         if data is None:
             data = {}
+        recorder = _get_recorder(data)
+        time = get_last_time(data)
         steps = 0
         for cycle in range(self.cycles):
             for stage in self.stages:
-                steps += stage.run(device, data)
+                stage_steps, time = stage._run(device, time, recorder)
+                steps += stage_steps
+        _extend_data(data, recorder)
 
         return steps
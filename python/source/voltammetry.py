@@ -6,7 +6,7 @@
 
 from operator import lt, gt, sub, add
 from matplotlib import pyplot
-from .data_helpers import report_data
+from .data_helpers import report_data, get_last_time
 
 __all__ = ['CyclicVoltammetry', 'plot_cyclic_voltammogram']
 
@@ -40,10 +40,7 @@ def ramp(device, data, voltage_limit, scan_rate, step_size):
         compare = lt
         update = add
     time_step = step_size / scan_rate
-    if data:
-        time = data['time'][-1]
-    else:
-        time = 0
+    time = get_last_time(data)
     voltage = initial_voltage
     while compare(voltage, update(final_voltage, -0.01 * step_size)):
         step += 1
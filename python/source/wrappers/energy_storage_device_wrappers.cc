@@ -9,9 +9,15 @@
 #include <cap/default_inspector.h>
 #include <cap/supercapacitor.h>
 #include <mpi4py/mpi4py.h>
+#include <algorithm>
+#include <complex>
+#include <stdexcept>
+#include <string>
 
 namespace pycap {
 
+namespace np = boost::python::numpy;
+
 double get_current(cap::EnergyStorageDevice const & dev)
 {
     double current;
@@ -76,6 +82,95 @@ boost::python::dict inspect(cap::EnergyStorageDevice & dev,
     return data;
 }
 
+std::vector<double> to_vector(np::ndarray const & array)
+{
+    if (array.get_nd() != 1)
+      throw std::runtime_error("Expected a one-dimensional array");
+    np::ndarray const values = array.astype(np::dtype::get_builtin<double>());
+    double const * data = reinterpret_cast<double const *>(values.get_data());
+    Py_intptr_t const stride = values.strides(0) / sizeof(double);
+    std::vector<double> vector(values.shape(0));
+    for (std::size_t k = 0; k < vector.size(); ++k)
+      vector[k] = data[k * stride];
+    return vector;
+}
+
+// Return a pointer to the data of an output array after checking that it can
+// hold n values.
+double * get_output_buffer(np::ndarray & array, std::size_t const n,
+                           std::string const & name)
+{
+    if ((array.get_nd() != 1) ||
+        !np::equivalent(array.get_dtype(), np::dtype::get_builtin<double>()))
+      throw std::runtime_error("'" + name + "' should be a one-dimensional "
+                               "array of float64");
+    int const required_flags = np::ndarray::C_CONTIGUOUS |
+                               np::ndarray::ALIGNED | np::ndarray::WRITEABLE;
+    if ((array.get_flags() & required_flags) != required_flags)
+      throw std::runtime_error("'" + name + "' should be contiguous and "
+                               "writeable");
+    if (static_cast<std::size_t>(array.shape(0)) < n)
+      throw std::runtime_error("'" + name + "' is too small");
+    return reinterpret_cast<double *>(array.get_data());
+}
+
+void evolve_n_time_steps(cap::EnergyStorageDevice & dev,
+                         EvolveOneTimeStep evolve, double const time_step,
+                         np::ndarray const & values, np::ndarray & time,
+                         np::ndarray & voltage, np::ndarray & current,
+                         double const initial_time)
+{
+    // Everything that touches a Python object is done before releasing the
+    // GIL.
+    std::vector<double> const setpoints = to_vector(values);
+    std::size_t const n = setpoints.size();
+    double * const time_data = get_output_buffer(time, n, "time");
+    double * const voltage_data = get_output_buffer(voltage, n, "voltage");
+    double * const current_data = get_output_buffer(current, n, "current");
+
+    ScopedGILRelease const release;
+    double t = initial_time;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+      (dev.*evolve)(time_step, setpoints[k]);
+      t += time_step;
+      time_data[k] = t;
+      dev.get_voltage(voltage_data[k]);
+      dev.get_current(current_data[k]);
+    }
+}
+
+np::ndarray compute_impedance(cap::EnergyStorageDevice const & dev,
+                              np::ndarray const & frequencies)
+{
+    std::vector<double> const f = to_vector(frequencies);
+    std::vector<std::complex<double>> impedance;
+    {
+      ScopedGILRelease const release;
+      impedance = dev.compute_impedance(f);
+    }
+    np::ndarray array =
+        np::empty(boost::python::make_tuple(impedance.size()),
+                  np::dtype::get_builtin<std::complex<double>>());
+    std::copy(impedance.begin(), impedance.end(),
+              reinterpret_cast<std::complex<double> *>(array.get_data()));
+    return array;
+}
+
+std::shared_ptr<cap::EnergyStorageDeviceSnapshot>
+snapshot(cap::EnergyStorageDevice const & dev)
+{
+    ScopedGILRelease const release;
+    return std::shared_ptr<cap::EnergyStorageDeviceSnapshot>(dev.snapshot());
+}
+
+void restore(cap::EnergyStorageDevice & dev,
+             cap::EnergyStorageDeviceSnapshot const & snapshot)
+{
+    ScopedGILRelease const release;
+    dev.restore(snapshot);
+}
+
 std::shared_ptr<cap::EnergyStorageDevice>
 build_energy_storage_device(boost::python::object & py_ptree,
                             boost::python::object & py_comm)
@@ -5,16 +5,84 @@
 #include <boost/python/object.hpp>
 #include <boost/python/wrapper.hpp>
 #include <boost/python/dict.hpp>
+#include <boost/python/numpy.hpp>
 #include <string>
+#include <vector>
 
 namespace pycap {
 
+// Release the global interpreter lock for the lifetime of the object so that
+// other Python threads can run while the device computes. Nothing that
+// touches a Python object may be done while the lock is released.
+class ScopedGILRelease
+{
+public:
+  ScopedGILRelease() : _state(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(_state); }
+  ScopedGILRelease(ScopedGILRelease const &) = delete;
+  ScopedGILRelease & operator=(ScopedGILRelease const &) = delete;
+
+private:
+  PyThreadState * _state;
+};
+
+typedef void (cap::EnergyStorageDevice::*EvolveOneTimeStep)(double, double);
+
+// Evolve the device by one time step without holding the GIL.
+template <EvolveOneTimeStep evolve>
+void evolve_one_time_step(cap::EnergyStorageDevice & device,
+                          double const time_step, double const value)
+{
+  ScopedGILRelease const release;
+  (device.*evolve)(time_step, value);
+}
+
+// Evolve the device by one time step per entry of values and write the time,
+// voltage, and current after each step in the caller's arrays. The arrays
+// must be one-dimensional, contiguous, writeable arrays of float64 with at
+// least as many entries as values. The GIL is released during the loop.
+void evolve_n_time_steps(cap::EnergyStorageDevice & device,
+                         EvolveOneTimeStep evolve, double const time_step,
+                         boost::python::numpy::ndarray const & values,
+                         boost::python::numpy::ndarray & time,
+                         boost::python::numpy::ndarray & voltage,
+                         boost::python::numpy::ndarray & current,
+                         double const initial_time);
+
+template <EvolveOneTimeStep evolve>
+void evolve_n_time_steps(cap::EnergyStorageDevice & device,
+                         double const time_step,
+                         boost::python::numpy::ndarray const & values,
+                         boost::python::numpy::ndarray & time,
+                         boost::python::numpy::ndarray & voltage,
+                         boost::python::numpy::ndarray & current,
+                         double const initial_time)
+{
+  evolve_n_time_steps(device, evolve, time_step, values, time, voltage,
+                      current, initial_time);
+}
+
 double get_current(cap::EnergyStorageDevice const & device);
 double get_voltage(cap::EnergyStorageDevice const & device);
 // TODO: may want const reference here
 boost::python::dict inspect(cap::EnergyStorageDevice & device,
                             const std::string & type = "default");
 
+// Copy a one-dimensional array into a vector of double.
+std::vector<double> to_vector(boost::python::numpy::ndarray const & array);
+
+boost::python::numpy::ndarray
+compute_impedance(cap::EnergyStorageDevice const & device,
+                  boost::python::numpy::ndarray const & frequencies);
+
+// Take an in-memory snapshot of the state of the device. Unlike save(), this
+// does not touch the filesystem.
+std::shared_ptr<cap::EnergyStorageDeviceSnapshot>
+snapshot(cap::EnergyStorageDevice const & device);
+
+void restore(cap::EnergyStorageDevice & device,
+             cap::EnergyStorageDeviceSnapshot const & snapshot);
+
 std::shared_ptr<cap::EnergyStorageDevice>
 build_energy_storage_device(boost::python::object & py_ptree,
                             boost::python::object & py_comm);
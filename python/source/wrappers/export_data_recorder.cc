@@ -0,0 +1,164 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <cap/data_recorder.h>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <boost/python/stl_iterator.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pycap
+{
+
+namespace np = boost::python::numpy;
+
+std::shared_ptr<cap::DataRecorder>
+build_data_recorder(std::size_t const chunk_size,
+                    boost::python::object const & keys)
+{
+  std::vector<std::string> const post_processor_keys(
+      (boost::python::stl_input_iterator<std::string>(keys)),
+      boost::python::stl_input_iterator<std::string>());
+  return std::make_shared<cap::DataRecorder>(chunk_size, post_processor_keys);
+}
+
+boost::python::list get_keys(cap::DataRecorder const & recorder)
+{
+  boost::python::list keys;
+  for (auto const & key : recorder.get_keys())
+    keys.append(key);
+  return keys;
+}
+
+typedef std::shared_ptr<std::vector<double> const> ChunkOwner;
+
+void delete_chunk_owner(PyObject * capsule)
+{
+  delete static_cast<ChunkOwner *>(PyCapsule_GetPointer(capsule, nullptr));
+}
+
+// The array is a read-only view on the chunk. The capsule owning the array
+// shares the ownership of the chunk so that the view stays valid after the
+// chunk has been released by the recorder.
+np::ndarray get_chunk(cap::DataRecorder const & recorder,
+                      std::string const & key, std::size_t const chunk)
+{
+  double const * values = recorder.get_values(key, chunk);
+  std::unique_ptr<ChunkOwner> chunk_owner(
+      new ChunkOwner(recorder.get_chunk(chunk)));
+  boost::python::object const owner(boost::python::handle<>(
+      PyCapsule_New(chunk_owner.get(), nullptr, &delete_chunk_owner)));
+  chunk_owner.release();
+  return np::from_data(values, np::dtype::get_builtin<double>(),
+                       boost::python::make_tuple(recorder.get_n_values(chunk)),
+                       boost::python::make_tuple(sizeof(double)), owner);
+}
+
+// Concatenate the chunks in memory. This copies the values, use get_chunk()
+// to avoid it.
+np::ndarray get_item(cap::DataRecorder const & recorder,
+                     std::string const & key)
+{
+  std::size_t const n_chunks = recorder.get_n_chunks();
+  np::ndarray array = np::empty(
+      boost::python::make_tuple(recorder.get_n_values_in_memory()),
+                                np::dtype::get_builtin<double>());
+  double * data = reinterpret_cast<double *>(array.get_data());
+  for (std::size_t chunk = 0; chunk < n_chunks; ++chunk)
+  {
+    double const * values = recorder.get_values(key, chunk);
+    data = std::copy(values, values + recorder.get_n_values(chunk), data);
+  }
+  return array;
+}
+
+bool always_true(cap::DataRecorder const &) { return true; }
+
+char const data_recorder_docstring[] =
+  "Record the time, the current, the voltage, and optionally quantities     \n"
+  "computed by the postprocessor after each time step. The values are       \n"
+  "stored in chunks of fixed size so that recording is O(1) per time step.  \n"
+  "The chunks can be accessed as numpy arrays without copy and written to a \n"
+  "file as soon as they are full (see pycap.stream_data). len() and []      \n"
+  "only cover the time steps in memory, size() counts the released ones.    \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "chunk_size : int                                                         \n"
+  "    The number of time steps stored in a chunk (the default is 4096).    \n"
+  "keys : list of str                                                       \n"
+  "    Quantities read from the postprocessor of a SuperCapacitor in        \n"
+  "    addition to the time, the current, and the voltage.                  \n"
+  ;
+
+char const get_chunk_docstring[] =
+  "Return a read-only view on the values of a quantity in a chunk. The view \n"
+  "keeps the chunk alive after it has been released.                        \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "key : str                                                                \n"
+  "chunk : int                                                              \n"
+  "    The index of the chunk among the chunks in memory.                   \n"
+  ;
+
+char const release_chunks_docstring[] =
+  "Free the memory of the first chunks, e.g. after they have been written   \n"
+  "to a file. The remaining chunks are renumbered from zero.                \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "n_chunks : int                                                           \n"
+  ;
+
+void export_data_recorder()
+{
+  boost::python::class_<cap::DataRecorder, std::shared_ptr<cap::DataRecorder>,
+                        boost::noncopyable>(
+      "DataRecorder", data_recorder_docstring, boost::python::no_init)
+      .def("__init__",
+           boost::python::make_constructor(
+               &build_data_recorder, boost::python::default_call_policies(),
+               (boost::python::arg("chunk_size") = 4096,
+                boost::python::arg("keys") = boost::python::list())))
+      .def("report", &cap::DataRecorder::report,
+           "Append the time and the state of the device.",
+           boost::python::args("self", "time", "device"))
+      .def("get_keys", &get_keys, "Return the names of the quantities.",
+           boost::python::args("self"))
+      .def("get_last_time", &cap::DataRecorder::get_last_time,
+           "Return the time of the last time step or 0.",
+           boost::python::args("self"))
+      .def("get_chunk_size", &cap::DataRecorder::get_chunk_size,
+           boost::python::args("self"))
+      .def("get_n_chunks", &cap::DataRecorder::get_n_chunks,
+           "Return the number of chunks in memory.",
+           boost::python::args("self"))
+      .def("get_n_full_chunks", &cap::DataRecorder::get_n_full_chunks,
+           "Return the number of full chunks in memory.",
+           boost::python::args("self"))
+      .def("get_chunk", &get_chunk, get_chunk_docstring,
+           boost::python::args("self", "key", "chunk"))
+      .def("release_chunks", &cap::DataRecorder::release_chunks,
+           release_chunks_docstring, boost::python::args("self", "n_chunks"))
+      .def("size", &cap::DataRecorder::size,
+           "Return the number of time steps recorded since the construction.",
+           boost::python::args("self"))
+      .def("__len__", &cap::DataRecorder::get_n_values_in_memory,
+           "Return the number of time steps in memory.")
+      .def("__getitem__", &get_item,
+           "Return a copy of the values of a quantity that are in memory.")
+      // The recorder must be truthy even when it is empty since the
+      // functions that report data check `if data:` first.
+      .def("__bool__", &always_true)
+      .def("__nonzero__", &always_true);
+}
+
+} // end namespace pycap
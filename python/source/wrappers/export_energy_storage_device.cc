@@ -105,6 +105,78 @@ char const evolve_one_time_step_constant_load_docstring[] =
   "    The load in ohms.                                                    \n"
   ;
 
+char const evolve_constant_current_n_docstring[] =
+  "Impose the electrical current and evolve in time.                        \n"
+  "Take one time step per entry of currents and write the response in the   \n"
+  "given arrays without copying them. The GIL is released meanwhile.        \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "currents : numpy.ndarray                                                 \n"
+  "    The electrical current in amperes at each time step.                 \n"
+  "time, voltage, current : numpy.ndarray                                   \n"
+  "    Contiguous arrays of float64, at least as long as currents, in which \n"
+  "    the time, the voltage, and the current after each step are written.  \n"
+  "initial_time : float                                                     \n"
+  "    The time before the first step (the default is 0).                   \n"
+  ;
+
+char const evolve_constant_voltage_n_docstring[] =
+  "Impose the voltage across the device and evolve in time.                 \n"
+  "Take one time step per entry of voltages and write the response in the   \n"
+  "given arrays without copying them. The GIL is released meanwhile.        \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "voltages : numpy.ndarray                                                 \n"
+  "    The voltage in volts at each time step.                              \n"
+  "time, voltage, current : numpy.ndarray                                   \n"
+  "    Contiguous arrays of float64, at least as long as voltages, in which \n"
+  "    the time, the voltage, and the current after each step are written.  \n"
+  "initial_time : float                                                     \n"
+  "    The time before the first step (the default is 0).                   \n"
+  ;
+
+char const evolve_constant_power_n_docstring[] =
+  "Impose the power and evolve in time.                                     \n"
+  "Take one time step per entry of powers and write the response in the     \n"
+  "given arrays without copying them. The GIL is released meanwhile.        \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "powers : numpy.ndarray                                                   \n"
+  "    The power in watts at each time step.                                \n"
+  "time, voltage, current : numpy.ndarray                                   \n"
+  "    Contiguous arrays of float64, at least as long as powers, in which   \n"
+  "    the time, the voltage, and the current after each step are written.  \n"
+  "initial_time : float                                                     \n"
+  "    The time before the first step (the default is 0).                   \n"
+  ;
+
+char const evolve_constant_load_n_docstring[] =
+  "Impose the load and evolve in time.                                      \n"
+  "Take one time step per entry of loads and write the response in the      \n"
+  "given arrays without copying them. The GIL is released meanwhile.        \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "loads : numpy.ndarray                                                    \n"
+  "    The load in ohms at each time step.                                  \n"
+  "time, voltage, current : numpy.ndarray                                   \n"
+  "    Contiguous arrays of float64, at least as long as loads, in which    \n"
+  "    the time, the voltage, and the current after each step are written.  \n"
+  "initial_time : float                                                     \n"
+  "    The time before the first step (the default is 0).                   \n"
+  ;
+
 char const save_docstring[] =
   "Save the current state of the energy storage device in a file.           \n"
   "                                                                         \n"
@@ -123,8 +195,52 @@ char const load_docstring[] =
   "    The name of the file where the device has been saved.                \n"
   ;
 
+char const snapshot_docstring[] =
+  "Copy the state of the device in memory. Unlike save, this does not touch \n"
+  "the filesystem and it is cheap enough to be called at every time step,   \n"
+  "e.g. to roll back a time step or to branch a parameter sweep.            \n"
+  "                                                                         \n"
+  "Returns                                                                  \n"
+  "-------                                                                  \n"
+  "pycap.EnergyStorageDeviceSnapshot                                        \n"
+  "    Opaque state that can be given back to restore.                      \n"
+  ;
+
+char const restore_docstring[] =
+  "Set the state of the device to a snapshot. The snapshot can be restored  \n"
+  "any number of times, also on another device of the same type built from  \n"
+  "the same property tree.                                                  \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "snapshot : pycap.EnergyStorageDeviceSnapshot                             \n"
+  "    A snapshot taken on a device of the same type.                       \n"
+  ;
+
+char const compute_impedance_docstring[] =
+  "Compute the small-signal impedance of the device directly in the         \n"
+  "frequency domain. The state of the device is not modified.               \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "frequencies : numpy.ndarray                                              \n"
+  "    The frequencies in hertz. They must be greater than zero.            \n"
+  "                                                                         \n"
+  "Returns                                                                  \n"
+  "-------                                                                  \n"
+  "numpy.ndarray of complex                                                 \n"
+  "    The impedance in ohms at each frequency.                             \n"
+  ;
+
 void export_energy_storage_device()
 {
+  boost::python::class_<cap::EnergyStorageDeviceSnapshot,
+                        std::shared_ptr<cap::EnergyStorageDeviceSnapshot>,
+                        boost::noncopyable>(
+    "EnergyStorageDeviceSnapshot",
+    "In-memory state of an EnergyStorageDevice returned by snapshot.",
+    boost::python::no_init);
+
   boost::python::class_<cap::EnergyStorageDevice,
                         std::shared_ptr<cap::EnergyStorageDevice>,
                         boost::noncopyable> (
@@ -152,33 +268,80 @@ void export_energy_storage_device()
     .def("inspect", &inspect, inspect_overloads(
         boost::python::args("self", "type"), inspect_docstring))
     .def("evolve_one_time_step_constant_current",
-         &cap::EnergyStorageDevice::evolve_one_time_step_constant_current,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_current>,
          evolve_one_time_step_constant_current_docstring,
          boost::python::args("self", "time_step", "current") )
     .def("evolve_one_time_step_constant_voltage",
-         &cap::EnergyStorageDevice::evolve_one_time_step_constant_voltage,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_voltage>,
          evolve_one_time_step_constant_voltage_docstring,
          boost::python::args("self", "time_step", "voltage") )
     .def("evolve_one_time_step_constant_power",
-         &cap::EnergyStorageDevice::evolve_one_time_step_constant_power,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_power>,
          evolve_one_time_step_constant_power_docstring,
          boost::python::args("self", "time_step", "power") )
     .def("evolve_one_time_step_constant_load",
-         &cap::EnergyStorageDevice::evolve_one_time_step_constant_load,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_load>,
          evolve_one_time_step_constant_load_docstring,
          boost::python::args("self", "time_step", "load") )
     .def("evolve_one_time_step_linear_current",
-         &cap::EnergyStorageDevice::evolve_one_time_step_linear_current,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_linear_current>,
          boost::python::args("self", "time_step", "current") )
     .def("evolve_one_time_step_linear_voltage",
-         &cap::EnergyStorageDevice::evolve_one_time_step_linear_voltage,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_linear_voltage>,
          boost::python::args("self", "time_step", "voltage") )
     .def("evolve_one_time_step_linear_power",
-         &cap::EnergyStorageDevice::evolve_one_time_step_linear_power,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_linear_power>,
          boost::python::args("self", "time_step", "power") )
     .def("evolve_one_time_step_linear_load",
-         &cap::EnergyStorageDevice::evolve_one_time_step_linear_load,
+         &evolve_one_time_step<
+             &cap::EnergyStorageDevice::evolve_one_time_step_linear_load>,
          boost::python::args("self", "time_step", "load") )
+    .def("evolve_constant_current_n",
+         &evolve_n_time_steps<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_current>,
+         evolve_constant_current_n_docstring,
+         (boost::python::arg("self"), boost::python::arg("time_step"),
+          boost::python::arg("currents"), boost::python::arg("time"),
+          boost::python::arg("voltage"), boost::python::arg("current"),
+          boost::python::arg("initial_time") = 0.))
+    .def("evolve_constant_voltage_n",
+         &evolve_n_time_steps<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_voltage>,
+         evolve_constant_voltage_n_docstring,
+         (boost::python::arg("self"), boost::python::arg("time_step"),
+          boost::python::arg("voltages"), boost::python::arg("time"),
+          boost::python::arg("voltage"), boost::python::arg("current"),
+          boost::python::arg("initial_time") = 0.))
+    .def("evolve_constant_power_n",
+         &evolve_n_time_steps<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_power>,
+         evolve_constant_power_n_docstring,
+         (boost::python::arg("self"), boost::python::arg("time_step"),
+          boost::python::arg("powers"), boost::python::arg("time"),
+          boost::python::arg("voltage"), boost::python::arg("current"),
+          boost::python::arg("initial_time") = 0.))
+    .def("evolve_constant_load_n",
+         &evolve_n_time_steps<
+             &cap::EnergyStorageDevice::evolve_one_time_step_constant_load>,
+         evolve_constant_load_n_docstring,
+         (boost::python::arg("self"), boost::python::arg("time_step"),
+          boost::python::arg("loads"), boost::python::arg("time"),
+          boost::python::arg("voltage"), boost::python::arg("current"),
+          boost::python::arg("initial_time") = 0.))
+    .def("compute_impedance", &compute_impedance,
+         compute_impedance_docstring,
+         boost::python::args("self", "frequencies"))
+    .def("snapshot", &snapshot, snapshot_docstring,
+         boost::python::args("self"))
+    .def("restore", &restore, restore_docstring,
+         boost::python::args("self", "snapshot"))
     .def("save",
          &cap::EnergyStorageDevice::save,
          save_docstring,
@@ -0,0 +1,112 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <pycap/energy_storage_device_wrappers.h>
+#include <cap/stage.h>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace pycap
+{
+
+namespace np = boost::python::numpy;
+
+np::ndarray to_ndarray(std::vector<double> const & values)
+{
+  np::ndarray array = np::empty(boost::python::make_tuple(values.size()),
+                                np::dtype::get_builtin<double>());
+  std::copy(values.begin(), values.end(),
+            reinterpret_cast<double *>(array.get_data()));
+  return array;
+}
+
+boost::python::object run_multi_stage(
+    cap::EnergyStorageDevice & device, boost::python::object & py_ptree,
+    double const initial_time = 0.,
+    boost::python::object const & py_recorder = boost::python::object(),
+    bool const record = true)
+{
+  boost::property_tree::ptree const & ptree =
+      boost::python::extract<boost::property_tree::ptree const &>(py_ptree);
+  cap::MultiStage multi_stage(ptree);
+  if (!py_recorder.is_none())
+  {
+    cap::DataRecorder & recorder =
+        boost::python::extract<cap::DataRecorder &>(py_recorder);
+    double time = initial_time;
+    {
+      ScopedGILRelease const release;
+      multi_stage.run(device, time, recorder);
+    }
+    return py_recorder;
+  }
+
+  if (!record)
+  {
+    double time = initial_time;
+    std::size_t n_time_steps;
+    {
+      ScopedGILRelease const release;
+      n_time_steps = multi_stage.run(device, time, nullptr);
+    }
+    return boost::python::make_tuple(n_time_steps, time);
+  }
+
+  cap::CyclingData data;
+  {
+    ScopedGILRelease const release;
+    data = multi_stage.run(device, initial_time);
+  }
+  boost::python::dict py_data;
+  py_data["time"] = to_ndarray(data.time);
+  py_data["current"] = to_ndarray(data.current);
+  py_data["voltage"] = to_ndarray(data.voltage);
+  return py_data;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(run_multi_stage_overloads, run_multi_stage,
+                                2, 5)
+
+char const run_multi_stage_docstring[] =
+  "Run the stages described by a property tree on the device. The whole     \n"
+  "loop over the time steps is done in C++ without holding the GIL.         \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "device : pycap.EnergyStorageDevice                                       \n"
+  "ptree : pycap.PropertyTree                                               \n"
+  "    Same schema as MultiStage (cycles, stages, stage_0, ...) or as Stage \n"
+  "    if there is no 'stages' key.                                         \n"
+  "initial_time : float                                                     \n"
+  "    Time at the beginning of the first stage (the default is 0).         \n"
+  "recorder : pycap.DataRecorder                                            \n"
+  "    If given, the data is appended to the recorder instead.              \n"
+  "record : bool                                                            \n"
+  "    If False and no recorder is given, nothing is recorded (the default  \n"
+  "    is True).                                                            \n"
+  "                                                                         \n"
+  "Returns                                                                  \n"
+  "-------                                                                  \n"
+  "dict or pycap.DataRecorder or tuple                                      \n"
+  "    The time, current, and voltage after each time step as numpy arrays, \n"
+  "    the recorder if one is given, or the number of time steps and the    \n"
+  "    time at the end of the last stage if record is False.                \n"
+  ;
+
+void export_multi_stage()
+{
+  boost::python::def("run_multi_stage", &run_multi_stage,
+                     run_multi_stage_overloads(
+                         boost::python::args("device", "ptree",
+                                             "initial_time", "recorder",
+                                             "record"),
+                         run_multi_stage_docstring));
+}
+
+} // end namespace pycap
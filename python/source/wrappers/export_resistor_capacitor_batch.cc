@@ -0,0 +1,260 @@
+/* Copyright (c) 2017, the Cap authors.
+ *
+ * This file is subject to the Modified BSD License and may not be distributed
+ * without copyright and license information. Please refer to the file LICENSE
+ * for the text and further information on this license.
+ */
+
+#include <pycap/energy_storage_device_wrappers.h>
+#include <cap/resistor_capacitor_batch.h>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace pycap
+{
+
+namespace np = boost::python::numpy;
+
+template <typename Batch>
+std::shared_ptr<Batch> build_batch(std::size_t const n,
+                                   boost::python::object &py_ptree)
+{
+  boost::property_tree::ptree const & ptree =
+      boost::python::extract<boost::property_tree::ptree const &>(py_ptree);
+  return std::make_shared<Batch>(n, ptree);
+}
+
+// The arrays returned by get_state() and get_parameter() are views on the
+// memory of the batch. The batch is kept alive as long as the arrays are.
+template <typename Batch, std::vector<double> Batch::*member>
+np::ndarray get_state(boost::python::object const & self)
+{
+  Batch & batch = boost::python::extract<Batch &>(self);
+  std::vector<double> & values = batch.*member;
+  return np::from_data(values.data(), np::dtype::get_builtin<double>(),
+                       boost::python::make_tuple(values.size()),
+                       boost::python::make_tuple(sizeof(double)), self);
+}
+
+// The parameters cannot be modified so the arrays are read-only.
+template <typename Batch, std::vector<double> const Batch::*member>
+np::ndarray get_parameter(boost::python::object const & self)
+{
+  Batch const & batch = boost::python::extract<Batch const &>(self);
+  std::vector<double> const & values = batch.*member;
+  return np::from_data(values.data(), np::dtype::get_builtin<double>(),
+                       boost::python::make_tuple(values.size()),
+                       boost::python::make_tuple(sizeof(double)), self);
+}
+
+template <typename Batch,
+          void (Batch::*evolve)(double, std::vector<double> const &)>
+void evolve_one_time_step(Batch & batch, double const delta_t,
+                          np::ndarray const & values)
+{
+  (batch.*evolve)(delta_t, to_vector(values));
+}
+
+// Define the function for a value shared by all the circuits and for an
+// array of values. The overload taking an array is registered last so that
+// Boost.Python tries it first.
+template <typename Class, typename Batch,
+          void (Batch::*scalar)(double, double),
+          void (Batch::*vector)(double, std::vector<double> const &)>
+void def_evolve_one_time_step(Class & batch_class, char const * name,
+                              char const * value_name,
+                              char const * docstring)
+{
+  batch_class.def(name, scalar, docstring,
+                  boost::python::args("self", "time_step", value_name));
+  batch_class.def(name, &evolve_one_time_step<Batch, vector>, docstring,
+                  boost::python::args("self", "time_step", value_name));
+}
+
+char const evolve_one_time_step_constant_current_docstring[] =
+  "Impose the electrical current and evolve all the circuits in time.      \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "current : float or numpy.ndarray                                         \n"
+  "    The electrical current in amperes, either shared by all the circuits \n"
+  "    or given for each circuit.                                           \n"
+  ;
+
+char const evolve_one_time_step_constant_voltage_docstring[] =
+  "Impose the voltage and evolve all the circuits in time.                  \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "voltage : float or numpy.ndarray                                         \n"
+  "    The voltage in volts, either shared by all the circuits or given for \n"
+  "    each circuit.                                                        \n"
+  ;
+
+char const evolve_one_time_step_constant_power_docstring[] =
+  "Impose the power and evolve all the circuits in time.                    \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "power : float or numpy.ndarray                                           \n"
+  "    The power in watts, either shared by all the circuits or given for   \n"
+  "    each circuit.                                                        \n"
+  ;
+
+char const evolve_one_time_step_constant_load_docstring[] =
+  "Impose the load and evolve all the circuits in time.                     \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "load : float or numpy.ndarray                                            \n"
+  "    The load in ohms, either shared by all the circuits or given for     \n"
+  "    each circuit.                                                        \n"
+  ;
+
+char const evolve_one_time_step_linear_current_docstring[] =
+  "Ramp the electrical current linearly and evolve all the circuits in     \n"
+  "time.                                                                    \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "current : float or numpy.ndarray                                         \n"
+  "    The electrical current in amperes at the end of the time step.       \n"
+  ;
+
+char const evolve_one_time_step_linear_voltage_docstring[] =
+  "Ramp the voltage linearly and evolve all the circuits in time.           \n"
+  "                                                                         \n"
+  "Parameters                                                               \n"
+  "----------                                                               \n"
+  "time_step : float                                                        \n"
+  "    The time step in seconds.                                            \n"
+  "voltage : float or numpy.ndarray                                         \n"
+  "    The voltage in volts at the end of the time step.                    \n"
+  ;
+
+template <typename Batch>
+boost::python::class_<Batch, std::shared_ptr<Batch>, boost::noncopyable>
+export_batch(char const * name, char const * docstring)
+{
+  typedef boost::python::class_<Batch, std::shared_ptr<Batch>,
+                                boost::noncopyable> Class;
+  Class batch_class(name, docstring, boost::python::no_init);
+  batch_class
+    .def("__init__",
+    boost::python::make_constructor(&build_batch<Batch>,
+    boost::python::default_call_policies(),
+    boost::python::args("n", "ptree")),
+    "                                                                       \n"
+    "Parameters                                                             \n"
+    "----------                                                             \n"
+    "n : int                                                                \n"
+    "    The number of circuits.                                            \n"
+    "ptree : pycap.PropertyTree                                             \n"
+    "    The property tree used to build each circuit.                      \n"
+    )
+    .def("__len__", &Batch::size)
+    .add_property("U_C", &get_state<Batch, &Batch::U_C>,
+                  "Voltage across the capacitors in volts.")
+    .add_property("U", &get_state<Batch, &Batch::U>,
+                  "Voltage across the circuits in volts.")
+    .add_property("I", &get_state<Batch, &Batch::I>,
+                  "Electrical current in amperes.")
+    ;
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_constant_current,
+    &Batch::evolve_one_time_step_constant_current>(
+    batch_class, "evolve_one_time_step_constant_current", "current",
+    evolve_one_time_step_constant_current_docstring);
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_constant_voltage,
+    &Batch::evolve_one_time_step_constant_voltage>(
+    batch_class, "evolve_one_time_step_constant_voltage", "voltage",
+    evolve_one_time_step_constant_voltage_docstring);
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_constant_power,
+    &Batch::evolve_one_time_step_constant_power>(
+    batch_class, "evolve_one_time_step_constant_power", "power",
+    evolve_one_time_step_constant_power_docstring);
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_constant_load,
+    &Batch::evolve_one_time_step_constant_load>(
+    batch_class, "evolve_one_time_step_constant_load", "load",
+    evolve_one_time_step_constant_load_docstring);
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_linear_current,
+    &Batch::evolve_one_time_step_linear_current>(
+    batch_class, "evolve_one_time_step_linear_current", "current",
+    evolve_one_time_step_linear_current_docstring);
+  def_evolve_one_time_step<Class, Batch,
+    &Batch::evolve_one_time_step_linear_voltage,
+    &Batch::evolve_one_time_step_linear_voltage>(
+    batch_class, "evolve_one_time_step_linear_voltage", "voltage",
+    evolve_one_time_step_linear_voltage_docstring);
+  return batch_class;
+}
+
+char const series_rc_batch_docstring[] =
+  "Batch of series RC circuits stored as arrays                             \n"
+  "                                                                         \n"
+  "The state of the circuits is exposed as numpy arrays that share the      \n"
+  "memory of the batch.                                                     \n"
+  "                                                                         \n"
+  "Examples                                                                 \n"
+  "--------                                                                 \n"
+  ">>> from pycap import PropertyTree, SeriesRCBatch                        \n"
+  ">>> ptree = PropertyTree()                                               \n"
+  ">>> ptree.parse_info('series_rc.info')                                   \n"
+  ">>> batch = SeriesRCBatch(10000, ptree)                                  \n"
+  ">>> batch.evolve_one_time_step_constant_current(0.1, 0.01)               \n"
+  ">>> U = batch.U # <- voltage of each circuit in volts                    \n"
+  "                                                                         \n"
+  ;
+
+char const parallel_rc_batch_docstring[] =
+  "Batch of parallel RC circuits stored as arrays                           \n"
+  "                                                                         \n"
+  "The state of the circuits is exposed as numpy arrays that share the      \n"
+  "memory of the batch.                                                     \n"
+  ;
+
+void export_resistor_capacitor_batch()
+{
+  export_batch<cap::SeriesRCBatch>("SeriesRCBatch", series_rc_batch_docstring)
+    .add_property("R",
+                  &get_parameter<cap::SeriesRCBatch, &cap::SeriesRCBatch::R>,
+                  "Series resistance in ohms (read-only).")
+    .add_property("C",
+                  &get_parameter<cap::SeriesRCBatch, &cap::SeriesRCBatch::C>,
+                  "Capacitance in farads (read-only).")
+    ;
+  export_batch<cap::ParallelRCBatch>("ParallelRCBatch",
+                                     parallel_rc_batch_docstring)
+    .add_property("R_series",
+                  &get_parameter<cap::ParallelRCBatch,
+                                 &cap::ParallelRCBatch::R_series>,
+                  "Series resistance in ohms (read-only).")
+    .add_property("R_parallel",
+                  &get_parameter<cap::ParallelRCBatch,
+                                 &cap::ParallelRCBatch::R_parallel>,
+                  "Parallel resistance in ohms (read-only).")
+    .add_property("C",
+                  &get_parameter<cap::ParallelRCBatch,
+                                 &cap::ParallelRCBatch::C>,
+                  "Capacitance in farads (read-only).")
+    ;
+}
+
+} // end namespace pycap
@@ -7,11 +7,15 @@
 
 #include <cap/version.h>
 #include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
 
 namespace pycap
 {
 void export_property_tree();
 void export_energy_storage_device();
+void export_resistor_capacitor_batch();
+void export_multi_stage();
+void export_data_recorder();
 }
 
 char const * pycap_docstring =
@@ -43,12 +47,16 @@ char const * pycap_docstring =
   "PropertyTree                                                             \n"
   "    Wrappers for Boost.PropertyTree                                      \n"
   "    A tree data structure that stores configuration data.                \n"
+  "DataRecorder                                                             \n"
+  "    Records the response of a device in chunks without copying.          \n"
   "                                                                         \n"
   "Available energy storage devices                                         \n"
   "--------------------------------                                         \n"
   "EnergyStorageDevice                                                      \n"
   "    Wrappers for Cap.EnergyStorageDevice                                 \n"
   "    See documentation.                                                   \n"
+  "SeriesRCBatch, ParallelRCBatch                                           \n"
+  "    Many equivalent circuits advanced in time together.                  \n"
   "                                                                         \n"
   "Available electrochemical techniques                                     \n"
   "------------------------------------                                     \n"
@@ -59,6 +67,8 @@ char const * pycap_docstring =
   "    end.                                                                 \n"
   "CyclicChargeDischarge                                                    \n"
   "    Records charge and discharge curves through a number of cycles.      \n"
+  "run_multi_stage                                                          \n"
+  "    Runs the stages of a charge or discharge entirely in C++.            \n"
   "CyclicVoltammetry                                                        \n"
   "    Applies cyclic linear voltage ramps.                                 \n"
   "ElectrochemicalImpedanceSpectroscopy                                     \n"
@@ -82,8 +92,16 @@ BOOST_PYTHON_MODULE(PyCap)
   doc_options.enable_py_signatures();
   doc_options.disable_cpp_signatures();
 
+  boost::python::numpy::initialize();
+
   pycap::export_energy_storage_device();
 
+  pycap::export_resistor_capacitor_batch();
+
+  pycap::export_multi_stage();
+
+  pycap::export_data_recorder();
+
   pycap::export_property_tree();
 }
 
@@ -6,6 +6,8 @@
 
 from pycap import PropertyTree, EnergyStorageDevice
 from mpi4py import MPI
+from threading import Thread
+import numpy
 import unittest
 import os
 
@@ -104,6 +106,92 @@ class capEnergyStorageDeviceWrappersTestCase(unittest.TestCase):
             device.evolve_one_time_step_constant_voltage(dt, U)
             self.assertAlmostEqual(device.get_voltage(), U)
 
+    def test_evolve_n_time_steps(self):
+        ptree = PropertyTree()
+        ptree.parse_info('series_rc.info')
+        dt = 0.1
+        currents = numpy.linspace(1e-3, 5e-3, 10)
+        # reference computed one time step at a time
+        device = EnergyStorageDevice(ptree)
+        voltage_ref = numpy.zeros(10)
+        for k, I in enumerate(currents):
+            device.evolve_one_time_step_constant_current(dt, I)
+            voltage_ref[k] = device.get_voltage()
+        # the response is written in the arrays provided by the caller
+        device = EnergyStorageDevice(ptree)
+        time = numpy.zeros(10)
+        voltage = numpy.zeros(10)
+        current = numpy.zeros(10)
+        device.evolve_constant_current_n(dt, currents, time, voltage, current)
+        numpy.testing.assert_allclose(time, dt * numpy.arange(1, 11))
+        numpy.testing.assert_allclose(current, currents)
+        numpy.testing.assert_allclose(voltage, voltage_ref)
+        # chain with a rest and write in a view of a larger array
+        buffers = numpy.zeros((3, 20))
+        device.evolve_constant_current_n(dt, numpy.zeros(5), buffers[0, 10:15],
+                                         buffers[1, 10:15], buffers[2, 10:15],
+                                         initial_time=time[-1])
+        self.assertAlmostEqual(buffers[0, 14], 1.5)
+        self.assertAlmostEqual(buffers[2, 14], 0.0)
+        self.assertAlmostEqual(buffers[1, 14], buffers[1, 10])
+        # invalid buffers
+        self.assertRaises(RuntimeError, device.evolve_constant_voltage_n,
+                          dt, numpy.ones(10), time[:5], voltage, current)
+        self.assertRaises(RuntimeError, device.evolve_constant_voltage_n,
+                          dt, numpy.ones(10), time, voltage[::-1], current)
+        self.assertRaises(RuntimeError, device.evolve_constant_voltage_n,
+                          dt, numpy.ones(10), time, voltage,
+                          numpy.zeros(10, dtype=numpy.float32))
+
+    def test_evolve_devices_in_threads(self):
+        ptree = PropertyTree()
+        ptree.parse_info('series_rc.info')
+        n_devices = 4
+        n_steps = 100
+        devices = [EnergyStorageDevice(ptree) for i in range(n_devices)]
+        data = numpy.zeros((n_devices, 3, n_steps))
+
+        def charge(i):
+            devices[i].evolve_constant_power_n(
+                0.1, 1e-3 * (i + 1) * numpy.ones(n_steps),
+                data[i, 0], data[i, 1], data[i, 2])
+        threads = [Thread(target=charge, args=(i,)) for i in range(n_devices)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for i in range(n_devices):
+            numpy.testing.assert_allclose(data[i, 1] * data[i, 2],
+                                          1e-3 * (i + 1), rtol=1e-6)
+
+    def test_snapshot_restore(self):
+        for filename in valid_device_input:
+            ptree = PropertyTree()
+            ptree.parse_info(filename)
+            device = EnergyStorageDevice(ptree)
+            dt = 0.1  # time_step in seconds
+            I = 5e-3  # current in amperes
+            device.evolve_one_time_step_constant_current(dt, I)
+            snapshot = device.snapshot()
+            voltage = device.get_voltage()
+            # branch twice from the same state
+            branch_voltage = []
+            for i in range(2):
+                device.restore(snapshot)
+                self.assertAlmostEqual(device.get_voltage(), voltage)
+                device.evolve_one_time_step_constant_current(dt, -I)
+                branch_voltage.append(device.get_voltage())
+            self.assertAlmostEqual(branch_voltage[0], branch_voltage[1])
+            # restore on another device of the same type
+            new_device = EnergyStorageDevice(ptree)
+            new_device.restore(snapshot)
+            self.assertAlmostEqual(new_device.get_voltage(), voltage)
+        # a snapshot cannot be restored on a device of another type
+        ptree = PropertyTree()
+        ptree.parse_info('parallel_rc.info')
+        self.assertRaises(RuntimeError, EnergyStorageDevice(ptree).restore,
+                          snapshot)
+
     def test_checkpoint_restart(self):
         # check rc devices
         for filename in valid_device_input[0:2]:
@@ -172,6 +172,42 @@ class ImpedanceSpectroscopyTestCase(unittest.TestCase):
             self.assertLessEqual(max_phase_error_in_degree, 1)
             self.assertLessEqual(max_magniture_error_in_decibel, 0.2)
 
+    def test_frequency_domain(self):
+        R = 50e-3   # ohm
+        R_L = 500   # ohm
+        C = 3       # farad
+        ptree = PropertyTree()
+        ptree.put_string('type', 'ElectrochemicalImpedanceSpectroscopy')
+        ptree.put_double('frequency_upper_limit', 1e+4)
+        ptree.put_double('frequency_lower_limit', 1e-6)
+        ptree.put_int('steps_per_decade', 3)
+        ptree.put_string('method', 'frequency_domain')
+        eis = Experiment(ptree)
+        device_database = PropertyTree()
+        device_database.put_double('series_resistance', R)
+        device_database.put_double('parallel_resistance', R_L)
+        device_database.put_double('capacitance', C)
+        Z = {}
+        Z['SeriesRC'] = lambda f: R + 1 / (1j * C * 2 * pi * f)
+        Z['ParallelRC'] = lambda f: R + R_L / (1 + 1j * R_L * C * 2 * pi * f)
+        for device_type in ['SeriesRC', 'ParallelRC']:
+            device_database.put_string('type', device_type)
+            device = EnergyStorageDevice(device_database)
+            eis.reset()
+            eis.run(device)
+            f = eis._data['frequency']
+            self.assertTrue(all(equal(f, eis._frequencies)))
+            Z_exact = Z[device_type](f)
+            self.assertLess(linalg.norm(
+                (eis._data['impedance'] - Z_exact) / Z_exact, inf), 1e-12)
+        # the frequencies must be positive
+        self.assertRaises(RuntimeError, device.compute_impedance,
+                          array([1., 0.]))
+        # invalid method
+        ptree.put_string('method', 'laplace_domain')
+        eis = Experiment(ptree)
+        self.assertRaises(RuntimeError, eis.run, device)
+
     def test_export_eclab_ascii_format(self):
         # define dummy experiment
         # it is quicker than building an actual EIS experiment
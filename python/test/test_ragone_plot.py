@@ -14,6 +14,7 @@ from pycap import PropertyTree, EnergyStorageDevice, Experiment,\
 from pycap import retrieve_performance_data
 from numpy import sqrt, log, inf, linalg
 from h5py import File
+from mpi4py import MPI
 import unittest
 
 
@@ -114,6 +115,49 @@ class RagoneAnalysisTestCase(unittest.TestCase):
                 inf)
             self.assertLess(max_percent_error, 0.1)
 
+    def test_parallel_sweep(self):
+        R = 50e-3  # ohm
+        C = 3      # farad
+        U_i = 2.7  # volt
+        U_f = 1.2  # volt
+        ptree = PropertyTree()
+        ptree.put_double('discharge_power_lower_limit', 1e-2)
+        ptree.put_double('discharge_power_upper_limit', 1e+2)
+        ptree.put_int('steps_per_decade', 2)
+        ptree.put_double('initial_voltage', U_i)
+        ptree.put_double('final_voltage', U_f)
+        ptree.put_double('time_step', 15)
+        ptree.put_int('min_steps_per_discharge', 2000)
+        ptree.put_int('max_steps_per_discharge', 3000)
+        device_database = PropertyTree()
+        device_database.put_string('type', 'SeriesRC')
+        device_database.put_double('series_resistance', R)
+        device_database.put_double('capacitance', C)
+        # each process measures its own points and the results are gathered
+        # on all the processes
+        comm = MPI.COMM_WORLD
+        ragone = RagoneAnalysis(ptree)
+        filename = 'trash_parallel.hdf5'
+        if comm.rank == 0:
+            with File(filename, 'w') as fout:
+                ragone.run_parallel(device_database, fout, comm)
+            with File(filename, 'r') as fin:
+                retrieved_data = retrieve_performance_data(fin)
+            self.assertEqual(linalg.norm(ragone._data['energy'] -
+                                         retrieved_data['energy'], inf), 0.0)
+        else:
+            ragone.run_parallel(device_database, comm=comm)
+        P = ragone._data['power']
+        self.assertGreaterEqual(len(P), 8)
+        U_0 = U_i / 2 + sqrt(U_i**2 / 4 - R * P)
+        E_exact = C / 2 * (-R * P * log(U_0**2 / U_f**2) + U_0**2 - U_f**2)
+        max_percent_error = 100 * linalg.norm(
+            (ragone._data['energy'] - E_exact) / E_exact, inf)
+        self.assertLess(max_percent_error, 0.1)
+        # the number of processes must be a multiple of ranks_per_device
+        self.assertRaises(RuntimeError, ragone.run_parallel, device_database,
+                          None, comm, comm.size + 1)
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,68 @@
+# Copyright (c) 2017, the Cap authors.
+#
+# This file is subject to the Modified BSD License and may not be distributed
+# without copyright and license information. Please refer to the file LICENSE
+# for the text and further information on this license.
+
+from pycap import PropertyTree, EnergyStorageDevice
+from pycap import SeriesRCBatch, ParallelRCBatch
+import numpy
+import unittest
+
+
+class capResistorCapacitorBatchWrappersTestCase(unittest.TestCase):
+
+    def test_same_as_energy_storage_device(self):
+        n = 10
+        dt = 0.1
+        for filename, Batch in [('series_rc.info', SeriesRCBatch),
+                                ('parallel_rc.info', ParallelRCBatch)]:
+            ptree = PropertyTree()
+            ptree.parse_info(filename)
+            batch = Batch(n, ptree)
+            self.assertEqual(len(batch), n)
+            device = EnergyStorageDevice(ptree)
+            batch.evolve_one_time_step_constant_current(dt, 0.1)
+            device.evolve_one_time_step_constant_current(dt, 0.1)
+            batch.evolve_one_time_step_constant_voltage(dt, 2.1)
+            device.evolve_one_time_step_constant_voltage(dt, 2.1)
+            batch.evolve_one_time_step_constant_power(dt, -0.1)
+            device.evolve_one_time_step_constant_power(dt, -0.1)
+            batch.evolve_one_time_step_constant_load(dt, 10.0)
+            device.evolve_one_time_step_constant_load(dt, 10.0)
+            numpy.testing.assert_allclose(
+                batch.U, device.get_voltage(), rtol=1e-12)
+            numpy.testing.assert_allclose(
+                batch.I, device.get_current(), rtol=1e-12)
+
+    def test_array_operating_conditions(self):
+        n = 5
+        ptree = PropertyTree()
+        ptree.parse_info('series_rc.info')
+        batch = SeriesRCBatch(n, ptree)
+        current = numpy.linspace(0.1, 0.5, n)
+        batch.evolve_one_time_step_constant_current(0.1, current)
+        numpy.testing.assert_allclose(batch.I, current)
+        numpy.testing.assert_allclose(
+            batch.U_C, current * 0.1 / batch.C)
+        # the number of values must match the number of circuits
+        self.assertRaises(RuntimeError,
+                          batch.evolve_one_time_step_constant_current,
+                          0.1, numpy.ones(n + 1))
+
+    def test_arrays_are_views(self):
+        ptree = PropertyTree()
+        ptree.parse_info('series_rc.info')
+        batch = SeriesRCBatch(3, ptree)
+        U_C = batch.U_C
+        batch.evolve_one_time_step_constant_current(1.0, 3.0)
+        numpy.testing.assert_allclose(U_C, 1.0)
+        U_C[:] = 0.0
+        numpy.testing.assert_allclose(batch.U_C, 0.0)
+        # the parameters are read-only
+        R = batch.R
+        self.assertFalse(R.flags.writeable)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -5,10 +5,13 @@
 # for the text and further information on this license.
 
 from pycap import PropertyTree, EnergyStorageDevice
-from pycap import Stage, MultiStage
-from pycap import initialize_data
+from pycap import Stage, MultiStage, run_multi_stage
+from pycap import initialize_data, DataRecorder, stream_data
 from mpi4py import MPI
+from h5py import File
+import numpy
 import unittest
+import os
 
 comm = MPI.COMM_WORLD
 filename = 'series_rc.info'
@@ -70,6 +73,117 @@ class capStageTestCase(unittest.TestCase):
         self.assertAlmostEqual(data['voltage'][0], data['voltage'][1])
         self.assertAlmostEqual(data['current'][3], 0.0)
 
+    def test_data_recorder(self):
+        ptree = PropertyTree()
+        ptree.put_string('mode', 'constant_current')
+        ptree.put_double('current', 5e-3)
+        ptree.put_string('end_criterion', 'time')
+        ptree.put_double('duration', 1.0)
+        ptree.put_double('time_step', 0.1)
+        stage = Stage(ptree)
+        data = initialize_data()
+        stage.run(device, data)
+        recorder = DataRecorder(chunk_size=4)
+        # the recorder is truthy even when it is empty
+        self.assertTrue(recorder)
+        self.assertEqual(stage.run(device, recorder), 10)
+        self.assertEqual(stage.run(device, recorder), 10)
+        self.assertEqual(len(recorder), 20)
+        self.assertAlmostEqual(recorder.get_last_time(), 2.0)
+        self.assertEqual(recorder.get_n_chunks(), 5)
+        self.assertEqual(recorder.get_n_full_chunks(), 5)
+        numpy.testing.assert_allclose(recorder['time'][:10], data['time'])
+        numpy.testing.assert_allclose(recorder['current'][:10],
+                                      data['current'])
+        # the chunks are read-only views
+        chunk = recorder.get_chunk('voltage', 1)
+        voltage = recorder['voltage'][4:8]
+        numpy.testing.assert_array_equal(chunk, voltage)
+        self.assertFalse(chunk.flags.writeable)
+        self.assertEqual(len(recorder['time']), len(recorder))
+        # stream to a file
+        with File('trash.hdf5', 'w') as fout:
+            stream_data(recorder, 'data', fout)
+            self.assertEqual(recorder.get_n_chunks(), 0)
+            self.assertEqual(fout['data/time'].shape, (20,))
+            stage.run(device, recorder)
+            self.assertEqual(recorder.get_n_full_chunks(), 2)
+            stream_data(recorder, 'data', fout, flush=True)
+            self.assertEqual(recorder.size(), 30)
+            self.assertEqual(len(recorder), 0)
+            self.assertEqual(len(recorder['time']), 0)
+            self.assertEqual(fout['data/time'].shape, (30,))
+            self.assertAlmostEqual(fout['data/time'][-1], 3.0)
+        os.remove('trash.hdf5')
+        self.assertRaises(RuntimeError, recorder.get_chunk, 'time', 0)
+        # the views outlive the release of their chunk
+        numpy.testing.assert_array_equal(chunk, voltage)
+
+    def test_custom_evolution_and_end_criterion(self):
+        ptree = PropertyTree()
+        ptree.put_string('mode', 'constant_current')
+        ptree.put_double('current', 5e-3)
+        ptree.put_string('end_criterion', 'time')
+        ptree.put_double('duration', 1.0)
+        ptree.put_double('time_step', 0.1)
+        stage = Stage(ptree)
+        # the stage must use the replaced attributes instead of the ptree
+        calls = []
+
+        def evolve_one_time_step(device, time_step):
+            calls.append(time_step)
+            device.evolve_one_time_step_constant_current(time_step, -5e-3)
+        stage.evolve_one_time_step = evolve_one_time_step
+        stage.time_step = 0.2
+        data = initialize_data()
+        self.assertEqual(stage.run(device, data), 5)
+        self.assertEqual(calls, [0.2] * 5)
+        self.assertEqual(len(data['time']), 5)
+        self.assertAlmostEqual(data['time'][-1], 1.0)
+        self.assertAlmostEqual(data['current'][-1], -5e-3)
+
+        class StepLimit:
+
+            def reset(self, time, device):
+                self.steps = 0
+
+            def check(self, time, device):
+                self.steps += 1
+                return self.steps > 3
+        stage.end_criterion = StepLimit()
+        recorder = DataRecorder()
+        self.assertEqual(stage.run(device, recorder), 3)
+        self.assertEqual(len(recorder), 3)
+        self.assertAlmostEqual(recorder.get_last_time(), 0.6)
+
+    def test_run_multi_stage(self):
+        ptree = PropertyTree()
+        ptree.put_int('stages', 2)
+        ptree.put_int('cycles', 3)
+        ptree.put_double('time_step', 0.1)
+        ptree.put_string('stage_0.mode', 'constant_current')
+        ptree.put_double('stage_0.current', 5e-3)
+        ptree.put_string('stage_0.end_criterion', 'time')
+        ptree.put_double('stage_0.duration', 1.0)
+        ptree.put_string('stage_1.mode', 'rest')
+        ptree.put_string('stage_1.end_criterion', 'time')
+        ptree.put_double('stage_1.duration', 0.5)
+        data = run_multi_stage(device, ptree, 2.0)
+        self.assertEqual(len(data['time']), 3 * 15)
+        self.assertEqual(len(data['current']), 3 * 15)
+        self.assertEqual(len(data['voltage']), 3 * 15)
+        self.assertAlmostEqual(data['time'][0], 2.1)
+        self.assertAlmostEqual(data['time'][-1], 6.5)
+        self.assertAlmostEqual(data['current'][9], 5e-3)
+        self.assertAlmostEqual(data['current'][10], 0.0)
+        # only count the time steps
+        steps, time = run_multi_stage(device, ptree, 2.0, None, False)
+        self.assertEqual(steps, 3 * 15)
+        self.assertAlmostEqual(time, 6.5)
+        # invalid time evolution
+        ptree.put_string('stage_1.mode', 'constant_flux')
+        self.assertRaises(RuntimeError, run_multi_stage, device, ptree)
+
 
 if __name__ == '__main__':
     unittest.main()